@@ -229,6 +229,169 @@ class HashTable(InitializableLookupTableBase):
       super(HashTable, self).__init__(table_ref, default_value, initializer)
 
 
+class MutableHashTable(LookupInterface):
+  """A generic mutable hash table implementation.
+
+  Unlike `HashTable`, the table needs no initializer: it starts empty, and
+  entries can be inserted or updated at any time, concurrently with lookups.
+
+  Example usage:
+
+  ```python
+  table = tf.contrib.lookup.MutableHashTable(key_dtype=tf.string,
+                                             value_dtype=tf.int64,
+                                             default_value=-1)
+  table.insert(keys, values).run()
+  out = table.lookup(query_keys)
+  print out.eval()
+  ```
+  """
+
+  def __init__(self, key_dtype, value_dtype, default_value, shared_name=None,
+               name="MutableHashTable"):
+    """Creates an empty `MutableHashTable` object.
+
+    Creates a table, the type of its keys and values are specified by key_dtype
+    and value_dtype, respectively.
+
+    Args:
+      key_dtype: the type of the key tensors.
+      value_dtype: the type of the value tensors.
+      default_value: The value to use if a key is missing in the table.
+      shared_name: If non-empty, this table will be shared under
+        the given name across multiple sessions.
+      name: A name for the operation (optional).
+
+    Returns:
+      A `MutableHashTable` object.
+    """
+    # pylint: disable=protected-access
+    self._table_ref = gen_data_flow_ops._mutable_hash_table(
+        shared_name=shared_name,
+        key_dtype=key_dtype,
+        value_dtype=value_dtype,
+        name=name)
+    # pylint: enable=protected-access
+    super(MutableHashTable, self).__init__(key_dtype, value_dtype,
+                                           self._table_ref.op.name.split(
+                                               "/")[-1])
+    self._default_value = ops.convert_to_tensor(default_value,
+                                                dtype=self._value_dtype)
+    self._default_value.get_shape().merge_with(tensor_shape.scalar())
+
+  @property
+  def table_ref(self):
+    """Get the underlying table reference."""
+    return self._table_ref
+
+  @property
+  def default_value(self):
+    """The default value of the table."""
+    return self._default_value
+
+  def size(self, name=None):
+    """Compute the number of elements in this table.
+
+    Args:
+      name: A name for the operation (optional).
+
+    Returns:
+      A scalar tensor containing the number of elements in this table.
+    """
+    if name is None:
+      name = "%s_Size" % self._name
+    # pylint: disable=protected-access
+    return gen_data_flow_ops._lookup_table_size(self._table_ref, name=name)
+    # pylint: enable=protected-access
+
+  def lookup(self, keys, name=None):
+    """Looks up `keys` in a table, outputs the corresponding values.
+
+    The `default_value` is used for keys not present in the table.
+
+    Args:
+      keys: Keys to look up. May be either a `SparseTensor` or dense `Tensor`.
+      name: A name for the operation (optional).
+
+    Returns:
+      A `SparseTensor` if keys are sparse, otherwise a dense `Tensor`.
+
+    Raises:
+      TypeError: when `keys` doesn't match the table key data type.
+    """
+    if name is None:
+      name = "%s_lookup_table_find" % self._name
+
+    key_tensor = keys
+    if isinstance(keys, ops.SparseTensor):
+      key_tensor = keys.values
+
+    if keys.dtype != self._key_dtype:
+      raise TypeError("Signature mismatch. Keys must be dtype %s, got %s." %
+                      (self._key_dtype, keys.dtype))
+
+    # pylint: disable=protected-access
+    values = gen_data_flow_ops._lookup_table_find(self._table_ref,
+                                                  key_tensor,
+                                                  self._default_value,
+                                                  name=name)
+    # pylint: enable=protected-access
+
+    if isinstance(keys, ops.SparseTensor):
+      return ops.SparseTensor(keys.indices, values, keys.shape)
+    else:
+      return values
+
+  def insert(self, keys, values, name=None):
+    """Associates `keys` with `values`.
+
+    Keys already in the table get the new values.
+
+    Args:
+      keys: Keys to insert. Can be a tensor of any shape. Must match the
+        table's key type.
+      values: Values to be associated with keys. Must be a tensor of the same
+        shape as `keys` and match the table's value type.
+      name: A name for the operation (optional).
+
+    Returns:
+      The created Operation.
+
+    Raises:
+      TypeError: when `keys` or `values` doesn't match the table data
+        types.
+    """
+    if name is None:
+      name = "%s_lookup_table_insert" % self._name
+    keys = ops.convert_to_tensor(keys, dtype=self._key_dtype, name="keys")
+    values = ops.convert_to_tensor(values, dtype=self._value_dtype,
+                                   name="values")
+    self._check_table_dtypes(keys.dtype, values.dtype)
+    # pylint: disable=protected-access
+    return gen_data_flow_ops._lookup_table_insert(self._table_ref, keys,
+                                                  values, name=name)
+    # pylint: enable=protected-access
+
+  def export(self, name=None):
+    """Returns tensors of all keys and values in the table.
+
+    Args:
+      name: A name for the operation (optional).
+
+    Returns:
+      A pair of tensors with the first tensor containing all keys and the
+        second tensors containing all values in the table.
+    """
+    if name is None:
+      name = "%s_lookup_table_export_values" % self._name
+    # pylint: disable=protected-access
+    return gen_data_flow_ops._lookup_table_export(self._table_ref,
+                                                  self._key_dtype,
+                                                  self._value_dtype,
+                                                  name=name)
+    # pylint: enable=protected-access
+
+
 class TableInitializerBase(object):
   """Base class for lookup table initializers."""
 
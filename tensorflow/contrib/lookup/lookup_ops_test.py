@@ -20,6 +20,8 @@ from __future__ import print_function
 import numpy as np
 import tensorflow as tf
 
+from tensorflow.python.ops import gen_data_flow_ops
+
 
 class HashTableOpTest(tf.test.TestCase):
 
@@ -235,6 +237,156 @@ class HashTableOpTest(tf.test.TestCase):
                                                         values), default_val)
 
 
+class MutableHashTableOpTest(tf.test.TestCase):
+
+  def testMutableHashTable(self):
+    with self.test_session():
+      default_val = -1
+      keys = tf.constant(["brain", "salad", "surgery"])
+      values = tf.constant([0, 1, 2], tf.int64)
+      table = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                 default_val)
+      self.assertAllEqual(0, table.size().eval())
+
+      table.insert(keys, values).run()
+      self.assertAllEqual(3, table.size().eval())
+
+      input_string = tf.constant(["brain", "salad", "tank"])
+      output = table.lookup(input_string)
+
+      result = output.eval()
+      self.assertAllEqual([0, 1, -1], result)
+
+      exported_keys, exported_values = table.export()
+      self.assertAllEqual([None], exported_keys.get_shape().as_list())
+      self.assertAllEqual([None], exported_values.get_shape().as_list())
+
+      # exported data is in the order of the internal map, i.e. undefined
+      sorted_keys = np.sort(exported_keys.eval())
+      sorted_values = np.sort(exported_values.eval())
+      self.assertAllEqual([b"brain", b"salad", b"surgery"], sorted_keys)
+      self.assertAllEqual([0, 1, 2], sorted_values)
+
+  def testMutableHashTableOverwrite(self):
+    with self.test_session():
+      default_val = -1
+      table = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                 default_val)
+      table.insert(tf.constant(["brain", "salad"]),
+                   tf.constant([0, 1], tf.int64)).run()
+      table.insert(tf.constant(["salad", "surgery", "surgery"]),
+                   tf.constant([10, 2, 20], tf.int64)).run()
+      self.assertAllEqual(3, table.size().eval())
+
+      output = table.lookup(tf.constant(["brain", "salad", "surgery"]))
+      self.assertAllEqual([0, 10, 20], output.eval())
+
+  def testMutableHashTableFindHighRank(self):
+    with self.test_session():
+      default_val = -1
+      keys = tf.constant(["brain", "salad", "surgery"])
+      values = tf.constant([0, 1, 2], tf.int64)
+      table = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                 default_val)
+      table.insert(keys, values).run()
+
+      input_string = tf.constant([["brain", "salad"], ["tank", "tarkus"]])
+      output = table.lookup(input_string)
+      self.assertAllEqual([2, 2], output.get_shape())
+
+      result = output.eval()
+      self.assertAllEqual([[0, 1], [-1, -1]], result)
+
+  def testMutableHashTableInt64Float(self):
+    with self.test_session():
+      default_val = -1.0
+      keys = tf.constant([3, 7, 11], tf.int64)
+      values = tf.constant([7.5, -1.2, 9.9], tf.float32)
+      table = tf.contrib.lookup.MutableHashTable(tf.int64, tf.float32,
+                                                 default_val)
+      table.insert(keys, values).run()
+      self.assertAllEqual(3, table.size().eval())
+
+      input_keys = tf.constant([11, 7, 12], tf.int64)
+      output = table.lookup(input_keys)
+      self.assertAllClose([9.9, -1.2, -1.0], output.eval())
+
+  def testMutableHashTableManyKeys(self):
+    with self.test_session():
+      default_val = -1
+      keys = tf.range(10000)
+      table = tf.contrib.lookup.MutableHashTable(tf.int64, tf.int64,
+                                                 default_val)
+      table.insert(tf.cast(keys, tf.int64), tf.cast(keys * 2, tf.int64)).run()
+      self.assertAllEqual(10000, table.size().eval())
+
+      output = table.lookup(tf.constant([0, 4999, 9999, 10000], tf.int64))
+      self.assertAllEqual([0, 9998, 19998, -1], output.eval())
+
+      exported_keys, exported_values = table.export()
+      exported_keys = exported_keys.eval()
+      exported_values = exported_values.eval()
+      self.assertAllEqual(exported_keys * 2, exported_values)
+      self.assertAllEqual(np.arange(10000), np.sort(exported_keys))
+
+  def testMultipleMutableHashTables(self):
+    with self.test_session() as sess:
+      default_val = -1
+      keys = tf.constant(["brain", "salad", "surgery"])
+      values = tf.constant([0, 1, 2], tf.int64)
+
+      table1 = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                  default_val)
+      table2 = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                  default_val)
+      table1.insert(keys, values).run()
+      self.assertAllEqual(3, table1.size().eval())
+      self.assertAllEqual(0, table2.size().eval())
+
+      input_string = tf.constant(["brain", "salad", "tank"])
+      output1 = table1.lookup(input_string)
+      output2 = table2.lookup(input_string)
+
+      out1, out2 = sess.run([output1, output2])
+      self.assertAllEqual([0, 1, -1], out1)
+      self.assertAllEqual([-1, -1, -1], out2)
+
+  def testMutableHashTableSignatureMismatch(self):
+    with self.test_session():
+      default_val = -1
+      table = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                 default_val)
+
+      with self.assertRaises(TypeError):
+        table.lookup(tf.constant([1, 2, 3], tf.int64))
+
+      with self.assertRaises(TypeError):
+        table.insert(["a"], [1.5])
+
+  def testMutableHashTableInsertShapeMismatch(self):
+    with self.test_session():
+      default_val = -1
+      table = tf.contrib.lookup.MutableHashTable(tf.string, tf.int64,
+                                                 default_val)
+      with self.assertRaises(ValueError):
+        table.insert(tf.constant(["a", "b"]), tf.constant([1, 2, 3], tf.int64))
+
+  def testHashTableDoesNotSupportInsert(self):
+    with self.test_session():
+      keys = tf.constant(["brain", "salad", "surgery"])
+      values = tf.constant([0, 1, 2], tf.int64)
+      table = tf.contrib.lookup.HashTable(
+          tf.contrib.lookup.KeyValueTensorInitializer(keys, values), -1)
+      table.init.run()
+
+      # pylint: disable=protected-access
+      insert = gen_data_flow_ops._lookup_table_insert(table.table_ref, keys,
+                                                      values)
+      # pylint: enable=protected-access
+      with self.assertRaisesOpError("Insert is not supported"):
+        insert.run()
+
+
 class StringToIndexTest(tf.test.TestCase):
 
   def test_string_to_index(self):
@@ -115,6 +115,10 @@ bool SetTimelineLabel(const Node* node, NodeExecStats* node_stats) {
             ", "),
         ")");
   }
+  // The annotation of the kernel, if any, was stored by SetAnnotation().
+  if (!node_stats->timeline_label().empty()) {
+    text = strings::StrCat(text, " ", node_stats->timeline_label());
+  }
   node_stats->set_timeline_label(text);
   return is_transfer_node;
 }
@@ -165,6 +169,12 @@ void SetMemory(NodeExecStats* nt, OpKernelContext* ctx) {
   }
 }
 
+// Stores the annotation of the kernel in the timeline label, which
+// SetTimelineLabel() then completes.
+void SetAnnotation(NodeExecStats* nt, OpKernelContext* ctx) {
+  nt->set_timeline_label(ctx->stats_annotation());
+}
+
 void SetReferencedTensors(NodeExecStats* nt,
                           const TensorReferenceVector& tensors) {
   // be careful not to increment the reference count on any tensor
@@ -949,6 +959,7 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
   params.device = device;
   // track allocations if and only if we are collecting statistics
   params.track_allocations = (stats_collector_ != nullptr);
+  params.collect_stats = (stats_collector_ != nullptr);
   params.rendezvous = rendezvous_;
   params.session_state = session_state_;
   params.tensor_store = tensor_store_;
@@ -1063,7 +1074,10 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           if (stats_collector_) nodestats::SetOpEnd(stats);
           EntryVector outputs;
           Status s = ProcessOutputs(item, ctx, &outputs, stats);
-          if (stats_collector_) nodestats::SetMemory(stats, ctx);
+          if (stats_collector_) {
+            nodestats::SetMemory(stats, ctx);
+            nodestats::SetAnnotation(stats, ctx);
+          }
           // Clears inputs.
           int num_inputs = item.num_inputs;
           for (int i = 0; i < num_inputs; ++i) {
@@ -1120,7 +1134,10 @@ void ExecutorState::Process(TaggedNode tagged_node, int64 scheduled_usec) {
           ctx.retrieve_accessed_tensors(&accessed_tensors);
           device_context = ctx.op_device_context();
         }
-        if (stats_collector_) nodestats::SetMemory(stats, &ctx);
+        if (stats_collector_) {
+          nodestats::SetMemory(stats, &ctx);
+          nodestats::SetAnnotation(stats, &ctx);
+        }
       }
     }
 
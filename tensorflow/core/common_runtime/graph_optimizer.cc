@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/common_runtime/constant_folding.h"
 #include "tensorflow/core/common_runtime/function.h"
+#include "tensorflow/core/common_runtime/op_fusion.h"
 #include "tensorflow/core/graph/algorithm.h"
 #include "tensorflow/core/graph/optimizer_cse.h"
 
@@ -67,6 +68,11 @@ void GraphOptimizer::Optimize(FunctionLibraryRuntime* runtime, Device* device,
       }
     }
 
+    if (opts_.do_op_fusion() && DoOpFusion(device, g)) {
+      DumpGraph("OpFusion", g);
+      changed = true;
+    }
+
     if (opts_.do_function_inlining() && FixupSourceAndSinkEdges(g)) {
       DumpGraph("FixupSourceAndSinkEdges", g);
       changed = true;
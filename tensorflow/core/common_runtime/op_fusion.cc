@@ -0,0 +1,161 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/op_fusion.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Returns the node consuming the only output edge of "n", provided that edge
+// carries output 0 of "n" to input 0 of its consumer, or nullptr.
+Node* SoleConsumer(const Node* n) {
+  if (n->out_edges().size() != 1) return nullptr;
+  const Edge* e = *n->out_edges().begin();
+  if (e->IsControlEdge() || e->src_output() != 0 || e->dst_input() != 0) {
+    return nullptr;
+  }
+  return e->dst();
+}
+
+// Returns the edge feeding the data input "index" of "n", or nullptr.
+const Edge* InputEdge(const Node* n, int index) {
+  for (const Edge* e : n->in_edges()) {
+    if (e->dst_input() == index) return e;
+  }
+  return nullptr;
+}
+
+// Returns the data format of "n", "NHWC" when it has none.
+string DataFormat(const Node* n) {
+  string data_format;
+  if (!GetNodeAttr(n->def(), "data_format", &data_format).ok()) {
+    data_format = "NHWC";
+  }
+  return data_format;
+}
+
+// Returns the fused op replacing a chain starting with an "op" node, or the
+// empty string if there is none.
+string FusedOp(const string& op) {
+  if (op == "MatMul") return "_FusedMatMul";
+  if (op == "Conv2D") return "_FusedConv2D";
+  if (op == "Gather") return "_FusedGather";
+  return "";
+}
+
+// A MatMul, Conv2D or Gather node, followed by its BiasAdd and optionally a
+// Relu.
+struct Chain {
+  Node* op = nullptr;
+  Node* bias_add = nullptr;
+  Node* relu = nullptr;
+
+  Node* last() const { return relu != nullptr ? relu : bias_add; }
+};
+
+// Returns true if "n" starts a chain that can be fused, and fills "chain".
+bool FindChain(Node* n, Chain* chain) {
+  if (FusedOp(n->type_string()).empty()) return false;
+  if (n->type_string() == "Conv2D" && DataFormat(n) != "NHWC") return false;
+  Node* bias_add = SoleConsumer(n);
+  if (bias_add == nullptr || bias_add->type_string() != "BiasAdd" ||
+      DataFormat(bias_add) != "NHWC") {
+    return false;
+  }
+  chain->op = n;
+  chain->bias_add = bias_add;
+  Node* relu = SoleConsumer(bias_add);
+  if (relu != nullptr && relu->type_string() == "Relu") chain->relu = relu;
+  return true;
+}
+
+// Replaces the nodes of "chain" by one fused node, if it has a kernel on
+// "device_type".  Returns true if "graph" has been mutated.
+bool FuseChain(const DeviceType& device_type, const Chain& chain,
+               Graph* graph) {
+  Node* op = chain.op;
+  const Edge* in0 = InputEdge(op, 0);
+  const Edge* in1 = InputEdge(op, 1);
+  const Edge* bias = InputEdge(chain.bias_add, 1);
+  if (in0 == nullptr || in1 == nullptr || bias == nullptr) return false;
+
+  NodeDefBuilder builder(chain.last()->name(), FusedOp(op->type_string()));
+  builder.Input(in0->src()->name(), in0->src_output(), op->input_type(0))
+      .Input(in1->src()->name(), in1->src_output(), op->input_type(1))
+      .Input(bias->src()->name(), bias->src_output(),
+             chain.bias_add->input_type(1))
+      .Device(op->def().device());
+  for (const auto& attr : op->def().attr()) {
+    builder.Attr(attr.first, attr.second);
+  }
+  builder.Attr("activation", chain.relu != nullptr ? "Relu" : "None");
+  NodeDef def;
+  if (!builder.Finalize(&def).ok()) return false;
+  if (!FindKernelDef(device_type, def, nullptr, nullptr).ok()) return false;
+
+  Status s;
+  Node* fused = graph->AddNode(def, &s);
+  if (!s.ok()) return false;
+  fused->set_assigned_device_name(op->assigned_device_name());
+  VLOG(1) << "Fusing " << op->name() << " into " << fused->DebugString();
+
+  graph->AddEdge(in0->src(), in0->src_output(), fused, 0);
+  graph->AddEdge(in1->src(), in1->src_output(), fused, 1);
+  graph->AddEdge(bias->src(), bias->src_output(), fused, 2);
+  for (Node* n : {op, chain.bias_add, chain.relu}) {
+    if (n == nullptr) continue;
+    for (const Edge* e : n->in_edges()) {
+      if (e->IsControlEdge()) graph->AddControlEdge(e->src(), fused);
+    }
+  }
+  for (const Edge* e : chain.last()->out_edges()) {
+    graph->AddEdge(fused, e->src_output(), e->dst(), e->dst_input());
+  }
+  graph->RemoveNode(op);
+  graph->RemoveNode(chain.bias_add);
+  if (chain.relu != nullptr) graph->RemoveNode(chain.relu);
+  return true;
+}
+
+}  // namespace
+
+bool DoOpFusion(Device* partition_device, Graph* graph) {
+  DeviceType device_type = partition_device
+                               ? DeviceType{partition_device->device_type()}
+                               : DEVICE_CPU;
+  if (device_type != DEVICE_CPU) return false;
+
+  // Chains never overlap, since each has a single MatMul, Conv2D or Gather.
+  std::vector<Chain> chains;
+  for (Node* n : graph->nodes()) {
+    Chain chain;
+    if (FindChain(n, &chain)) chains.push_back(chain);
+  }
+  bool changed = false;
+  for (const Chain& chain : chains) {
+    if (FuseChain(device_type, chain, graph)) changed = true;
+  }
+  return changed;
+}
+
+}  // namespace tensorflow
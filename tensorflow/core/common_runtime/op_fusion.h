@@ -0,0 +1,40 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_COMMON_RUNTIME_OP_FUSION_H_
+#define TENSORFLOW_COMMON_RUNTIME_OP_FUSION_H_
+
+#include "tensorflow/core/common_runtime/device.h"
+#include "tensorflow/core/graph/graph.h"
+
+namespace tensorflow {
+
+// Replaces in "graph" each chain MatMul -> BiasAdd [-> Relu] by a single
+// _FusedMatMul node, each chain Conv2D -> BiasAdd [-> Relu] by a single
+// _FusedConv2D node, and each chain Gather -> BiasAdd [-> Relu] by a single
+// _FusedGather node, which apply the bias and the activation to the output of
+// the first op while it is still in cache.
+//
+// A chain is fused only when each of its nodes but the last feeds nothing but
+// the next one, so that no intermediate tensor is needed elsewhere.  The fused
+// node takes the name of the last node of the chain.  "partition_device", if
+// non-null, is the device where all the graph nodes are assumed to execute;
+// the fused kernels only exist on CPU.
+// Returns true if and only if "graph" has been mutated.
+bool DoOpFusion(Device* partition_device, Graph* graph);
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_COMMON_RUNTIME_OP_FUSION_H_
@@ -0,0 +1,210 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/op_fusion.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/node_def_util.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class OpFusionTest : public ::testing::Test {
+ protected:
+  OpFusionTest() : g_(new Graph(OpRegistry::Global())) {}
+
+  Node* Constant(const TensorShape& shape) {
+    Tensor t(DT_FLOAT, shape);
+    t.flat<float>().setZero();
+    return test::graph::Constant(g_.get(), t);
+  }
+
+  Node* BiasAdd(Node* value, Node* bias) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g_->NewName("bias_add"), "BiasAdd")
+                    .Input(value)
+                    .Input(bias)
+                    .Finalize(g_.get(), &ret));
+    return ret;
+  }
+
+  Node* Relu(Node* features) {
+    Node* ret;
+    TF_CHECK_OK(NodeBuilder(g_->NewName("relu"), "Relu")
+                    .Input(features)
+                    .Finalize(g_.get(), &ret));
+    return ret;
+  }
+
+  Node* Send(Node* n) {
+    return test::graph::Send(g_.get(), n, n->name(), "sender", 0, "receiver");
+  }
+
+  // Returns the only input of "n".
+  static Node* Input(const Node* n) {
+    EXPECT_EQ(1, n->num_inputs());
+    return *n->in_nodes().begin();
+  }
+
+  // Checks that "n" is a "fused_op" node named "name", with "activation",
+  // computed from "in0", "in1" and "bias".
+  static void ExpectFused(const Node* n, const string& fused_op,
+                          const string& name, const string& activation,
+                          const Node* in0, const Node* in1, const Node* bias) {
+    EXPECT_EQ(fused_op, n->type_string());
+    EXPECT_EQ(name, n->name());
+    string value;
+    TF_EXPECT_OK(GetNodeAttr(n->def(), "activation", &value));
+    EXPECT_EQ(activation, value);
+    std::vector<const Node*> inputs(3);
+    for (const Edge* e : n->in_edges()) {
+      if (!e->IsControlEdge()) inputs[e->dst_input()] = e->src();
+    }
+    EXPECT_EQ(in0, inputs[0]);
+    EXPECT_EQ(in1, inputs[1]);
+    EXPECT_EQ(bias, inputs[2]);
+  }
+
+  std::unique_ptr<Graph> g_;
+};
+
+TEST_F(OpFusionTest, MatMulBiasAddRelu) {
+  Node* a = Constant({2, 3});
+  Node* b = Constant({3, 4});
+  Node* bias = Constant({4});
+  Node* relu = Relu(BiasAdd(test::graph::Matmul(g_.get(), a, b, false, true),
+                            bias));
+  const string name = relu->name();
+  Node* send = Send(relu);
+  const int num_nodes = g_->num_nodes();
+
+  EXPECT_TRUE(DoOpFusion(nullptr, g_.get()));
+  EXPECT_EQ(num_nodes - 2, g_->num_nodes());
+  Node* fused = Input(send);
+  ExpectFused(fused, "_FusedMatMul", name, "Relu", a, b, bias);
+  bool transpose_b;
+  TF_EXPECT_OK(GetNodeAttr(fused->def(), "transpose_b", &transpose_b));
+  EXPECT_TRUE(transpose_b);
+
+  // There is nothing left to fuse.
+  EXPECT_FALSE(DoOpFusion(nullptr, g_.get()));
+}
+
+TEST_F(OpFusionTest, MatMulBiasAdd) {
+  Node* a = Constant({2, 3});
+  Node* b = Constant({3, 4});
+  Node* bias = Constant({4});
+  Node* bias_add =
+      BiasAdd(test::graph::Matmul(g_.get(), a, b, false, false), bias);
+  const string name = bias_add->name();
+  Node* send = Send(bias_add);
+
+  EXPECT_TRUE(DoOpFusion(nullptr, g_.get()));
+  ExpectFused(Input(send), "_FusedMatMul", name, "None", a, b, bias);
+}
+
+TEST_F(OpFusionTest, Conv2DBiasAddRelu) {
+  Node* input = Constant({1, 5, 5, 3});
+  Node* filter = Constant({3, 3, 3, 8});
+  Node* bias = Constant({8});
+  Node* conv;
+  TF_ASSERT_OK(NodeBuilder("conv", "Conv2D")
+                   .Input(input)
+                   .Input(filter)
+                   .Attr("strides", {1, 1, 1, 1})
+                   .Attr("padding", "SAME")
+                   .Finalize(g_.get(), &conv));
+  Node* relu = Relu(BiasAdd(conv, bias));
+  const string name = relu->name();
+  Node* send = Send(relu);
+
+  EXPECT_TRUE(DoOpFusion(nullptr, g_.get()));
+  Node* fused = Input(send);
+  ExpectFused(fused, "_FusedConv2D", name, "Relu", input, filter, bias);
+  string padding;
+  TF_EXPECT_OK(GetNodeAttr(fused->def(), "padding", &padding));
+  EXPECT_EQ("SAME", padding);
+}
+
+TEST_F(OpFusionTest, GatherBiasAddRelu) {
+  Node* params = Constant({10, 4});
+  Tensor indices(DT_INT32, {3});
+  test::FillValues<int32>(&indices, {1, 5, 1});
+  Node* indices_node = test::graph::Constant(g_.get(), indices);
+  Node* bias = Constant({4});
+  Node* relu = Relu(
+      BiasAdd(test::graph::Gather(g_.get(), params, indices_node), bias));
+  const string name = relu->name();
+  Node* send = Send(relu);
+
+  EXPECT_TRUE(DoOpFusion(nullptr, g_.get()));
+  Node* fused = Input(send);
+  ExpectFused(fused, "_FusedGather", name, "Relu", params, indices_node, bias);
+  DataType index_type;
+  TF_EXPECT_OK(GetNodeAttr(fused->def(), "Tindices", &index_type));
+  EXPECT_EQ(DT_INT32, index_type);
+}
+
+TEST_F(OpFusionTest, IntermediateOutputUsedElsewhere) {
+  // The output of the MatMul is also sent, so it must be kept.
+  Node* matmul = test::graph::Matmul(g_.get(), Constant({2, 3}),
+                                     Constant({3, 4}), false, false);
+  Node* relu = Relu(BiasAdd(matmul, Constant({4})));
+  Send(matmul);
+  Node* send = Send(relu);
+  EXPECT_FALSE(DoOpFusion(nullptr, g_.get()));
+  EXPECT_EQ(relu, Input(send));
+}
+
+TEST_F(OpFusionTest, BiasAddUsedElsewhere) {
+  // The Relu is not fused, since the BiasAdd feeds another node.
+  Node* a = Constant({2, 3});
+  Node* b = Constant({3, 4});
+  Node* bias = Constant({4});
+  Node* bias_add =
+      BiasAdd(test::graph::Matmul(g_.get(), a, b, false, false), bias);
+  const string name = bias_add->name();
+  Node* relu = Relu(bias_add);
+  Node* send = Send(bias_add);
+  Send(relu);
+
+  EXPECT_TRUE(DoOpFusion(nullptr, g_.get()));
+  Node* fused = Input(send);
+  ExpectFused(fused, "_FusedMatMul", name, "None", a, b, bias);
+  EXPECT_EQ(fused, Input(relu));
+}
+
+TEST_F(OpFusionTest, UnsupportedType) {
+  // There is no fused kernel for int32.
+  Tensor a(DT_INT32, {2, 2});
+  a.flat<int32>().setZero();
+  Node* a_node = test::graph::Constant(g_.get(), a);
+  Tensor bias(DT_INT32, {2});
+  bias.flat<int32>().setZero();
+  Node* matmul = test::graph::Matmul(g_.get(), a_node, a_node, false, false);
+  Send(BiasAdd(matmul, test::graph::Constant(g_.get(), bias)));
+  EXPECT_FALSE(DoOpFusion(nullptr, g_.get()));
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -41,6 +41,14 @@ Status LookupInterface::CheckKeyAndValueTensors(const Tensor& key,
   return Status::OK();
 }
 
+Status LookupInterface::Insert(const Tensor& keys, const Tensor& values) {
+  return errors::Unimplemented("Insert is not supported by this table.");
+}
+
+Status LookupInterface::ExportValues(OpKernelContext* ctx) {
+  return errors::Unimplemented("Export is not supported by this table.");
+}
+
 Status LookupInterface::CheckFindArguments(const Tensor& key,
                                            const Tensor& value,
                                            const Tensor& default_value) {
@@ -21,6 +21,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 
 namespace tensorflow {
+
+class OpKernelContext;
+
 namespace lookup {
 
 // Forward declaration so we can define GetInitializableLookupTable() in
@@ -47,6 +50,20 @@ class LookupInterface : public ResourceBase {
   virtual Status Find(const Tensor& keys, Tensor* values,
                       const Tensor& default_value) = 0;
 
+  // Inserts or updates the entries of "keys", with the corresponding
+  // elements of "values".  Tables that cannot be changed once built return
+  // Unimplemented.
+  //
+  // Returns the following statuses:
+  // - OK: when the insert finishes successfully.
+  // - InvalidArgument: if any of the preconditions on the key or value fails.
+  // - Unimplemented: if the table does not support inserts.
+  virtual Status Insert(const Tensor& keys, const Tensor& values);
+
+  // Outputs all the entries of the table as two vectors, "keys" and
+  // "values", of "ctx".  Tables that do not support it return Unimplemented.
+  virtual Status ExportValues(OpKernelContext* ctx);
+
   // Returns the number of elements in the table.
   virtual size_t size() const = 0;
 
@@ -491,6 +491,10 @@ class OpKernelContext {
 
     bool track_allocations = false;
 
+    // True if the executor is collecting step stats, in which case the
+    // kernel may annotate them with set_stats_annotation().
+    bool collect_stats = false;
+
     // Array indexed by output number for this node
     const AllocatorAttributes* output_attr_array = nullptr;
 
@@ -909,6 +913,18 @@ class OpKernelContext {
     return params_->cancellation_manager;
   }
 
+  // Step stats.
+  //
+  // When collect_stats() is true, a kernel may describe what this
+  // execution did, e.g. how long it waited on a queue, with
+  // set_stats_annotation().  The annotation is appended to the timeline
+  // label of the node in the step stats.
+  bool collect_stats() const { return params_->collect_stats; }
+  void set_stats_annotation(const string& annotation) {
+    stats_annotation_ = annotation;
+  }
+  const string& stats_annotation() const { return stats_annotation_; }
+
   // Other accessors.
 
   // For control flow.
@@ -975,6 +991,7 @@ class OpKernelContext {
 
   bool is_output_dead_ = false;
   bool record_tensor_accesses_ = false;
+  string stats_annotation_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(OpKernelContext);
 };
@@ -27,6 +27,8 @@ limitations under the License.
 
 namespace tensorflow {
 
+class Summary;
+
 // All implementations must be thread-safe.
 class QueueInterface : public ResourceBase {
  public:
@@ -84,6 +86,10 @@ class QueueInterface : public ResourceBase {
   // Returns the number of elements in the queue.
   virtual int32 size() = 0;
 
+  // Adds statistics about the queue to "summary": how many elements went
+  // through it, how long enqueues and dequeues waited, and how full it was.
+  virtual Status GetStats(Summary* summary) = 0;
+
   virtual const DataTypeVector& component_dtypes() const = 0;
 
   string DebugString() override { return "A queue"; }
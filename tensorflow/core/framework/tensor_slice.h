@@ -129,6 +129,10 @@ class TensorSlice {
     return Intersect(other, nullptr);
   }
 
+  // Returns true if "other" has the same extents as this slice. A full extent
+  // is not equal to an explicit extent that happens to cover the dimension.
+  bool operator==(const TensorSlice& other) const;
+
   // Interaction with TensorShape.
 
   // Slices a shape and stores the result into *result_shape.
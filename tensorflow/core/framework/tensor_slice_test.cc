@@ -149,6 +149,16 @@ TEST(TensorSliceTest, Intersection) {
   }
 }
 
+TEST(TensorSliceTest, Equality) {
+  EXPECT_TRUE(TensorSlice::ParseOrDie("-:1,2") ==
+              TensorSlice::ParseOrDie("-:1,2"));
+  EXPECT_FALSE(TensorSlice::ParseOrDie("-:1,2") ==
+               TensorSlice::ParseOrDie("-:1,3"));
+  EXPECT_FALSE(TensorSlice::ParseOrDie("-:1,2") ==
+               TensorSlice::ParseOrDie("0,4:1,2"));
+  EXPECT_FALSE(TensorSlice::ParseOrDie("-") == TensorSlice::ParseOrDie("-:-"));
+}
+
 // Testing applying a slice to a tensor shape
 TEST(TensorSliceTest, SliceTensorShape) {
   // A proper application
@@ -21,6 +21,7 @@ limitations under the License.
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
 
 namespace tensorflow {
 
@@ -78,6 +79,7 @@ class AssignOp : public OpKernel {
                                                   &copy, &copyTensor, attr));
         Copy(context, copyTensor, rhs);
         context->replace_ref_input(0, *copyTensor, true);
+        dirty_rows_.MarkAll(context, {0});
         return;
       }
 
@@ -85,6 +87,7 @@ class AssignOp : public OpKernel {
       // matches the left hand side's shape.
       if (use_exclusive_lock_) {
         Copy(context, &old_lhs, rhs);
+        dirty_rows_.MarkAll(context, {0});
         return;
       }
     }
@@ -94,12 +97,14 @@ class AssignOp : public OpKernel {
     // copy outside the lock.
     Tensor old_unlocked_lhs = context->mutable_input(0, false);
     Copy(context, &old_unlocked_lhs, rhs);
+    dirty_rows_.MarkAll(context, {0});
   }
 
   virtual void Copy(OpKernelContext* context, Tensor* lhs,
                     const Tensor& rhs) = 0;
 
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
   bool validate_shape_;
 };
 
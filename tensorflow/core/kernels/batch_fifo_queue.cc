@@ -0,0 +1,424 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/data_flow_ops.cc.
+
+#include "tensorflow/core/kernels/batch_fifo_queue.h"
+
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+namespace {
+
+// The number of elements the ring buffers hold after the first enqueue.
+const int64 kMinRingCapacity = 16;
+
+char* MutableData(Tensor* t) {
+  return const_cast<char*>(t->tensor_data().data());
+}
+
+// Copies elements [src_index, src_index + num_elements) of "src" into
+// elements [dst_index, ...) of "dst", where an element is the
+// "element_size" scalars of a slice in the first dimension.
+void CopyElements(const Tensor& src, int64 src_index, Tensor* dst,
+                  int64 dst_index, int64 num_elements, int64 element_size) {
+  if (num_elements == 0 || element_size == 0) return;
+  const int64 src_offset = src_index * element_size;
+  const int64 dst_offset = dst_index * element_size;
+  const int64 n = num_elements * element_size;
+  if (src.dtype() == DT_STRING) {
+    std::copy_n(src.flat<string>().data() + src_offset, n,
+                dst->flat<string>().data() + dst_offset);
+  } else {
+    const int64 bytes = DataTypeSize(src.dtype());
+    memcpy(MutableData(dst) + dst_offset * bytes,
+           src.tensor_data().data() + src_offset * bytes, n * bytes);
+  }
+}
+
+// Like CopyElements(), but strings are moved out of "src".
+void MoveElements(Tensor* src, int64 src_index, Tensor* dst, int64 dst_index,
+                  int64 num_elements, int64 element_size) {
+  if (src->dtype() == DT_STRING && num_elements > 0 && element_size > 0) {
+    string* begin = src->flat<string>().data() + src_index * element_size;
+    std::move(begin, begin + num_elements * element_size,
+              dst->flat<string>().data() + dst_index * element_size);
+    return;
+  }
+  CopyElements(*src, src_index, dst, dst_index, num_elements, element_size);
+}
+
+}  // namespace
+
+BatchFIFOQueue::BatchFIFOQueue(int capacity,
+                               const DataTypeVector& component_dtypes,
+                               const std::vector<TensorShape>& component_shapes,
+                               const string& name)
+    : QueueBase(capacity, component_dtypes, component_shapes, name) {}
+
+/* static */
+bool BatchFIFOQueue::IsSupported(
+    const DataTypeVector& component_dtypes,
+    const std::vector<TensorShape>& component_shapes) {
+  if (component_shapes.empty()) return false;
+  for (const DataType dtype : component_dtypes) {
+    if (dtype != DT_STRING && !DataTypeCanUseMemcpy(dtype)) return false;
+  }
+  return true;
+}
+
+Status BatchFIFOQueue::Initialize() {
+  if (component_dtypes_.empty()) {
+    return errors::InvalidArgument("Empty component types for queue ", name_);
+  }
+  if (component_dtypes_.size() != component_shapes_.size()) {
+    return errors::InvalidArgument(
+        "Different number of component types.  ", "Types: ",
+        DataTypeSliceString(component_dtypes_), ", Shapes: ",
+        ShapeListString(component_shapes_));
+  }
+  if (!IsSupported(component_dtypes_, component_shapes_)) {
+    return errors::InvalidArgument("Unsupported component types for queue ",
+                                   name_, ": ",
+                                   DataTypeSliceString(component_dtypes_));
+  }
+  element_sizes_.reserve(num_components());
+  for (const TensorShape& shape : component_shapes_) {
+    element_sizes_.push_back(shape.num_elements());
+  }
+  return Status::OK();
+}
+
+Status BatchFIFOQueue::ReserveLocked(OpKernelContext* ctx,
+                                     int64 num_elements) {
+  if (num_elements <= ring_capacity_) return Status::OK();
+  // Grow geometrically so that the cost of moving the elements to the new
+  // buffers is amortized, but not beyond the capacity of the queue.  Putting
+  // back the elements of a failed DequeueMany may exceed that capacity.
+  int64 new_capacity = std::max(kMinRingCapacity, 2 * ring_capacity_);
+  new_capacity = std::min<int64>(new_capacity, capacity_);
+  new_capacity = std::max(new_capacity, num_elements);
+
+  std::vector<PersistentTensor> buffers(num_components());
+  Tuple new_tuple;
+  new_tuple.reserve(num_components());
+  for (int i = 0; i < num_components(); ++i) {
+    Tensor* buffer = nullptr;
+    TF_RETURN_IF_ERROR(ctx->allocate_persistent(
+        component_dtypes_[i], ManyOutShape(i, new_capacity), &buffers[i],
+        &buffer));
+    new_tuple.push_back(*buffer);
+  }
+  CopyFromRingLocked(ctx, head_, &new_tuple, 0, size_);
+  buffers_.swap(buffers);
+  ring_capacity_ = new_capacity;
+  head_ = 0;
+  return Status::OK();
+}
+
+void BatchFIFOQueue::CopyToRingLocked(OpKernelContext* ctx, const Tuple& tuple,
+                                      int64 src_index, int64 ring_index,
+                                      int64 num_elements) {
+  if (num_elements == 0) return;
+  DCHECK_LE(num_elements, ring_capacity_);
+  const int64 first = std::min(num_elements, ring_capacity_ - ring_index);
+  for (int i = 0; i < num_components(); ++i) {
+    Tensor* buffer = buffers_[i].AccessTensor(ctx);
+    CopyElements(tuple[i], src_index, buffer, ring_index, first,
+                 element_sizes_[i]);
+    CopyElements(tuple[i], src_index + first, buffer, 0, num_elements - first,
+                 element_sizes_[i]);
+  }
+}
+
+void BatchFIFOQueue::CopyFromRingLocked(OpKernelContext* ctx, int64 ring_index,
+                                        Tuple* tuple, int64 dst_index,
+                                        int64 num_elements) {
+  if (num_elements == 0) return;
+  DCHECK_LE(num_elements, ring_capacity_);
+  const int64 first = std::min(num_elements, ring_capacity_ - ring_index);
+  for (int i = 0; i < num_components(); ++i) {
+    Tensor* buffer = buffers_[i].AccessTensor(ctx);
+    MoveElements(buffer, ring_index, &(*tuple)[i], dst_index, first,
+                 element_sizes_[i]);
+    MoveElements(buffer, 0, &(*tuple)[i], dst_index + first,
+                 num_elements - first, element_sizes_[i]);
+  }
+}
+
+Status BatchFIFOQueue::EnqueueLocked(OpKernelContext* ctx, const Tuple& tuple,
+                                     int64 src_index, int64 num_elements) {
+  TF_RETURN_IF_ERROR(ReserveLocked(ctx, size_ + num_elements));
+  CopyToRingLocked(ctx, tuple, src_index, (head_ + size_) % ring_capacity_,
+                   num_elements);
+  size_ += num_elements;
+  return Status::OK();
+}
+
+void BatchFIFOQueue::DequeueLocked(OpKernelContext* ctx, Tuple* tuple,
+                                   int64 dst_index, int64 num_elements) {
+  DCHECK_LE(num_elements, size_);
+  CopyFromRingLocked(ctx, head_, tuple, dst_index, num_elements);
+  head_ = (head_ + num_elements) % ring_capacity_;
+  size_ -= num_elements;
+}
+
+void BatchFIFOQueue::TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                                DoneCallback callback) {
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kEnqueue, cm, token); });
+    if (!already_cancelled) {
+      enqueue_attempts_.emplace_back(
+          1, callback, ctx, cm, token,
+          [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            if (closed_) {
+              attempt->context->SetStatus(
+                  errors::Aborted("FIFOQueue '", name_, "' is closed."));
+              return kComplete;
+            }
+            if (size_ < capacity_) {
+              // A single element is laid out like a batch of one.
+              attempt->context->SetStatus(
+                  EnqueueLocked(attempt->context, tuple, 0, 1));
+              return kComplete;
+            } else {
+              return kNoProgress;
+            }
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+void BatchFIFOQueue::TryEnqueueMany(const Tuple& tuple, OpKernelContext* ctx,
+                                    DoneCallback callback) {
+  const int64 batch_size = tuple[0].dim_size(0);
+  if (batch_size == 0) {
+    callback();
+    return;
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kEnqueue, cm, token); });
+    if (!already_cancelled) {
+      enqueue_attempts_.emplace_back(
+          batch_size, callback, ctx, cm, token,
+          [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            if (closed_) {
+              attempt->context->SetStatus(
+                  errors::Aborted("FIFOQueue '", name_, "' is closed."));
+              return kComplete;
+            }
+            const int64 n = std::min<int64>(capacity_ - size_,
+                                            attempt->elements_requested);
+            if (n <= 0) return kNoProgress;
+            const int64 index =
+                tuple[0].dim_size(0) - attempt->elements_requested;
+            attempt->context->SetStatus(
+                EnqueueLocked(attempt->context, tuple, index, n));
+            if (!attempt->context->status().ok()) return kComplete;
+            attempt->elements_requested -= n;
+            return attempt->elements_requested == 0 ? kComplete : kProgress;
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+void BatchFIFOQueue::TryDequeue(OpKernelContext* ctx,
+                                CallbackWithTuple callback) {
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kDequeue, cm, token); });
+    if (!already_cancelled) {
+      dequeue_attempts_.emplace_back(
+          1, [callback]() { callback(Tuple()); }, ctx, cm, token,
+          [callback, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            const int64 s = size_;
+            if (closed_ && s == 0) {
+              attempt->context->SetStatus(errors::OutOfRange(
+                  "FIFOQueue '", name_, "' is closed and has ",
+                  "insufficient elements (requested ", 1, ", current size ", s,
+                  ")"));
+              return kComplete;
+            }
+            if (s > 0) {
+              Tuple tuple;
+              tuple.reserve(num_components());
+              for (int i = 0; i < num_components(); ++i) {
+                Tensor element;
+                attempt->context->SetStatus(attempt->context->allocate_temp(
+                    component_dtypes_[i], component_shapes_[i], &element));
+                if (!attempt->context->status().ok()) return kComplete;
+                tuple.emplace_back(element);
+              }
+              DequeueLocked(attempt->context, &tuple, 0, 1);
+              attempt->done_callback = [callback, tuple]() { callback(tuple); };
+              return kComplete;
+            } else {
+              return kNoProgress;
+            }
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
+    callback(Tuple());
+  }
+}
+
+void BatchFIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                                    bool allow_small_batch,
+                                    CallbackWithTuple callback) {
+  if (allow_small_batch) {
+    ctx->SetStatus(
+        errors::Unimplemented("Dequeue: Queue does not support small batches"));
+    callback(Tuple());
+    return;
+  }
+
+  if (num_elements == 0) {
+    Tuple tuple;
+    tuple.reserve(num_components());
+    for (int i = 0; i < num_components(); ++i) {
+      // See FIFOQueue::TryDequeueMany() about allocating outputs here.
+      Tensor element;
+      ctx->allocate_temp(component_dtypes_[i], ManyOutShape(i, 0), &element);
+      tuple.emplace_back(element);
+    }
+    callback(tuple);
+    return;
+  }
+
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  bool already_cancelled;
+  {
+    mutex_lock l(mu_);
+    already_cancelled = !cm->RegisterCallback(
+        token, [this, cm, token]() { Cancel(kDequeue, cm, token); });
+    if (!already_cancelled) {
+      dequeue_attempts_.emplace_back(
+          num_elements, [callback]() { callback(Tuple()); }, ctx, cm, token,
+          [callback, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+            const int64 s = size_;
+            if (closed_ && s < attempt->elements_requested) {
+              attempt->context->SetStatus(errors::OutOfRange(
+                  "FIFOQueue '", name_, "' is closed and has ",
+                  "insufficient elements (requested ",
+                  attempt->elements_requested, ", current size ", s, ")"));
+
+              if (!attempt->tuple.empty()) {
+                // Restore already-dequeued elements to the front of the queue.
+                const int64 n =
+                    attempt->tuple[0].dim_size(0) - attempt->elements_requested;
+                Status status = ReserveLocked(attempt->context, size_ + n);
+                if (status.ok()) {
+                  head_ = (head_ + ring_capacity_ - n) % ring_capacity_;
+                  CopyToRingLocked(attempt->context, attempt->tuple, 0, head_,
+                                   n);
+                  size_ += n;
+                } else {
+                  attempt->context->SetStatus(errors::DataLoss(
+                      "Failed to restore elements from partially-dequeued "
+                      "batch to FIFOQueue: ",
+                      status.error_message()));
+                }
+              }
+              return kComplete;
+            }
+            if (s == 0) return kNoProgress;
+
+            if (attempt->tuple.empty()) {
+              // Only allocate tuple when we have something to dequeue
+              // so we don't use excessive memory when there are many
+              // blocked dequeue attempts waiting.
+              attempt->tuple.reserve(num_components());
+              for (int i = 0; i < num_components(); ++i) {
+                const TensorShape shape =
+                    ManyOutShape(i, attempt->elements_requested);
+                Tensor element;
+                attempt->context->SetStatus(attempt->context->allocate_temp(
+                    component_dtypes_[i], shape, &element));
+                if (!attempt->context->status().ok()) return kComplete;
+                attempt->tuple.emplace_back(element);
+              }
+            }
+            const int64 n = std::min<int64>(s, attempt->elements_requested);
+            const int64 index =
+                attempt->tuple[0].dim_size(0) - attempt->elements_requested;
+            DequeueLocked(attempt->context, &attempt->tuple, index, n);
+            attempt->elements_requested -= n;
+            if (attempt->elements_requested > 0) return kProgress;
+            Tuple tuple = attempt->tuple;
+            attempt->done_callback = [callback, tuple]() { callback(tuple); };
+            return kComplete;
+          });
+    }
+  }
+  if (!already_cancelled) {
+    FlushUnlocked();
+  } else {
+    ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
+    callback(Tuple());
+  }
+}
+
+Status BatchFIFOQueue::MatchesNodeDef(const NodeDef& node_def) {
+  TF_RETURN_IF_ERROR(MatchesNodeDefOp(node_def, "FIFOQueue"));
+  TF_RETURN_IF_ERROR(MatchesNodeDefCapacity(node_def, capacity_));
+  TF_RETURN_IF_ERROR(MatchesNodeDefTypes(node_def));
+  TF_RETURN_IF_ERROR(MatchesNodeDefShapes(node_def));
+  return Status::OK();
+}
+
+}  // namespace tensorflow
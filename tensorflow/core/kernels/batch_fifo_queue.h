@@ -0,0 +1,116 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_BATCH_FIFO_QUEUE_H_
+#define TENSORFLOW_KERNELS_BATCH_FIFO_QUEUE_H_
+
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/queue_base.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A FIFO queue for components with fully specified shapes, which keeps its
+// elements in a ring buffer per component: a single tensor of shape
+// [ring_capacity] + component_shape.  EnqueueMany and DequeueMany copy a
+// whole batch with at most two copies per component, instead of splitting
+// it into one tensor per element as FIFOQueue does.
+//
+// The ring buffers grow geometrically as elements are enqueued, up to the
+// capacity of the queue, and are never shrunk.
+class BatchFIFOQueue : public QueueBase {
+ public:
+  // REQUIRES: IsSupported(component_dtypes, component_shapes).
+  BatchFIFOQueue(int32 capacity, const DataTypeVector& component_dtypes,
+                 const std::vector<TensorShape>& component_shapes,
+                 const string& name);
+
+  Status Initialize();  // Must be called before any other method.
+
+  // Returns true if a queue with these components can be a BatchFIFOQueue:
+  // their shapes must be specified, and their types either strings or types
+  // that can be copied with memcpy.
+  static bool IsSupported(const DataTypeVector& component_dtypes,
+                          const std::vector<TensorShape>& component_shapes);
+
+  // Implementations of QueueInterface methods --------------------------------
+
+  void TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                  DoneCallback callback) override;
+  void TryEnqueueMany(const Tuple& tuple, OpKernelContext* ctx,
+                      DoneCallback callback) override;
+  void TryDequeue(OpKernelContext* ctx, CallbackWithTuple callback) override;
+  void TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                      bool allow_small_batch,
+                      CallbackWithTuple callback) override;
+  Status MatchesNodeDef(const NodeDef& node_def) override;
+
+ private:
+  ~BatchFIFOQueue() override {}
+
+  int32 SizeLocked() override { return size_; }
+
+  // Grows the ring buffers, if needed, so that they can hold at least
+  // "num_elements" elements.
+  Status ReserveLocked(OpKernelContext* ctx, int64 num_elements)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Copies elements [src_index, src_index + num_elements) of the batch
+  // "tuple" into the ring buffers, starting at ring position "ring_index".
+  void CopyToRingLocked(OpKernelContext* ctx, const Tuple& tuple,
+                        int64 src_index, int64 ring_index, int64 num_elements)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Copies "num_elements" elements from the ring buffers, starting at ring
+  // position "ring_index", into elements [dst_index, ...) of the batch
+  // "*tuple".
+  void CopyFromRingLocked(OpKernelContext* ctx, int64 ring_index,
+                          Tuple* tuple, int64 dst_index, int64 num_elements)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Appends elements [src_index, src_index + num_elements) of the batch
+  // "tuple" to the back of the queue.
+  Status EnqueueLocked(OpKernelContext* ctx, const Tuple& tuple,
+                       int64 src_index, int64 num_elements)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Moves the "num_elements" elements at the front of the queue into
+  // elements [dst_index, ...) of the batch "*tuple".
+  void DequeueLocked(OpKernelContext* ctx, Tuple* tuple, int64 dst_index,
+                     int64 num_elements) EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // The number of scalars in an element of each component.
+  std::vector<int64> element_sizes_;
+
+  // The ring buffers, which hold "ring_capacity_" elements each.
+  std::vector<PersistentTensor> buffers_ GUARDED_BY(mu_);
+  int64 ring_capacity_ GUARDED_BY(mu_) = 0;
+  // Ring position of the front of the queue, and number of elements in it.
+  int64 head_ GUARDED_BY(mu_) = 0;
+  int64 size_ GUARDED_BY(mu_) = 0;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(BatchFIFOQueue);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_BATCH_FIFO_QUEUE_H_
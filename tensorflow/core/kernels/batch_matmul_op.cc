@@ -18,6 +18,7 @@ limitations under the License.
 #define EIGEN_USE_THREADS
 
 #include <vector>
+#include "third_party/eigen3/Eigen/Core"
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op.h"
 #include "tensorflow/core/framework/op_kernel.h"
@@ -41,6 +42,36 @@ typedef Eigen::GpuDevice GPUDevice;
 template <typename Device, typename Scalar>
 struct LaunchBatchMatMul;
 
+// Multiplies the small matrices [start, limit) of a batch with Eigen's matrix
+// product, through maps of "Size" x "Size" matrices, or of matrices of any
+// size if "Size" is Eigen::Dynamic.  With a fixed size, Eigen unrolls the
+// whole product and keeps it in registers.
+template <typename Scalar, int Size>
+struct SmallBatchMatMul {
+  typedef Eigen::Matrix<Scalar, Size, Size, Eigen::RowMajor> Matrix;
+  typedef Eigen::Map<const Matrix> ConstMatrixMap;
+  typedef Eigen::Map<Matrix> MatrixMap;
+
+  static void Run(const Scalar* x, const Scalar* y, Scalar* z, int64 m,
+                  int64 k, int64 n, bool adj_x, bool adj_y, int64 start,
+                  int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      ConstMatrixMap x_i(x + i * m * k, adj_x ? k : m, adj_x ? m : k);
+      ConstMatrixMap y_i(y + i * k * n, adj_y ? n : k, adj_y ? k : n);
+      MatrixMap z_i(z + i * m * n, m, n);
+      if (!adj_x && !adj_y) {
+        z_i.noalias() = x_i * y_i;
+      } else if (!adj_x && adj_y) {
+        z_i.noalias() = x_i * y_i.adjoint();
+      } else if (adj_x && !adj_y) {
+        z_i.noalias() = x_i.adjoint() * y_i;
+      } else {
+        z_i.noalias() = x_i.adjoint() * y_i.adjoint();
+      }
+    }
+  }
+};
+
 template <typename Scalar>
 struct LaunchBatchMatMul<CPUDevice, Scalar> {
   static void Launch(OpKernelContext* context, const Tensor& in_x,
@@ -48,13 +79,24 @@ struct LaunchBatchMatMul<CPUDevice, Scalar> {
     auto Tx = in_x.tensor<Scalar, 3>();
     auto Ty = in_y.tensor<Scalar, 3>();
     auto Tz = out->tensor<Scalar, 3>();
+    const int64 m = out->dim_size(1);
+    const int64 k = in_x.dim_size(adj_x ? 1 : 2);
+    const int64 n = out->dim_size(2);
 
     // Shards "n"-matmuls into "num" shards. Each shard is
     // dispatched to a thread.
     auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
     const int64 num_units = in_x.dim_size(0);
-    const int64 cost_per_unit =
-        in_x.dim_size(0) * in_x.dim_size(1) * out->dim_size(2);
+    const int64 cost_per_unit = m * k * n;
+    if (cost_per_unit <= kMaxSmallMatrixCost) {
+      Shard(worker_threads.num_threads, worker_threads.workers, num_units,
+            cost_per_unit, [&Tx, &Ty, m, k, n, adj_x, adj_y, &Tz](
+                               int64 start, int64 limit) {
+              RunSmall(Tx.data(), Ty.data(), Tz.data(), m, k, n, adj_x, adj_y,
+                       start, limit);
+            });
+      return;
+    }
     Shard(worker_threads.num_threads, worker_threads.workers, num_units,
           cost_per_unit, [&Tx, &Ty, adj_x, adj_y, &Tz](int start, int limit) {
             LaunchBatchMatMul<CPUDevice, Scalar>::Run(Tx, Ty, adj_x, adj_y, Tz,
@@ -62,6 +104,35 @@ struct LaunchBatchMatMul<CPUDevice, Scalar> {
           });
   }
 
+  // Up to this many multiply-adds per product, the products are computed by
+  // SmallBatchMatMul.  A tensor contraction sets up evaluators and allocates
+  // its packing buffers for every product, which costs more than the
+  // arithmetic of small products, while Eigen's matrix product keeps its
+  // buffers on the stack at these sizes.
+  static const int64 kMaxSmallMatrixCost = 64 * 64 * 64;
+
+  static void RunSmall(const Scalar* x, const Scalar* y, Scalar* z, int64 m,
+                       int64 k, int64 n, bool adj_x, bool adj_y, int64 start,
+                       int64 limit) {
+    if (m == k && k == n) {
+      switch (m) {
+#define CASE(SIZE)                                                          \
+  case SIZE:                                                                \
+    SmallBatchMatMul<Scalar, SIZE>::Run(x, y, z, m, k, n, adj_x, adj_y,     \
+                                        start, limit);                      \
+    return;
+        CASE(2);
+        CASE(3);
+        CASE(4);
+        CASE(8);
+        CASE(16);
+#undef CASE
+      }
+    }
+    SmallBatchMatMul<Scalar, Eigen::Dynamic>::Run(x, y, z, m, k, n, adj_x,
+                                                  adj_y, start, limit);
+  }
+
   template <typename In, typename Out>
   static void Run(In Tx, In Ty, bool adj_x, bool adj_y, Out Tz, int start,
                   int limit) {
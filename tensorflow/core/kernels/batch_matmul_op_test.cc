@@ -0,0 +1,74 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+static Graph* BatchMatmul(int b, int m, int k, int n, bool adjoint_a,
+                          bool adjoint_b) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in0(DT_FLOAT, adjoint_a ? TensorShape({b, k, m})
+                                 : TensorShape({b, m, k}));
+  in0.flat<float>().setRandom();
+  Tensor in1(DT_FLOAT, adjoint_b ? TensorShape({b, n, k})
+                                 : TensorShape({b, k, n}));
+  in1.flat<float>().setRandom();
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "BatchMatMul")
+                  .Input(test::graph::Constant(g, in0))
+                  .Input(test::graph::Constant(g, in1))
+                  .Attr("adj_x", adjoint_a)
+                  .Attr("adj_y", adjoint_b)
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_BatchMatmulDev(B, M, K, N, TA, TB, DEVICE)                       \
+  static void                                                               \
+      BM_BatchMatmul##_##B##_##M##_##K##_##N##_##TA##_##TB##_##DEVICE(      \
+          int iters) {                                                      \
+    testing::ItemsProcessed(static_cast<int64>(iters) * B * M * K * N * 2); \
+    test::Benchmark(#DEVICE, BatchMatmul(B, M, K, N, TA, TB)).Run(iters);   \
+  }                                                                         \
+  BENCHMARK(BM_BatchMatmul##_##B##_##M##_##K##_##N##_##TA##_##TB##_##DEVICE);
+
+#define BM_BatchMatmul(B, M, K, N, TA, TB) \
+  BM_BatchMatmulDev(B, M, K, N, TA, TB, cpu);
+
+// Tiny matrices, some of which have fixed-size CPU kernels.
+BM_BatchMatmul(4096, 2, 2, 2, false, false);
+BM_BatchMatmul(4096, 4, 4, 4, false, false);
+BM_BatchMatmul(4096, 8, 8, 8, false, false);
+BM_BatchMatmul(1024, 16, 16, 16, false, false);
+BM_BatchMatmul(1024, 10, 10, 10, false, false);
+
+// Attention: queries times keys, then weights times values.
+BM_BatchMatmul(32, 64, 64, 64, false, true);
+BM_BatchMatmul(32, 64, 64, 64, false, false);
+BM_BatchMatmul(128, 1, 64, 64, false, true);
+BM_BatchMatmul(128, 32, 16, 32, false, true);
+
+// Large matrices, multiplied by tensor contractions.
+BM_BatchMatmul(8, 128, 128, 128, false, false);
+BM_BatchMatmul(2, 512, 512, 512, false, false);
+BM_BatchMatmul(2, 512, 512, 512, true, true);
+
+}  // end namespace tensorflow
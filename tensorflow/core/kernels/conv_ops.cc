@@ -18,18 +18,21 @@ limitations under the License.
 #define USE_EIGEN_TENSOR
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <vector>
-#include "tensorflow/core/framework/numeric_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/conv_2d.h"
+#include "tensorflow/core/kernels/conv_ops_cpu.h"
+#include "tensorflow/core/kernels/matmul_op_fused.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/util/padding.h"
@@ -93,16 +96,118 @@ struct LaunchConvOp<CPUDevice, T> {
                      const Tensor& filter, int row_stride, int col_stride,
                      const Eigen::PaddingType& padding, Tensor* output,
                      TensorFormat data_format) {
-    LaunchGeneric<CPUDevice, T>::launch(ctx, input, filter, row_stride,
-                                        col_stride, padding, output,
-                                        data_format);
+    if (data_format != FORMAT_NHWC) {
+      LaunchGeneric<CPUDevice, T>::launch(ctx, input, filter, row_stride,
+                                          col_stride, padding, output,
+                                          data_format);
+      return;
+    }
+    CpuConvShape shape;
+    shape.batch = input.dim_size(0);
+    shape.in_rows = input.dim_size(1);
+    shape.in_cols = input.dim_size(2);
+    shape.in_depth = input.dim_size(3);
+    shape.filter_rows = filter.dim_size(0);
+    shape.filter_cols = filter.dim_size(1);
+    shape.out_depth = filter.dim_size(3);
+    shape.stride_rows = row_stride;
+    shape.stride_cols = col_stride;
+    shape.out_rows = output->dim_size(1);
+    shape.out_cols = output->dim_size(2);
+    shape.num_threads =
+        ctx->device()->tensorflow_cpu_worker_threads()->num_threads;
+    // The padding before the input, the excess going after it as in
+    // SpatialConvolution.
+    int out_rows = 0, out_cols = 0, pad_bottom = 0, pad_right = 0;
+    OP_REQUIRES_OK(
+        ctx, Get2dOutputSizeVerbose(
+                 shape.in_rows, shape.in_cols, shape.filter_rows,
+                 shape.filter_cols, row_stride, col_stride,
+                 padding == Eigen::PADDING_SAME ? Padding::SAME
+                                                : Padding::VALID,
+                 &out_rows, &out_cols, &shape.pad_rows, &pad_bottom,
+                 &shape.pad_cols, &pad_right));
+
+    const std::vector<CpuConvAlgorithm> candidates = CpuConvCandidates(shape);
+    CpuConvAlgorithm algorithm = candidates[0];
+    if (candidates.size() == 1 || !CpuConvUseAutotune() ||
+        CpuConvAlgorithmMap::Global()->Find(shape, &algorithm)) {
+      Launch(ctx, algorithm, shape, input, filter, padding, output);
+      return;
+    }
+
+    // The first convolution of a shape times every candidate, the way cuDNN
+    // autotuning does on GPU.  They all compute the same output.  Each one
+    // runs once to warm up its caches, and then keeps the best of a few runs,
+    // which filters out the noise of a single one.
+    static const int kTimedRuns = 3;
+    uint64 best_micros = ~0ULL;
+    for (CpuConvAlgorithm candidate : candidates) {
+      Launch(ctx, candidate, shape, input, filter, padding, output);
+      if (!ctx->status().ok()) return;
+      uint64 micros = ~0ULL;
+      for (int run = 0; run < kTimedRuns; ++run) {
+        const uint64 start_micros = Env::Default()->NowMicros();
+        Launch(ctx, candidate, shape, input, filter, padding, output);
+        micros = std::min(micros, Env::Default()->NowMicros() - start_micros);
+      }
+      VLOG(2) << "Conv2D with " << CpuConvAlgorithmName(candidate) << ": "
+              << micros << "us for " << shape.DebugString();
+      if (micros < best_micros) {
+        best_micros = micros;
+        algorithm = candidate;
+      }
+    }
+    CpuConvAlgorithmMap::Global()->Insert(shape, algorithm);
+  }
+
+ private:
+  static void Launch(OpKernelContext* ctx, CpuConvAlgorithm algorithm,
+                     const CpuConvShape& shape, const Tensor& input,
+                     const Tensor& filter, const Eigen::PaddingType& padding,
+                     Tensor* output) {
+    const T* input_data = input.flat<T>().data();
+    const T* filter_data = filter.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    const DeviceBase::CpuWorkerThreads& workers =
+        *ctx->device()->tensorflow_cpu_worker_threads();
+    switch (algorithm) {
+      case CpuConvAlgorithm::kSpatialConvolution:
+      case CpuConvAlgorithm::kMatMul:
+        // LaunchGeneric multiplies matrices for 1x1 filters with stride 1.
+        LaunchGeneric<CPUDevice, T>::launch(
+            ctx, input, filter, shape.stride_rows, shape.stride_cols, padding,
+            output, FORMAT_NHWC);
+        break;
+      case CpuConvAlgorithm::kIm2col:
+        functor::Conv2DIm2col<T>(workers, shape, input_data, filter_data,
+                                 output_data);
+        break;
+      case CpuConvAlgorithm::kDirect:
+        functor::Conv2DDirect<T>(workers, shape, input_data, filter_data,
+                                 output_data);
+        break;
+      case CpuConvAlgorithm::kWinograd2x2:
+        functor::Conv2DWinograd<T, 2>(workers, shape, input_data, filter_data,
+                                      output_data);
+        break;
+      case CpuConvAlgorithm::kWinograd4x4:
+        functor::Conv2DWinograd<T, 4>(workers, shape, input_data, filter_data,
+                                      output_data);
+        break;
+    }
   }
 };
 
 template <typename Device, typename T>
-class Conv2DOp : public BinaryOp<T> {
+class Conv2DOp : public OpKernel {
  public:
-  explicit Conv2DOp(OpKernelConstruction* context) : BinaryOp<T>(context) {
+  explicit Conv2DOp(OpKernelConstruction* context) : OpKernel(context) {
+    // _FusedConv2D takes its bias as a third input.
+    const DataType dt = DataTypeToEnum<T>::v();
+    OP_REQUIRES_OK(context,
+                   context->MatchSignature(
+                       DataTypeVector(context->num_inputs(), dt), {dt}));
     OP_REQUIRES_OK(context, context->GetAttr("strides", &strides_));
     string data_format;
     OP_REQUIRES_OK(context, context->GetAttr("data_format", &data_format));
@@ -222,11 +327,21 @@ class Conv2DOp : public BinaryOp<T> {
     if (out_shape.num_elements() == 0) {
       return;
     }
+    Launch(context, input, filter, stride_rows, stride_cols, output);
+  }
+
+ protected:
+  // Computes the convolution into "output", once the shapes are checked.
+  virtual void Launch(OpKernelContext* context, const Tensor& input,
+                      const Tensor& filter, int stride_rows, int stride_cols,
+                      Tensor* output) {
     LaunchConvOp<Device, T>::launch(
         context, use_cudnn_, input, filter, stride_rows, stride_cols,
         BrainPadding2EigenPadding(padding_), output, data_format_);
   }
 
+  TensorFormat data_format() const { return data_format_; }
+
  private:
   std::vector<int32> strides_;
   bool use_cudnn_;
@@ -240,6 +355,59 @@ REGISTER_KERNEL_BUILDER(
     Name("Conv2D").Device(DEVICE_CPU).TypeConstraint<float>("T"),
     Conv2DOp<CPUDevice, float>);
 
+// Conv2D followed by a BiasAdd and an optional activation.  A 1x1 convolution
+// is a matrix multiplication, which applies the bias and the activation to
+// each block of the output while it is still in cache; otherwise they are
+// applied in one pass over the output of the convolution.
+template <typename T>
+class FusedConv2DOp : public Conv2DOp<CPUDevice, T> {
+ public:
+  explicit FusedConv2DOp(OpKernelConstruction* context)
+      : Conv2DOp<CPUDevice, T>(context) {
+    OP_REQUIRES_OK(context, GetFusedActivation(context, &activation_));
+    OP_REQUIRES(context, this->data_format() == FORMAT_NHWC,
+                errors::InvalidArgument(
+                    "_FusedConv2D only supports the NHWC data format"));
+  }
+
+ protected:
+  void Launch(OpKernelContext* context, const Tensor& input,
+              const Tensor& filter, int stride_rows, int stride_cols,
+              Tensor* output) override {
+    const Tensor& bias = context->input(2);
+    const int64 depth = filter.dim_size(3);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(bias.shape()) &&
+                             bias.dim_size(0) == depth,
+                errors::InvalidArgument(
+                    "Bias must be a vector of the size of the output depth: ",
+                    bias.shape().DebugString(), " vs. ", depth));
+    const int64 rows = output->NumElements() / depth;
+    auto out = output->shaped<T, 2>({rows, depth});
+    if (filter.dim_size(0) == 1 && filter.dim_size(1) == 1 &&
+        stride_rows == 1 && stride_cols == 1 && filter.dim_size(2) > 0) {
+      Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1> dim_pair;
+      dim_pair[0] = Eigen::IndexPair<Eigen::DenseIndex>(1, 0);
+      functor::FusedMatMul<T>(
+          context, input.shaped<T, 2>({rows, filter.dim_size(2)}),
+          filter.shaped<T, 2>({filter.dim_size(2), depth}), dim_pair,
+          bias.vec<T>(), activation_, out);
+    } else {
+      Conv2DOp<CPUDevice, T>::Launch(context, input, filter, stride_rows,
+                                     stride_cols, output);
+      functor::BiasActivation<T>(
+          *context->device()->tensorflow_cpu_worker_threads(), out,
+          bias.vec<T>(), activation_);
+    }
+  }
+
+ private:
+  FusedActivation activation_;
+};
+
+REGISTER_KERNEL_BUILDER(
+    Name("_FusedConv2D").Device(DEVICE_CPU).TypeConstraint<float>("T"),
+    FusedConv2DOp<float>);
+
 #if GOOGLE_CUDA
 
 int64 GetCudnnWorkspaceLimit(const string& envvar_in_mb,
@@ -0,0 +1,155 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/conv_ops_cpu.h"
+
+#include <stdlib.h>
+
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Inputs with at most this many channels can use kDirect.
+const int kMaxDirectInDepth = 4;
+
+}  // namespace
+
+const char* CpuConvAlgorithmName(CpuConvAlgorithm algorithm) {
+  switch (algorithm) {
+    case CpuConvAlgorithm::kSpatialConvolution:
+      return "SpatialConvolution";
+    case CpuConvAlgorithm::kMatMul:
+      return "MatMul";
+    case CpuConvAlgorithm::kIm2col:
+      return "Im2col";
+    case CpuConvAlgorithm::kDirect:
+      return "Direct";
+    case CpuConvAlgorithm::kWinograd2x2:
+      return "Winograd2x2";
+    case CpuConvAlgorithm::kWinograd4x4:
+      return "Winograd4x4";
+  }
+  return "Unknown";
+}
+
+bool CpuConvShape::operator==(const CpuConvShape& other) const {
+  return batch == other.batch && in_rows == other.in_rows &&
+         in_cols == other.in_cols && in_depth == other.in_depth &&
+         filter_rows == other.filter_rows &&
+         filter_cols == other.filter_cols && out_depth == other.out_depth &&
+         stride_rows == other.stride_rows &&
+         stride_cols == other.stride_cols && pad_rows == other.pad_rows &&
+         pad_cols == other.pad_cols && out_rows == other.out_rows &&
+         out_cols == other.out_cols && num_threads == other.num_threads;
+}
+
+string CpuConvShape::DebugString() const {
+  return strings::StrCat("input ", batch, "x", in_rows, "x", in_cols, "x",
+                         in_depth, ", filter ", filter_rows, "x", filter_cols,
+                         "x", in_depth, "x", out_depth, ", strides ",
+                         stride_rows, "x", stride_cols, ", padding ", pad_rows,
+                         "x", pad_cols, ", output ", out_rows, "x", out_cols,
+                         " on ", num_threads, " threads");
+}
+
+size_t CpuConvShapeHash::operator()(const CpuConvShape& shape) const {
+  uint64 h = 0;
+  for (int dim : {shape.batch, shape.in_rows, shape.in_cols, shape.in_depth,
+                  shape.filter_rows, shape.filter_cols, shape.out_depth,
+                  shape.stride_rows, shape.stride_cols, shape.pad_rows,
+                  shape.pad_cols, shape.out_rows, shape.out_cols,
+                  shape.num_threads}) {
+    h = Hash64Combine(h, dim);
+  }
+  return h;
+}
+
+std::vector<CpuConvAlgorithm> CpuConvCandidates(const CpuConvShape& shape) {
+  std::vector<CpuConvAlgorithm> candidates;
+  if (shape.filter_rows == 1 && shape.filter_cols == 1 &&
+      shape.stride_rows == 1 && shape.stride_cols == 1) {
+    // SpatialConvolution produced NaNs on 1x1 filters during training.
+    candidates.push_back(CpuConvAlgorithm::kMatMul);
+  } else {
+    candidates.push_back(CpuConvAlgorithm::kSpatialConvolution);
+  }
+  candidates.push_back(CpuConvAlgorithm::kIm2col);
+  if (shape.in_depth <= kMaxDirectInDepth) {
+    candidates.push_back(CpuConvAlgorithm::kDirect);
+  }
+  if (shape.filter_rows == 3 && shape.filter_cols == 3 &&
+      shape.stride_rows == 1 && shape.stride_cols == 1) {
+    candidates.push_back(CpuConvAlgorithm::kWinograd2x2);
+    candidates.push_back(CpuConvAlgorithm::kWinograd4x4);
+  }
+  return candidates;
+}
+
+bool CpuConvUseAutotune() {
+  const char* use_autotune = getenv("TF_CPU_CONV_USE_AUTOTUNE");
+  return use_autotune != nullptr && string(use_autotune) == "1";
+}
+
+CpuConvAlgorithmMap* CpuConvAlgorithmMap::Global() {
+  static CpuConvAlgorithmMap* map = new CpuConvAlgorithmMap;
+  return map;
+}
+
+bool CpuConvAlgorithmMap::Find(const CpuConvShape& shape,
+                               CpuConvAlgorithm* algorithm) const {
+  mutex_lock l(mu_);
+  auto it = algorithms_.find(shape);
+  if (it == algorithms_.end()) return false;
+  *algorithm = it->second;
+  return true;
+}
+
+void CpuConvAlgorithmMap::Insert(const CpuConvShape& shape,
+                                 CpuConvAlgorithm algorithm) {
+  VLOG(1) << "Conv2D on CPU uses " << CpuConvAlgorithmName(algorithm)
+          << " for " << shape.DebugString();
+  mutex_lock l(mu_);
+  algorithms_[shape] = algorithm;
+}
+
+namespace functor {
+
+const float WinogradTransform<2>::kBT[4][4] = {
+    {1, 0, -1, 0}, {0, 1, 1, 0}, {0, -1, 1, 0}, {0, 1, 0, -1}};
+const float WinogradTransform<2>::kG[4][3] = {
+    {1, 0, 0}, {0.5, 0.5, 0.5}, {0.5, -0.5, 0.5}, {0, 0, 1}};
+const float WinogradTransform<2>::kAT[2][4] = {{1, 1, 1, 0}, {0, 1, -1, -1}};
+
+const float WinogradTransform<4>::kBT[6][6] = {
+    {4, 0, -5, 0, 1, 0},  {0, -4, -4, 1, 1, 0}, {0, 4, -4, -1, 1, 0},
+    {0, -2, -1, 2, 1, 0}, {0, 2, -1, -2, 1, 0}, {0, 4, 0, -5, 0, 1}};
+const float WinogradTransform<4>::kG[6][3] = {
+    {1.0f / 4, 0, 0},
+    {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+    {-1.0f / 6, 1.0f / 6, -1.0f / 6},
+    {1.0f / 24, 1.0f / 12, 1.0f / 6},
+    {1.0f / 24, -1.0f / 12, 1.0f / 6},
+    {0, 0, 1}};
+const float WinogradTransform<4>::kAT[4][6] = {{1, 1, 1, 1, 1, 0},
+                                               {0, 1, -1, 2, -2, 0},
+                                               {0, 1, 1, 4, 4, 0},
+                                               {0, 1, -1, 8, -8, 1}};
+
+}  // namespace functor
+}  // namespace tensorflow
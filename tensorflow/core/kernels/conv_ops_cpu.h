@@ -0,0 +1,453 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_CONV_OPS_CPU_H_
+#define TENSORFLOW_KERNELS_CONV_OPS_CPU_H_
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// The algorithms computing Conv2D on CPU in the NHWC data format.  They all
+// compute the same result, up to rounding, and each is the fastest for some
+// shapes.
+enum class CpuConvAlgorithm {
+  // Eigen's SpatialConvolution tensor expression.  Supports every shape but
+  // 1x1 filters with stride 1.
+  kSpatialConvolution,
+  // A single tensor contraction of the input by the filter.  Only for 1x1
+  // filters with stride 1.
+  kMatMul,
+  // Blocks of image patches, copied by rows of the filter and multiplied by
+  // the filter matrix, in parallel.
+  kIm2col,
+  // Each filter tap scales a whole output pixel.  Only for inputs with few
+  // channels, whose patches make for skinny matrix products.
+  kDirect,
+  // Winograd's minimal filtering F(2x2, 3x3) and F(4x4, 3x3): 2.25 and 4
+  // times fewer multiplications than the other algorithms, at the cost of
+  // some precision.  Only for 3x3 filters with stride 1.
+  kWinograd2x2,
+  kWinograd4x4,
+};
+
+// Returns the name of "algorithm", for logging.
+const char* CpuConvAlgorithmName(CpuConvAlgorithm algorithm);
+
+// The shape of a Conv2D, which determines the fastest algorithm along with the
+// number of intra-op threads computing it.  The padding is the number of rows
+// and columns added before the input; the padding after it follows from the
+// output size.
+struct CpuConvShape {
+  int batch;
+  int in_rows;
+  int in_cols;
+  int in_depth;
+  int filter_rows;
+  int filter_cols;
+  int out_depth;
+  int stride_rows;
+  int stride_cols;
+  int pad_rows;
+  int pad_cols;
+  int out_rows;
+  int out_cols;
+  int num_threads;
+
+  bool operator==(const CpuConvShape& other) const;
+  string DebugString() const;
+};
+
+struct CpuConvShapeHash {
+  size_t operator()(const CpuConvShape& shape) const;
+};
+
+// Returns the algorithms that can compute a convolution of "shape", starting
+// with the one to use when there is no time to measure them.
+std::vector<CpuConvAlgorithm> CpuConvCandidates(const CpuConvShape& shape);
+
+// Returns true if the environment variable TF_CPU_CONV_USE_AUTOTUNE is "1", in
+// which case the first convolution of each shape times its candidates.
+// Otherwise each convolution uses the first of its candidates.
+bool CpuConvUseAutotune();
+
+// The fastest algorithm measured for each shape and number of threads, shared
+// by all the Conv2D kernels of the process.  Thread-safe.
+class CpuConvAlgorithmMap {
+ public:
+  static CpuConvAlgorithmMap* Global();
+
+  // Returns true and sets "algorithm" if "shape" has been measured.
+  bool Find(const CpuConvShape& shape, CpuConvAlgorithm* algorithm) const;
+  void Insert(const CpuConvShape& shape, CpuConvAlgorithm algorithm);
+
+ private:
+  mutable mutex mu_;
+  std::unordered_map<CpuConvShape, CpuConvAlgorithm, CpuConvShapeHash>
+      algorithms_ GUARDED_BY(mu_);
+};
+
+namespace functor {
+
+// Copies into "col_data" the patches of the output pixels [begin, end) of
+// one image, in the layout of the filter: (filter_rows, filter_cols,
+// in_depth).  Unlike Im2col in ops_util.h, copies a whole row of the filter
+// at once where it lies within the image.
+template <typename T>
+void Im2colRange(const CpuConvShape& s, const T* image, int64 begin,
+                 int64 end, T* col_data) {
+  const int64 filter_row_size = static_cast<int64>(s.filter_cols) * s.in_depth;
+  for (int64 p = begin; p < end; ++p) {
+    const int row_start = (p / s.out_cols) * s.stride_rows - s.pad_rows;
+    const int col_start = (p % s.out_cols) * s.stride_cols - s.pad_cols;
+    // The columns of the filter that lie within the image.
+    const int col_begin = std::max(0, -col_start);
+    const int col_end = std::min(s.filter_cols, s.in_cols - col_start);
+    for (int r = 0; r < s.filter_rows; ++r) {
+      const int row = row_start + r;
+      if (row < 0 || row >= s.in_rows || col_begin >= col_end) {
+        memset(col_data, 0, sizeof(T) * filter_row_size);
+      } else {
+        memset(col_data, 0, sizeof(T) * col_begin * s.in_depth);
+        memcpy(col_data + col_begin * s.in_depth,
+               image + (static_cast<int64>(row) * s.in_cols + col_start +
+                        col_begin) *
+                           s.in_depth,
+               sizeof(T) * (col_end - col_begin) * s.in_depth);
+        memset(col_data + col_end * s.in_depth, 0,
+               sizeof(T) * (s.filter_cols - col_end) * s.in_depth);
+      }
+      col_data += filter_row_size;
+    }
+  }
+}
+
+// Computes the convolution as products of blocks of patches by the filter
+// matrix.  The blocks of all the images are spread over the threads, each of
+// which multiplies them with a single-threaded packed GEMM.  A 1x1 filter
+// with stride 1 and no padding multiplies blocks of the input directly.
+template <typename T>
+void Conv2DIm2col(const DeviceBase::CpuWorkerThreads& workers,
+                  const CpuConvShape& s, const T* input, const T* filter,
+                  T* output) {
+  typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  typedef Eigen::Map<Matrix> MatrixMap;
+  typedef Eigen::Map<const Matrix> ConstMatrixMap;
+
+  // Blocks of patches of about 512KB fit in the L2 or L3 cache, while they
+  // have enough rows to amortize the packing of the filter by each GEMM.
+  static const int64 kBlockBytes = 512 << 10;
+  static const int64 kMinBlockRows = 64;
+  const int64 patch_size =
+      static_cast<int64>(s.filter_rows) * s.filter_cols * s.in_depth;
+  const int64 out_image_size = static_cast<int64>(s.out_rows) * s.out_cols;
+  const int64 in_image_size =
+      static_cast<int64>(s.in_rows) * s.in_cols * s.in_depth;
+  const int64 patch_bytes = patch_size * static_cast<int64>(sizeof(T));
+  const int64 block_rows = std::min(
+      out_image_size, std::max(kMinBlockRows, kBlockBytes / patch_bytes));
+  const int64 blocks_per_image =
+      (out_image_size + block_rows - 1) / block_rows;
+  const bool copy_patches = !(s.filter_rows == 1 && s.filter_cols == 1 &&
+                              s.stride_rows == 1 && s.stride_cols == 1 &&
+                              s.pad_rows == 0 && s.pad_cols == 0);
+
+  auto multiply_blocks = [&](int64 start, int64 limit) {
+    Matrix patches;
+    if (copy_patches) patches.resize(block_rows, patch_size);
+    ConstMatrixMap filter_matrix(filter, patch_size, s.out_depth);
+    for (int64 i = start; i < limit; ++i) {
+      const int64 b = i / blocks_per_image;
+      const int64 begin = (i % blocks_per_image) * block_rows;
+      const int64 rows = std::min(block_rows, out_image_size - begin);
+      const T* image = input + b * in_image_size;
+      MatrixMap out(output + (b * out_image_size + begin) * s.out_depth, rows,
+                    s.out_depth);
+      if (copy_patches) {
+        Im2colRange<T>(s, image, begin, begin + rows, patches.data());
+        out.noalias() = patches.topRows(rows) * filter_matrix;
+      } else {
+        out.noalias() =
+            ConstMatrixMap(image + begin * s.in_depth, rows, patch_size) *
+            filter_matrix;
+      }
+    }
+  };
+  Shard(workers.num_threads, workers.workers, s.batch * blocks_per_image,
+        block_rows * (patch_size + 2 * patch_size * s.out_depth),
+        multiply_blocks);
+}
+
+// Computes the convolution one output row at a time: each input value under
+// a filter tap adds its multiple of a row of the filter to an output pixel.
+// Skips the padding instead of multiplying zeros.
+template <typename T>
+void Conv2DDirect(const DeviceBase::CpuWorkerThreads& workers,
+                  const CpuConvShape& s, const T* input, const T* filter,
+                  T* output) {
+  typedef Eigen::Map<Eigen::Matrix<T, Eigen::Dynamic, 1>> VectorMap;
+  typedef Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, 1>>
+      ConstVectorMap;
+
+  const int64 in_row_size = static_cast<int64>(s.in_cols) * s.in_depth;
+  const int64 in_image_size = s.in_rows * in_row_size;
+  const int64 out_row_size = static_cast<int64>(s.out_cols) * s.out_depth;
+  const int64 filter_row_size =
+      static_cast<int64>(s.filter_cols) * s.in_depth * s.out_depth;
+
+  auto compute_rows = [&](int64 start, int64 limit) {
+    for (int64 i = start; i < limit; ++i) {
+      const T* image = input + (i / s.out_rows) * in_image_size;
+      const int row_start = (i % s.out_rows) * s.stride_rows - s.pad_rows;
+      T* out_row = output + i * out_row_size;
+      std::fill(out_row, out_row + out_row_size, T(0));
+      for (int r = 0; r < s.filter_rows; ++r) {
+        const int row = row_start + r;
+        if (row < 0 || row >= s.in_rows) continue;
+        const T* in_row = image + row * in_row_size;
+        const T* filter_row = filter + r * filter_row_size;
+        for (int x = 0; x < s.out_cols; ++x) {
+          const int col_start = x * s.stride_cols - s.pad_cols;
+          const int col_begin = std::max(0, -col_start);
+          const int col_end = std::min(s.filter_cols, s.in_cols - col_start);
+          if (col_begin >= col_end) continue;
+          // The taps of this filter row cover contiguous input values.
+          const T* in = in_row + (col_start + col_begin) * s.in_depth;
+          const T* f = filter_row + col_begin * s.in_depth * s.out_depth;
+          VectorMap out(out_row + x * s.out_depth, s.out_depth);
+          for (int64 k = 0; k < (col_end - col_begin) * s.in_depth; ++k) {
+            out += in[k] * ConstVectorMap(f, s.out_depth);
+            f += s.out_depth;
+          }
+        }
+      }
+    }
+  };
+  const int64 cost_per_row = static_cast<int64>(s.out_cols) * s.filter_rows *
+                             s.filter_cols * s.in_depth * s.out_depth * 2;
+  Shard(workers.num_threads, workers.workers,
+        static_cast<int64>(s.batch) * s.out_rows, cost_per_row, compute_rows);
+}
+
+// The matrices of Winograd's F(kTileSize x kTileSize, 3x3), as chosen by
+// Lavin & Gray, "Fast Algorithms for Convolutional Neural Networks": an
+// output tile is AT * [(G * g * GT) .* (BT * d * B)] * A, for a 3x3 filter g
+// and an input tile d of kInputTileSize x kInputTileSize.
+template <int kTileSize>
+struct WinogradTransform;
+
+template <>
+struct WinogradTransform<2> {
+  static const int kInputTileSize = 4;
+  static const float kBT[4][4];
+  static const float kG[4][3];
+  static const float kAT[2][4];
+};
+
+template <>
+struct WinogradTransform<4> {
+  static const int kInputTileSize = 6;
+  static const float kBT[6][6];
+  static const float kG[6][3];
+  static const float kAT[4][6];
+};
+
+// Sets the "size" values at "dst" to the sum of the vectors at "src",
+// "src + stride", ..., weighted by the N coefficients.  Skips the zeros,
+// which the transforms have many of.
+template <typename T, int N>
+void WinogradCombine(const float* coefficients, const T* src, int64 stride,
+                     int64 size, T* dst) {
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> ArrayMap;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstArrayMap;
+  ArrayMap out(dst, size);
+  out.setZero();
+  for (int k = 0; k < N; ++k) {
+    if (coefficients[k] == 0) continue;
+    out += static_cast<T>(coefficients[k]) *
+           ConstArrayMap(src + k * stride, size);
+  }
+}
+
+// Computes a 3x3 convolution with stride 1 by Winograd's minimal filtering
+// F(kTileSize x kTileSize, 3x3).  The output is cut into tiles, whose input
+// tiles are transformed by blocks that fit in the cache; each of the
+// kInputTileSize^2 positions of a block then multiplies a matrix of
+// (tiles, in_depth) by the transformed filter, of (in_depth, out_depth),
+// with a packed GEMM.  The blocks of all the images are spread over the
+// threads.
+template <typename T, int kTileSize>
+void Conv2DWinograd(const DeviceBase::CpuWorkerThreads& workers,
+                    const CpuConvShape& s, const T* input, const T* filter,
+                    T* output) {
+  typedef WinogradTransform<kTileSize> Transform;
+  typedef Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      Matrix;
+  typedef Eigen::Map<const Matrix> ConstMatrixMap;
+  static const int kA = Transform::kInputTileSize;
+  static const int kPositions = kA * kA;
+
+  const int64 in_depth = s.in_depth;
+  const int64 out_depth = s.out_depth;
+  const int64 filter_size = in_depth * out_depth;
+
+  // The filter transform, G * g * GT for each pair of channels, stored as
+  // kPositions matrices of (in_depth, out_depth).
+  Matrix filter_by_rows(kA * 3, filter_size);
+  Matrix transformed_filter(kPositions, filter_size);
+  for (int i = 0; i < kA; ++i) {
+    WinogradCombine<T, 3>(Transform::kG[i], filter, 3 * filter_size,
+                          3 * filter_size,
+                          filter_by_rows.data() + i * 3 * filter_size);
+  }
+  for (int i = 0; i < kA; ++i) {
+    for (int j = 0; j < kA; ++j) {
+      WinogradCombine<T, 3>(
+          Transform::kG[j], filter_by_rows.data() + i * 3 * filter_size,
+          filter_size, filter_size,
+          transformed_filter.data() + (i * kA + j) * filter_size);
+    }
+  }
+
+  const int64 tile_rows = (s.out_rows + kTileSize - 1) / kTileSize;
+  const int64 tile_cols = (s.out_cols + kTileSize - 1) / kTileSize;
+  const int64 tiles_per_image = tile_rows * tile_cols;
+  const int64 num_tiles = s.batch * tiles_per_image;
+  // Blocks of transformed tiles of about 1MB stay in the L2 or L3 cache
+  // between their transforms and their GEMMs.
+  static const int64 kBlockBytes = 1 << 20;
+  static const int64 kMinBlockTiles = 16;
+  const int64 tile_bytes =
+      kPositions * (in_depth + out_depth) * static_cast<int64>(sizeof(T));
+  const int64 block_tiles = std::min(
+      num_tiles, std::max(kMinBlockTiles, kBlockBytes / tile_bytes));
+  const int64 num_blocks = (num_tiles + block_tiles - 1) / block_tiles;
+  const int64 in_row_size = static_cast<int64>(s.in_cols) * in_depth;
+  const int64 in_image_size = s.in_rows * in_row_size;
+  const int64 out_row_size = static_cast<int64>(s.out_cols) * out_depth;
+  const int64 out_image_size = s.out_rows * out_row_size;
+
+  auto compute_blocks = [&](int64 start, int64 limit) {
+    // The transformed input and output tiles of a block, by position: the
+    // rows of position p are [p * block_tiles, (p + 1) * block_tiles).
+    Matrix transformed_input(kPositions * block_tiles, in_depth);
+    Matrix transformed_output(kPositions * block_tiles, out_depth);
+    Eigen::Matrix<T, Eigen::Dynamic, 1> tile(kPositions * in_depth);
+    Eigen::Matrix<T, Eigen::Dynamic, 1> tile_by_rows(kPositions * in_depth);
+    Eigen::Matrix<T, Eigen::Dynamic, 1> output_rows(kTileSize * kA *
+                                                    out_depth);
+    for (int64 block = start; block < limit; ++block) {
+      const int64 first = block * block_tiles;
+      const int64 tiles = std::min(block_tiles, num_tiles - first);
+
+      // BT * d * B for each input tile, the outside of the image being zero.
+      for (int64 t = 0; t < tiles; ++t) {
+        const int64 b = (first + t) / tiles_per_image;
+        const int64 tile_index = (first + t) % tiles_per_image;
+        const int row_start = (tile_index / tile_cols) * kTileSize - s.pad_rows;
+        const int col_start = (tile_index % tile_cols) * kTileSize - s.pad_cols;
+        const int col_begin = std::max(0, -col_start);
+        const int col_end = std::min(kA, s.in_cols - col_start);
+        const T* image = input + b * in_image_size;
+        T* d = tile.data();
+        for (int r = 0; r < kA; ++r) {
+          const int row = row_start + r;
+          T* d_row = d + r * kA * in_depth;
+          if (row < 0 || row >= s.in_rows || col_begin >= col_end) {
+            memset(d_row, 0, sizeof(T) * kA * in_depth);
+            continue;
+          }
+          memset(d_row, 0, sizeof(T) * col_begin * in_depth);
+          memcpy(d_row + col_begin * in_depth,
+                 image + row * in_row_size + (col_start + col_begin) * in_depth,
+                 sizeof(T) * (col_end - col_begin) * in_depth);
+          memset(d_row + col_end * in_depth, 0,
+                 sizeof(T) * (kA - col_end) * in_depth);
+        }
+        for (int i = 0; i < kA; ++i) {
+          WinogradCombine<T, kA>(Transform::kBT[i], d, kA * in_depth,
+                                 kA * in_depth,
+                                 tile_by_rows.data() + i * kA * in_depth);
+        }
+        for (int i = 0; i < kA; ++i) {
+          for (int j = 0; j < kA; ++j) {
+            WinogradCombine<T, kA>(
+                Transform::kBT[j], tile_by_rows.data() + i * kA * in_depth,
+                in_depth, in_depth,
+                transformed_input.data() +
+                    ((i * kA + j) * block_tiles + t) * in_depth);
+          }
+        }
+      }
+
+      // The elementwise products, summed over the input channels.
+      for (int p = 0; p < kPositions; ++p) {
+        transformed_output.middleRows(p * block_tiles, tiles).noalias() =
+            transformed_input.middleRows(p * block_tiles, tiles) *
+            ConstMatrixMap(transformed_filter.data() + p * filter_size,
+                           in_depth, out_depth);
+      }
+
+      // AT * m * A for each output tile, cropped to the output.
+      const int64 position_stride = block_tiles * out_depth;
+      for (int64 t = 0; t < tiles; ++t) {
+        const int64 b = (first + t) / tiles_per_image;
+        const int64 tile_index = (first + t) % tiles_per_image;
+        const int row_start = (tile_index / tile_cols) * kTileSize;
+        const int col_start = (tile_index % tile_cols) * kTileSize;
+        const T* m = transformed_output.data() + t * out_depth;
+        for (int i = 0; i < kTileSize; ++i) {
+          for (int j = 0; j < kA; ++j) {
+            WinogradCombine<T, kA>(
+                Transform::kAT[i], m + j * position_stride,
+                kA * position_stride, out_depth,
+                output_rows.data() + (i * kA + j) * out_depth);
+          }
+        }
+        T* image = output + b * out_image_size;
+        for (int i = 0; i < kTileSize && row_start + i < s.out_rows; ++i) {
+          for (int j = 0; j < kTileSize && col_start + j < s.out_cols; ++j) {
+            WinogradCombine<T, kA>(
+                Transform::kAT[j], output_rows.data() + i * kA * out_depth,
+                out_depth, out_depth,
+                image + (row_start + i) * out_row_size +
+                    (col_start + j) * out_depth);
+          }
+        }
+      }
+    }
+  };
+  const int64 cost_per_block =
+      block_tiles * kPositions * (in_depth * out_depth * 2 +
+                                  (in_depth + out_depth) * kA * 2);
+  Shard(workers.num_threads, workers.workers, num_blocks, cost_per_block,
+        compute_blocks);
+}
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_CONV_OPS_CPU_H_
@@ -0,0 +1,318 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/conv_ops_cpu.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns the shape of a convolution with "padding", as Conv2D computes it.
+CpuConvShape MakeShape(int batch, int rows, int cols, int in_depth,
+                       int filter_rows, int filter_cols, int out_depth,
+                       int stride, Padding padding) {
+  CpuConvShape s;
+  s.batch = batch;
+  s.in_rows = rows;
+  s.in_cols = cols;
+  s.in_depth = in_depth;
+  s.filter_rows = filter_rows;
+  s.filter_cols = filter_cols;
+  s.out_depth = out_depth;
+  s.stride_rows = stride;
+  s.stride_cols = stride;
+  int pad_bottom, pad_right;
+  TF_CHECK_OK(Get2dOutputSizeVerbose(rows, cols, filter_rows, filter_cols,
+                                     stride, stride, padding, &s.out_rows,
+                                     &s.out_cols, &s.pad_rows, &pad_bottom,
+                                     &s.pad_cols, &pad_right));
+  // Only the cache of the fastest algorithms looks at the thread count.
+  s.num_threads = 1;
+  return s;
+}
+
+// Returns "n" small values, some of them negative.
+std::vector<float> Values(int64 n, int seed) {
+  std::vector<float> values(n);
+  for (int64 i = 0; i < n; ++i) {
+    values[i] = static_cast<float>((i * 7 + seed) % 13) / 4.0f - 1.5f;
+  }
+  return values;
+}
+
+// Computes the convolution of shape "s" with plain loops.
+std::vector<float> Reference(const CpuConvShape& s,
+                             const std::vector<float>& input,
+                             const std::vector<float>& filter) {
+  std::vector<float> output(
+      static_cast<int64>(s.batch) * s.out_rows * s.out_cols * s.out_depth);
+  float* out = output.data();
+  for (int b = 0; b < s.batch; ++b) {
+    for (int y = 0; y < s.out_rows; ++y) {
+      for (int x = 0; x < s.out_cols; ++x) {
+        for (int o = 0; o < s.out_depth; ++o) {
+          double sum = 0;
+          for (int r = 0; r < s.filter_rows; ++r) {
+            const int row = y * s.stride_rows - s.pad_rows + r;
+            if (row < 0 || row >= s.in_rows) continue;
+            for (int c = 0; c < s.filter_cols; ++c) {
+              const int col = x * s.stride_cols - s.pad_cols + c;
+              if (col < 0 || col >= s.in_cols) continue;
+              for (int d = 0; d < s.in_depth; ++d) {
+                sum += input[((b * s.in_rows + row) * s.in_cols + col) *
+                                 s.in_depth +
+                             d] *
+                       filter[((r * s.filter_cols + c) * s.in_depth + d) *
+                                  s.out_depth +
+                              o];
+              }
+            }
+          }
+          *out++ = sum;
+        }
+      }
+    }
+  }
+  return output;
+}
+
+class CpuConvTest : public ::testing::Test {
+ protected:
+  // Runs the algorithms on 4 threads, whatever the number of cores.
+  CpuConvTest() : pool_(Env::Default(), "test", 4) {
+    workers_.num_threads = 4;
+    workers_.workers = &pool_;
+  }
+
+  // Checks "algorithm" against the reference on a convolution of "s", within
+  // "tolerance" of the largest magnitude of the output.
+  void Check(CpuConvAlgorithm algorithm, const CpuConvShape& s,
+             float tolerance = 1e-5) {
+    const std::vector<float> input = Values(
+        static_cast<int64>(s.batch) * s.in_rows * s.in_cols * s.in_depth, 1);
+    const std::vector<float> filter = Values(
+        static_cast<int64>(s.filter_rows) * s.filter_cols * s.in_depth *
+            s.out_depth,
+        2);
+    const std::vector<float> expected = Reference(s, input, filter);
+    // Garbage in the output must be overwritten.
+    std::vector<float> output(expected.size(), 1e10f);
+    switch (algorithm) {
+      case CpuConvAlgorithm::kIm2col:
+        functor::Conv2DIm2col<float>(workers_, s, input.data(), filter.data(),
+                                     output.data());
+        break;
+      case CpuConvAlgorithm::kDirect:
+        functor::Conv2DDirect<float>(workers_, s, input.data(), filter.data(),
+                                     output.data());
+        break;
+      case CpuConvAlgorithm::kWinograd2x2:
+        functor::Conv2DWinograd<float, 2>(workers_, s, input.data(),
+                                          filter.data(), output.data());
+        break;
+      case CpuConvAlgorithm::kWinograd4x4:
+        functor::Conv2DWinograd<float, 4>(workers_, s, input.data(),
+                                          filter.data(), output.data());
+        break;
+      default:
+        FAIL() << "Not computed by the header: "
+               << CpuConvAlgorithmName(algorithm);
+    }
+    float max_magnitude = 1;
+    for (float value : expected) {
+      max_magnitude = std::max(max_magnitude, std::abs(value));
+    }
+    for (size_t i = 0; i < expected.size(); ++i) {
+      ASSERT_NEAR(expected[i], output[i], tolerance * max_magnitude)
+          << i << " in " << s.DebugString();
+    }
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads workers_;
+};
+
+TEST_F(CpuConvTest, Im2col) {
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(2, 5, 7, 3, 3, 3, 4, 1, SAME));
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(2, 5, 7, 3, 3, 3, 4, 1, VALID));
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(3, 9, 8, 5, 3, 2, 6, 2, SAME));
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(1, 11, 11, 2, 5, 5, 3, 3, VALID));
+  // Filters wider than the image, and strides larger than the filter.
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(1, 3, 2, 2, 5, 4, 3, 1, SAME));
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(2, 8, 8, 3, 1, 1, 5, 3, SAME));
+}
+
+TEST_F(CpuConvTest, Im2colBlocks) {
+  // Several blocks per image, the last one partial.
+  Check(CpuConvAlgorithm::kIm2col,
+        MakeShape(2, 40, 37, 64, 3, 3, 16, 1, SAME));
+}
+
+TEST_F(CpuConvTest, Im2col1x1) {
+  // Multiplies the input itself.
+  Check(CpuConvAlgorithm::kIm2col, MakeShape(3, 20, 30, 8, 1, 1, 5, 1, SAME));
+}
+
+TEST_F(CpuConvTest, Direct) {
+  Check(CpuConvAlgorithm::kDirect, MakeShape(2, 5, 7, 3, 3, 3, 4, 1, SAME));
+  Check(CpuConvAlgorithm::kDirect, MakeShape(2, 5, 7, 1, 3, 3, 4, 1, VALID));
+  Check(CpuConvAlgorithm::kDirect, MakeShape(2, 16, 15, 3, 7, 7, 8, 2, SAME));
+  Check(CpuConvAlgorithm::kDirect, MakeShape(1, 3, 2, 2, 5, 4, 3, 1, SAME));
+  Check(CpuConvAlgorithm::kDirect, MakeShape(1, 11, 11, 4, 3, 3, 3, 4, SAME));
+}
+
+// The transforms of F(4x4, 3x3) have larger coefficients, which cost some
+// precision.
+const float kWinograd2x2Tolerance = 1e-5;
+const float kWinograd4x4Tolerance = 1e-4;
+
+TEST_F(CpuConvTest, Winograd) {
+  for (CpuConvAlgorithm algorithm :
+       {CpuConvAlgorithm::kWinograd2x2, CpuConvAlgorithm::kWinograd4x4}) {
+    const float tolerance = algorithm == CpuConvAlgorithm::kWinograd2x2
+                                ? kWinograd2x2Tolerance
+                                : kWinograd4x4Tolerance;
+    // Outputs covered by whole tiles, and by partial ones.
+    Check(algorithm, MakeShape(2, 8, 8, 3, 3, 3, 4, 1, SAME), tolerance);
+    Check(algorithm, MakeShape(2, 7, 9, 5, 3, 3, 6, 1, SAME), tolerance);
+    Check(algorithm, MakeShape(3, 10, 11, 4, 3, 3, 2, 1, VALID), tolerance);
+    Check(algorithm, MakeShape(1, 1, 2, 3, 3, 3, 3, 1, SAME), tolerance);
+    Check(algorithm, MakeShape(1, 3, 3, 2, 3, 3, 5, 1, VALID), tolerance);
+  }
+}
+
+TEST_F(CpuConvTest, WinogradBlocks) {
+  // Several blocks of tiles, spread over the threads, the last one partial.
+  Check(CpuConvAlgorithm::kWinograd2x2,
+        MakeShape(2, 35, 35, 64, 3, 3, 48, 1, SAME), kWinograd2x2Tolerance);
+  Check(CpuConvAlgorithm::kWinograd4x4,
+        MakeShape(2, 35, 35, 64, 3, 3, 48, 1, SAME), kWinograd4x4Tolerance);
+}
+
+TEST(CpuConvCandidatesTest, Candidates) {
+  const std::vector<CpuConvAlgorithm> matmul =
+      CpuConvCandidates(MakeShape(1, 8, 8, 16, 1, 1, 8, 1, SAME));
+  ASSERT_EQ(2, matmul.size());
+  EXPECT_EQ(CpuConvAlgorithm::kMatMul, matmul[0]);
+  EXPECT_EQ(CpuConvAlgorithm::kIm2col, matmul[1]);
+
+  const std::vector<CpuConvAlgorithm> spatial =
+      CpuConvCandidates(MakeShape(1, 8, 8, 16, 5, 5, 8, 1, SAME));
+  ASSERT_EQ(2, spatial.size());
+  EXPECT_EQ(CpuConvAlgorithm::kSpatialConvolution, spatial[0]);
+
+  const std::vector<CpuConvAlgorithm> winograd =
+      CpuConvCandidates(MakeShape(1, 8, 8, 16, 3, 3, 8, 1, SAME));
+  ASSERT_EQ(4, winograd.size());
+  EXPECT_EQ(CpuConvAlgorithm::kSpatialConvolution, winograd[0]);
+  EXPECT_EQ(CpuConvAlgorithm::kWinograd2x2, winograd[2]);
+  EXPECT_EQ(CpuConvAlgorithm::kWinograd4x4, winograd[3]);
+
+  const std::vector<CpuConvAlgorithm> rgb =
+      CpuConvCandidates(MakeShape(1, 8, 8, 3, 3, 3, 8, 2, SAME));
+  ASSERT_EQ(3, rgb.size());
+  EXPECT_EQ(CpuConvAlgorithm::kDirect, rgb[2]);
+}
+
+class Conv2DAutotuneTest : public OpsTestBase {
+ protected:
+  Conv2DAutotuneTest() { setenv("TF_CPU_CONV_USE_AUTOTUNE", "1", 1); }
+  ~Conv2DAutotuneTest() override { unsetenv("TF_CPU_CONV_USE_AUTOTUNE"); }
+
+  // Returns the shape of a convolution, as the Conv2D kernel sees it.
+  CpuConvShape KernelShape(int batch, int rows, int cols, int in_depth,
+                           int filter_size, int out_depth, int stride,
+                           Padding padding) {
+    CpuConvShape s = MakeShape(batch, rows, cols, in_depth, filter_size,
+                               filter_size, out_depth, stride, padding);
+    s.num_threads = device_->tensorflow_cpu_worker_threads()->num_threads;
+    return s;
+  }
+
+  // Runs Conv2D twice on a convolution of "s" and checks both outputs against
+  // the reference.
+  void RunConv2D(const CpuConvShape& s, const string& padding) {
+    TF_ASSERT_OK(NodeDefBuilder("conv", "Conv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("strides", {1, s.stride_rows, s.stride_cols, 1})
+                     .Attr("padding", padding)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    const TensorShape input_shape({s.batch, s.in_rows, s.in_cols, s.in_depth});
+    const TensorShape filter_shape(
+        {s.filter_rows, s.filter_cols, s.in_depth, s.out_depth});
+    const std::vector<float> input = Values(input_shape.num_elements(), 1);
+    const std::vector<float> filter = Values(filter_shape.num_elements(), 2);
+    AddInputFromArray<float>(input_shape, input);
+    AddInputFromArray<float>(filter_shape, filter);
+    Tensor expected(DT_FLOAT,
+                    TensorShape({s.batch, s.out_rows, s.out_cols, s.out_depth}));
+    test::FillValues<float>(&expected, Reference(s, input, filter));
+
+    // The first run measures every candidate, each of them writing the
+    // output, and the second one uses the fastest.
+    for (int run = 0; run < 2; ++run) {
+      TF_ASSERT_OK(RunOpKernel());
+      test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-3);
+    }
+  }
+};
+
+TEST_F(Conv2DAutotuneTest, CachesFastestAlgorithm) {
+  const CpuConvShape s = KernelShape(2, 6, 5, 3, 3, 4, 1, SAME);
+  CpuConvAlgorithm algorithm;
+  ASSERT_FALSE(CpuConvAlgorithmMap::Global()->Find(s, &algorithm));
+  RunConv2D(s, "SAME");
+  EXPECT_TRUE(CpuConvAlgorithmMap::Global()->Find(s, &algorithm));
+
+  // The fastest algorithm on other thread counts is still unknown.
+  CpuConvShape other_threads = s;
+  other_threads.num_threads += 1;
+  EXPECT_FALSE(CpuConvAlgorithmMap::Global()->Find(other_threads, &algorithm));
+}
+
+TEST_F(Conv2DAutotuneTest, StridedOneByOneSame) {
+  // The output needs less than the input, so no padding is added before it.
+  const CpuConvShape s = KernelShape(1, 8, 8, 3, 1, 2, 4, SAME);
+  EXPECT_EQ(0, s.pad_rows);
+  EXPECT_EQ(0, s.pad_cols);
+  RunConv2D(s, "SAME");
+}
+
+TEST_F(Conv2DAutotuneTest, DisabledByDefault) {
+  unsetenv("TF_CPU_CONV_USE_AUTOTUNE");
+  const CpuConvShape s = KernelShape(1, 7, 6, 2, 3, 3, 1, VALID);
+  RunConv2D(s, "VALID");
+  CpuConvAlgorithm algorithm;
+  EXPECT_FALSE(CpuConvAlgorithmMap::Global()->Find(s, &algorithm));
+}
+
+}  // namespace
+}  // namespace tensorflow
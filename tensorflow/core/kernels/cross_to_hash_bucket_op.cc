@@ -0,0 +1,105 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Hashes crosses of string and int64 features: element i of the output is the
+// combined keyed hash of the elements i of all the inputs, modulo the number
+// of buckets.  Each feature is hashed in place, so no cross is ever built as a
+// string.
+class CrossToHashBucketOp : public OpKernel {
+ public:
+  explicit CrossToHashBucketOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_buckets", &num_buckets_));
+    std::vector<int64> key;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("key", &key));
+    OP_REQUIRES(ctx, key.size() == 2,
+                errors::InvalidArgument("Key must have 2 elements, got ",
+                                        key.size()));
+    key_[0] = static_cast<uint64>(key[0]);
+    key_[1] = static_cast<uint64>(key[1]);
+  }
+
+  void Compute(OpKernelContext* context) override {
+    OpInputList inputs;
+    OP_REQUIRES_OK(context, context->input_list("inputs", &inputs));
+    const TensorShape& shape = inputs[0].shape();
+    // Only one of the two pointers of each feature is set, by its type.
+    std::vector<const string*> strings(inputs.size(), nullptr);
+    std::vector<const int64*> ints(inputs.size(), nullptr);
+    for (int j = 0; j < inputs.size(); ++j) {
+      OP_REQUIRES(context, inputs[j].shape() == shape,
+                  errors::InvalidArgument(
+                      "All inputs must have the same shape, but input 0 has "
+                      "shape ",
+                      shape.DebugString(), " and input ", j, " has shape ",
+                      inputs[j].shape().DebugString()));
+      if (inputs[j].dtype() == DT_STRING) {
+        strings[j] = inputs[j].flat<string>().data();
+      } else {
+        ints[j] = inputs[j].flat<int64>().data();
+      }
+    }
+
+    Tensor* output_tensor = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output("output", shape, &output_tensor));
+    auto output_flat = output_tensor->flat<int64>();
+
+    auto hash = [this, &strings, &ints](int j, int64 i) {
+      if (strings[j] != nullptr) return KeyedHash64(key_, strings[j][i]);
+      char buf[sizeof(int64)];
+      core::EncodeFixed64(buf, ints[j][i]);
+      return KeyedHash64(key_, buf, sizeof(buf));
+    };
+    const int num_inputs = inputs.size();
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          shape.num_elements(), 100 * num_inputs,
+          [&hash, &output_flat, num_inputs, this](int64 start, int64 limit) {
+            for (int64 i = start; i < limit; ++i) {
+              uint64 cross = hash(0, i);
+              for (int j = 1; j < num_inputs; ++j) {
+                cross = Hash64Combine(cross, hash(j, i));
+              }
+              // The number of buckets is positive in int64, so the cast of
+              // the bucket id is safe.
+              output_flat(i) = static_cast<int64>(cross % num_buckets_);
+            }
+          });
+  }
+
+ private:
+  int64 num_buckets_;
+  uint64 key_[2];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(CrossToHashBucketOp);
+};
+
+REGISTER_KERNEL_BUILDER(Name("CrossToHashBucket").Device(DEVICE_CPU),
+                        CrossToHashBucketOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,127 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/parsing_ops.cc.
+
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/io/column_block.h"
+
+namespace tensorflow {
+
+namespace {
+
+Status ColumnTypeForDataType(DataType dtype, io::ColumnType* type) {
+  switch (dtype) {
+    case DT_FLOAT:
+      *type = io::kColumnFloat;
+      return Status::OK();
+    case DT_DOUBLE:
+      *type = io::kColumnDouble;
+      return Status::OK();
+    case DT_INT32:
+      *type = io::kColumnInt32;
+      return Status::OK();
+    case DT_INT64:
+      *type = io::kColumnInt64;
+      return Status::OK();
+    default:
+      return errors::InvalidArgument("Unsupported column type: ",
+                                     DataTypeString(dtype));
+  }
+}
+
+// Decodes column "column" of "reader" into "out", whose type matches it.
+Status ReadColumn(const io::ColumnBlockReader& reader, int column,
+                  Tensor* out) {
+  switch (out->dtype()) {
+#define HANDLE_TYPE(T)                                 \
+  case DataTypeToEnum<T>::value:                       \
+    return reader.ReadColumn(                          \
+        column, reinterpret_cast<char*>(out->flat<T>().data()));
+    HANDLE_TYPE(float);
+    HANDLE_TYPE(double);
+    HANDLE_TYPE(int32);
+    HANDLE_TYPE(int64);
+#undef HANDLE_TYPE
+    default:
+      return errors::InvalidArgument("Unsupported column type: ",
+                                     DataTypeString(out->dtype()));
+  }
+}
+
+}  // namespace
+
+class DecodeColumnBlockOp : public OpKernel {
+ public:
+  explicit DecodeColumnBlockOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("dtypes", &dtypes_));
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("row_shapes", &row_shapes_));
+    OP_REQUIRES(ctx, dtypes_.size() == row_shapes_.size(),
+                errors::InvalidArgument("len(dtypes) != len(row_shapes)"));
+    column_types_.resize(dtypes_.size());
+    for (size_t c = 0; c < dtypes_.size(); ++c) {
+      OP_REQUIRES_OK(ctx, ColumnTypeForDataType(dtypes_[c], &column_types_[c]));
+    }
+  }
+
+  void Compute(OpKernelContext* ctx) override {
+    const Tensor& block = ctx->input(0);
+    OP_REQUIRES(ctx, TensorShapeUtils::IsScalar(block.shape()),
+                errors::InvalidArgument("block must be a scalar, got shape: ",
+                                        block.shape().DebugString()));
+
+    io::ColumnBlockReader reader;
+    OP_REQUIRES_OK(ctx, reader.Init(block.scalar<string>()()));
+    OP_REQUIRES(ctx, reader.num_columns() == static_cast<int>(dtypes_.size()),
+                errors::InvalidArgument("Expected ", dtypes_.size(),
+                                        " columns but the block has ",
+                                        reader.num_columns()));
+
+    for (int c = 0; c < reader.num_columns(); ++c) {
+      OP_REQUIRES(ctx, reader.type(c) == column_types_[c],
+                  errors::InvalidArgument("Column ", c, " of the block is not ",
+                                          DataTypeString(dtypes_[c])));
+      OP_REQUIRES(
+          ctx, reader.values_per_row(c) == row_shapes_[c].num_elements(),
+          errors::InvalidArgument("Column ", c, " of the block has ",
+                                  reader.values_per_row(c),
+                                  " values per row but row shape ",
+                                  row_shapes_[c].DebugString(), " has ",
+                                  row_shapes_[c].num_elements()));
+      TensorShape shape({reader.num_rows()});
+      shape.AppendShape(row_shapes_[c]);
+
+      Tensor* out = nullptr;
+      OP_REQUIRES_OK(ctx, ctx->allocate_output(c, shape, &out));
+      OP_REQUIRES_OK(ctx, ReadColumn(reader, c, out));
+    }
+  }
+
+ private:
+  DataTypeVector dtypes_;
+  std::vector<io::ColumnType> column_types_;
+  std::vector<TensorShape> row_shapes_;
+};
+
+REGISTER_KERNEL_BUILDER(Name("DecodeColumnBlock").Device(DEVICE_CPU),
+                        DecodeColumnBlockOp);
+
+}  // namespace tensorflow
@@ -0,0 +1,90 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/io/column_block.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class DecodeColumnBlockOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const DataTypeVector& dtypes,
+              const std::vector<TensorShape>& row_shapes) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "DecodeColumnBlock")
+                     .Input(FakeInput(DT_STRING))
+                     .Attr("dtypes", dtypes)
+                     .Attr("row_shapes", row_shapes)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(DecodeColumnBlockOpTest, Decode) {
+  const float floats[] = {0, 1, 2, 3, 4, 5};
+  const int64 ints[] = {7, 8, 9};
+  io::ColumnBlockBuilder builder(3, table::kNoCompression);
+  builder.AddColumn(io::kColumnFloat, 2, floats);
+  builder.AddColumn(io::kColumnInt64, 1, ints);
+  const string block = builder.Finish();
+
+  MakeOp({DT_FLOAT, DT_INT64}, {TensorShape({2}), TensorShape({})});
+  AddInputFromArray<string>(TensorShape({}), {block});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_floats(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected_floats, {0, 1, 2, 3, 4, 5});
+  test::ExpectTensorEqual<float>(expected_floats, *GetOutput(0));
+  Tensor expected_ints(allocator(), DT_INT64, TensorShape({3}));
+  test::FillValues<int64>(&expected_ints, {7, 8, 9});
+  test::ExpectTensorEqual<int64>(expected_ints, *GetOutput(1));
+}
+
+TEST_F(DecodeColumnBlockOpTest, Compressed) {
+  std::vector<double> doubles(1000, 3.0);
+  io::ColumnBlockBuilder builder(500, table::kSnappyCompression);
+  builder.AddColumn(io::kColumnDouble, 2, doubles.data());
+
+  MakeOp({DT_DOUBLE}, {TensorShape({2})});
+  AddInputFromArray<string>(TensorShape({}), {builder.Finish()});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_DOUBLE, TensorShape({500, 2}));
+  test::FillFn<double>(&expected, [](int) { return 3.0; });
+  test::ExpectTensorEqual<double>(expected, *GetOutput(0));
+}
+
+TEST_F(DecodeColumnBlockOpTest, Mismatch) {
+  const int32 ints[] = {1, 2, 3};
+  io::ColumnBlockBuilder builder(3, table::kNoCompression);
+  builder.AddColumn(io::kColumnInt32, 1, ints);
+  const string block = builder.Finish();
+
+  MakeOp({DT_FLOAT}, {TensorShape({})});
+  AddInputFromArray<string>(TensorShape({}), {block});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("is not float")) << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -14,6 +14,8 @@ limitations under the License.
 ==============================================================================*/
 
 // See docs in ../ops/parsing_ops.cc.
+#include <string.h>
+#include <deque>
 #include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -21,9 +23,43 @@ limitations under the License.
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/strings/numbers.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// Returns the first byte in [p, end) that is "delim", a quote or a CR/LF,
+// or "end" if there is none. Eight bytes are tested at a time using the
+// usual "has zero byte" bit trick, so long unquoted fields are skipped
+// without looking at every character.
+inline const char* FindSpecialChar(const char* p, const char* end,
+                                   char delim) {
+  static const uint64 kOnes = 0x0101010101010101ULL;
+  static const uint64 kHighBits = 0x8080808080808080ULL;
+  const uint64 delims = kOnes * static_cast<uint8>(delim);
+  const uint64 quotes = kOnes * static_cast<uint8>('"');
+  const uint64 newlines = kOnes * static_cast<uint8>('\n');
+  const uint64 returns = kOnes * static_cast<uint8>('\r');
+  auto has_zero_byte = [](uint64 x) { return (x - kOnes) & ~x & kHighBits; };
+  for (; end - p >= 8; p += 8) {
+    uint64 word;
+    memcpy(&word, p, sizeof(word));
+    if (has_zero_byte(word ^ delims) | has_zero_byte(word ^ quotes) |
+        has_zero_byte(word ^ newlines) | has_zero_byte(word ^ returns)) {
+      break;
+    }
+  }
+  for (; p < end; ++p) {
+    const char c = *p;
+    if (c == delim || c == '"' || c == '\n' || c == '\r') return p;
+  }
+  return end;
+}
+
+}  // namespace
+
 class DecodeCSVOp : public OpKernel {
  public:
   explicit DecodeCSVOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -62,176 +98,200 @@ class DecodeCSVOp : public OpKernel {
 
     for (int i = 0; i < static_cast<int>(out_type_.size()); ++i) {
       Tensor* out = nullptr;
-      output.allocate(i, records->shape(), &out);
+      OP_REQUIRES_OK(ctx, output.allocate(i, records->shape(), &out));
     }
 
-    for (int64 i = 0; i < records_size; ++i) {
-      const StringPiece record(records_t(i));
-      std::vector<string> fields;
-      ExtractFields(ctx, record, &fields);
-      OP_REQUIRES(ctx, fields.size() == out_type_.size(),
-                  errors::InvalidArgument("Expect ", out_type_.size(),
-                                          " fields but have ", fields.size(),
-                                          " in record ", i));
-
-      // Check each field in the record
-      for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
-        const DataType& dtype = out_type_[f];
-        switch (dtype) {
-          case DT_INT32: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
-            } else {
-              int32 value;
-              OP_REQUIRES(ctx, strings::safe_strto32(fields[f], &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid int32: ",
-                                                  fields[f]));
-              output[f]->flat<int32>()(i) = value;
-            }
-            break;
+    // Records are independent, so they are split into contiguous ranges that
+    // are parsed in parallel. Each field is converted straight into its
+    // output column. If several records are malformed, the error of the
+    // first one is reported.
+    mutex mu;
+    int64 first_error_record = records_size;
+    Status first_error;
+    auto parse_range = [this, &records_t, &record_defaults, &output, &mu,
+                        &first_error_record, &first_error](int64 start,
+                                                           int64 limit) {
+      std::vector<StringPiece> fields;
+      std::deque<string> unescaped;
+      string scratch;
+      for (int64 i = start; i < limit; ++i) {
+        fields.clear();
+        unescaped.clear();
+        Status s = ExtractFields(records_t(i), &fields, &unescaped);
+        if (s.ok()) {
+          s = ConvertFields(i, fields, record_defaults, &output, &scratch);
+        }
+        if (!s.ok()) {
+          mutex_lock l(mu);
+          if (i < first_error_record) {
+            first_error_record = i;
+            first_error = s;
           }
-          case DT_INT64: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-
-              output[f]->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
-            } else {
-              int64 value;
-              OP_REQUIRES(ctx, strings::safe_strto64(fields[f], &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid int64: ",
-                                                  fields[f]));
-              output[f]->flat<int64>()(i) = value;
+          return;
+        }
+      }
+    };
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+    const int64 cost_per_record = 100 + 50 * out_type_.size();
+    Shard(worker_threads.num_threads, worker_threads.workers, records_size,
+          cost_per_record, parse_range);
+    OP_REQUIRES_OK(ctx, first_error);
+  }
+
+ private:
+  std::vector<DataType> out_type_;
+  char delim_;
+
+  // Checks the fields of record "i" and writes them into the outputs.
+  // "scratch" is reused to NUL-terminate float fields for strtof.
+  Status ConvertFields(int64 i, const std::vector<StringPiece>& fields,
+                       const OpInputList& record_defaults,
+                       OpOutputList* output, string* scratch) {
+    if (fields.size() != out_type_.size()) {
+      return errors::InvalidArgument("Expect ", out_type_.size(),
+                                     " fields but have ", fields.size(),
+                                     " in record ", i);
+    }
+
+    // Check each field in the record
+    for (int f = 0; f < static_cast<int>(out_type_.size()); ++f) {
+      const DataType& dtype = out_type_[f];
+      const StringPiece field = fields[f];
+      Tensor* out = (*output)[f];
+      // If this field is empty, check if default is given:
+      // If yes, use default value; Otherwise report error.
+      if (field.empty()) {
+        if (record_defaults[f].NumElements() != 1) {
+          return errors::InvalidArgument(
+              "Field ", f, " is required but missing in record ", i, "!");
+        }
+      }
+      switch (dtype) {
+        case DT_INT32: {
+          if (field.empty()) {
+            out->flat<int32>()(i) = record_defaults[f].flat<int32>()(0);
+          } else {
+            int32 value;
+            if (!strings::safe_strto32(field, &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid int32: ", field);
             }
-            break;
+            out->flat<int32>()(i) = value;
           }
-          case DT_FLOAT: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<float>()(i) = record_defaults[f].flat<float>()(0);
-            } else {
-              float value;
-              OP_REQUIRES(ctx, strings::safe_strtof(fields[f].c_str(), &value),
-                          errors::InvalidArgument("Field ", f, " in record ", i,
-                                                  " is not a valid float: ",
-                                                  fields[f]));
-              output[f]->flat<float>()(i) = value;
+          break;
+        }
+        case DT_INT64: {
+          if (field.empty()) {
+            out->flat<int64>()(i) = record_defaults[f].flat<int64>()(0);
+          } else {
+            int64 value;
+            if (!strings::safe_strto64(field, &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid int64: ", field);
             }
-            break;
+            out->flat<int64>()(i) = value;
           }
-          case DT_STRING: {
-            // If this field is empty, check if default is given:
-            // If yes, use default value; Otherwise report error.
-            if (fields[f].empty()) {
-              OP_REQUIRES(ctx, record_defaults[f].NumElements() == 1,
-                          errors::InvalidArgument(
-                              "Field ", f,
-                              " is required but missing in record ", i, "!"));
-              output[f]->flat<string>()(i) =
-                  record_defaults[f].flat<string>()(0);
-            } else {
-              output[f]->flat<string>()(i) = fields[f];
+          break;
+        }
+        case DT_FLOAT: {
+          if (field.empty()) {
+            out->flat<float>()(i) = record_defaults[f].flat<float>()(0);
+          } else {
+            float value;
+            scratch->assign(field.data(), field.size());
+            if (!strings::safe_strtof(scratch->c_str(), &value)) {
+              return errors::InvalidArgument("Field ", f, " in record ", i,
+                                             " is not a valid float: ", field);
             }
-            break;
+            out->flat<float>()(i) = value;
+          }
+          break;
+        }
+        case DT_STRING: {
+          if (field.empty()) {
+            out->flat<string>()(i) = record_defaults[f].flat<string>()(0);
+          } else {
+            out->flat<string>()(i).assign(field.data(), field.size());
           }
-          default:
-            OP_REQUIRES(ctx, false,
-                        errors::InvalidArgument("csv: data type ", dtype,
-                                                " not supported in field ", f));
+          break;
         }
+        default:
+          return errors::InvalidArgument("csv: data type ", dtype,
+                                         " not supported in field ", f);
       }
     }
+    return Status::OK();
   }
 
- private:
-  std::vector<DataType> out_type_;
-  char delim_;
-
-  void ExtractFields(OpKernelContext* ctx, StringPiece input,
-                     std::vector<string>* result) {
-    int64 current_idx = 0;
+  // Splits "input" into fields. Fields are returned as pieces of "input",
+  // except for quoted fields containing escaped quotes, which are unescaped
+  // into strings appended to "unescaped".
+  Status ExtractFields(StringPiece input, std::vector<StringPiece>* result,
+                       std::deque<string>* unescaped) {
+    const size_t size = input.size();
+    const char* const data = input.data();
+    size_t current_idx = 0;
     if (!input.empty()) {
-      while (static_cast<size_t>(current_idx) < input.size()) {
-        if (input[current_idx] == '\n' || input[current_idx] == '\r') {
+      while (current_idx < size) {
+        if (data[current_idx] == '\n' || data[current_idx] == '\r') {
           current_idx++;
           continue;
         }
 
-        bool quoted = false;
-        if (input[current_idx] == '"') {
-          quoted = true;
-          current_idx++;
-        }
-
-        // This is the body of the field;
-        string field;
-        if (!quoted) {
-          while (static_cast<size_t>(current_idx) < input.size() &&
-                 input[current_idx] != delim_) {
-            OP_REQUIRES(ctx, input[current_idx] != '"' &&
-                                 input[current_idx] != '\n' &&
-                                 input[current_idx] != '\r',
-                        errors::InvalidArgument(
-                            "Unquoted fields cannot have quotes/CRLFs inside"));
-            field += input[current_idx];
-            current_idx++;
+        if (data[current_idx] != '"') {
+          const char* end =
+              FindSpecialChar(data + current_idx, data + size, delim_);
+          if (end != data + size && *end != delim_) {
+            return errors::InvalidArgument(
+                "Unquoted fields cannot have quotes/CRLFs inside");
           }
+          result->emplace_back(data + current_idx, end - data - current_idx);
 
           // Go to next field or the end
-          current_idx++;
-        } else {
-          // Quoted field needs to be ended with '"' and delim or end
-          while (
-              (static_cast<size_t>(current_idx) < input.size() - 1) &&
-              (input[current_idx] != '"' || input[current_idx + 1] != delim_)) {
-            if (input[current_idx] != '"') {
-              field += input[current_idx];
-              current_idx++;
+          current_idx = end - data + 1;
+          continue;
+        }
+
+        // Quoted field needs to be ended with '"' and delim or end. Inside
+        // it, a quote has to be escaped by another quote.
+        current_idx++;
+        size_t field_start = current_idx;
+        string* field = nullptr;
+        while (true) {
+          const char* quote = static_cast<const char*>(
+              memchr(data + current_idx, '"', size - current_idx));
+          if (quote == nullptr) {
+            return errors::InvalidArgument(
+                "Quoted field has to end with quote followed by delim or end");
+          }
+          const size_t quote_idx = quote - data;
+          if (quote_idx == size - 1 || data[quote_idx + 1] == delim_) {
+            if (field == nullptr) {
+              result->emplace_back(data + field_start, quote_idx - field_start);
             } else {
-              OP_REQUIRES(
-                  ctx, input[current_idx + 1] == '"',
-                  errors::InvalidArgument("Quote inside a string has to be "
-                                          "escaped by another quote"));
-              field += '"';
-              current_idx += 2;
+              field->append(data + current_idx, quote_idx - current_idx);
+              result->emplace_back(*field);
             }
+            current_idx = quote_idx + 2;
+            break;
           }
-
-          OP_REQUIRES(
-              ctx, (static_cast<size_t>(current_idx) < input.size() &&
-                    input[current_idx] == '"' &&
-                    (static_cast<size_t>(current_idx) == input.size() - 1 ||
-                     input[current_idx + 1] == delim_)),
-              errors::InvalidArgument("Quoted field has to end with quote "
-                                      "followed by delim or end"));
-
-          current_idx += 2;
+          if (data[quote_idx + 1] != '"') {
+            return errors::InvalidArgument(
+                "Quote inside a string has to be escaped by another quote");
+          }
+          if (field == nullptr) {
+            unescaped->emplace_back();
+            field = &unescaped->back();
+          }
+          field->append(data + current_idx, quote_idx + 1 - current_idx);
+          current_idx = quote_idx + 2;
         }
-
-        result->push_back(field);
       }
 
       // Check if the last field is missing
-      if (input[input.size() - 1] == delim_) result->push_back(string());
+      if (data[size - 1] == delim_) result->emplace_back();
     }
+    return Status::OK();
   }
 };
 
@@ -0,0 +1,165 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/device_factory.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/public/session_options.h"
+
+namespace tensorflow {
+namespace {
+
+class DecodeCSVOpTest : public OpsTestBase {
+ protected:
+  // Parses on 4 threads, so that large batches are sharded whatever the
+  // number of cores.
+  DecodeCSVOpTest() {
+    SessionOptions options;
+    options.config.set_intra_op_parallelism_threads(4);
+    device_.reset(
+        DeviceFactory::NewDevice("CPU", options, "/job:a/replica:0/task:0"));
+  }
+
+  // Makes a DecodeCSV op with a default for every field of "types".
+  void MakeOp(const DataTypeVector& types) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "DecodeCSV")
+                     .Input(FakeInput(DT_STRING))
+                     .Input(FakeInput(types))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(DecodeCSVOpTest, QuotedFieldsAcrossWords) {
+  MakeOp({DT_STRING, DT_STRING, DT_INT32});
+  // Moves the delimiters, quotes and escaped quotes over every position of
+  // the 8-byte words scanned at a time.
+  const int kNumOffsets = 17;
+  std::vector<string> records;
+  std::vector<string> unquoted;
+  std::vector<string> quoted;
+  std::vector<int32> numbers;
+  for (int k = 0; k < kNumOffsets; ++k) {
+    const string prefix(k, 'a');
+    const string inside(k, 'b');
+    const string suffix(kNumOffsets - k, 'c');
+    records.push_back(strings::StrCat(prefix, ",\"", inside, ",\"\"", suffix,
+                                      "\",", k));
+    unquoted.push_back(prefix);
+    quoted.push_back(strings::StrCat(inside, ",\"", suffix));
+    numbers.push_back(k);
+  }
+  AddInputFromArray<string>(TensorShape({kNumOffsets}), records);
+  AddInputFromArray<string>(TensorShape({1}), {"default"});
+  AddInputFromArray<string>(TensorShape({1}), {"default"});
+  AddInputFromArray<int32>(TensorShape({1}), {-1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_unquoted(allocator(), DT_STRING, TensorShape({kNumOffsets}));
+  test::FillValues<string>(&expected_unquoted, unquoted);
+  // The empty first field of the first record takes the default.
+  expected_unquoted.vec<string>()(0) = "default";
+  test::ExpectTensorEqual<string>(expected_unquoted, *GetOutput(0));
+  Tensor expected_quoted(allocator(), DT_STRING, TensorShape({kNumOffsets}));
+  test::FillValues<string>(&expected_quoted, quoted);
+  test::ExpectTensorEqual<string>(expected_quoted, *GetOutput(1));
+  Tensor expected_numbers(allocator(), DT_INT32, TensorShape({kNumOffsets}));
+  test::FillValues<int32>(&expected_numbers, numbers);
+  test::ExpectTensorEqual<int32>(expected_numbers, *GetOutput(2));
+}
+
+TEST_F(DecodeCSVOpTest, EmptyAndTrailingFields) {
+  MakeOp({DT_STRING, DT_INT64, DT_FLOAT});
+  AddInputFromArray<string>(TensorShape({5}),
+                            {"x,,", ",2,", ",,3.5", "\"\",4,4.5",
+                             "long field over a word,5,\"\""});
+  AddInputFromArray<string>(TensorShape({1}), {"none"});
+  AddInputFromArray<int64>(TensorShape({1}), {-1});
+  AddInputFromArray<float>(TensorShape({1}), {-1.0f});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_strings(allocator(), DT_STRING, TensorShape({5}));
+  test::FillValues<string>(&expected_strings, {"x", "none", "none", "none",
+                                               "long field over a word"});
+  test::ExpectTensorEqual<string>(expected_strings, *GetOutput(0));
+  Tensor expected_ints(allocator(), DT_INT64, TensorShape({5}));
+  test::FillValues<int64>(&expected_ints, {-1, 2, -1, 4, 5});
+  test::ExpectTensorEqual<int64>(expected_ints, *GetOutput(1));
+  Tensor expected_floats(allocator(), DT_FLOAT, TensorShape({5}));
+  test::FillValues<float>(&expected_floats, {-1.0f, -1.0f, 3.5f, 4.5f, -1.0f});
+  test::ExpectTensorEqual<float>(expected_floats, *GetOutput(2));
+}
+
+TEST_F(DecodeCSVOpTest, MalformedFields) {
+  MakeOp({DT_STRING, DT_STRING});
+  // A quote in an unquoted field, right after the first word.
+  AddInputFromArray<string>(TensorShape({1}), {"abcdefgh\"ij,k"});
+  AddInputFromArray<string>(TensorShape({1}), {""});
+  AddInputFromArray<string>(TensorShape({1}), {""});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Unquoted fields cannot have quotes/CRLFs inside"))
+      << s;
+}
+
+TEST_F(DecodeCSVOpTest, ShardedBatch) {
+  MakeOp({DT_INT32, DT_STRING});
+  const int kBatchSize = 10000;
+  std::vector<string> records;
+  std::vector<int32> numbers;
+  std::vector<string> strings;
+  for (int i = 0; i < kBatchSize; ++i) {
+    records.push_back(strings::StrCat(i, ",\"row ", i, ", \"\"quoted\"\"\""));
+    numbers.push_back(i);
+    strings.push_back(strings::StrCat("row ", i, ", \"quoted\""));
+  }
+  AddInputFromArray<string>(TensorShape({kBatchSize}), records);
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  AddInputFromArray<string>(TensorShape({0}), {});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_numbers(allocator(), DT_INT32, TensorShape({kBatchSize}));
+  test::FillValues<int32>(&expected_numbers, numbers);
+  test::ExpectTensorEqual<int32>(expected_numbers, *GetOutput(0));
+  Tensor expected_strings(allocator(), DT_STRING, TensorShape({kBatchSize}));
+  test::FillValues<string>(&expected_strings, strings);
+  test::ExpectTensorEqual<string>(expected_strings, *GetOutput(1));
+}
+
+TEST_F(DecodeCSVOpTest, ShardedBatchReportsFirstError) {
+  MakeOp({DT_INT32});
+  const int kBatchSize = 10000;
+  std::vector<string> records(kBatchSize, "1");
+  records[9000] = "not a number";
+  records[5000] = "not a number either";
+  AddInputFromArray<string>(TensorShape({kBatchSize}), records);
+  AddInputFromArray<int32>(TensorShape({0}), {});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Field 0 in record 5000 is not a valid int32"))
+      << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -15,12 +15,16 @@ limitations under the License.
 
 // See docs in ../ops/image_ops.cc
 
+#include <math.h>
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/jpeg/jpeg_mem.h"
 #include "tensorflow/core/platform/logging.h"
@@ -84,4 +88,187 @@ class DecodeJpegOp : public OpKernel {
 };
 REGISTER_KERNEL_BUILDER(Name("DecodeJpeg").Device(DEVICE_CPU), DecodeJpegOp);
 
+// Decode a window of a JPEG file at the lowest scale that does not make it
+// smaller than the requested size, then resize it with bilinear
+// interpolation.
+class DecodeCropAndResizeJpegOp : public OpKernel {
+ public:
+  explicit DecodeCropAndResizeJpegOp(OpKernelConstruction* context)
+      : OpKernel(context) {
+    OP_REQUIRES_OK(context, context->GetAttr("channels", &flags_.components));
+    OP_REQUIRES(context, flags_.components == 0 || flags_.components == 1 ||
+                             flags_.components == 3,
+                errors::InvalidArgument("channels must be 0, 1, or 3, got ",
+                                        flags_.components));
+    OP_REQUIRES_OK(
+        context, context->GetAttr("fancy_upscaling", &flags_.fancy_upscaling));
+    OP_REQUIRES_OK(context, context->GetAttr("align_corners", &align_corners_));
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& contents = context->input(0);
+    OP_REQUIRES(context, TensorShapeUtils::IsScalar(contents.shape()),
+                errors::InvalidArgument("contents must be scalar, got shape ",
+                                        contents.shape().DebugString()));
+    const StringPiece input = contents.scalar<string>()();
+    OP_REQUIRES(context, input.size() <= std::numeric_limits<int>::max(),
+                errors::InvalidArgument("JPEG contents are too large for int: ",
+                                        input.size()));
+    const Tensor& crop_window = context->input(1);
+    OP_REQUIRES(context, crop_window.dims() == 1 &&
+                             crop_window.NumElements() == 4,
+                errors::InvalidArgument(
+                    "crop_window must be a vector of 4 elements, got shape ",
+                    crop_window.shape().DebugString()));
+    const Tensor& size = context->input(2);
+    OP_REQUIRES(context, size.dims() == 1 && size.NumElements() == 2,
+                errors::InvalidArgument(
+                    "size must be a vector of 2 elements, got shape ",
+                    size.shape().DebugString()));
+    const int crop_y = crop_window.vec<int32>()(0);
+    const int crop_x = crop_window.vec<int32>()(1);
+    const int crop_height = crop_window.vec<int32>()(2);
+    const int crop_width = crop_window.vec<int32>()(3);
+    const int out_height = size.vec<int32>()(0);
+    const int out_width = size.vec<int32>()(1);
+    OP_REQUIRES(context, out_height > 0 && out_width > 0,
+                errors::InvalidArgument("output dimensions must be positive"));
+
+    int image_width, image_height;
+    OP_REQUIRES(context,
+                jpeg::GetImageInfo(input.data(), input.size(), &image_width,
+                                   &image_height, nullptr),
+                errors::InvalidArgument("Invalid JPEG data, size ",
+                                        input.size()));
+    OP_REQUIRES(
+        context, crop_y >= 0 && crop_x >= 0 && crop_height > 0 &&
+                     crop_width > 0 && crop_y <= image_height - crop_height &&
+                     crop_x <= image_width - crop_width,
+        errors::InvalidArgument("crop_window ", crop_window.SummarizeValue(4),
+                                " does not fit in the image of size ",
+                                image_height, "x", image_width));
+
+    // libjpeg computes its scaled IDCT for 1 / ratio of the pixels in each
+    // dimension.  The window is decoded at the largest ratio which leaves at
+    // least as many pixels as the output has.  The products are computed in
+    // int64, since the output size comes straight from the input.
+    int ratio = 8;
+    while (ratio > 1 &&
+           (crop_height < static_cast<int64>(out_height) * ratio ||
+            crop_width < static_cast<int64>(out_width) * ratio)) {
+      ratio /= 2;
+    }
+    // The smallest window of the scaled image which covers the crop window,
+    // the scaled image having ceil(height / ratio) x ceil(width / ratio)
+    // pixels.
+    jpeg::UncompressFlags flags = flags_;
+    flags.ratio = ratio;
+    flags.crop = true;
+    flags.crop_y = crop_y / ratio;
+    flags.crop_x = crop_x / ratio;
+    flags.crop_height =
+        (crop_y + crop_height + ratio - 1) / ratio - flags.crop_y;
+    flags.crop_width = (crop_x + crop_width + ratio - 1) / ratio - flags.crop_x;
+
+    Tensor window;
+    OP_REQUIRES(
+        context,
+        jpeg::Uncompress(
+            input.data(), input.size(), flags, nullptr /* nwarn */,
+            [=, &window](int width, int height, int channels) -> uint8* {
+              Status status(context->allocate_temp(
+                  DT_UINT8, TensorShape({height, width, channels}), &window));
+              if (!status.ok()) {
+                VLOG(1) << status;
+                context->SetStatus(status);
+                return nullptr;
+              }
+              return window.flat<uint8>().data();
+            }),
+        errors::InvalidArgument("Invalid JPEG data, size ", input.size()));
+
+    const int channels = window.dim_size(2);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({out_height, out_width, channels}),
+                       &output));
+
+    // As in ResizeBilinear, the resized pixel (y, x) is interpolated at
+    // (crop_y + y * height_scale, crop_x + x * width_scale) in the image.
+    const float height_scale =
+        CalculateResizeScale(crop_height, out_height, align_corners_);
+    const float width_scale =
+        CalculateResizeScale(crop_width, out_width, align_corners_);
+    const std::vector<Interpolation> ys =
+        ComputeInterpolation(out_height, height_scale, crop_y, flags.crop_y,
+                             ratio, flags.crop_height);
+    const std::vector<Interpolation> xs =
+        ComputeInterpolation(out_width, width_scale, crop_x, flags.crop_x,
+                             ratio, flags.crop_width);
+
+    auto input_data = window.tensor<uint8, 3>();
+    auto output_data = output->tensor<float, 3>();
+    for (int y = 0; y < out_height; ++y) {
+      const Interpolation& iy = ys[y];
+      for (int x = 0; x < out_width; ++x) {
+        const Interpolation& ix = xs[x];
+        for (int c = 0; c < channels; ++c) {
+          const float top_left(input_data(iy.lower, ix.lower, c));
+          const float top_right(input_data(iy.lower, ix.upper, c));
+          const float bottom_left(input_data(iy.upper, ix.lower, c));
+          const float bottom_right(input_data(iy.upper, ix.upper, c));
+          const float top = top_left + (top_right - top_left) * ix.lerp;
+          const float bottom =
+              bottom_left + (bottom_right - bottom_left) * ix.lerp;
+          output_data(y, x, c) = top + (bottom - top) * iy.lerp;
+        }
+      }
+    }
+  }
+
+ private:
+  // The two pixels of the decoded window between which an output pixel is
+  // interpolated along one dimension, and the weight of the upper one.
+  struct Interpolation {
+    int64 lower;
+    int64 upper;
+    float lerp;
+  };
+
+  // Returns the interpolations along a dimension of "out_size" pixels,
+  // resized by "scale" from the crop window starting at "crop_start".  The
+  // window is decoded at 1 / "ratio" scale, from "window_start" and over
+  // "window_size" pixels.
+  static std::vector<Interpolation> ComputeInterpolation(
+      int out_size, float scale, int crop_start, int window_start, int ratio,
+      int window_size) {
+    std::vector<Interpolation> result(out_size);
+    // Pixel k of the decoded window is the average of pixels
+    // [k * ratio, (k + 1) * ratio) of the image from window_start * ratio, so
+    // it stands for the pixel at the middle of those.  With a ratio of 1, this
+    // is the same computation as in ResizeBilinear.
+    const float offset = crop_start - window_start * ratio - (ratio - 1) / 2.0f;
+    for (int i = 0; i < out_size; ++i) {
+      const float in = std::max(0.0f, (offset + i * scale) / ratio);
+      const int64 lower = std::min(static_cast<int64>(floorf(in)),
+                                   static_cast<int64>(window_size - 1));
+      result[i].lower = lower;
+      result[i].upper =
+          std::min(static_cast<int64>(ceilf(in)),
+                   static_cast<int64>(window_size - 1));
+      result[i].lerp = in - lower;
+    }
+    return result;
+  }
+
+  jpeg::UncompressFlags flags_;
+  bool align_corners_;
+};
+REGISTER_KERNEL_BUILDER(Name("DecodeCropAndResizeJpeg")
+                            .Device(DEVICE_CPU)
+                            .HostMemory("crop_window")
+                            .HostMemory("size"),
+                        DecodeCropAndResizeJpegOp);
+
 }  // namespace tensorflow
@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/kernels/assign_op.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -75,9 +76,11 @@ class DenseUpdateOp : public OpKernel {
     functor::DenseUpdate<Device, T, OP> update_functor;
     update_functor(context->eigen_device<Device>(), Tparams.flat<T>(),
                    Tupdate.flat<T>());
+    dirty_rows_.MarkAll(context, {0});
   }
 
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
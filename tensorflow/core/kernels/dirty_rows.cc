@@ -0,0 +1,165 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/dirty_rows.h"
+
+#include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/logging.h"
+
+namespace tensorflow {
+
+DirtyRowTracker* DirtyRowTracker::Global() {
+  static DirtyRowTracker* tracker = new DirtyRowTracker;
+  return tracker;
+}
+
+DirtyRowTracker::Entry* DirtyRowTracker::Find(mutex* mu, int64* generation) {
+  mutex_lock l(mu_);
+  *generation = generation_.load(std::memory_order_relaxed);
+  Entry* entry = gtl::FindPtrOrNull(entries_, mu);
+  if (entry != nullptr) entry->Ref();
+  return entry;
+}
+
+void DirtyRowTracker::MarkAll(mutex* mu) {
+  if (!tracking()) return;
+  int64 generation;
+  Entry* entry = Find(mu, &generation);
+  if (entry == nullptr) return;
+  core::ScopedUnref unref(entry);
+  entry->MarkAll();
+}
+
+void DirtyRowTracker::TakeRows(mutex* mu, const Tensor& var,
+                               std::vector<int64>* rows) {
+  CHECK_GE(var.dims(), 1);
+  Entry* entry;
+  {
+    mutex_lock l(mu_);
+    Entry*& e = entries_[mu];
+    if (e == nullptr) {
+      e = new Entry;
+      generation_.fetch_add(1, std::memory_order_release);
+      num_tracked_.fetch_add(1, std::memory_order_release);
+    }
+    entry = e;
+    entry->Ref();
+  }
+  core::ScopedUnref unref(entry);
+  entry->TakeRows(var, rows);
+}
+
+void DirtyRowTracker::CommitRows(mutex* mu, const Tensor& var,
+                                 const int64* rows, int64 n) {
+  if (!tracking()) return;
+  int64 generation;
+  Entry* entry = Find(mu, &generation);
+  if (entry == nullptr) return;
+  core::ScopedUnref unref(entry);
+  entry->CommitRows(var, rows, n);
+}
+
+void DirtyRowTracker::Forget(mutex* mu) {
+  if (!tracking()) return;
+  Entry* entry = nullptr;
+  {
+    mutex_lock l(mu_);
+    auto it = entries_.find(mu);
+    if (it == entries_.end()) return;
+    entry = it->second;
+    entries_.erase(it);
+    generation_.fetch_add(1, std::memory_order_release);
+    num_tracked_.fetch_sub(1, std::memory_order_release);
+  }
+  entry->Unref();
+}
+
+void DirtyRowTracker::Entry::MarkAll() {
+  mutex_lock l(mu_);
+  all_dirty_ = true;
+}
+
+void DirtyRowTracker::Entry::TakeRows(const Tensor& var,
+                                      std::vector<int64>* rows) {
+  const int64 num_rows = var.dim_size(0);
+  const char* buffer = var.tensor_data().data();
+  rows->clear();
+  mutex_lock l(mu_);
+  if (all_dirty_ || num_rows_ != num_rows || buffer_ != buffer) {
+    rows->reserve(num_rows);
+    for (int64 row = 0; row < num_rows; ++row) rows->push_back(row);
+    buffer_ = buffer;
+    num_rows_ = num_rows;
+    all_dirty_ = false;
+    dirty_.assign(num_rows, false);
+    taken_.assign(num_rows, true);
+    return;
+  }
+  for (int64 row = 0; row < num_rows; ++row) {
+    if (dirty_[row] || taken_[row]) {
+      rows->push_back(row);
+      dirty_[row] = false;
+      taken_[row] = true;
+    }
+  }
+}
+
+void DirtyRowTracker::Entry::CommitRows(const Tensor& var, const int64* rows,
+                                        int64 n) {
+  mutex_lock l(mu_);
+  if (var.dims() < 1 || var.dim_size(0) != num_rows_ ||
+      var.tensor_data().data() != buffer_) {
+    return;
+  }
+  for (int64 i = 0; i < n; ++i) {
+    const int64 row = rows[i];
+    if (row >= 0 && row < num_rows_) taken_[row] = false;
+  }
+}
+
+DirtyRowMarker::~DirtyRowMarker() {
+  for (const Cached& cached : cached_) {
+    if (cached.entry != nullptr) cached.entry->Unref();
+  }
+}
+
+DirtyRowTracker::Entry* DirtyRowMarker::Get(int input, mutex* mu) {
+  DirtyRowTracker* tracker = DirtyRowTracker::Global();
+  const int64 generation =
+      tracker->generation_.load(std::memory_order_acquire);
+  mutex_lock l(mu_);
+  if (input >= static_cast<int>(cached_.size())) cached_.resize(input + 1);
+  Cached& cached = cached_[input];
+  if (cached.mu != mu || cached.generation != generation) {
+    if (cached.entry != nullptr) cached.entry->Unref();
+    cached.mu = mu;
+    cached.entry = tracker->Find(mu, &cached.generation);
+  }
+  if (cached.entry != nullptr) cached.entry->Ref();
+  return cached.entry;
+}
+
+void DirtyRowMarker::MarkAll(OpKernelContext* ctx,
+                             std::initializer_list<int> inputs) {
+  if (!DirtyRowTracker::Global()->tracking()) return;
+  for (const int input : inputs) {
+    DirtyRowTracker::Entry* entry = Get(input, ctx->input_ref_mutex(input));
+    if (entry == nullptr) continue;
+    core::ScopedUnref unref(entry);
+    entry->MarkAll();
+  }
+}
+
+}  // namespace tensorflow
@@ -0,0 +1,230 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_DIRTY_ROWS_H_
+#define TENSORFLOW_KERNELS_DIRTY_ROWS_H_
+
+#include <atomic>
+#include <initializer_list>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Keeps track of the rows of variables that changed, so that delta
+// checkpoints only need to save those (see TakeDirtyRows, CommitDirtyRows and
+// SaveDelta in ../ops). A variable is tracked from the first time its rows
+// are taken; until then, marking its rows costs a single atomic load.
+//
+// Variables are identified by the mutex of their ref, which lives as long as
+// the variable. Kernels that update some rows of a variable in place mark
+// them through a DirtyRowMarker once they have updated them; kernels that may
+// change any row mark all of them.
+class DirtyRowTracker {
+ public:
+  static DirtyRowTracker* Global();
+
+  // Records that rows "rows[0, n)" of "var", the value of the variable
+  // guarded by "mu", may have changed. Rows out of range are ignored.
+  // Looks the variable up under the lock of the tracker: kernels use a
+  // DirtyRowMarker instead.
+  template <typename Index>
+  void MarkRows(mutex* mu, const Tensor& var, const Index* rows, int64 n);
+
+  // Records that any row of the variable guarded by "mu" may have changed.
+  void MarkAll(mutex* mu);
+
+  // Sets "*rows" to the rows of "var", the 1-D or higher value of the
+  // variable guarded by "mu", that may have changed since they were last
+  // committed, in increasing order: the rows marked since the previous call
+  // for that variable, and the rows taken by earlier calls that were not
+  // committed since. Returns all the rows on the first call, and when the
+  // buffer of the variable was replaced since the previous call.
+  void TakeRows(mutex* mu, const Tensor& var, std::vector<int64>* rows);
+
+  // Records that rows "rows[0, n)" taken from "var", the value of the
+  // variable guarded by "mu", were saved, so that TakeRows() no longer
+  // returns them until they are marked again. Rows out of range, and rows
+  // taken from a buffer that was since replaced, are ignored.
+  void CommitRows(mutex* mu, const Tensor& var, const int64* rows, int64 n);
+
+  // Stops tracking the variable guarded by "mu". Called when the variable is
+  // destroyed.
+  void Forget(mutex* mu);
+
+ private:
+  friend class DirtyRowMarker;
+
+  // The dirty rows of one variable. Entries are reference counted, so that
+  // markers can keep using the entries they cached after Forget().
+  class Entry : public core::RefCounted {
+   public:
+    template <typename Index>
+    void MarkRows(const Tensor& var, const Index* rows, int64 n);
+    void MarkAll();
+    void TakeRows(const Tensor& var, std::vector<int64>* rows);
+    void CommitRows(const Tensor& var, const int64* rows, int64 n);
+
+   private:
+    mutex mu_;
+    // The buffer and number of rows of the variable as of the last
+    // TakeRows(). If either changed, all the rows are dirty.
+    const char* buffer_ GUARDED_BY(mu_) = nullptr;
+    int64 num_rows_ GUARDED_BY(mu_) = 0;
+    bool all_dirty_ GUARDED_BY(mu_) = true;
+    // The rows marked since the last TakeRows().
+    std::vector<bool> dirty_ GUARDED_BY(mu_);
+    // The rows returned by TakeRows() that were not committed since.
+    std::vector<bool> taken_ GUARDED_BY(mu_);
+  };
+
+  DirtyRowTracker() {}
+
+  bool tracking() const {
+    return num_tracked_.load(std::memory_order_acquire) != 0;
+  }
+
+  // Returns the entry of the variable guarded by "mu" with a new reference,
+  // or nullptr if it is not tracked, and sets "*generation" to the current
+  // generation.
+  Entry* Find(mutex* mu, int64* generation);
+
+  mutex mu_;
+  std::unordered_map<mutex*, Entry*> entries_ GUARDED_BY(mu_);
+  std::atomic<int> num_tracked_{0};
+  // Incremented, under "mu_", whenever a variable is added to or removed from
+  // "entries_".
+  std::atomic<int64> generation_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DirtyRowTracker);
+};
+
+template <typename Index>
+void DirtyRowTracker::Entry::MarkRows(const Tensor& var, const Index* rows,
+                                      int64 n) {
+  mutex_lock l(mu_);
+  if (all_dirty_) return;
+  if (var.dims() < 1 || var.dim_size(0) != num_rows_ ||
+      var.tensor_data().data() != buffer_) {
+    all_dirty_ = true;
+    return;
+  }
+  for (int64 i = 0; i < n; ++i) {
+    const int64 row = rows[i];
+    if (row >= 0 && row < num_rows_) dirty_[row] = true;
+  }
+}
+
+template <typename Index>
+void DirtyRowTracker::MarkRows(mutex* mu, const Tensor& var, const Index* rows,
+                               int64 n) {
+  if (!tracking()) return;
+  int64 generation;
+  Entry* entry = Find(mu, &generation);
+  if (entry == nullptr) return;
+  core::ScopedUnref unref(entry);
+  entry->MarkRows(var, rows, n);
+}
+
+// Marks the rows of the variables of the ref inputs of a kernel dirty. It
+// caches the tracker entry of each input, so that marking rows only takes the
+// lock of the variable's entry; the tracker is looked up again only after a
+// variable started or stopped being tracked. A kernel holds one marker for
+// its lifetime, and may use it from concurrent calls of Compute().
+class DirtyRowMarker {
+ public:
+  DirtyRowMarker() {}
+  ~DirtyRowMarker();
+
+  // Marks rows "rows[0, n)" of "var", the value of ref input "input" of
+  // "ctx", dirty.
+  template <typename Index>
+  void MarkRows(OpKernelContext* ctx, int input, const Tensor& var,
+                const Index* rows, int64 n);
+
+  // Marks all the rows of the variables of ref inputs "inputs" of "ctx"
+  // dirty.
+  void MarkAll(OpKernelContext* ctx, std::initializer_list<int> inputs);
+
+ private:
+  struct Cached {
+    mutex* mu = nullptr;
+    int64 generation = -1;
+    DirtyRowTracker::Entry* entry = nullptr;
+  };
+
+  // Returns the entry of the variable guarded by "mu", the mutex of ref input
+  // "input", with a new reference, or nullptr if it is not tracked.
+  DirtyRowTracker::Entry* Get(int input, mutex* mu);
+
+  mutex mu_;
+  std::vector<Cached> cached_ GUARDED_BY(mu_);
+
+  TF_DISALLOW_COPY_AND_ASSIGN(DirtyRowMarker);
+};
+
+template <typename Index>
+void DirtyRowMarker::MarkRows(OpKernelContext* ctx, int input,
+                              const Tensor& var, const Index* rows, int64 n) {
+  if (!DirtyRowTracker::Global()->tracking()) return;
+  DirtyRowTracker::Entry* entry = Get(input, ctx->input_ref_mutex(input));
+  if (entry == nullptr) return;
+  core::ScopedUnref unref(entry);
+  entry->MarkRows(var, rows, n);
+}
+
+// Marks rows "indices" of the variables added with Add() dirty when it goes
+// out of scope: declared after a kernel has locked its variables, it marks
+// the rows once the kernel has updated them, including when the kernel
+// returns early because of an invalid index.
+template <typename Index>
+class ScopedDirtyRowMarker {
+ public:
+  ScopedDirtyRowMarker(DirtyRowMarker* marker, OpKernelContext* ctx,
+                       const Tensor& indices)
+      : marker_(marker), ctx_(ctx), indices_(indices) {}
+
+  ~ScopedDirtyRowMarker() {
+    auto indices_flat = indices_.flat<Index>();
+    for (const auto& var : vars_) {
+      marker_->MarkRows(ctx_, var.first, var.second, indices_flat.data(),
+                        indices_flat.size());
+    }
+  }
+
+  // Marks rows of "var", the value of ref input "input".
+  void Add(int input, const Tensor& var) { vars_.emplace_back(input, var); }
+
+ private:
+  DirtyRowMarker* const marker_;
+  OpKernelContext* const ctx_;
+  const Tensor indices_;
+  std::vector<std::pair<int, Tensor>> vars_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ScopedDirtyRowMarker);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_DIRTY_ROWS_H_
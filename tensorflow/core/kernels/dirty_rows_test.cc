@@ -0,0 +1,119 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/dirty_rows.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+// Takes the dirty rows of "var" and commits them, as a successful save does.
+std::vector<int64> TakeRows(mutex* mu, const Tensor& var) {
+  std::vector<int64> rows;
+  DirtyRowTracker::Global()->TakeRows(mu, var, &rows);
+  DirtyRowTracker::Global()->CommitRows(mu, var, rows.data(), rows.size());
+  return rows;
+}
+
+TEST(DirtyRowTrackerTest, TracksMarkedRows) {
+  DirtyRowTracker* tracker = DirtyRowTracker::Global();
+  mutex mu;
+  Tensor var(DT_FLOAT, TensorShape({5, 2}));
+  const int32 rows[] = {3, 1, 3, -1, 5};
+
+  // Rows marked before the first TakeRows() are not tracked, and the first
+  // call returns all the rows.
+  tracker->MarkRows(&mu, var, rows, 1);
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), TakeRows(&mu, var));
+  EXPECT_EQ(std::vector<int64>(), TakeRows(&mu, var));
+
+  // Duplicate and out of range rows are dropped.
+  tracker->MarkRows(&mu, var, rows, 5);
+  EXPECT_EQ(std::vector<int64>({1, 3}), TakeRows(&mu, var));
+  EXPECT_EQ(std::vector<int64>(), TakeRows(&mu, var));
+
+  tracker->MarkAll(&mu);
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), TakeRows(&mu, var));
+
+  // Other variables are tracked separately.
+  mutex other_mu;
+  Tensor other(DT_FLOAT, TensorShape({2}));
+  EXPECT_EQ(std::vector<int64>({0, 1}), TakeRows(&other_mu, other));
+  tracker->MarkRows(&other_mu, other, rows + 1, 1);
+  EXPECT_EQ(std::vector<int64>(), TakeRows(&mu, var));
+  EXPECT_EQ(std::vector<int64>({1}), TakeRows(&other_mu, other));
+
+  // Once forgotten, a variable starts over.
+  tracker->Forget(&mu);
+  tracker->Forget(&other_mu);
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), TakeRows(&mu, var));
+  tracker->Forget(&mu);
+}
+
+TEST(DirtyRowTrackerTest, ReplacedBuffer) {
+  DirtyRowTracker* tracker = DirtyRowTracker::Global();
+  mutex mu;
+  Tensor var(DT_INT32, TensorShape({3}));
+  EXPECT_EQ(std::vector<int64>({0, 1, 2}), TakeRows(&mu, var));
+
+  // The variable was assigned a new buffer, as Assign does when the shape
+  // changes: all rows are dirty.
+  Tensor replacement(DT_INT32, TensorShape({4}));
+  const int64 row = 0;
+  tracker->MarkRows(&mu, replacement, &row, 1);
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3}), TakeRows(&mu, replacement));
+  tracker->Forget(&mu);
+}
+
+TEST(DirtyRowTrackerTest, UncommittedRows) {
+  DirtyRowTracker* tracker = DirtyRowTracker::Global();
+  mutex mu;
+  Tensor var(DT_FLOAT, TensorShape({5}));
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), TakeRows(&mu, var));
+
+  // The save of the taken rows failed: they are taken again, with the rows
+  // marked since.
+  const int64 rows[] = {1, 3, 4};
+  tracker->MarkRows(&mu, var, rows, 2);
+  std::vector<int64> taken;
+  tracker->TakeRows(&mu, var, &taken);
+  EXPECT_EQ(std::vector<int64>({1, 3}), taken);
+  tracker->MarkRows(&mu, var, rows + 2, 1);
+  tracker->TakeRows(&mu, var, &taken);
+  EXPECT_EQ(std::vector<int64>({1, 3, 4}), taken);
+
+  // Rows marked while the taken rows are saved are taken again after the
+  // commit.
+  tracker->MarkRows(&mu, var, rows + 1, 1);
+  tracker->CommitRows(&mu, var, taken.data(), taken.size());
+  EXPECT_EQ(std::vector<int64>({3}), TakeRows(&mu, var));
+  EXPECT_EQ(std::vector<int64>(), TakeRows(&mu, var));
+
+  // Commits of rows taken from a replaced buffer are ignored.
+  tracker->MarkRows(&mu, var, rows, 1);
+  tracker->TakeRows(&mu, var, &taken);
+  Tensor replacement(DT_FLOAT, TensorShape({5}));
+  tracker->CommitRows(&mu, replacement, taken.data(), taken.size());
+  EXPECT_EQ(std::vector<int64>({1}), TakeRows(&mu, var));
+  tracker->Forget(&mu);
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,358 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/math_ops.cc.
+
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+#include "third_party/eigen3/Eigen/Core"
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/register_types.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/gather_rows.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+enum Combiner { kSum, kMean, kSqrtN };
+
+}  // namespace
+
+// Validation and segmentation shared by EmbeddingLookupSparse and its
+// gradient.  Both kernels work on one segment at a time, so the segments are
+// sharded across the intra-op thread pool and no two threads write the same
+// row.
+template <typename T, typename Index>
+class EmbeddingLookupSparseOpBase : public OpKernel {
+ public:
+  explicit EmbeddingLookupSparseOpBase(OpKernelConstruction* context)
+      : OpKernel(context) {
+    string combiner;
+    OP_REQUIRES_OK(context, context->GetAttr("combiner", &combiner));
+    if (combiner == "sum") {
+      combiner_ = kSum;
+    } else if (combiner == "mean") {
+      combiner_ = kMean;
+    } else {
+      combiner_ = kSqrtN;
+    }
+  }
+
+ protected:
+  // Checks params, ids, weights and segment_ids, and fills *segment_starts
+  // with the first entry of each segment followed by the number of entries,
+  // so that segment i covers entries [(*segment_starts)[i],
+  // (*segment_starts)[i + 1]).
+  Status Segment(const Tensor& params, const Tensor& ids,
+                 const Tensor& weights, const Tensor& segment_ids,
+                 std::vector<int64>* segment_starts) {
+    if (!TensorShapeUtils::IsVectorOrHigher(params.shape())) {
+      return errors::InvalidArgument("params must be at least 1 dimensional");
+    }
+    if (!TensorShapeUtils::IsVector(ids.shape())) {
+      return errors::InvalidArgument("ids should be a vector.");
+    }
+    if (!TensorShapeUtils::IsVector(segment_ids.shape())) {
+      return errors::InvalidArgument("segment_ids should be a vector.");
+    }
+    if (!TensorShapeUtils::IsVector(weights.shape())) {
+      return errors::InvalidArgument("weights should be a vector.");
+    }
+    const int64 num_entries = ids.NumElements();
+    if (segment_ids.NumElements() != num_entries) {
+      return errors::InvalidArgument(
+          "segment_ids and ids should have same size.");
+    }
+    if (weights.NumElements() != 0 && weights.NumElements() != num_entries) {
+      return errors::InvalidArgument(
+          "weights should be empty or have the same size as ids.");
+    }
+
+    const auto segment_vec = segment_ids.vec<int32>();
+    const int32 num_segments =
+        num_entries > 0
+            ? internal::SubtleMustCopy(segment_vec(num_entries - 1)) + 1
+            : 0;
+    if (num_segments < 0) {
+      return errors::InvalidArgument("segment ids must be >= 0");
+    }
+    segment_starts->resize(num_segments + 1);
+    int32 next_segment = 0;
+    for (int64 i = 0; i < num_entries; ++i) {
+      const int32 segment = internal::SubtleMustCopy(segment_vec(i));
+      if (segment < 0 || segment < next_segment - 1 ||
+          segment >= num_segments) {
+        return errors::InvalidArgument("segment ids are not sorted: ",
+                                       "segment_ids[", i, "] == ", segment);
+      }
+      while (next_segment <= segment) {
+        (*segment_starts)[next_segment++] = i;
+      }
+    }
+    (*segment_starts)[num_segments] = num_entries;
+    return Status::OK();
+  }
+
+  // Returns the factor the weighted sum of the entries [start, end) is
+  // multiplied by.  "weights" is null if all the weights are 1.
+  T Scale(const T* weights, int64 start, int64 end) const {
+    if (combiner_ == kSum || start == end) return T(1);
+    T total(0);
+    for (int64 i = start; i < end; ++i) {
+      const T w = weights == nullptr ? T(1) : weights[i];
+      total += combiner_ == kMean ? w : w * w;
+    }
+    return combiner_ == kMean ? T(1) / total : T(1) / std::sqrt(total);
+  }
+
+  // Shards "work" over the segments, given the average cost of an entry.
+  void ShardSegments(OpKernelContext* context,
+                     const std::vector<int64>& segment_starts,
+                     int64 cost_per_entry,
+                     std::function<void(int64, int64)> work) {
+    const int64 num_segments = segment_starts.size() - 1;
+    if (num_segments <= 0) return;
+    const int64 num_entries = segment_starts.back();
+    const int64 cost_per_segment =
+        1 + cost_per_entry * (num_entries / num_segments + 1);
+    auto worker_threads = context->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, num_segments,
+          cost_per_segment, work);
+  }
+
+  // Rows are combined through plain Eigen arrays rather than chips of the
+  // tensors, which cost much more than the arithmetic for the narrow rows
+  // typical of embeddings.
+  typedef Eigen::Map<Eigen::Array<T, Eigen::Dynamic, 1>> EigenRow;
+  typedef Eigen::Map<const Eigen::Array<T, Eigen::Dynamic, 1>> ConstEigenRow;
+
+  Combiner combiner_;
+};
+
+template <typename T, typename Index>
+class EmbeddingLookupSparseOp : public EmbeddingLookupSparseOpBase<T, Index> {
+ public:
+  typedef EmbeddingLookupSparseOpBase<T, Index> Base;
+  typedef typename Base::EigenRow EigenRow;
+  typedef typename Base::ConstEigenRow ConstEigenRow;
+
+  explicit EmbeddingLookupSparseOp(OpKernelConstruction* context)
+      : Base(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& params = context->input(0);
+    const Tensor& ids = context->input(1);
+    const Tensor& weights = context->input(2);
+    const Tensor& segment_ids = context->input(3);
+
+    std::vector<int64> segment_starts;
+    OP_REQUIRES_OK(context, this->Segment(params, ids, weights, segment_ids,
+                                          &segment_starts));
+    const int64 num_segments = segment_starts.size() - 1;
+
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, num_segments);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &output));
+    if (output->NumElements() == 0) return;
+
+    const auto params_flat = params.flat_outer_dims<T>();
+    const auto ids_vec = ids.vec<Index>();
+    const T* weights_data =
+        weights.NumElements() > 0 ? weights.flat<T>().data() : nullptr;
+    auto output_flat = output->flat_outer_dims<T>();
+    const Index limit = static_cast<Index>(params_flat.dimension(0));
+    const int64 dim = params_flat.dimension(1);
+
+    mutex mu;
+    int64 bad_entry = -1;
+    auto work = [this, &params_flat, &ids_vec, weights_data, &output_flat,
+                 &segment_starts, limit, dim, &mu,
+                 &bad_entry](int64 start_segment, int64 end_segment) {
+      // Rows are prefetched across segment boundaries, up to the end of the
+      // shard.
+      const int64 shard_end = segment_starts[end_segment];
+      const T* params_base = params_flat.data();
+      const size_t prefetch_bytes = GatherPrefetchBytes<T>(dim);
+      for (int64 segment = start_segment; segment < end_segment; ++segment) {
+        const int64 start = segment_starts[segment];
+        const int64 end = segment_starts[segment + 1];
+        EigenRow out(&output_flat(segment, 0), dim);
+        out.setZero();
+        for (int64 i = start; i < end; ++i) {
+          PrefetchGatherRow<T, Index, int64>(params_base, ids_vec, limit, dim,
+                                             prefetch_bytes, i, shard_end);
+          const Index index = internal::SubtleMustCopy(ids_vec(i));
+          if (!FastBoundsCheck(index, limit)) {
+            RecordBadGatherIndex(&mu, i, &bad_entry);
+            return;
+          }
+          const ConstEigenRow row(params_base + index * dim, dim);
+          if (weights_data == nullptr) {
+            out += row;
+          } else {
+            out += row * weights_data[i];
+          }
+        }
+        if (this->combiner_ != kSum && start < end) {
+          out *= this->Scale(weights_data, start, end);
+        }
+      }
+    };
+    this->ShardSegments(context, segment_starts,
+                        kGatherRowMissCost + dim * sizeof(T) / 4, work);
+    OP_REQUIRES(context, bad_entry < 0,
+                errors::InvalidArgument("ids[", bad_entry, "] = ",
+                                        ids_vec(bad_entry), " is not in [0, ",
+                                        limit, ")"));
+  }
+};
+
+template <typename T, typename Index>
+class EmbeddingLookupSparseGradOp
+    : public EmbeddingLookupSparseOpBase<T, Index> {
+ public:
+  typedef EmbeddingLookupSparseOpBase<T, Index> Base;
+  typedef typename Base::EigenRow EigenRow;
+  typedef typename Base::ConstEigenRow ConstEigenRow;
+
+  explicit EmbeddingLookupSparseGradOp(OpKernelConstruction* context)
+      : Base(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor& grad = context->input(0);
+    const Tensor& params = context->input(1);
+    const Tensor& ids = context->input(2);
+    const Tensor& weights = context->input(3);
+    const Tensor& segment_ids = context->input(4);
+    const Tensor& output = context->input(5);
+
+    std::vector<int64> segment_starts;
+    OP_REQUIRES_OK(context, this->Segment(params, ids, weights, segment_ids,
+                                          &segment_starts));
+    const int64 num_segments = segment_starts.size() - 1;
+    TensorShape output_shape = params.shape();
+    output_shape.set_dim(0, num_segments);
+    OP_REQUIRES(context, grad.shape() == output_shape,
+                errors::InvalidArgument("grad must have shape ",
+                                        output_shape.DebugString(), " but is ",
+                                        grad.shape().DebugString()));
+    OP_REQUIRES(context, output.shape() == output_shape,
+                errors::InvalidArgument("output must have shape ",
+                                        output_shape.DebugString(), " but is ",
+                                        output.shape().DebugString()));
+
+    TensorShape params_grad_shape = params.shape();
+    params_grad_shape.set_dim(0, ids.NumElements());
+    Tensor* params_grad = nullptr;
+    OP_REQUIRES_OK(context, context->allocate_output(0, params_grad_shape,
+                                                     &params_grad));
+    Tensor* weights_grad = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(1, weights.shape(), &weights_grad));
+    if (ids.NumElements() == 0) return;
+
+    const auto params_flat = params.flat_outer_dims<T>();
+    const auto grad_flat = grad.flat_outer_dims<T>();
+    const auto output_flat = output.flat_outer_dims<T>();
+    const auto ids_vec = ids.vec<Index>();
+    const T* weights_data =
+        weights.NumElements() > 0 ? weights.flat<T>().data() : nullptr;
+    auto params_grad_flat = params_grad->flat_outer_dims<T>();
+    T* weights_grad_data =
+        weights_data != nullptr ? weights_grad->flat<T>().data() : nullptr;
+    const Index limit = static_cast<Index>(params_flat.dimension(0));
+    const int64 dim = params_flat.dimension(1);
+
+    mutex mu;
+    int64 bad_entry = -1;
+    auto work = [this, &params_flat, &grad_flat, &output_flat, &ids_vec,
+                 weights_data, &params_grad_flat, weights_grad_data, limit,
+                 dim, &segment_starts, &mu,
+                 &bad_entry](int64 start_segment, int64 end_segment) {
+      for (int64 segment = start_segment; segment < end_segment; ++segment) {
+        const int64 start = segment_starts[segment];
+        const int64 end = segment_starts[segment + 1];
+        const T scale = this->Scale(weights_data, start, end);
+        const ConstEigenRow g(&grad_flat(segment, 0), dim);
+        const ConstEigenRow out(&output_flat(segment, 0), dim);
+        for (int64 i = start; i < end; ++i) {
+          const Index index = internal::SubtleMustCopy(ids_vec(i));
+          if (!FastBoundsCheck(index, limit)) {
+            RecordBadGatherIndex(&mu, i, &bad_entry);
+            return;
+          }
+          const T w = weights_data == nullptr ? T(1) : weights_data[i];
+          EigenRow(&params_grad_flat(i, 0), dim) = g * (w * scale);
+          if (weights_grad_data == nullptr) continue;
+
+          // d output / d w[i] is scale * params[index], plus the derivative
+          // of the scale times the weighted sum, which is output / scale.
+          T output_coefficient(0);
+          if (this->combiner_ == kMean) {
+            output_coefficient = scale;
+          } else if (this->combiner_ == kSqrtN) {
+            output_coefficient = w * scale * scale;
+          }
+          const ConstEigenRow row(&params_flat(index, 0), dim);
+          const T sum =
+              (g * (row * scale - out * output_coefficient)).sum();
+          weights_grad_data[i] = sum;
+        }
+      }
+    };
+    this->ShardSegments(context, segment_starts, 10 + dim * sizeof(T) / 2,
+                        work);
+    OP_REQUIRES(context, bad_entry < 0,
+                errors::InvalidArgument("ids[", bad_entry, "] = ",
+                                        ids_vec(bad_entry), " is not in [0, ",
+                                        limit, ")"));
+  }
+};
+
+#define REGISTER_CPU_KERNELS(type, index_type)                       \
+  REGISTER_KERNEL_BUILDER(Name("EmbeddingLookupSparse")              \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<type>("T")             \
+                              .TypeConstraint<index_type>("Tidx"),   \
+                          EmbeddingLookupSparseOp<type, index_type>); \
+  REGISTER_KERNEL_BUILDER(Name("EmbeddingLookupSparseGrad")          \
+                              .Device(DEVICE_CPU)                    \
+                              .TypeConstraint<type>("T")             \
+                              .TypeConstraint<index_type>("Tidx"),   \
+                          EmbeddingLookupSparseGradOp<type, index_type>);
+
+REGISTER_CPU_KERNELS(float, int32);
+REGISTER_CPU_KERNELS(float, int64);
+REGISTER_CPU_KERNELS(double, int32);
+REGISTER_CPU_KERNELS(double, int64);
+#undef REGISTER_CPU_KERNELS
+
+}  // namespace tensorflow
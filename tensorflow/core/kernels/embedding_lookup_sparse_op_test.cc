@@ -0,0 +1,314 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <cmath>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class EmbeddingLookupSparseOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "EmbeddingLookupSparse")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Rows (1, 2), (3, 4), (5, 6) and (7, 8), of which segment 0 takes rows 1
+  // and 3 with weights 2 and 0.5, segment 1 is empty, and segment 2 takes
+  // rows 0 and 1 with weights 1 and 3.
+  void AddWeightedInputs() {
+    AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+    AddInputFromArray<int64>(TensorShape({4}), {1, 3, 0, 1});
+    AddInputFromArray<float>(TensorShape({4}), {2, 0.5, 1, 3});
+    AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  }
+};
+
+TEST_F(EmbeddingLookupSparseOpTest, Sum) {
+  MakeOp("sum");
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int64>(TensorShape({5}), {1, 3, 0, 1, 2});
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({5}), {0, 0, 1, 1, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 2}));
+  test::FillValues<float>(&expected, {10, 12, 9, 12});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, WeightedSum) {
+  MakeOp("sum");
+  AddWeightedInputs();
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {9.5, 12, 0, 0, 10, 14});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, WeightedMean) {
+  MakeOp("mean");
+  AddWeightedInputs();
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected, {3.8, 4.8, 0, 0, 2.5, 3.5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, WeightedSqrtN) {
+  MakeOp("sqrtn");
+  AddWeightedInputs();
+  TF_ASSERT_OK(RunOpKernel());
+
+  const float s0 = std::sqrt(4.25f);
+  const float s2 = std::sqrt(10.0f);
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected,
+                          {9.5f / s0, 12 / s0, 0, 0, 10 / s2, 14 / s2});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, Sharded) {
+  MakeOp("mean");
+
+  // Enough segments to be split across threads.
+  const int kRows = 100;
+  const int kDim = 16;
+  const int kSegments = 1000;
+  const int kPerSegment = 5;
+  std::vector<float> params(kRows * kDim);
+  for (int i = 0; i < kRows * kDim; ++i) params[i] = i % 7;
+  std::vector<int64> ids;
+  std::vector<int32> segment_ids;
+  std::vector<float> expected_values(kSegments * kDim, 0);
+  for (int s = 0; s < kSegments; ++s) {
+    for (int j = 0; j < kPerSegment; ++j) {
+      const int64 id = (s * 37 + j * 11) % kRows;
+      ids.push_back(id);
+      segment_ids.push_back(s);
+      for (int k = 0; k < kDim; ++k) {
+        expected_values[s * kDim + k] += params[id * kDim + k] / kPerSegment;
+      }
+    }
+  }
+  AddInputFromArray<float>(TensorShape({kRows, kDim}), params);
+  AddInputFromArray<int64>(TensorShape({kSegments * kPerSegment}), ids);
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({kSegments * kPerSegment}),
+                           segment_ids);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kSegments, kDim}));
+  test::FillValues<float>(&expected, expected_values);
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, Error_IdOutOfRange) {
+  MakeOp("sum");
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int64>(TensorShape({4}), {1, 3, 4, 1});
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 1, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("ids[2] = 4 is not in [0, 4)"))
+      << s;
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, Error_UnsortedSegments) {
+  MakeOp("sum");
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int64>(TensorShape({4}), {1, 3, 0, 1});
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 2, 1, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("segment ids are not sorted"))
+      << s;
+}
+
+TEST_F(EmbeddingLookupSparseOpTest, Error_WeightsSize) {
+  MakeOp("sum");
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int64>(TensorShape({4}), {1, 3, 0, 1});
+  AddInputFromArray<float>(TensorShape({3}), {1, 1, 1});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 1, 1});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("weights should be empty"))
+      << s;
+}
+
+class EmbeddingLookupSparseGradOpTest : public OpsTestBase {
+ protected:
+  void MakeOp(const string& combiner) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "EmbeddingLookupSparseGrad")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("combiner", combiner)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+};
+
+TEST_F(EmbeddingLookupSparseGradOpTest, WeightedMean) {
+  MakeOp("mean");
+  AddInputFromArray<float>(TensorShape({3, 2}), {1, 0, 5, 5, 0, 1});
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int32>(TensorShape({4}), {1, 3, 0, 1});
+  AddInputFromArray<float>(TensorShape({4}), {2, 0.5, 1, 3});
+  AddInputFromArray<int32>(TensorShape({4}), {0, 0, 2, 2});
+  AddInputFromArray<float>(TensorShape({3, 2}), {3.8, 4.8, 0, 0, 2.5, 3.5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_params_grad(allocator(), DT_FLOAT, TensorShape({4, 2}));
+  test::FillValues<float>(&expected_params_grad,
+                          {0.8, 0, 0.2, 0, 0, 0.25, 0, 0.75});
+  test::ExpectTensorNear<float>(expected_params_grad, *GetOutput(0), 1e-5);
+  Tensor expected_weights_grad(allocator(), DT_FLOAT, TensorShape({4}));
+  test::FillValues<float>(&expected_weights_grad,
+                          {-0.32, 1.28, -0.375, 0.125});
+  test::ExpectTensorNear<float>(expected_weights_grad, *GetOutput(1), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseGradOpTest, WeightedSqrtN) {
+  MakeOp("sqrtn");
+  // output = (2 w0 + 3 w1) / sqrt(w0^2 + w1^2) at w = (1, 2).
+  const float s = std::sqrt(5.0f);
+  AddInputFromArray<float>(TensorShape({1, 1}), {1});
+  AddInputFromArray<float>(TensorShape({2, 1}), {2, 3});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 1});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  AddInputFromArray<int32>(TensorShape({2}), {0, 0});
+  AddInputFromArray<float>(TensorShape({1, 1}), {8 / s});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_params_grad(allocator(), DT_FLOAT, TensorShape({2, 1}));
+  test::FillValues<float>(&expected_params_grad, {1 / s, 2 / s});
+  test::ExpectTensorNear<float>(expected_params_grad, *GetOutput(0), 1e-5);
+  Tensor expected_weights_grad(allocator(), DT_FLOAT, TensorShape({2}));
+  test::FillValues<float>(&expected_weights_grad, {2 / (5 * s), -1 / (5 * s)});
+  test::ExpectTensorNear<float>(expected_weights_grad, *GetOutput(1), 1e-5);
+}
+
+TEST_F(EmbeddingLookupSparseGradOpTest, UnweightedSum) {
+  MakeOp("sum");
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({4, 2}), {1, 2, 3, 4, 5, 6, 7, 8});
+  AddInputFromArray<int32>(TensorShape({3}), {1, 3, 1});
+  AddInputFromArray<float>(TensorShape({0}), {});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 1, 1});
+  AddInputFromArray<float>(TensorShape({2, 2}), {3, 4, 10, 12});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_params_grad(allocator(), DT_FLOAT, TensorShape({3, 2}));
+  test::FillValues<float>(&expected_params_grad, {1, 2, 3, 4, 3, 4});
+  test::ExpectTensorEqual<float>(expected_params_grad, *GetOutput(0));
+  EXPECT_EQ(0, GetOutput(1)->NumElements());
+}
+
+// Looks up "per_segment" random rows of a [table_bytes / dim / 4, dim] table
+// for each of "batch" segments, and takes their mean.  If "fused" is false,
+// the rows are gathered and then reduced as embedding_lookup_sparse used to.
+static Graph* EmbeddingLookup(bool fused, int dim, int64 table_bytes,
+                              int batch, int per_segment) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const int64 rows = table_bytes / sizeof(float) / dim;
+  const int64 num_entries = batch * per_segment;
+  Tensor params(DT_FLOAT, TensorShape({rows, dim}));
+  params.flat<float>().setRandom();
+  Tensor ids(DT_INT64, TensorShape({num_entries}));
+  Tensor segment_ids(DT_INT32, TensorShape({num_entries}));
+  Tensor positions(DT_INT32, TensorShape({num_entries}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int64 i = 0; i < num_entries; ++i) {
+    ids.flat<int64>()(i) = rnd.Uniform64(rows);
+    segment_ids.flat<int32>()(i) = i / per_segment;
+    positions.flat<int32>()(i) = i;
+  }
+  Node* ret;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "EmbeddingLookupSparse")
+                    .Input(test::graph::Constant(g, params))
+                    .Input(test::graph::Constant(g, ids))
+                    .Input(test::graph::Constant(
+                        g, Tensor(DT_FLOAT, TensorShape({0}))))
+                    .Input(test::graph::Constant(g, segment_ids))
+                    .Attr("combiner", "mean")
+                    .Finalize(g, &ret));
+  } else {
+    Node* rows_node = test::graph::Gather(g, test::graph::Constant(g, params),
+                                          test::graph::Constant(g, ids));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "SparseSegmentMean")
+                    .Input(rows_node)
+                    .Input(test::graph::Constant(g, positions))
+                    .Input(test::graph::Constant(g, segment_ids))
+                    .Finalize(g, &ret));
+  }
+  return g;
+}
+
+#define BM_EMBEDDING_LOOKUP_SPARSE(FUSED, DIM)                                \
+  static void BM_EmbeddingLookupSparse_##FUSED##_##DIM(int iters, int mb) {  \
+    const int kBatch = 1024;                                                  \
+    const int kPerSegment = 50;                                               \
+    testing::UseRealTime();                                                   \
+    testing::ItemsProcessed(static_cast<int64>(iters) * kBatch *             \
+                            kPerSegment);                                     \
+    testing::BytesProcessed(static_cast<int64>(iters) * kBatch *             \
+                            kPerSegment * DIM * sizeof(float));               \
+    test::Benchmark(                                                          \
+        "cpu", EmbeddingLookup(FUSED, DIM, static_cast<int64>(mb) << 20,      \
+                               kBatch, kPerSegment))                          \
+        .Run(iters);                                                          \
+  }                                                                           \
+  BENCHMARK(BM_EmbeddingLookupSparse_##FUSED##_##DIM)->Arg(4)->Arg(256);
+
+BM_EMBEDDING_LOOKUP_SPARSE(false, 16);
+BM_EMBEDDING_LOOKUP_SPARSE(true, 16);
+BM_EMBEDDING_LOOKUP_SPARSE(false, 64);
+BM_EMBEDDING_LOOKUP_SPARSE(true, 64);
+BM_EMBEDDING_LOOKUP_SPARSE(false, 256);
+BM_EMBEDDING_LOOKUP_SPARSE(true, 256);
+
+}  // namespace
+}  // namespace tensorflow
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
 #include "tensorflow/core/util/example_proto_helper.h"
 #include "tensorflow/core/util/sparse/sparse_tensor.h"
 #include "tensorflow/core/util/work_sharder.h"
@@ -148,7 +149,7 @@ class ExampleParserOp : public OpKernel {
       out_shape.AddDim(batch_size);
       for (const int dim : dense_shapes_[d].dim_sizes()) out_shape.AddDim(dim);
       Tensor* out = nullptr;
-      dense_values.allocate(d, out_shape, &out);
+      OP_REQUIRES_OK(ctx, dense_values.allocate(d, out_shape, &out));
 
       FixedLenFeature config;
       config.key = dense_keys_t[d];
@@ -159,15 +160,6 @@ class ExampleParserOp : public OpKernel {
       output_dense_values[d] = dense_values[d];
     }
 
-    // sparse_values_tmp will be num_sparse_ size map of batch_size length
-    // tensor vector's, containing the sparse values from the input layer.
-    // After these are all stored, we can allocate properly sized outputs
-    // and copy data over. Doing it this way saves us the trouble of either
-    // performing deserialization twice, or alternatively storing all copies of
-    // the full Example protos.
-    std::vector<std::vector<Tensor>> sparse_values_tmp(
-        num_sparse_, std::vector<Tensor>(batch_size));
-
     // Setup Sparse features.
     std::vector<VarLenFeature> var_len_features(num_sparse_);
     for (int d = 0; d < num_sparse_; ++d) {
@@ -177,79 +169,29 @@ class ExampleParserOp : public OpKernel {
       var_len_features[d] = config;
     }
 
-    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
-
-    // Estimate the cost of parsing each batch element.
-    int64 work_unit_size = 100 + 100 * num_sparse_;
-    for (int d = 0; d < num_dense_; ++d) {
-      work_unit_size += dense_shapes_[d].num_elements();
+    // The serialized Examples are parsed straight from the wire format into
+    // the dense outputs; sparse values are gathered per shard and then moved
+    // into the sparse outputs once their sizes are known.
+    gtl::ArraySlice<string> example_names;
+    if (has_names) {
+      example_names = gtl::ArraySlice<string>(names_t.data(), names_t.size());
     }
-
-    mutex mu;
-
-    auto DoWork = [&ctx, &mu, &serialized_t, has_names, &names_t,
-                   &fixed_len_features, &var_len_features, &output_dense_values,
-                   &sparse_values_tmp](int64 start, int64 limit) {
-      Example ex;
-      // Processing each Example in the batch starts here.
-      for (std::size_t b = static_cast<size_t>(start);
-           b < static_cast<size_t>(limit); ++b) {
-        bool parse_success = ParseProtoUnlimited(&ex, serialized_t(b));
-        if (!TF_PREDICT_TRUE(parse_success)) {
-          mutex_lock l(mu);
-          ctx->CtxFailure(errors::InvalidArgument(
-              "Could not parse example input, value: '", serialized_t(b), "'"));
-          return;
-        }
-        const string& example_name = (has_names) ? names_t(b) : "<unknown>";
-        Status s = SingleExampleProtoToTensors(
-            ex, example_name, b, fixed_len_features, var_len_features,
-            &output_dense_values, &sparse_values_tmp);
-        if (!TF_PREDICT_TRUE(s.ok())) {
-          mutex_lock l(mu);
-          ctx->CtxFailureWithWarning(s);
-        }
-      }
+    auto allocate_sparse = [&sparse_indices, &sparse_values, &sparse_shapes](
+        int d, int64 num_values, Tensor** indices, Tensor** values,
+        Tensor** shape) {
+      TF_RETURN_IF_ERROR(
+          sparse_indices.allocate(d, TensorShape({num_values, 2}), indices));
+      TF_RETURN_IF_ERROR(
+          sparse_values.allocate(d, TensorShape({num_values}), values));
+      return sparse_shapes.allocate(d, TensorShape({2}), shape);
     };
-
-    Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
-          work_unit_size, DoWork);
-
-    if (!TF_PREDICT_TRUE(ctx->status().ok())) {
-      return;
-    }
-
-    // Copy from sparse_values_tmp into final resting Tensors
-    // -------------------------
-    for (int d = 0; d < num_sparse_; ++d) {
-      const VarLenFeature& feature_config = var_len_features[d];
-      const std::vector<Tensor>& sparse_values_tmp_tensors =
-          sparse_values_tmp[d];
-      VarLenFeatureBatchShapes sparse_tensor_batch_shapes;
-      GetSparseTensorShapes(feature_config, sparse_values_tmp_tensors,
-                            batch_size, &sparse_tensor_batch_shapes);
-
-      Tensor* sp_indices_d = nullptr;
-      Tensor* sp_values_d = nullptr;
-      Tensor* sp_shape_d = nullptr;
-
-      sparse_indices.allocate(d, sparse_tensor_batch_shapes.indices_shape,
-                              &sp_indices_d);
-      sparse_values.allocate(d, sparse_tensor_batch_shapes.values_shape,
-                             &sp_values_d);
-      sparse_shapes.allocate(d, TensorShape({2}), &sp_shape_d);
-
-      auto shape_t = sp_shape_d->vec<int64>();
-      shape_t(0) = batch_size;
-      shape_t(1) = sparse_tensor_batch_shapes.max_num_features;
-
-      int64 offset = 0;
-      for (int b = 0; b < batch_size; ++b) {
-        const int64 num_elements = CopyIntoSparseTensor(
-            sparse_values_tmp_tensors[b], b, offset, sp_indices_d, sp_values_d);
-        offset += num_elements;
-      }
-    }
+    auto worker_threads = *(ctx->device()->tensorflow_cpu_worker_threads());
+    OP_REQUIRES_OK(
+        ctx, FastParseExample(
+                 fixed_len_features, var_len_features,
+                 gtl::ArraySlice<string>(serialized_t.data(), batch_size),
+                 example_names, worker_threads.num_threads,
+                 worker_threads.workers, &output_dense_values, allocate_sparse));
   }
 
  protected:
@@ -48,14 +48,11 @@ class FIFOQueue : public TypedQueue<std::deque<PersistentTensor> > {
                       CallbackWithTuple callback) override;
   Status MatchesNodeDef(const NodeDef& node_def) override;
 
-  int32 size() override {
-    mutex_lock lock(mu_);
-    return queues_[0].size();
-  }
-
  protected:
   ~FIFOQueue() override {}
 
+  int32 SizeLocked() override { return queues_[0].size(); }
+
   // Helper for dequeuing a single element from queues_.
   void DequeueLocked(OpKernelContext* ctx, Tuple* tuple)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
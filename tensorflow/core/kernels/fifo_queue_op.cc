@@ -23,7 +23,9 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/batch_fifo_queue.h"
 #include "tensorflow/core/kernels/fifo_queue.h"
+#include "tensorflow/core/kernels/lock_free_fifo_queue.h"
 #include "tensorflow/core/kernels/queue_base.h"
 #include "tensorflow/core/kernels/queue_op.h"
 #include "tensorflow/core/lib/core/errors.h"
@@ -36,7 +38,9 @@ limitations under the License.
 namespace tensorflow {
 
 // Defines a FIFOQueueOp, which produces a Queue (specifically, one
-// backed by FIFOQueue) that persists across different graph
+// backed by FIFOQueue, by BatchFIFOQueue when the shapes of the
+// components are specified, or by LockFreeFIFOQueue when they are not
+// and the capacity is bounded) that persists across different graph
 // executions, and sessions. Running this op produces a single-element
 // tensor of handles to Queues in the corresponding device.
 class FIFOQueueOp : public QueueOp {
@@ -47,6 +51,22 @@ class FIFOQueueOp : public QueueOp {
 
  protected:
   CreatorCallback GetCreator() const override {
+    if (BatchFIFOQueue::IsSupported(component_types_, component_shapes_)) {
+      return [this](QueueInterface** ret) {
+        BatchFIFOQueue* queue = new BatchFIFOQueue(
+            capacity_, component_types_, component_shapes_, cinfo_.name());
+        *ret = queue;
+        return queue->Initialize();
+      };
+    }
+    if (LockFreeFIFOQueue::IsSupported(capacity_, component_shapes_)) {
+      return [this](QueueInterface** ret) {
+        LockFreeFIFOQueue* queue = new LockFreeFIFOQueue(
+            capacity_, component_types_, component_shapes_, cinfo_.name());
+        *ret = queue;
+        return queue->Initialize();
+      };
+    }
     return [this](QueueInterface** ret) {
       FIFOQueue* queue = new FIFOQueue(capacity_, component_types_,
                                        component_shapes_, cinfo_.name());
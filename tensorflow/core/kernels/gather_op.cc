@@ -15,15 +15,20 @@ limitations under the License.
 
 // See docs in ../ops/array_ops.cc.
 
+#define EIGEN_USE_THREADS
+
 #include "tensorflow/core/kernels/gather_op.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/gather_rows.h"
+#include "tensorflow/core/kernels/matmul_op_fused.h"
 #include "tensorflow/core/platform/logging.h"
-#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -78,7 +83,7 @@ class GatherOp : public OpKernel {
       auto out_flat = out->shaped<T, 2>({N, out->NumElements() / N});
 
       functor::Gather<Device, T, Index> functor;
-      int64 bad_i = functor(c->eigen_device<Device>(), params_flat,
+      int64 bad_i = functor(c, c->eigen_device<Device>(), params_flat,
                             indices_flat, out_flat);
 
       OP_REQUIRES(
@@ -92,15 +97,15 @@ class GatherOp : public OpKernel {
 
 namespace functor {
 
-// Helper method to copy using memcpy.
+// Helper method to copy rows [start, end) of out using memcpy.  Returns the
+// first i in [start, end) whose index is out of range, or -1.
 template <typename T, typename Index, typename SliceIndex,
           SliceIndex static_slice_elems>
 SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
                         typename TTypes<Index>::ConstFlat indices,
                         SliceIndex slice_elems,
-                        typename TTypes<T>::Matrix out) {
-  const SliceIndex first_dim_size =
-      static_cast<SliceIndex>(indices.dimension(0));
+                        typename TTypes<T>::Matrix out, SliceIndex start,
+                        SliceIndex end) {
   const Index limit = static_cast<Index>(params.dimension(0));
   T* out_base = &out(0, 0);
   const T* params_base = &params(0, 0);
@@ -111,12 +116,11 @@ SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
   }
   // Compute slice_bytes here so that static knowledge is available
   const size_t slice_bytes = slice_elems * sizeof(T);
-  for (SliceIndex i = 0; i < first_dim_size; i++) {
-    const SliceIndex j = i + 1;
-    if (j < first_dim_size) {
-      port::prefetch<port::PREFETCH_HINT_T0>(&params(indices(j), 0));
-      port::prefetch<port::PREFETCH_HINT_T0>(&out(j, 0));
-    }
+  const size_t prefetch_bytes = GatherPrefetchBytes<T>(slice_elems);
+  for (SliceIndex i = start; i < end; i++) {
+    PrefetchGatherRow<T, Index, SliceIndex>(params_base, indices, limit,
+                                            slice_elems, prefetch_bytes, i,
+                                            end);
     // Grab the index and check its validity.  An earlier version of the
     // code checked it and then grabbed it from memory a second time, which
     // was a security risk since it could have changed in between.
@@ -133,44 +137,210 @@ SliceIndex HandleCopies(typename TTypes<T>::ConstMatrix params,
   return -1;
 }
 
-// Specialization gather functor for CPU.
+// Specialization gather functor for CPU.  The indices are sharded across
+// the intra-op thread pool.
 template <typename T, typename Index>
 struct Gather<CPUDevice, T, Index> {
-  int64 operator()(const CPUDevice& d, typename TTypes<T>::ConstMatrix params,
+  int64 operator()(OpKernelContext* ctx, const CPUDevice& d,
+                   typename TTypes<T>::ConstMatrix params,
                    typename TTypes<Index>::ConstFlat indices,
                    typename TTypes<T>::Matrix out) {
     const int64 N = indices.size();
     const int64 slice_size = out.size() / N;
-    int64 bad_i;
 
     bool use_large = (slice_size > std::numeric_limits<int32>::max() ||
                       params.size() > std::numeric_limits<int32>::max() ||
                       N > std::numeric_limits<int32>::max());
-#define CALL(elems)                                                   \
-  do {                                                                \
-    if (use_large) {                                                  \
-      bad_i = HandleCopies<T, Index, int64, elems>(params, indices,   \
-                                                   slice_size, out);  \
-    } else {                                                          \
-      const int32 small_slice = static_cast<int32>(slice_size);       \
-      bad_i = HandleCopies<T, Index, int32, elems>(params, indices,   \
-                                                   small_slice, out); \
-    }                                                                 \
+    mutex mu;
+    int64 bad_i = -1;
+    auto work = [&params, &indices, &out, slice_size, use_large, &mu,
+                 &bad_i](int64 start, int64 end) {
+      int64 shard_bad_i;
+#define CALL(elems)                                                         \
+  do {                                                                      \
+    if (use_large) {                                                        \
+      shard_bad_i = HandleCopies<T, Index, int64, elems>(                   \
+          params, indices, slice_size, out, start, end);                    \
+    } else {                                                                \
+      const int32 small_slice = static_cast<int32>(slice_size);             \
+      shard_bad_i = HandleCopies<T, Index, int32, elems>(                   \
+          params, indices, small_slice, out, static_cast<int32>(start),     \
+          static_cast<int32>(end));                                         \
+    }                                                                       \
   } while (0)
 
-    if (slice_size == 10)
-      CALL(10);
-    else if (slice_size == 20)
-      CALL(20);
-    else
-      CALL(-1);
+      // Narrow rows get copies of a fixed size, which the compiler inlines.
+      // Wider rows are copied faster by the library memcpy.
+      switch (slice_size) {
+        case 8:
+          CALL(8);
+          break;
+        case 10:
+          CALL(10);
+          break;
+        case 16:
+          CALL(16);
+          break;
+        case 20:
+          CALL(20);
+          break;
+        default:
+          CALL(-1);
+          break;
+      }
 #undef CALL
 
+      if (shard_bad_i >= 0) RecordBadGatherIndex(&mu, shard_bad_i, &bad_i);
+    };
+
+    const int64 cost_per_row =
+        kGatherRowMissCost + slice_size * sizeof(T) / 8;
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, N,
+          cost_per_row, work);
+    return bad_i;
+  }
+};
+
+// Computes rows [start, end) of out = activation(gather(params, indices) +
+// bias), adding "bias" to each row of params as it is copied, so that the
+// output is written once.  Returns the first i in [start, end) whose index is
+// out of range, or -1.
+template <typename T, typename Index>
+int64 HandleBiasActivationCopies(typename TTypes<T>::ConstMatrix params,
+                                 typename TTypes<Index>::ConstFlat indices,
+                                 typename TTypes<T>::ConstVec bias,
+                                 FusedActivation activation,
+                                 typename TTypes<T>::Matrix out, int64 start,
+                                 int64 end) {
+  const Index limit = static_cast<Index>(params.dimension(0));
+  const int64 slice_elems = params.dimension(1);
+  const int64 depth = bias.size();
+  const size_t prefetch_bytes = GatherPrefetchBytes<T>(slice_elems);
+  for (int64 i = start; i < end; i++) {
+    PrefetchGatherRow<T, Index, int64>(params.data(), indices, limit,
+                                       slice_elems, prefetch_bytes, i, end);
+    const Index index = internal::SubtleMustCopy(indices(i));
+    if (!FastBoundsCheck(index, limit)) return i;
+    if (slice_elems < depth) {
+      // params is 1-D, so the last dimension of the output comes from the
+      // indices, and each gathered element gets the bias of its column.
+      const T value = params(index, 0) + bias(i % depth);
+      out(i, 0) = activation == FusedActivation::kRelu
+                      ? std::max(value, static_cast<T>(0))
+                      : value;
+      continue;
+    }
+    // Each slice holds slice_elems / depth rows of the bias size.
+    for (int64 offset = 0; offset < slice_elems; offset += depth) {
+      typename TTypes<T>::UnalignedConstVec in(
+          params.data() + index * slice_elems + offset, depth);
+      typename TTypes<T>::UnalignedVec row(
+          out.data() + i * slice_elems + offset, depth);
+      if (activation == FusedActivation::kRelu) {
+        row = (in + bias).cwiseMax(static_cast<T>(0));
+      } else {
+        row = in + bias;
+      }
+    }
+  }
+  return -1;
+}
+
+// Gather functor adding a bias and applying an activation to the gathered
+// rows, on the CPU.  The indices are sharded across the intra-op thread pool.
+template <typename T, typename Index>
+struct GatherBiasActivation {
+  int64 operator()(OpKernelContext* ctx, typename TTypes<T>::ConstMatrix params,
+                   typename TTypes<Index>::ConstFlat indices,
+                   typename TTypes<T>::ConstVec bias,
+                   FusedActivation activation,
+                   typename TTypes<T>::Matrix out) {
+    const int64 N = indices.size();
+    const int64 slice_size = out.dimension(1);
+    mutex mu;
+    int64 bad_i = -1;
+    auto work = [&params, &indices, &bias, activation, &out, &mu, &bad_i](
+        int64 start, int64 end) {
+      const int64 shard_bad_i = HandleBiasActivationCopies<T, Index>(
+          params, indices, bias, activation, out, start, end);
+      if (shard_bad_i >= 0) RecordBadGatherIndex(&mu, shard_bad_i, &bad_i);
+    };
+    const int64 cost_per_row =
+        kGatherRowMissCost + slice_size * sizeof(T) / 8 + slice_size;
+    auto worker_threads = ctx->device()->tensorflow_cpu_worker_threads();
+    Shard(worker_threads->num_threads, worker_threads->workers, N,
+          cost_per_row, work);
     return bad_i;
   }
 };
 }  // namespace functor
 
+// Computes activation(Gather(params, indices) + bias), where the bias is added
+// along the last dimension of the output as BiasAdd does.
+template <typename T, typename Index>
+class FusedGatherOp : public OpKernel {
+ public:
+  explicit FusedGatherOp(OpKernelConstruction* c) : OpKernel(c) {
+    const DataType dt = DataTypeToEnum<T>::v();
+    const DataType index_t = DataTypeToEnum<Index>::v();
+    OP_REQUIRES_OK(c, c->MatchSignature({dt, index_t, dt}, {dt}));
+    // Indices are always validated, as by GatherOp.
+    OP_REQUIRES_OK(c, GetFusedActivation(c, &activation_));
+  }
+
+  void Compute(OpKernelContext* c) override {
+    const Tensor& params = c->input(0);
+    const Tensor& indices = c->input(1);
+    const Tensor& bias = c->input(2);
+    OP_REQUIRES(
+        c, TensorShapeUtils::IsVectorOrHigher(params.shape()),
+        errors::InvalidArgument("params must be at least 1 dimensional"));
+    OP_REQUIRES(
+        c, params.dim_size(0) <= std::numeric_limits<Index>::max(),
+        errors::InvalidArgument("params.shape[0] too large for ",
+                                DataTypeString(DataTypeToEnum<Index>::v()),
+                                " indexing: ", params.dim_size(0), " > ",
+                                std::numeric_limits<Index>::max()));
+
+    TensorShape result_shape = indices.shape();
+    for (int i = 1; i < params.dims(); i++) {
+      result_shape.AddDim(params.dim_size(i));
+    }
+    // The checks of BiasAdd on its input, which is the output here.
+    OP_REQUIRES(c, TensorShapeUtils::IsMatrixOrHigher(result_shape),
+                errors::InvalidArgument("Input tensor must be at least 2D: ",
+                                        result_shape.DebugString()));
+    OP_REQUIRES(c, TensorShapeUtils::IsVector(bias.shape()),
+                errors::InvalidArgument("Biases must be 1D: ",
+                                        bias.shape().DebugString()));
+    OP_REQUIRES(
+        c, bias.dim_size(0) == result_shape.dim_size(result_shape.dims() - 1),
+        errors::InvalidArgument(
+            "Must provide as many biases as the last dimension "
+            "of the input tensor: ",
+            bias.shape().DebugString(), " vs. ", result_shape.DebugString()));
+
+    Tensor* out = nullptr;
+    OP_REQUIRES_OK(c, c->allocate_output(0, result_shape, &out));
+    const int64 N = indices.NumElements();
+    if (out->NumElements() == 0) return;
+
+    auto indices_flat = indices.flat<Index>();
+    const int64 bad_i = functor::GatherBiasActivation<T, Index>()(
+        c, params.flat_outer_dims<T>(), indices_flat, bias.vec<T>(),
+        activation_, out->shaped<T, 2>({N, out->NumElements() / N}));
+    OP_REQUIRES(
+        c, bad_i < 0,
+        errors::InvalidArgument(
+            "indices", SliceDebugString(indices.shape(), bad_i), " = ",
+            indices_flat(bad_i), " is not in [0, ", params.dim_size(0), ")"));
+  }
+
+ private:
+  FusedActivation activation_;
+};
+
 #define REGISTER_GATHER_FULL(dev, type, index_type)                    \
   REGISTER_KERNEL_BUILDER(Name("Gather")                               \
                               .Device(DEVICE_##dev)                    \
@@ -188,13 +358,31 @@ TF_CALL_ALL_TYPES(REGISTER_GATHER_CPU);
 
 #undef REGISTER_GATHER_CPU
 
+#define REGISTER_FUSED_GATHER_FULL(type, index_type)                   \
+  REGISTER_KERNEL_BUILDER(Name("_FusedGather")                         \
+                              .Device(DEVICE_CPU)                      \
+                              .TypeConstraint<type>("Tparams")         \
+                              .TypeConstraint<index_type>("Tindices"), \
+                          FusedGatherOp<type, index_type>)
+
+#define REGISTER_FUSED_GATHER_CPU(type)    \
+  REGISTER_FUSED_GATHER_FULL(type, int32); \
+  REGISTER_FUSED_GATHER_FULL(type, int64)
+
+REGISTER_FUSED_GATHER_CPU(float);
+REGISTER_FUSED_GATHER_CPU(double);
+
+#undef REGISTER_FUSED_GATHER_CPU
+#undef REGISTER_FUSED_GATHER_FULL
+
 #if GOOGLE_CUDA
 // Forward declarations of the functor specializations for GPU.
 namespace functor {
 #define DECLARE_GPU_SPECS_INDEX(T, Index)                          \
   template <>                                                      \
   Index Gather<GPUDevice, T, Index>::operator()(                   \
-      const GPUDevice& d, typename TTypes<T>::ConstMatrix Tparams, \
+      OpKernelContext* ctx, const GPUDevice& d,                    \
+      typename TTypes<T>::ConstMatrix Tparams,                     \
       typename TTypes<Index>::ConstFlat Tindices,                  \
       typename TTypes<T>::Matrix Tout);                            \
   extern template struct Gather<GPUDevice, T, Index>;
@@ -49,7 +49,8 @@ __global__ void GatherOpKernel(const T* params, const Index* indices, T* out,
 namespace functor {
 template <typename T, typename Index>
 struct Gather<GPUDevice, T, Index> {
-  Index operator()(const GPUDevice& d, typename TTypes<T>::ConstMatrix Tparams,
+  Index operator()(OpKernelContext* ctx, const GPUDevice& d,
+                   typename TTypes<T>::ConstMatrix Tparams,
                    typename TTypes<Index>::ConstFlat Tindices,
                    typename TTypes<T>::Matrix Tout) {
     const int64 first_dim_size = Tparams.dimension(0);
@@ -120,6 +120,48 @@ TEST_F(GatherOpTest, HighRank) {
   test::ExpectTensorEqual<float>(expected, *GetOutput(0));
 }
 
+TEST_F(GatherOpTest, Sharded) {
+  MakeOp(DT_INT32);
+
+  // Enough rows of a fixed-width copy loop to be split across threads.
+  const int kRows = 100;
+  const int kWidth = 16;
+  const int kIndices = 5000;
+  std::vector<float> params(kRows * kWidth);
+  for (int i = 0; i < kRows * kWidth; ++i) params[i] = i;
+  std::vector<int32> indices(kIndices);
+  std::vector<float> expected_values;
+  for (int i = 0; i < kIndices; ++i) {
+    indices[i] = (i * 37) % kRows;
+    for (int j = 0; j < kWidth; ++j) {
+      expected_values.push_back(indices[i] * kWidth + j);
+    }
+  }
+  AddInputFromArray<float>(TensorShape({kRows, kWidth}), params);
+  AddInputFromArray<int32>(TensorShape({kIndices}), indices);
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({kIndices, kWidth}));
+  test::FillValues<float>(&expected, expected_values);
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(GatherOpTest, Sharded_FirstBadIndex) {
+  MakeOp(DT_INT32);
+
+  // The first bad index is reported even when a later shard also has one.
+  const int kIndices = 5000;
+  std::vector<int32> indices(kIndices, 1);
+  indices[1000] = 7;
+  indices[4000] = -1;
+  AddInputFromArray<float>(TensorShape({5, 8}), std::vector<float>(40));
+  AddInputFromArray<int32>(TensorShape({kIndices}), indices);
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("indices[1000] = 7 is not in [0, 5)"))
+      << s;
+}
+
 TEST_F(GatherOpTest, Error_IndexOutOfRange) {
   MakeOp(DT_INT32);
 
@@ -136,20 +178,20 @@ TEST_F(GatherOpTest, Error_IndexOutOfRange) {
 constexpr int kLookups = 2000;
 
 template <typename Index>
-static Graph* Gather(int dim) {
+static Graph* Gather(int dim, int64 table_bytes = 512 << 20,
+                     int num_lookups = kLookups) {
   Graph* g = new Graph(OpRegistry::Global());
-  // Always use a 512MB buffer.
-  const int kRows = ((512 << 20) / sizeof(float)) / dim;
+  const int kRows = (table_bytes / sizeof(float)) / dim;
   Tensor params(DT_FLOAT, TensorShape({kRows, dim}));
   params.flat<float>().setRandom();
 
   random::PhiloxRandom philox(301, 17);
   random::SimplePhilox rnd(&philox);
   std::vector<Index> indices_vec;
-  for (int i = 0; i < kLookups; i++) {
+  for (int i = 0; i < num_lookups; i++) {
     indices_vec.push_back(rnd.Uniform(kRows));
   }
-  Tensor indices(DataTypeToEnum<Index>::value, TensorShape({kLookups}));
+  Tensor indices(DataTypeToEnum<Index>::value, TensorShape({num_lookups}));
   for (int i = 0; i < indices_vec.size(); i++) {
     indices.flat<Index>()(i) = indices_vec[i];
   }
@@ -181,5 +223,27 @@ BM_GATHER(gpu, int32);
 BM_GATHER(cpu, int64);
 BM_GATHER(gpu, int64);
 
+// Embedding lookups: many indices into tables of "table_mb" megabytes,
+// most of which are larger than the last level cache.
+constexpr int kEmbeddingLookups = 100000;
+
+#define BM_GATHER_EMBEDDING(DIM)                                          \
+  static void BM_cpu_gather_embedding_##DIM(int iters, int table_mb) {    \
+    const int64 tot = static_cast<int64>(iters) * kEmbeddingLookups * DIM; \
+    testing::ItemsProcessed(tot);                                         \
+    testing::BytesProcessed(tot * sizeof(float));                         \
+    testing::UseRealTime();                                               \
+    test::Benchmark("cpu", Gather<int32>(DIM, int64{table_mb} << 20,      \
+                                         kEmbeddingLookups))              \
+        .Run(iters);                                                      \
+  }                                                                       \
+  BENCHMARK(BM_cpu_gather_embedding_##DIM)->Arg(4)->Arg(256)->Arg(1024)
+
+BM_GATHER_EMBEDDING(8);
+BM_GATHER_EMBEDDING(16);
+BM_GATHER_EMBEDDING(32);
+BM_GATHER_EMBEDDING(64);
+BM_GATHER_EMBEDDING(100);
+
 }  // namespace
 }  // namespace tensorflow
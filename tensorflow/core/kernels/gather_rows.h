@@ -0,0 +1,83 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_GATHER_ROWS_H_
+#define TENSORFLOW_KERNELS_GATHER_ROWS_H_
+// Helpers shared by the CPU kernels that read rows of a table in the order
+// given by a vector of indices: Gather, _FusedGather and
+// EmbeddingLookupSparse.
+
+#include <algorithm>
+
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/platform/mem.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// Most rows of a large table miss the cache, which costs on the order of
+// 100ns on top of the work done with the row.  To overlap those misses with
+// each other and with that work, rows are prefetched kGatherPrefetchDistance
+// indices ahead of the one being read, and only their first
+// kGatherMaxPrefetchBytes.
+static const int kGatherPrefetchDistance = 8;
+static const int kGatherMaxPrefetchBytes = 256;
+// The cost of the cache miss of a row, in the units of Shard().
+static const int64 kGatherRowMissCost = 100;
+
+// Returns the number of bytes to prefetch at the start of rows of
+// "row_elems" values of type T.
+template <typename T>
+inline size_t GatherPrefetchBytes(int64 row_elems) {
+  return std::min(static_cast<size_t>(row_elems * sizeof(T)),
+                  static_cast<size_t>(kGatherMaxPrefetchBytes));
+}
+
+// Prefetches the first "prefetch_bytes" of the row of "params_base", made of
+// rows of "row_elems" values, selected by the index kGatherPrefetchDistance
+// after "i", if that one is before "end".  Out of range indices are skipped
+// here, and reported by the caller when their turn comes.
+template <typename T, typename Index, typename SliceIndex>
+inline void PrefetchGatherRow(const T* params_base,
+                              typename TTypes<Index>::ConstFlat indices,
+                              Index limit, SliceIndex row_elems,
+                              size_t prefetch_bytes, SliceIndex i,
+                              SliceIndex end) {
+  const SliceIndex j = i + kGatherPrefetchDistance;
+  if (j >= end) return;
+  const Index next = indices(j);
+  if (FastBoundsCheck(next, limit)) {
+    const char* row =
+        reinterpret_cast<const char*>(params_base + next * row_elems);
+    for (size_t offset = 0; offset < prefetch_bytes; offset += 64) {
+      port::prefetch<port::PREFETCH_HINT_T0>(row + offset);
+    }
+  }
+}
+
+// The shards of a sharded gather each stop at their first out of range
+// index, and the smallest of those is reported, as if the indices had been
+// walked in order.  Records "i", the first bad index of a shard, in
+// "*bad_i", which is -1 until a bad index is found.
+inline void RecordBadGatherIndex(mutex* mu, int64 i, int64* bad_i) {
+  mutex_lock l(*mu);
+  if (*bad_i < 0 || i < *bad_i) *bad_i = i;
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_GATHER_ROWS_H_
@@ -14,14 +14,15 @@ limitations under the License.
 ==============================================================================*/
 
 #include <string>
-#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/flatset.h"
 
 namespace tensorflow {
 template <typename T>
@@ -42,24 +43,24 @@ class ListDiffOp : public OpKernel {
     OP_REQUIRES(context, TensorShapeUtils::IsVector(y.shape()),
                 errors::InvalidArgument("y should be a 1D vector."));
 
-    std::unordered_set<T> y_set;
     const auto Ty = y.vec<T>();
     const int y_size = Ty.size();
-    y_set.reserve(y_size);
+    gtl::FlatSet<T> y_set(y_size);
     for (int i = 0; i < y_size; ++i) {
       y_set.insert(Ty(i));
     }
 
-    // Compute the size of the output.
+    // Find the elements of x that are not in y, which sizes the outputs even
+    // if x is concurrently mutated.
     const auto Tx = x.vec<T>();
     const int x_size = Tx.size();
-
-    int out_size = 0;
+    std::vector<int32> kept;
     for (int i = 0; i < x_size; ++i) {
       if (y_set.count(Tx(i)) == 0) {
-        ++out_size;
+        kept.push_back(i);
       }
     }
+    const int out_size = kept.size();
 
     // Allocate and populate outputs.
     Tensor* out = nullptr;
@@ -70,18 +71,9 @@ class ListDiffOp : public OpKernel {
     OP_REQUIRES_OK(context, context->allocate_output(1, {out_size}, &indices));
     auto Tindices = indices->vec<int32>();
 
-    for (int i = 0, p = 0; i < x_size; ++i) {
-      if (y_set.count(Tx(i)) == 0) {
-        OP_REQUIRES(context, p < out_size,
-                    errors::InvalidArgument(
-                        "Tried to set output index ", p,
-                        " when output Tensor only had ", out_size,
-                        " elements. Check that your "
-                        "input tensors are not being concurrently mutated."));
-        Tout(p) = Tx(i);
-        Tindices(p) = i;
-        p++;
-      }
+    for (int p = 0; p < out_size; ++p) {
+      Tout(p) = Tx(kept[p]);
+      Tindices(p) = kept[p];
     }
   }
 };
@@ -0,0 +1,272 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// See docs in ../ops/data_flow_ops.cc.
+
+#include "tensorflow/core/kernels/lock_free_fifo_queue.h"
+
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/queue_base.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// The fast paths and the blocking attempts hand elements to each other
+// without a common lock, so a fast path that moves an element and an
+// attempt that is about to wait each publish their change and then look
+// at the other's, with a full fence in between: either the attempt sees
+// the element, or the fast path sees the attempt and flushes the queue.
+
+LockFreeFIFOQueue::LockFreeFIFOQueue(
+    int32 capacity, const DataTypeVector& component_dtypes,
+    const std::vector<TensorShape>& component_shapes, const string& name)
+    : QueueBase(capacity, component_dtypes, component_shapes, name),
+      ring_(capacity) {}
+
+// static
+bool LockFreeFIFOQueue::IsSupported(
+    int32 capacity, const std::vector<TensorShape>& component_shapes) {
+  return capacity > 0 && capacity <= kMaxCapacity && component_shapes.empty();
+}
+
+Status LockFreeFIFOQueue::Initialize() {
+  if (component_dtypes_.empty()) {
+    return errors::InvalidArgument("Empty component types for queue ", name_);
+  }
+  if (!IsSupported(capacity_, component_shapes_)) {
+    return errors::InvalidArgument("Unsupported capacity or shapes for queue ",
+                                   name_, ": ", capacity_, ", ",
+                                   ShapeListString(component_shapes_));
+  }
+  return Status::OK();
+}
+
+bool LockFreeFIFOQueue::AddAttempt(Action action, int32 elements_requested,
+                                   OpKernelContext* ctx,
+                                   DoneCallback done_callback,
+                                   RunCallback run_callback) {
+  CancellationManager* cm = ctx->cancellation_manager();
+  CancellationToken token = cm->get_cancellation_token();
+  std::atomic<int32>* num_waiting = action == kEnqueue
+                                        ? &num_waiting_enqueues_
+                                        : &num_waiting_dequeues_;
+  {
+    mutex_lock l(mu_);
+    if (!cm->RegisterCallback(token, [this, action, cm, token]() {
+          Cancel(action, cm, token);
+        })) {
+      return false;
+    }
+    num_waiting->fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::deque<Attempt>* attempts =
+        action == kEnqueue ? &enqueue_attempts_ : &dequeue_attempts_;
+    // The count is dropped before the callback runs, since the callback may
+    // release the last reference to the queue.
+    attempts->emplace_back(elements_requested,
+                           [num_waiting, done_callback]() {
+                             num_waiting->fetch_sub(1,
+                                                    std::memory_order_relaxed);
+                             done_callback();
+                           },
+                           ctx, cm, token, run_callback);
+  }
+  FlushUnlocked();
+  return true;
+}
+
+void LockFreeFIFOQueue::WakeWaiting(Action action) {
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  const std::atomic<int32>& num_waiting =
+      action == kEnqueue ? num_waiting_dequeues_ : num_waiting_enqueues_;
+  if (num_waiting.load(std::memory_order_relaxed) > 0) FlushUnlocked();
+}
+
+void LockFreeFIFOQueue::TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                                   DoneCallback callback) {
+  if (num_waiting_enqueues_.load(std::memory_order_relaxed) == 0) {
+    Tuple element(tuple);
+    if (ring_.TryPush(&element)) {
+      AnnotateStats(ctx, kEnqueue, 1, 0, ring_.size());
+      WakeWaiting(kEnqueue);
+      callback();
+      return;
+    }
+  }
+  const bool added = AddAttempt(
+      kEnqueue, 1, ctx, callback,
+      [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (closed_) {
+          attempt->context->SetStatus(
+              errors::Aborted("FIFOQueue '", name_, "' is closed."));
+          return kComplete;
+        }
+        // The ring buffer is closed as soon as Close() is called, but the
+        // enqueues that were waiting before it still go in.
+        Tuple element(tuple);
+        return ring_.TryPush(&element, true /* even_if_closed */)
+                   ? kComplete
+                   : kNoProgress;
+      });
+  if (!added) {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+void LockFreeFIFOQueue::TryEnqueueMany(const Tuple& tuple,
+                                       OpKernelContext* ctx,
+                                       DoneCallback callback) {
+  const int64 batch_size = tuple[0].dim_size(0);
+  if (batch_size == 0) {
+    callback();
+    return;
+  }
+
+  const bool added = AddAttempt(
+      kEnqueue, batch_size, ctx, callback,
+      [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (closed_) {
+          attempt->context->SetStatus(
+              errors::Aborted("FIFOQueue '", name_, "' is closed."));
+          return kComplete;
+        }
+        RunResult result = kNoProgress;
+        while (true) {
+          // attempt->tuple holds the next element until there is room for it.
+          if (attempt->tuple.empty()) {
+            const int64 index =
+                tuple[0].dim_size(0) - attempt->elements_requested;
+            for (int i = 0; i < num_components(); ++i) {
+              TensorShape element_shape(tuple[i].shape());
+              element_shape.RemoveDim(0);
+              PersistentTensor element;
+              Tensor* element_access = nullptr;
+              attempt->context->SetStatus(attempt->context->allocate_persistent(
+                  tuple[i].dtype(), element_shape, &element, &element_access));
+              if (!attempt->context->status().ok()) return kComplete;
+              attempt->context->SetStatus(
+                  CopySliceToElement(tuple[i], element_access, index));
+              if (!attempt->context->status().ok()) return kComplete;
+              attempt->tuple.push_back(*element_access);
+            }
+          }
+          if (!ring_.TryPush(&attempt->tuple, true /* even_if_closed */)) {
+            return result;
+          }
+          attempt->tuple.clear();
+          result = kProgress;
+          --attempt->elements_requested;
+          if (attempt->elements_requested == 0) {
+            return kComplete;
+          }
+        }
+      });
+  if (!added) {
+    ctx->SetStatus(errors::Cancelled("Enqueue operation was cancelled"));
+    callback();
+  }
+}
+
+void LockFreeFIFOQueue::TryDequeue(OpKernelContext* ctx,
+                                   CallbackWithTuple callback) {
+  if (num_waiting_dequeues_.load(std::memory_order_relaxed) == 0) {
+    Tuple tuple;
+    if (ring_.TryPop(&tuple)) {
+      AnnotateStats(ctx, kDequeue, 1, 0, ring_.size());
+      WakeWaiting(kDequeue);
+      callback(tuple);
+      return;
+    }
+  }
+  // Shared between the attempt and its callback, which stays empty if the
+  // attempt fails or is cancelled.
+  std::shared_ptr<Tuple> tuple(new Tuple);
+  const bool added = AddAttempt(
+      kDequeue, 1, ctx, [callback, tuple]() { callback(*tuple); },
+      [tuple, this](Attempt* attempt) EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+        if (ring_.TryPop(tuple.get())) {
+          return kComplete;
+        }
+        // Pushes that have claimed a slot count in the size, and wake this
+        // attempt up once they finish.
+        const int64 s = ring_.size();
+        if (closed_ && s == 0) {
+          attempt->context->SetStatus(errors::OutOfRange(
+              "FIFOQueue '", name_, "' is closed and has ",
+              "insufficient elements (requested ", 1, ", current size ", s,
+              ")"));
+          return kComplete;
+        }
+        return kNoProgress;
+      });
+  if (!added) {
+    ctx->SetStatus(errors::Cancelled("Dequeue operation was cancelled"));
+    callback(Tuple());
+  }
+}
+
+void LockFreeFIFOQueue::TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                                       bool allow_small_batch,
+                                       CallbackWithTuple callback) {
+  if (allow_small_batch) {
+    ctx->SetStatus(
+        errors::Unimplemented("Dequeue: Queue does not support small batches"));
+  } else {
+    ctx->SetStatus(
+        errors::InvalidArgument("FIFOQueue's DequeueMany requires the "
+                                "components to have specified shapes."));
+  }
+  callback(Tuple());
+}
+
+void LockFreeFIFOQueue::Close(OpKernelContext* ctx,
+                              bool cancel_pending_enqueues,
+                              DoneCallback callback) {
+  // Enqueues that start after this go through the attempts, behind the
+  // close.
+  ring_.Close();
+  QueueBase::Close(ctx, cancel_pending_enqueues, callback);
+}
+
+Status LockFreeFIFOQueue::MatchesNodeDef(const NodeDef& node_def) {
+  TF_RETURN_IF_ERROR(MatchesNodeDefOp(node_def, "FIFOQueue"));
+  TF_RETURN_IF_ERROR(MatchesNodeDefCapacity(node_def, capacity_));
+  TF_RETURN_IF_ERROR(MatchesNodeDefTypes(node_def));
+  TF_RETURN_IF_ERROR(MatchesNodeDefShapes(node_def));
+  return Status::OK();
+}
+
+Status LockFreeFIFOQueue::GetStats(Summary* summary) {
+  {
+    // The fast paths do not record anything, so take the counts from the
+    // ring buffer instead.  The wait histograms only cover the operations
+    // that went through the attempts.
+    mutex_lock l(mu_);
+    num_enqueued_ = ring_.num_pushed();
+    num_dequeued_ = ring_.num_popped();
+  }
+  return QueueBase::GetStats(summary);
+}
+
+}  // namespace tensorflow
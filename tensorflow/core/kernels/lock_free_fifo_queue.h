@@ -0,0 +1,110 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_LOCK_FREE_FIFO_QUEUE_H_
+#define TENSORFLOW_KERNELS_LOCK_FREE_FIFO_QUEUE_H_
+
+#include <atomic>
+#include <vector>
+
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/kernels/mpmc_ring_buffer.h"
+#include "tensorflow/core/kernels/queue_base.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A bounded FIFO queue whose elements live in a lock-free ring buffer.
+// Enqueue and Dequeue of a single element go straight to the ring buffer
+// when the queue is neither full nor empty and nobody is waiting, without
+// taking mu_ or scheduling callbacks.  They fall back to the attempt
+// machinery of QueueBase only when they have to block, or when earlier
+// attempts of the same kind are already blocked, so that those are not
+// overtaken.  EnqueueMany always goes through the attempt machinery, so
+// elements enqueued concurrently without blocking may be interleaved with
+// its batch.
+//
+// Only queues without specified shapes are supported; those can only
+// dequeue one element at a time.
+class LockFreeFIFOQueue : public QueueBase {
+ public:
+  // The largest capacity for which the ring buffer is preallocated.
+  static const int32 kMaxCapacity = 1 << 16;
+
+  // REQUIRES: IsSupported(capacity, component_shapes).
+  LockFreeFIFOQueue(int32 capacity, const DataTypeVector& component_dtypes,
+                    const std::vector<TensorShape>& component_shapes,
+                    const string& name);
+
+  Status Initialize();  // Must be called before any other method.
+
+  // Returns true if a queue with this capacity and these component shapes
+  // can be a LockFreeFIFOQueue: it must be bounded by at most kMaxCapacity,
+  // and the shapes must not be specified.
+  static bool IsSupported(int32 capacity,
+                          const std::vector<TensorShape>& component_shapes);
+
+  // Implementations of QueueInterface methods --------------------------------
+
+  void TryEnqueue(const Tuple& tuple, OpKernelContext* ctx,
+                  DoneCallback callback) override;
+  void TryEnqueueMany(const Tuple& tuple, OpKernelContext* ctx,
+                      DoneCallback callback) override;
+  void TryDequeue(OpKernelContext* ctx, CallbackWithTuple callback) override;
+  void TryDequeueMany(int num_elements, OpKernelContext* ctx,
+                      bool allow_small_batch,
+                      CallbackWithTuple callback) override;
+  void Close(OpKernelContext* ctx, bool cancel_pending_enqueues,
+             DoneCallback callback) override;
+  Status MatchesNodeDef(const NodeDef& node_def) override;
+  Status GetStats(Summary* summary) override;
+
+  int32 size() override { return ring_.size(); }
+
+ private:
+  ~LockFreeFIFOQueue() override {}
+
+  int32 SizeLocked() override { return ring_.size(); }
+
+  // Adds a blocking attempt to *attempts, counting it in *num_waiting until
+  // its callback runs.  Returns false if the operation was already
+  // cancelled, in which case nothing was added.
+  bool AddAttempt(Action action, int32 elements_requested,
+                  OpKernelContext* ctx, DoneCallback done_callback,
+                  RunCallback run_callback);
+
+  // Wakes up the attempts of the other kind after an element was moved
+  // without the lock, if any of them are waiting.
+  void WakeWaiting(Action action);
+
+  MPMCRingBuffer<Tuple> ring_;
+
+  // The number of enqueue and dequeue attempts that have not finished.
+  // While an attempt of one kind is waiting, operations of that kind do not
+  // use the fast path.
+  std::atomic<int32> num_waiting_enqueues_{0};
+  std::atomic<int32> num_waiting_dequeues_{0};
+
+  TF_DISALLOW_COPY_AND_ASSIGN(LockFreeFIFOQueue);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_LOCK_FREE_FIFO_QUEUE_H_
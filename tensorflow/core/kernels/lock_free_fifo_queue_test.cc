@@ -0,0 +1,305 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/lock_free_fifo_queue.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/cancellation.h"
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/kernels/fifo_queue.h"
+#include "tensorflow/core/lib/core/blocking_counter.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/notification.h"
+#include "tensorflow/core/lib/core/refcount.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+typedef QueueInterface::Tuple Tuple;
+
+class TestDevice : public DeviceBase {
+ public:
+  TestDevice() : DeviceBase(Env::Default()) {}
+  Allocator* GetAllocator(AllocatorAttributes /*attr*/) override {
+    return cpu_allocator();
+  }
+};
+
+// A context for calling the queue directly, as the queue ops do.
+class TestContext {
+ public:
+  TestContext() {
+    params_.device = &device_;
+    params_.cancellation_manager = &cancellation_manager_;
+    ctx_.reset(new OpKernelContext(&params_, 0));
+  }
+
+  OpKernelContext* get() { return ctx_.get(); }
+  CancellationManager* cancellation_manager() { return &cancellation_manager_; }
+
+ private:
+  TestDevice device_;
+  CancellationManager cancellation_manager_;
+  OpKernelContext::Params params_;
+  std::unique_ptr<OpKernelContext> ctx_;
+};
+
+template <typename Queue>
+Queue* NewQueue(int32 capacity) {
+  Queue* queue = new Queue(capacity, {DT_INT32}, {}, "test");
+  TF_CHECK_OK(queue->Initialize());
+  return queue;
+}
+
+Status Enqueue(QueueInterface* queue, int32 value) {
+  TestContext ctx;
+  Notification done;
+  queue->TryEnqueue({test::AsScalar<int32>(value)}, ctx.get(),
+                    [&done]() { done.Notify(); });
+  done.WaitForNotification();
+  return ctx.get()->status();
+}
+
+Status Dequeue(QueueInterface* queue, int32* value) {
+  TestContext ctx;
+  Notification done;
+  queue->TryDequeue(ctx.get(), [&done, value](const Tuple& tuple) {
+    if (!tuple.empty()) *value = tuple[0].scalar<int32>()();
+    done.Notify();
+  });
+  done.WaitForNotification();
+  return ctx.get()->status();
+}
+
+TEST(LockFreeFIFOQueueTest, IsSupported) {
+  EXPECT_TRUE(LockFreeFIFOQueue::IsSupported(10, {}));
+  EXPECT_FALSE(LockFreeFIFOQueue::IsSupported(QueueBase::kUnbounded, {}));
+  EXPECT_FALSE(LockFreeFIFOQueue::IsSupported(0, {}));
+  EXPECT_FALSE(LockFreeFIFOQueue::IsSupported(10, {TensorShape({})}));
+}
+
+TEST(LockFreeFIFOQueueTest, EnqueueAndDequeue) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(3);
+  core::ScopedUnref unref(queue);
+  for (int32 i = 0; i < 10; ++i) {
+    TF_EXPECT_OK(Enqueue(queue, i));
+    TF_EXPECT_OK(Enqueue(queue, 100 + i));
+    EXPECT_EQ(2, queue->size());
+    int32 value;
+    TF_EXPECT_OK(Dequeue(queue, &value));
+    EXPECT_EQ(i, value);
+    TF_EXPECT_OK(Dequeue(queue, &value));
+    EXPECT_EQ(100 + i, value);
+  }
+  EXPECT_EQ(0, queue->size());
+}
+
+TEST(LockFreeFIFOQueueTest, DequeueWaitsForEnqueue) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(2);
+  core::ScopedUnref unref(queue);
+  TestContext ctx;
+  Notification done;
+  int32 value = -1;
+  queue->TryDequeue(ctx.get(), [&done, &value](const Tuple& tuple) {
+    value = tuple[0].scalar<int32>()();
+    done.Notify();
+  });
+  EXPECT_FALSE(done.HasBeenNotified());
+  TF_EXPECT_OK(Enqueue(queue, 7));
+  done.WaitForNotification();
+  TF_EXPECT_OK(ctx.get()->status());
+  EXPECT_EQ(7, value);
+  EXPECT_EQ(0, queue->size());
+}
+
+TEST(LockFreeFIFOQueueTest, EnqueueWaitsWhenFull) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(1);
+  core::ScopedUnref unref(queue);
+  TF_EXPECT_OK(Enqueue(queue, 1));
+  TestContext ctx;
+  Notification done;
+  queue->TryEnqueue({test::AsScalar<int32>(2)}, ctx.get(),
+                    [&done]() { done.Notify(); });
+  EXPECT_FALSE(done.HasBeenNotified());
+  int32 value;
+  TF_EXPECT_OK(Dequeue(queue, &value));
+  EXPECT_EQ(1, value);
+  done.WaitForNotification();
+  TF_EXPECT_OK(ctx.get()->status());
+  TF_EXPECT_OK(Dequeue(queue, &value));
+  EXPECT_EQ(2, value);
+}
+
+TEST(LockFreeFIFOQueueTest, CancelWaitingDequeue) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(2);
+  core::ScopedUnref unref(queue);
+  TestContext ctx;
+  Notification done;
+  queue->TryDequeue(ctx.get(), [&done](const Tuple& tuple) {
+    EXPECT_TRUE(tuple.empty());
+    done.Notify();
+  });
+  ctx.cancellation_manager()->StartCancel();
+  done.WaitForNotification();
+  EXPECT_TRUE(errors::IsCancelled(ctx.get()->status()));
+
+  // The cancelled attempt no longer keeps the fast path off.
+  TF_EXPECT_OK(Enqueue(queue, 3));
+  int32 value;
+  TF_EXPECT_OK(Dequeue(queue, &value));
+  EXPECT_EQ(3, value);
+}
+
+TEST(LockFreeFIFOQueueTest, Close) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(2);
+  core::ScopedUnref unref(queue);
+  TF_EXPECT_OK(Enqueue(queue, 1));
+  TestContext ctx;
+  Notification closed;
+  queue->Close(ctx.get(), false /* cancel_pending_enqueues */,
+               [&closed]() { closed.Notify(); });
+  closed.WaitForNotification();
+  TF_EXPECT_OK(ctx.get()->status());
+
+  EXPECT_TRUE(errors::IsAborted(Enqueue(queue, 2)));
+  int32 value;
+  TF_EXPECT_OK(Dequeue(queue, &value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(errors::IsOutOfRange(Dequeue(queue, &value)));
+}
+
+TEST(LockFreeFIFOQueueTest, CloseWakesWaitingDequeue) {
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(2);
+  core::ScopedUnref unref(queue);
+  TestContext dequeue_ctx;
+  Notification dequeued;
+  queue->TryDequeue(dequeue_ctx.get(),
+                    [&dequeued](const Tuple& tuple) { dequeued.Notify(); });
+  TestContext close_ctx;
+  queue->Close(close_ctx.get(), false /* cancel_pending_enqueues */, []() {});
+  dequeued.WaitForNotification();
+  EXPECT_TRUE(errors::IsOutOfRange(dequeue_ctx.get()->status()));
+}
+
+TEST(LockFreeFIFOQueueTest, ConcurrentEnqueueAndDequeue) {
+  const int kEnqueuers = 4;
+  const int kDequeuers = 4;
+  const int kPerEnqueuer = 2000;
+  LockFreeFIFOQueue* queue = NewQueue<LockFreeFIFOQueue>(4);
+  core::ScopedUnref unref(queue);
+
+  mutex mu;
+  std::vector<int> seen(kEnqueuers * kPerEnqueuer, 0);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kEnqueuers + kDequeuers);
+    for (int e = 0; e < kEnqueuers; ++e) {
+      pool.Schedule([queue, e]() {
+        for (int i = 0; i < kPerEnqueuer; ++i) {
+          TF_EXPECT_OK(Enqueue(queue, e * kPerEnqueuer + i));
+        }
+      });
+    }
+    for (int d = 0; d < kDequeuers; ++d) {
+      pool.Schedule([queue, &mu, &seen]() {
+        for (int i = 0; i < kEnqueuers * kPerEnqueuer / kDequeuers; ++i) {
+          int32 value = -1;
+          TF_EXPECT_OK(Dequeue(queue, &value));
+          mutex_lock l(mu);
+          ++seen[value];
+        }
+      });
+    }
+  }
+  for (int i = 0; i < kEnqueuers * kPerEnqueuer; ++i) {
+    ASSERT_EQ(1, seen[i]) << i;
+  }
+  EXPECT_EQ(0, queue->size());
+}
+
+// Runs "num_enqueuers" threads that enqueue single elements and
+// "num_dequeuers" threads that dequeue them, as fast as they can.
+template <typename Queue>
+void BM_Contention(int iters, int num_enqueuers, int num_dequeuers) {
+  testing::StopTiming();
+  const int64 unit = num_enqueuers * num_dequeuers;
+  const int64 total = std::max<int64>(unit, iters / unit * unit);
+  Queue* queue = NewQueue<Queue>(64);
+  core::ScopedUnref unref(queue);
+  const Tuple tuple = {test::AsScalar<int32>(0)};
+
+  thread::ThreadPool pool(Env::Default(), "contention",
+                          num_enqueuers + num_dequeuers);
+  BlockingCounter finished(num_enqueuers + num_dequeuers);
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < num_enqueuers; ++i) {
+    pool.Schedule([queue, &tuple, &finished, total, num_enqueuers]() {
+      TestContext ctx;
+      for (int64 j = 0; j < total / num_enqueuers; ++j) {
+        Notification done;
+        queue->TryEnqueue(tuple, ctx.get(), [&done]() { done.Notify(); });
+        done.WaitForNotification();
+      }
+      finished.DecrementCount();
+    });
+  }
+  for (int i = 0; i < num_dequeuers; ++i) {
+    pool.Schedule([queue, &finished, total, num_dequeuers]() {
+      TestContext ctx;
+      for (int64 j = 0; j < total / num_dequeuers; ++j) {
+        Notification done;
+        queue->TryDequeue(ctx.get(),
+                          [&done](const Tuple& tuple) { done.Notify(); });
+        done.WaitForNotification();
+      }
+      finished.DecrementCount();
+    });
+  }
+  finished.Wait();
+  testing::StopTiming();
+  testing::ItemsProcessed(total);
+}
+
+#define BM_CONTENTION(QUEUE, E, D)                   \
+  static void BM_##QUEUE##_##E##_##D(int iters) {    \
+    BM_Contention<QUEUE>(iters, E, D);               \
+  }                                                  \
+  BENCHMARK(BM_##QUEUE##_##E##_##D)
+
+BM_CONTENTION(FIFOQueue, 1, 1);
+BM_CONTENTION(FIFOQueue, 4, 1);
+BM_CONTENTION(FIFOQueue, 16, 1);
+BM_CONTENTION(FIFOQueue, 4, 4);
+BM_CONTENTION(FIFOQueue, 16, 16);
+BM_CONTENTION(LockFreeFIFOQueue, 1, 1);
+BM_CONTENTION(LockFreeFIFOQueue, 4, 1);
+BM_CONTENTION(LockFreeFIFOQueue, 16, 1);
+BM_CONTENTION(LockFreeFIFOQueue, 4, 4);
+BM_CONTENTION(LockFreeFIFOQueue, 16, 16);
+
+}  // namespace
+}  // namespace tensorflow
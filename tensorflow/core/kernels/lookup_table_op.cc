@@ -16,16 +16,21 @@ limitations under the License.
 #include "tensorflow/core/kernels/lookup_table_op.h"
 #define EIGEN_USE_THREADS
 
+#include <functional>
 #include <string>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/bounds_check.h"
 #include "tensorflow/core/kernels/initializable_lookup_table.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/lib/hash/hash.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 
 namespace tensorflow {
 namespace lookup {
@@ -44,8 +49,8 @@ const string& SubtleMustCopyUnlessString(const string& value) { return value; }
 
 }  // namespace
 
-// Lookup table that wraps an unordered_map, where the key and value data type
-// is specified.
+// Lookup table that wraps a FlatMap, where the key and value data type is
+// specified.
 //
 // This table is recommended for any variations to key values.
 //
@@ -55,8 +60,8 @@ const string& SubtleMustCopyUnlessString(const string& value) { return value; }
 // Sample use case:
 //
 // HashTable<int64, int64> table;  // int64 -> int64.
-// table.Prepare(10); // Prepare the underlying data structure, the number of
-//                    // elements is required by interface, but not used.
+// table.Prepare(10); // Prepare the underlying data structure, and reserve
+//                    // room for the number of elements, if known.
 // // Populate the table, elements could be added in one or multiple calls.
 // table.Insert(key_tensor, value_tensor); // Populate the table.
 // ...
@@ -81,13 +86,16 @@ class HashTable : public InitializableLookupTable {
   DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
 
  protected:
-  Status DoPrepare(size_t unused) override {
+  Status DoPrepare(size_t size) override {
     if (is_initialized_) {
       return errors::Aborted("HashTable already initialized.");
     }
     if (!table_) {
-      table_ = std::unique_ptr<std::unordered_map<K, V>>(
-          new std::unordered_map<K, V>());
+      table_ = std::unique_ptr<gtl::FlatMap<K, V>>(new gtl::FlatMap<K, V>());
+    }
+    // The size is -1 if unknown.
+    if (static_cast<int64>(size) > 0) {
+      table_->reserve(table_->size() + size);
     }
     return Status::OK();
   };
@@ -126,7 +134,136 @@ class HashTable : public InitializableLookupTable {
   }
 
  private:
-  std::unique_ptr<std::unordered_map<K, V>> table_;
+  std::unique_ptr<gtl::FlatMap<K, V>> table_;
+};
+
+// Lookup table that can be updated at any time, where the key and value data
+// type is specified.
+//
+// The table needs no initialization: Find returns the default value for keys
+// never inserted, Insert adds or overwrites entries and ExportValues outputs
+// a snapshot of all the entries.  Any of them may run concurrently with the
+// others.
+//
+// The entries are split in kNumShards FlatMaps by a hash of the key, each
+// with its own lock.  A batch operation handles the keys shard by shard, and
+// so takes each lock once, for the keys of that shard only.  Readers and
+// writers of a large table then rarely wait on each other.
+template <class K, class V>
+class MutableHashTable : public LookupInterface {
+ public:
+  size_t size() const override {
+    size_t result = 0;
+    for (const Shard& shard : shards_) {
+      mutex_lock l(shard.mu);
+      result += shard.table.size();
+    }
+    return result;
+  }
+
+  Status Find(const Tensor& keys, Tensor* values,
+              const Tensor& default_value) override {
+    TF_RETURN_IF_ERROR(CheckFindArguments(keys, *values, default_value));
+    const V default_val = default_value.flat<V>()(0);
+    const auto key_values = keys.flat<K>();
+    auto value_values = values->flat<V>();
+    ForEachShard(key_values, [&](Shard* shard, const int64* begin,
+                                 const int64* end) {
+      mutex_lock l(shard->mu);
+      for (const int64* i = begin; i != end; ++i) {
+        value_values(*i) = gtl::FindWithDefault(
+            shard->table, SubtleMustCopyUnlessString(key_values(*i)),
+            default_val);
+      }
+    });
+    return Status::OK();
+  }
+
+  // If a key is repeated in "keys", the last of its values is kept.
+  Status Insert(const Tensor& keys, const Tensor& values) override {
+    TF_RETURN_IF_ERROR(CheckKeyAndValueTensors(keys, values));
+    const auto key_values = keys.flat<K>();
+    const auto value_values = values.flat<V>();
+    ForEachShard(key_values, [&](Shard* shard, const int64* begin,
+                                 const int64* end) {
+      mutex_lock l(shard->mu);
+      for (const int64* i = begin; i != end; ++i) {
+        shard->table[SubtleMustCopyUnlessString(key_values(*i))] =
+            value_values(*i);
+      }
+    });
+    return Status::OK();
+  }
+
+  // Holds all the locks while copying, so that the outputs are a consistent
+  // snapshot of the table.
+  Status ExportValues(OpKernelContext* ctx) override {
+    std::vector<mutex_lock> locks;
+    locks.reserve(kNumShards);
+    int64 size = 0;
+    for (Shard& shard : shards_) {
+      locks.emplace_back(shard.mu);
+      size += shard.table.size();
+    }
+    Tensor* keys;
+    Tensor* values;
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("keys", TensorShape({size}), &keys));
+    TF_RETURN_IF_ERROR(
+        ctx->allocate_output("values", TensorShape({size}), &values));
+    auto key_values = keys->flat<K>();
+    auto value_values = values->flat<V>();
+    int64 i = 0;
+    for (const Shard& shard : shards_) {
+      for (const auto& entry : shard.table) {
+        key_values(i) = entry.first;
+        value_values(i) = entry.second;
+        ++i;
+      }
+    }
+    return Status::OK();
+  }
+
+  DataType key_dtype() const override { return DataTypeToEnum<K>::v(); }
+
+  DataType value_dtype() const override { return DataTypeToEnum<V>::v(); }
+
+ private:
+  static const int kNumShards = 32;
+
+  struct Shard {
+    mutable mutex mu;
+    gtl::FlatMap<K, V> table GUARDED_BY(mu);
+  };
+
+  // Calls fn(shard, begin, end) once for every shard that holds some of
+  // "keys", where [begin, end) are the indices of those keys, in order.
+  template <typename Fn>
+  void ForEachShard(typename TTypes<K>::ConstFlat keys, Fn fn) {
+    const int64 n = keys.size();
+    std::hash<K> hasher;
+    std::vector<uint8> shard_of(n);
+    int64 starts[kNumShards + 1] = {0};
+    for (int64 i = 0; i < n; ++i) {
+      // The FlatMaps use the low bits of another mix of the same hash.
+      const uint64 h = static_cast<uint64>(hasher(keys(i))) *
+                       0x9E3779B97F4A7C15ull;
+      shard_of[i] = (h >> 32) % kNumShards;
+      ++starts[shard_of[i] + 1];
+    }
+    for (int s = 0; s < kNumShards; ++s) starts[s + 1] += starts[s];
+    std::vector<int64> order(n);
+    int64 next[kNumShards];
+    std::copy(starts, starts + kNumShards, next);
+    for (int64 i = 0; i < n; ++i) order[next[shard_of[i]]++] = i;
+    for (int s = 0; s < kNumShards; ++s) {
+      if (starts[s] < starts[s + 1]) {
+        fn(&shards_[s], order.data() + starts[s], order.data() + starts[s + 1]);
+      }
+    }
+  }
+
+  Shard shards_[kNumShards];
 };
 
 }  // namespace lookup
@@ -182,6 +319,49 @@ class LookupTableSizeOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("LookupTableSize").Device(DEVICE_CPU),
                         LookupTableSizeOp);
 
+// Op that inserts or updates entries of the given table.
+class LookupTableInsertOp : public OpKernel {
+ public:
+  explicit LookupTableInsertOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::LookupInterface* table;
+    OP_REQUIRES_OK(ctx, GetLookupTable("table_handle", ctx, &table));
+    core::ScopedUnref unref_me(table);
+
+    DataTypeVector expected_inputs = {DT_STRING_REF, table->key_dtype(),
+                                      table->value_dtype()};
+    OP_REQUIRES_OK(ctx, ctx->MatchSignature(expected_inputs, {}));
+
+    OP_REQUIRES_OK(ctx, table->Insert(ctx->input(1), ctx->input(2)));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("LookupTableInsert").Device(DEVICE_CPU),
+                        LookupTableInsertOp);
+
+// Op that outputs all the keys and values of the given table.
+class LookupTableExportOp : public OpKernel {
+ public:
+  explicit LookupTableExportOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
+
+  void Compute(OpKernelContext* ctx) override {
+    lookup::LookupInterface* table;
+    OP_REQUIRES_OK(ctx, GetLookupTable("table_handle", ctx, &table));
+    core::ScopedUnref unref_me(table);
+
+    DataTypeVector expected_inputs = {DT_STRING_REF};
+    DataTypeVector expected_outputs = {table->key_dtype(),
+                                       table->value_dtype()};
+    OP_REQUIRES_OK(ctx, ctx->MatchSignature(expected_inputs, expected_outputs));
+
+    OP_REQUIRES_OK(ctx, table->ExportValues(ctx));
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("LookupTableExport").Device(DEVICE_CPU),
+                        LookupTableExportOp);
+
 // Register the HashTable op with the currently supported key and value types.
 #define REGISTER_KERNEL(key_dtype, value_dtype)                           \
   REGISTER_KERNEL_BUILDER(                                                \
@@ -197,4 +377,22 @@ REGISTER_KERNEL(int64, string);
 
 #undef REGISTER_KERNEL
 
+// Register the MutableHashTable op with the currently supported key and value
+// types.
+#define REGISTER_KERNEL(key_dtype, value_dtype)                           \
+  REGISTER_KERNEL_BUILDER(                                                \
+      Name("MutableHashTable")                                            \
+          .Device(DEVICE_CPU)                                             \
+          .TypeConstraint<key_dtype>("key_dtype")                         \
+          .TypeConstraint<value_dtype>("value_dtype"),                    \
+      LookupTableOp<lookup::MutableHashTable<key_dtype, value_dtype>,     \
+                    key_dtype, value_dtype>)
+
+REGISTER_KERNEL(string, int64);
+REGISTER_KERNEL(string, float);
+REGISTER_KERNEL(int64, int64);
+REGISTER_KERNEL(int64, float);
+
+#undef REGISTER_KERNEL
+
 }  // namespace tensorflow
@@ -0,0 +1,145 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_MATMUL_OP_FUSED_H_
+#define TENSORFLOW_KERNELS_MATMUL_OP_FUSED_H_
+
+// CPU helpers of the kernels that fuse a BiasAdd and an activation into the
+// op producing their input: _FusedMatMul, _FusedConv2D and _FusedGather.  The
+// includer must define EIGEN_USE_THREADS.
+
+#include <algorithm>
+
+#include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Activation applied by a fused kernel once the bias is added.
+enum class FusedActivation { kNone, kRelu };
+
+// Reads the "activation" attr of a fused kernel.
+inline Status GetFusedActivation(OpKernelConstruction* context,
+                                 FusedActivation* activation) {
+  string name;
+  TF_RETURN_IF_ERROR(context->GetAttr("activation", &name));
+  if (name == "None") {
+    *activation = FusedActivation::kNone;
+  } else if (name == "Relu") {
+    *activation = FusedActivation::kRelu;
+  } else {
+    return errors::InvalidArgument("Unsupported fused activation: ", name);
+  }
+  return Status::OK();
+}
+
+namespace functor {
+
+// Adds "bias" to the rows [begin, end) of "out" and applies "activation", in
+// place.
+template <typename T>
+void BiasActivationRows(typename TTypes<T>::Matrix out,
+                        typename TTypes<T>::ConstVec bias,
+                        FusedActivation activation, int64 begin, int64 end) {
+  const int64 depth = out.dimension(1);
+  for (int64 r = begin; r < end; ++r) {
+    typename TTypes<T>::UnalignedVec row(out.data() + r * depth, depth);
+    if (activation == FusedActivation::kRelu) {
+      row = (row + bias).cwiseMax(static_cast<T>(0));
+    } else {
+      row = row + bias;
+    }
+  }
+}
+
+// Adds "bias" to every row of "out" and applies "activation", in place, with
+// the rows sharded across "workers".
+template <typename T>
+void BiasActivation(const DeviceBase::CpuWorkerThreads& workers,
+                    typename TTypes<T>::Matrix out,
+                    typename TTypes<T>::ConstVec bias,
+                    FusedActivation activation) {
+  Shard(workers.num_threads, workers.workers, out.dimension(0),
+        2 * out.dimension(1), [&out, &bias, activation](int64 begin,
+                                                         int64 end) {
+          BiasActivationRows<T>(out, bias, activation, begin, end);
+        });
+}
+
+// Computes out = activation(a * b + bias) on the CPU, where * contracts the
+// dimensions of "dim_pair" and "bias" is added to every row of the product.
+//
+// When there are enough rows for every thread, each thread computes whole
+// blocks of rows of the product, and adds the bias and applies the activation
+// to each block right after computing it, while it is still in cache.
+// Otherwise all the threads compute the product together, and then update it
+// in a separate pass.
+template <typename T>
+void FusedMatMul(
+    OpKernelContext* ctx, typename TTypes<T>::ConstMatrix a,
+    typename TTypes<T>::ConstMatrix b,
+    const Eigen::array<Eigen::IndexPair<Eigen::DenseIndex>, 1>& dim_pair,
+    typename TTypes<T>::ConstVec bias, FusedActivation activation,
+    typename TTypes<T>::Matrix out) {
+  const DeviceBase::CpuWorkerThreads& workers =
+      *ctx->device()->tensorflow_cpu_worker_threads();
+  const int64 m = out.dimension(0);
+  const int64 n = out.dimension(1);
+  const int64 k = a.dimension(dim_pair[0].first);
+
+  // Blocks of about 1MB of output, which stay in the last levels of cache,
+  // but tall enough that repacking "b" for each of them stays cheap.
+  static const int64 kBlockBytes = 1024 << 10;
+  static const int64 kMinBlockRows = 256;
+  const int64 block_rows = std::max<int64>(
+      kMinBlockRows, kBlockBytes / static_cast<int64>(sizeof(T) * n));
+  const int64 num_blocks = (m + block_rows - 1) / block_rows;
+  if (num_blocks < workers.num_threads) {
+    out.device(ctx->eigen_device<Eigen::ThreadPoolDevice>()) =
+        a.contract(b, dim_pair);
+    BiasActivation<T>(workers, out, bias, activation);
+    return;
+  }
+
+  const bool transpose_a = dim_pair[0].first == 0;
+  auto compute_blocks = [&](int64 begin, int64 end) {
+    for (int64 block = begin; block < end; ++block) {
+      const int64 row = block * block_rows;
+      const int64 rows = std::min(block_rows, m - row);
+      typename TTypes<T>::UnalignedMatrix out_block(out.data() + row * n,
+                                                    rows, n);
+      if (transpose_a) {
+        Eigen::DSizes<Eigen::DenseIndex, 2> offsets(0, row);
+        Eigen::DSizes<Eigen::DenseIndex, 2> extents(k, rows);
+        out_block = a.slice(offsets, extents).contract(b, dim_pair);
+      } else {
+        typename TTypes<T>::UnalignedConstMatrix a_block(a.data() + row * k,
+                                                         rows, k);
+        out_block = a_block.contract(b, dim_pair);
+      }
+      BiasActivationRows<T>(out, bias, activation, row, row + rows);
+    }
+  };
+  Shard(workers.num_threads, workers.workers, num_blocks,
+        2 * block_rows * n * k, compute_blocks);
+}
+
+}  // namespace functor
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_MATMUL_OP_FUSED_H_
@@ -0,0 +1,401 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Returns a [rows, cols] tensor of small values, some of them negative.
+Tensor Values(int64 rows, int64 cols, int seed) {
+  Tensor t(DT_FLOAT, TensorShape({rows, cols}));
+  auto flat = t.flat<float>();
+  for (int64 i = 0; i < flat.size(); ++i) {
+    flat(i) = static_cast<float>((i * 7 + seed) % 13) - 6.0f;
+  }
+  return t;
+}
+
+// Returns the transpose of the matrix "t".
+Tensor Transpose(const Tensor& t) {
+  Tensor result(DT_FLOAT, TensorShape({t.dim_size(1), t.dim_size(0)}));
+  Eigen::array<int, 2> perm({1, 0});
+  result.matrix<float>() = t.matrix<float>().shuffle(perm);
+  return result;
+}
+
+class FusedOpsTest : public OpsTestBase {
+ protected:
+  // Runs the kernels on 4 threads, so that large products are computed by
+  // blocks whatever the number of cores.
+  FusedOpsTest() : pool_(Env::Default(), "test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  // Adds the float tensor "t" as an input of shape "shape".
+  void AddInput(const TensorShape& shape, const Tensor& t) {
+    AddInputFromArray<float>(
+        shape, gtl::ArraySlice<float>(t.flat<float>().data(), t.NumElements()));
+  }
+
+  // Checks _FusedMatMul on a [m, k] by [k, n] product against a plain loop.
+  void CheckMatMul(int64 m, int64 k, int64 n, bool transpose_a,
+                   bool transpose_b, const string& activation) {
+    inputs_.clear();
+    TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedMatMul")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("transpose_a", transpose_a)
+                     .Attr("transpose_b", transpose_b)
+                     .Attr("activation", activation)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    const Tensor a = Values(m, k, 1);
+    const Tensor b = Values(k, n, 2);
+    const Tensor bias = Values(1, n, 3);
+    AddInput(transpose_a ? TensorShape({k, m}) : a.shape(),
+             transpose_a ? Transpose(a) : a);
+    AddInput(transpose_b ? TensorShape({n, k}) : b.shape(),
+             transpose_b ? Transpose(b) : b);
+    AddInput(TensorShape({n}), bias);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({m, n}));
+    for (int64 i = 0; i < m; ++i) {
+      for (int64 j = 0; j < n; ++j) {
+        float sum = bias.flat<float>()(j);
+        for (int64 l = 0; l < k; ++l) {
+          sum += a.matrix<float>()(i, l) * b.matrix<float>()(l, j);
+        }
+        if (activation == "Relu" && sum < 0) sum = 0;
+        expected.matrix<float>()(i, j) = sum;
+      }
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-3);
+  }
+
+  // Checks _FusedConv2D against Conv2D, with the bias added in a loop.
+  void CheckConv2D(int batch, int rows, int cols, int in_depth, int filter_size,
+                   int out_depth, int stride, const string& padding,
+                   const string& activation) {
+    const Tensor input = Values(batch * rows * cols, in_depth, 1);
+    const Tensor filter = Values(filter_size * filter_size * in_depth,
+                                 out_depth, 2);
+    const Tensor bias = Values(1, out_depth, 3);
+    const TensorShape input_shape({batch, rows, cols, in_depth});
+    const TensorShape filter_shape(
+        {filter_size, filter_size, in_depth, out_depth});
+
+    inputs_.clear();
+    TF_ASSERT_OK(NodeDefBuilder("conv", "Conv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", padding)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInput(input_shape, input);
+    AddInput(filter_shape, filter);
+    TF_ASSERT_OK(RunOpKernel());
+    Tensor expected = *GetOutput(0);
+    auto out = expected.flat_inner_dims<float>();
+    for (int64 i = 0; i < out.dimension(0); ++i) {
+      for (int64 j = 0; j < out_depth; ++j) {
+        out(i, j) += bias.flat<float>()(j);
+        if (activation == "Relu" && out(i, j) < 0) out(i, j) = 0;
+      }
+    }
+
+    inputs_.clear();
+    TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedConv2D")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("strides", {1, stride, stride, 1})
+                     .Attr("padding", padding)
+                     .Attr("activation", activation)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    AddInput(input_shape, input);
+    AddInput(filter_shape, filter);
+    AddInput(TensorShape({out_depth}), bias);
+    TF_ASSERT_OK(RunOpKernel());
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-3);
+  }
+
+  // Checks _FusedGather of the rows "indices" of a [rows, cols, depth] params
+  // against a plain loop.
+  void CheckGather(int64 rows, int64 cols, int64 depth,
+                   const std::vector<int64>& indices,
+                   const string& activation) {
+    inputs_.clear();
+    TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedGather")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT64))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("activation", activation)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+    const Tensor params = Values(rows, cols * depth, 1);
+    const Tensor bias = Values(1, depth, 3);
+    AddInput(TensorShape({rows, cols, depth}), params);
+    const int64 n = indices.size();
+    AddInputFromArray<int64>(TensorShape({n}), indices);
+    AddInput(TensorShape({depth}), bias);
+    TF_ASSERT_OK(RunOpKernel());
+
+    Tensor expected(DT_FLOAT, TensorShape({n, cols, depth}));
+    auto out = expected.tensor<float, 3>();
+    for (int64 i = 0; i < n; ++i) {
+      for (int64 j = 0; j < cols; ++j) {
+        for (int64 d = 0; d < depth; ++d) {
+          float value = params.matrix<float>()(indices[i], j * depth + d) +
+                        bias.flat<float>()(d);
+          if (activation == "Relu" && value < 0) value = 0;
+          out(i, j, d) = value;
+        }
+      }
+    }
+    test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(FusedOpsTest, MatMulSmall) {
+  CheckMatMul(3, 4, 5, false, false, "None");
+  CheckMatMul(3, 4, 5, false, false, "Relu");
+}
+
+TEST_F(FusedOpsTest, MatMulBlocked) {
+  // Enough rows for every thread to compute blocks, with a partial last one.
+  CheckMatMul(1100, 8, 1024, false, false, "Relu");
+  CheckMatMul(1100, 8, 1024, true, false, "Relu");
+  CheckMatMul(1100, 8, 1024, false, true, "None");
+}
+
+TEST_F(FusedOpsTest, MatMulEmptyInnerDimension) {
+  // The product is all zeros, so the output is the activated bias.
+  CheckMatMul(3, 0, 5, false, false, "Relu");
+}
+
+TEST_F(FusedOpsTest, MatMulBadBias) {
+  TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedMatMul")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("Bias must be a vector"))
+      << s;
+}
+
+TEST_F(FusedOpsTest, Conv2D1x1) {
+  CheckConv2D(2, 5, 7, 3, 1, 4, 1, "SAME", "Relu");
+  // Large enough to be computed by blocks.
+  CheckConv2D(4, 16, 17, 8, 1, 1024, 1, "VALID", "Relu");
+}
+
+TEST_F(FusedOpsTest, Conv2DSpatial) {
+  CheckConv2D(2, 5, 7, 3, 3, 4, 1, "SAME", "Relu");
+  CheckConv2D(1, 9, 9, 2, 3, 5, 2, "VALID", "None");
+}
+
+TEST_F(FusedOpsTest, GatherRows) {
+  CheckGather(7, 1, 5, {3, 0, 6, 3}, "None");
+  CheckGather(7, 1, 5, {3, 0, 6, 3}, "Relu");
+  // The bias is added to each of the rows of a gathered slice.
+  CheckGather(4, 3, 2, {2, 1}, "Relu");
+  // Enough indices to be sharded across the threads.
+  std::vector<int64> indices;
+  for (int64 i = 0; i < 5000; ++i) indices.push_back((i * 31) % 100);
+  CheckGather(100, 1, 16, indices, "Relu");
+}
+
+TEST_F(FusedOpsTest, GatherScalarRows) {
+  // With 1-D params, the bias is added along the last dimension of the
+  // indices.
+  TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedGather")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Attr("activation", "Relu")
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({5}), {1, -2, 3, -4, 5});
+  AddInputFromArray<int32>(TensorShape({2, 3}), {0, 1, 2, 4, 3, 0});
+  AddInputFromArray<float>(TensorShape({3}), {10, 1, -4});
+  TF_ASSERT_OK(RunOpKernel());
+  Tensor expected(DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected, {11, 0, 0, 15, 0, 0});
+  test::ExpectTensorEqual<float>(expected, *GetOutput(0));
+}
+
+TEST_F(FusedOpsTest, GatherBadIndex) {
+  TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedGather")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({3}), {0, 2, 1});
+  AddInputFromArray<float>(TensorShape({2}), {1, 2});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("indices[1] = 2 is not in"))
+      << s;
+}
+
+TEST_F(FusedOpsTest, GatherBadBias) {
+  TF_ASSERT_OK(NodeDefBuilder("fused", "_FusedGather")
+                   .Input(FakeInput(DT_FLOAT))
+                   .Input(FakeInput(DT_INT32))
+                   .Input(FakeInput(DT_FLOAT))
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({1}), {1});
+  AddInputFromArray<float>(TensorShape({3}), {1, 2, 3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(
+      StringPiece(s.ToString()).contains("Must provide as many biases"))
+      << s;
+}
+
+// MatMul, BiasAdd and Relu, either as three ops or fused.
+static Graph* MatMulBiasRelu(int m, int k, int n, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor a(DT_FLOAT, TensorShape({m, k}));
+  a.flat<float>().setRandom();
+  Tensor b(DT_FLOAT, TensorShape({k, n}));
+  b.flat<float>().setRandom();
+  Tensor bias(DT_FLOAT, TensorShape({n}));
+  bias.flat<float>().setRandom();
+  Node* a_node = test::graph::Constant(g, a);
+  Node* b_node = test::graph::Constant(g, b);
+  Node* bias_node = test::graph::Constant(g, bias);
+  Node* ret;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedMatMul")
+                    .Input(a_node)
+                    .Input(b_node)
+                    .Input(bias_node)
+                    .Attr("activation", "Relu")
+                    .Finalize(g, &ret));
+  } else {
+    Node* matmul = test::graph::Matmul(g, a_node, b_node, false, false);
+    Node* bias_add;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "BiasAdd")
+                    .Input(matmul)
+                    .Input(bias_node)
+                    .Finalize(g, &bias_add));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Relu")
+                    .Input(bias_add)
+                    .Finalize(g, &ret));
+  }
+  return g;
+}
+
+#define BM_MatMulBiasRelu(M, K, N, FUSED)                                   \
+  static void BM_MatMulBiasRelu_##M##_##K##_##N##_##FUSED(int iters) {      \
+    testing::ItemsProcessed(static_cast<int64>(iters) * M * K * N * 2);     \
+    test::Benchmark("cpu", MatMulBiasRelu(M, K, N, FUSED)).Run(iters);      \
+  }                                                                         \
+  BENCHMARK(BM_MatMulBiasRelu_##M##_##K##_##N##_##FUSED);
+
+BM_MatMulBiasRelu(128, 512, 512, false);
+BM_MatMulBiasRelu(128, 512, 512, true);
+BM_MatMulBiasRelu(1024, 1024, 1024, false);
+BM_MatMulBiasRelu(1024, 1024, 1024, true);
+BM_MatMulBiasRelu(4096, 256, 256, false);
+BM_MatMulBiasRelu(4096, 256, 256, true);
+
+// Gather, BiasAdd and Relu of "n" random rows of a [rows, depth] table,
+// either as three ops or fused.
+static Graph* GatherBiasRelu(int rows, int depth, int n, bool fused) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor params(DT_FLOAT, TensorShape({rows, depth}));
+  params.flat<float>().setRandom();
+  Tensor indices(DT_INT32, TensorShape({n}));
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int i = 0; i < n; ++i) indices.flat<int32>()(i) = rnd.Uniform(rows);
+  Tensor bias(DT_FLOAT, TensorShape({depth}));
+  bias.flat<float>().setRandom();
+  Node* params_node = test::graph::Constant(g, params);
+  Node* indices_node = test::graph::Constant(g, indices);
+  Node* bias_node = test::graph::Constant(g, bias);
+  Node* ret;
+  if (fused) {
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "_FusedGather")
+                    .Input(params_node)
+                    .Input(indices_node)
+                    .Input(bias_node)
+                    .Attr("activation", "Relu")
+                    .Finalize(g, &ret));
+  } else {
+    Node* gather = test::graph::Gather(g, params_node, indices_node);
+    Node* bias_add;
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "BiasAdd")
+                    .Input(gather)
+                    .Input(bias_node)
+                    .Finalize(g, &bias_add));
+    TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Relu")
+                    .Input(bias_add)
+                    .Finalize(g, &ret));
+  }
+  return g;
+}
+
+#define BM_GatherBiasRelu(ROWS, DEPTH, N, FUSED)                           \
+  static void BM_GatherBiasRelu_##ROWS##_##DEPTH##_##N##_##FUSED(          \
+      int iters) {                                                          \
+    testing::BytesProcessed(static_cast<int64>(iters) * N * DEPTH *         \
+                            sizeof(float));                                 \
+    test::Benchmark("cpu", GatherBiasRelu(ROWS, DEPTH, N, FUSED))           \
+        .Run(iters);                                                        \
+  }                                                                         \
+  BENCHMARK(BM_GatherBiasRelu_##ROWS##_##DEPTH##_##N##_##FUSED);
+
+BM_GatherBiasRelu(100000, 64, 4096, false);
+BM_GatherBiasRelu(100000, 64, 4096, true);
+BM_GatherBiasRelu(10000, 512, 1024, false);
+BM_GatherBiasRelu(10000, 512, 1024, true);
+
+}  // namespace
+}  // namespace tensorflow
@@ -0,0 +1,159 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_MPMC_RING_BUFFER_H_
+#define TENSORFLOW_KERNELS_MPMC_RING_BUFFER_H_
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+
+// A bounded multi-producer multi-consumer FIFO ring buffer that does not
+// take any locks.  Each slot carries a sequence number, which tells a
+// producer whether the slot is free for the lap it is on, and a consumer
+// whether the slot has been filled in that lap; producers and consumers
+// then only contend on a compare-and-swap of the position they claim.
+// For position p, the sequence number of its slot is 2 * p while the slot
+// is free and 2 * p + 1 once it is filled, which keeps the two states
+// apart even when the capacity is 1.
+//
+// TryPush() and TryPop() never block: they fail if the buffer is full or
+// empty, respectively.  A push or pop that has claimed a slot but not yet
+// filled or emptied it makes the buffer look full or empty to the others
+// until it finishes, even if size() says otherwise.
+//
+// T must be default constructible and move assignable.
+template <typename T>
+class MPMCRingBuffer {
+ public:
+  explicit MPMCRingBuffer(int64 capacity)
+      : capacity_(capacity), slots_(new Slot[capacity]) {
+    CHECK_GT(capacity, 0);
+    for (int64 i = 0; i < capacity; ++i) {
+      slots_[i].sequence.store(2 * i, std::memory_order_relaxed);
+    }
+  }
+
+  int64 capacity() const { return capacity_; }
+
+  // Moves *value to the back of the buffer and returns true, or returns
+  // false if the buffer is full, or if it was closed and "even_if_closed"
+  // is false.  *value is left untouched if this returns false.
+  bool TryPush(T* value, bool even_if_closed = false) {
+    int64 pos = push_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      if ((pos & kClosedBit) && !even_if_closed) return false;
+      const int64 index = pos & ~kClosedBit;
+      slot = &slots_[index % capacity_];
+      const int64 diff =
+          slot->sequence.load(std::memory_order_acquire) - 2 * index;
+      if (diff == 0) {
+        // The slot is free: claim it, preserving the closed bit.
+        if (push_pos_.compare_exchange_weak(pos, pos + 1,
+                                            std::memory_order_relaxed)) {
+          pos = index;
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // Full: the slot is still held from the previous lap.
+      } else {
+        pos = push_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(*value);
+    slot->sequence.store(2 * pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Moves the front of the buffer into *value and returns true, or returns
+  // false if the buffer is empty.
+  bool TryPop(T* value) {
+    int64 pos = pop_pos_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[pos % capacity_];
+      const int64 diff =
+          slot->sequence.load(std::memory_order_acquire) - (2 * pos + 1);
+      if (diff == 0) {
+        if (pop_pos_.compare_exchange_weak(pos, pos + 1,
+                                           std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;  // Empty: the slot has not been filled in this lap.
+      } else {
+        pos = pop_pos_.load(std::memory_order_relaxed);
+      }
+    }
+    *value = std::move(slot->value);
+    slot->value = T();
+    slot->sequence.store(2 * (pos + capacity_), std::memory_order_release);
+    return true;
+  }
+
+  // Makes TryPush() fail from now on unless it is called with
+  // "even_if_closed".  Pushes that claimed a slot before the call still
+  // complete, and the elements in the buffer can still be popped.
+  void Close() { push_pos_.fetch_or(kClosedBit, std::memory_order_relaxed); }
+
+  // The number of pushes and pops that have claimed a slot so far.
+  int64 num_pushed() const {
+    return push_pos_.load(std::memory_order_relaxed) & ~kClosedBit;
+  }
+  int64 num_popped() const { return pop_pos_.load(std::memory_order_relaxed); }
+
+  // The number of elements in the buffer, which is only a snapshot if
+  // other threads are pushing or popping.
+  int64 size() const {
+    const int64 popped = num_popped();
+    const int64 size = num_pushed() - popped;
+    if (size < 0) return 0;
+    return size > capacity_ ? capacity_ : size;
+  }
+
+ private:
+  static const int64 kClosedBit = int64{1} << 62;
+
+  // Slots are padded to a cache line so that threads working on adjacent
+  // slots do not invalidate each other's caches.
+  struct Slot {
+    std::atomic<int64> sequence;
+    T value;
+    char padding[64 > sizeof(std::atomic<int64>) + sizeof(T)
+                     ? 64 - sizeof(std::atomic<int64>) - sizeof(T)
+                     : 1];
+  };
+
+  const int64 capacity_;
+  std::unique_ptr<Slot[]> slots_;
+  char padding0_[64];
+  std::atomic<int64> push_pos_{0};
+  char padding1_[64];
+  std::atomic<int64> pop_pos_{0};
+  char padding2_[64];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(MPMCRingBuffer);
+};
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_MPMC_RING_BUFFER_H_
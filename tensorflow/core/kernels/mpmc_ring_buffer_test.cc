@@ -0,0 +1,128 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/mpmc_ring_buffer.h"
+
+#include <thread>
+#include <vector>
+
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+TEST(MPMCRingBufferTest, PushAndPop) {
+  MPMCRingBuffer<int> ring(3);
+  int value = 0;
+  EXPECT_FALSE(ring.TryPop(&value));
+
+  // Go around the ring a few times.
+  for (int lap = 0; lap < 3; ++lap) {
+    for (int i = 0; i < 3; ++i) {
+      value = lap * 10 + i;
+      EXPECT_TRUE(ring.TryPush(&value));
+    }
+    value = -1;
+    EXPECT_FALSE(ring.TryPush(&value));
+    EXPECT_EQ(-1, value);
+    EXPECT_EQ(3, ring.size());
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_TRUE(ring.TryPop(&value));
+      EXPECT_EQ(lap * 10 + i, value);
+    }
+    EXPECT_FALSE(ring.TryPop(&value));
+    EXPECT_EQ(0, ring.size());
+  }
+  EXPECT_EQ(9, ring.num_pushed());
+  EXPECT_EQ(9, ring.num_popped());
+}
+
+TEST(MPMCRingBufferTest, CapacityOne) {
+  MPMCRingBuffer<int> ring(1);
+  for (int i = 0; i < 3; ++i) {
+    int value = i;
+    EXPECT_TRUE(ring.TryPush(&value));
+    EXPECT_FALSE(ring.TryPush(&value));
+    EXPECT_TRUE(ring.TryPop(&value));
+    EXPECT_EQ(i, value);
+    EXPECT_FALSE(ring.TryPop(&value));
+  }
+}
+
+TEST(MPMCRingBufferTest, Close) {
+  MPMCRingBuffer<int> ring(2);
+  int value = 1;
+  EXPECT_TRUE(ring.TryPush(&value));
+  ring.Close();
+  value = 2;
+  EXPECT_FALSE(ring.TryPush(&value));
+  EXPECT_TRUE(ring.TryPush(&value, true /* even_if_closed */));
+  EXPECT_EQ(2, ring.num_pushed());
+  EXPECT_TRUE(ring.TryPop(&value));
+  EXPECT_EQ(1, value);
+  EXPECT_TRUE(ring.TryPop(&value));
+  EXPECT_EQ(2, value);
+  EXPECT_FALSE(ring.TryPop(&value));
+}
+
+TEST(MPMCRingBufferTest, ConcurrentProducersAndConsumers) {
+  const int kProducers = 4;
+  const int kConsumers = 4;
+  const int kPerProducer = 5000;
+  MPMCRingBuffer<int> ring(16);
+
+  mutex mu;
+  std::vector<int> seen(kProducers * kPerProducer, 0);
+  {
+    thread::ThreadPool pool(Env::Default(), "test", kProducers + kConsumers);
+    for (int p = 0; p < kProducers; ++p) {
+      pool.Schedule([&ring, p]() {
+        for (int i = 0; i < kPerProducer; ++i) {
+          int value = p * kPerProducer + i;
+          while (!ring.TryPush(&value)) {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+    for (int c = 0; c < kConsumers; ++c) {
+      pool.Schedule([&ring, &mu, &seen]() {
+        // The elements of each producer must come out in order.
+        std::vector<int> last(kProducers, -1);
+        for (int i = 0; i < kProducers * kPerProducer / kConsumers; ++i) {
+          int value;
+          while (!ring.TryPop(&value)) {
+            std::this_thread::yield();
+          }
+          const int producer = value / kPerProducer;
+          EXPECT_LT(last[producer], value);
+          last[producer] = value;
+          mutex_lock l(mu);
+          ++seen[value];
+        }
+      });
+    }
+  }
+  for (int i = 0; i < kProducers * kPerProducer; ++i) {
+    ASSERT_EQ(1, seen[i]) << i;
+  }
+  EXPECT_EQ(0, ring.size());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -269,6 +269,21 @@ BM_ConvFloatFwd(32, 73, 73, 64, 192, 3, 3, 1, VALID, conv52);
 BM_ConvFloatFwd(32, 73, 73, 64, 64, 1, 1, 1, VALID, conv53);
 BM_ConvFloatFwd(32, 147, 147, 24, 64, 1, 1, 1, VALID, conv54);
 
+// First layers on RGB images, and single images, for which the CPU picks
+// among several algorithms.
+BM_ConvFloatFwd(8, 224, 224, 3, 64, 7, 7, 2, SAME, conv55);
+BM_ConvFloatFwd(8, 112, 112, 3, 32, 3, 3, 1, SAME, conv56);
+BM_ConvFloatFwd(1, 35, 35, 64, 96, 3, 3, 1, SAME, conv57);
+BM_ConvFloatFwd(1, 17, 17, 128, 192, 1, 7, 1, SAME, conv58);
+BM_ConvFloatFwd(1, 56, 56, 64, 64, 1, 1, 1, SAME, conv59);
+
+// 3x3 filters with stride 1, which the CPU can compute with Winograd's
+// minimal filtering.
+BM_ConvFloatFwd(1, 56, 56, 64, 64, 3, 3, 1, SAME, conv60);
+BM_ConvFloatFwd(8, 28, 28, 256, 256, 3, 3, 1, SAME, conv61);
+BM_ConvFloatFwd(32, 14, 14, 512, 512, 3, 3, 1, SAME, conv62);
+BM_ConvFloatFwd(32, 17, 17, 128, 128, 3, 3, 1, VALID, conv63);
+
 #define BM_ConvFloatBkInAndFilter(BS, R, C, ID, OD, KR, KC, STR, PAD, LABEL)  \
   static void BM_ConvFloatBkInCPU1_##LABEL(int iters) {                       \
     BM_ConvFloat(iters, BS, R, C, ID, OD, KR, KC, CONV_OP_BACKPROP_INPUT, 1,  \
@@ -18,6 +18,7 @@ limitations under the License.
 #include <vector>
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 
@@ -71,7 +72,8 @@ QueueBase::QueueBase(int32 capacity, const DataTypeVector& component_dtypes,
       component_dtypes_(component_dtypes),
       component_shapes_(component_shapes),
       name_(name),
-      closed_(false) {}
+      closed_(false),
+      last_stats_micros_(Env::Default()->NowMicros()) {}
 
 QueueBase::~QueueBase() {}
 
@@ -315,6 +317,7 @@ bool QueueBase::TryAttemptLocked(Action action,
           break;
         case kComplete:
           progress = true;
+          RecordAttemptLocked(action, *cur_attempt);
           clean_up->emplace_back(std::move(cur_attempt->done_callback),
                                  cur_attempt->cancellation_token,
                                  cur_attempt->context->cancellation_manager());
@@ -326,6 +329,69 @@ bool QueueBase::TryAttemptLocked(Action action,
   return progress;
 }
 
+void QueueBase::RecordAttemptLocked(Action action, const Attempt& attempt) {
+  // Close() runs as an enqueue attempt of no elements.
+  if (attempt.elements_total == 0 || !attempt.context->status().ok()) return;
+  const int64 elements = attempt.elements_total - attempt.elements_requested;
+  const int64 wait_usecs = Env::Default()->NowMicros() - attempt.start_micros;
+  if (action == kEnqueue) {
+    num_enqueued_ += elements;
+    enqueue_wait_usecs_.Add(wait_usecs);
+  } else {
+    num_dequeued_ += elements;
+    dequeue_wait_usecs_.Add(wait_usecs);
+  }
+  const int32 size = SizeLocked();
+  occupancy_.Add(size);
+  AnnotateStats(attempt.context, action, elements, wait_usecs, size);
+}
+
+void QueueBase::AnnotateStats(OpKernelContext* ctx, Action action,
+                              int64 elements, int64 wait_usecs, int32 size) {
+  if (!ctx->collect_stats()) return;
+  ctx->set_stats_annotation(strings::StrCat(
+      "[", action == kEnqueue ? "enqueued " : "dequeued ", elements,
+      " after waiting ", wait_usecs, "us, queue size ", size, "]"));
+}
+
+Status QueueBase::GetStats(Summary* summary) {
+  mutex_lock lock(mu_);
+  const string prefix = strings::StrCat("queue/", name_, "/");
+  auto add_value = [summary, &prefix](const string& tag, double value) {
+    Summary::Value* v = summary->add_value();
+    v->set_tag(strings::StrCat(prefix, tag));
+    v->set_simple_value(value);
+  };
+  auto add_histogram = [summary, &prefix, &add_value](
+      const string& tag, const histogram::Histogram& histogram) {
+    Summary::Value* v = summary->add_value();
+    v->set_tag(strings::StrCat(prefix, tag));
+    histogram.EncodeToProto(v->mutable_histo(),
+                            false /* Drop zero buckets */);
+    add_value(strings::StrCat(tag, "/mean"), histogram.Average());
+    add_value(strings::StrCat(tag, "/p50"), histogram.Median());
+    add_value(strings::StrCat(tag, "/p99"), histogram.Percentile(99));
+  };
+
+  // Rates are over the time since the previous call, counts are totals.
+  const int64 now_micros = Env::Default()->NowMicros();
+  const double seconds = (now_micros - last_stats_micros_) / 1e6;
+  add_value("size", SizeLocked());
+  add_value("enqueued", num_enqueued_);
+  add_value("dequeued", num_dequeued_);
+  if (seconds > 0) {
+    add_value("enqueue_rate", (num_enqueued_ - last_num_enqueued_) / seconds);
+    add_value("dequeue_rate", (num_dequeued_ - last_num_dequeued_) / seconds);
+  }
+  add_histogram("enqueue_wait_usecs", enqueue_wait_usecs_);
+  add_histogram("dequeue_wait_usecs", dequeue_wait_usecs_);
+  add_histogram("occupancy", occupancy_);
+  last_stats_micros_ = now_micros;
+  last_num_enqueued_ = num_enqueued_;
+  last_num_dequeued_ = num_dequeued_;
+  return Status::OK();
+}
+
 void QueueBase::FlushUnlocked() {
   std::vector<CleanUp> clean_up;
   Ref();
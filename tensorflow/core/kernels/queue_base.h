@@ -21,10 +21,13 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/queue_interface.h"
+#include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/lib/histogram/histogram.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
@@ -62,6 +65,13 @@ class QueueBase : public QueueInterface {
   void Close(OpKernelContext* ctx, bool cancel_pending_enqueues,
              DoneCallback callback) override;
 
+  int32 size() override {
+    mutex_lock lock(mu_);
+    return SizeLocked();
+  }
+
+  Status GetStats(Summary* summary) override;
+
   // Other public methods -----------------------------------------------------
   const std::vector<TensorShape>& component_shapes() const {
     return component_shapes_;
@@ -99,6 +109,9 @@ class QueueBase : public QueueInterface {
     CancellationManager* cm;
   };
 
+  // Returns the number of elements in the queue.
+  virtual int32 SizeLocked() EXCLUSIVE_LOCKS_REQUIRED(mu_) = 0;
+
   // Returns the number of components in a queue-element tuple.
   int32 num_components() const { return component_dtypes_.size(); }
 
@@ -125,6 +138,18 @@ class QueueBase : public QueueInterface {
   bool TryAttemptLocked(Action action, std::vector<CleanUp>* clean_up)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
 
+  struct Attempt;
+  // Updates the statistics of the queue for an attempt that completed, and
+  // annotates the step stats of its op with how long it waited.
+  void RecordAttemptLocked(Action action, const Attempt& attempt)
+      EXCLUSIVE_LOCKS_REQUIRED(mu_);
+
+  // Annotates the step stats of the op of "ctx", if they are collected, with
+  // an operation that moved "elements" elements after waiting "wait_usecs",
+  // leaving "size" elements in the queue.
+  static void AnnotateStats(OpKernelContext* ctx, Action action,
+                            int64 elements, int64 wait_usecs, int32 size);
+
   // Tries to make progress on the enqueues or dequeues at the front
   // of the *_attempts_ queues.
   void FlushUnlocked();
@@ -146,10 +171,11 @@ class QueueBase : public QueueInterface {
   mutex mu_;
   bool closed_ GUARDED_BY(mu_);
 
-  struct Attempt;
   typedef std::function<RunResult(Attempt*)> RunCallback;
   struct Attempt {
     int32 elements_requested;
+    int32 elements_total;  // The value of elements_requested when created.
+    int64 start_micros;
     DoneCallback done_callback;  // must be run outside mu_
     OpKernelContext* context;
     CancellationManager* cancellation_manager;  // not owned
@@ -164,6 +190,8 @@ class QueueBase : public QueueInterface {
             OpKernelContext* context, CancellationManager* cancellation_manager,
             CancellationToken cancellation_token, RunCallback run_callback)
         : elements_requested(elements_requested),
+          elements_total(elements_requested),
+          start_micros(Env::Default()->NowMicros()),
           done_callback(done_callback),
           context(context),
           cancellation_manager(cancellation_manager),
@@ -174,6 +202,20 @@ class QueueBase : public QueueInterface {
   std::deque<Attempt> enqueue_attempts_ GUARDED_BY(mu_);
   std::deque<Attempt> dequeue_attempts_ GUARDED_BY(mu_);
 
+  // Statistics reported by GetStats().  Only attempts that complete
+  // successfully are counted.
+  int64 num_enqueued_ GUARDED_BY(mu_) = 0;
+  int64 num_dequeued_ GUARDED_BY(mu_) = 0;
+  // How long enqueue and dequeue attempts waited before they completed.
+  histogram::Histogram enqueue_wait_usecs_ GUARDED_BY(mu_);
+  histogram::Histogram dequeue_wait_usecs_ GUARDED_BY(mu_);
+  // The number of elements in the queue after each enqueue or dequeue.
+  histogram::Histogram occupancy_ GUARDED_BY(mu_);
+  // The state as of the previous GetStats() call, to compute rates.
+  int64 last_stats_micros_ GUARDED_BY(mu_);
+  int64 last_num_enqueued_ GUARDED_BY(mu_) = 0;
+  int64 last_num_dequeued_ GUARDED_BY(mu_) = 0;
+
   TF_DISALLOW_COPY_AND_ASSIGN(QueueBase);
 };
 
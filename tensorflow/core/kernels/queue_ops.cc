@@ -17,6 +17,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/queue_interface.h"
+#include "tensorflow/core/framework/summary.pb.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/types.h"
@@ -380,4 +381,33 @@ class QueueSizeOp : public QueueOpKernel {
 
 REGISTER_KERNEL_BUILDER(Name("QueueSize").Device(DEVICE_CPU), QueueSizeOp);
 
+// Defines a QueueStatsOp, which emits a Summary protocol buffer with
+// statistics about the given Queue.
+//
+// The op has one input, which is the handle of the appropriate Queue;
+// and one output, a scalar string tensor with the serialized Summary.
+class QueueStatsOp : public QueueOpKernel {
+ public:
+  explicit QueueStatsOp(OpKernelConstruction* context)
+      : QueueOpKernel(context) {}
+
+ protected:
+  void ComputeAsync(OpKernelContext* ctx, QueueInterface* queue,
+                    DoneCallback callback) override {
+    Summary s;
+    OP_REQUIRES_OK_ASYNC(ctx, queue->GetStats(&s), callback);
+    Tensor* summary_tensor = nullptr;
+    OP_REQUIRES_OK_ASYNC(
+        ctx, ctx->allocate_output(0, TensorShape({}), &summary_tensor),
+        callback);
+    CHECK(s.SerializeToString(&summary_tensor->scalar<string>()()));
+    callback();
+  }
+
+ private:
+  TF_DISALLOW_COPY_AND_ASSIGN(QueueStatsOp);
+};
+
+REGISTER_KERNEL_BUILDER(Name("QueueStats").Device(DEVICE_CPU), QueueStatsOp);
+
 }  // namespace tensorflow
@@ -57,14 +57,11 @@ class RandomShuffleQueue : public TypedQueue<std::vector<PersistentTensor> > {
                       CallbackWithTuple callback) override;
   Status MatchesNodeDef(const NodeDef& node_def) override;
 
-  int32 size() override {
-    mutex_lock lock(mu_);
-    return queues_[0].size();
-  }
-
  private:
   ~RandomShuffleQueue() override {}
 
+  int32 SizeLocked() override { return queues_[0].size(); }
+
   // Helper for dequeuing a single random element from queues_.
   void DequeueLocked(OpKernelContext* ctx, Tuple* tuple)
       EXCLUSIVE_LOCKS_REQUIRED(mu_);
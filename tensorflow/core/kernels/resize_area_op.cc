@@ -18,6 +18,7 @@ limitations under the License.
 
 #include <algorithm>
 #include <memory>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -27,11 +28,49 @@ limitations under the License.
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+namespace {
+
+// The input rows (or columns) that cover each output row (or column), as
+// offsets into the input clamped to the image, with the fraction of each of
+// them that lies within the output row.
+struct CachedSpans {
+  // The input rows of output row i are those in [starts[i], starts[i + 1]).
+  std::vector<int64> starts;
+  std::vector<int64> offsets;
+  std::vector<float> weights;
+};
+
+// Computes the spans of the "out_size" output positions along a dimension of
+// "in_size" input positions, whose offsets are "stride" apart.
+void ComputeSpans(int64 out_size, int64 in_size, float scale, int64 stride,
+                  CachedSpans* spans) {
+  spans->starts.resize(out_size + 1);
+  for (int64 i = 0; i < out_size; ++i) {
+    spans->starts[i] = spans->offsets.size();
+    const float in = i * scale;
+    const float in1 = (i + 1) * scale;
+    // The start and end indices of all the cells that could contribute to the
+    // target cell.
+    const int64 start = floor(in);
+    const int64 end = ceil(in1);
+    for (int64 j = start; j < end; ++j) {
+      spans->offsets.push_back(
+          std::min(in_size - 1, std::max<int64>(0, j)) * stride);
+      spans->weights.push_back(
+          j < in ? j + 1 - in : (j + 1 > in1 ? in1 - j : 1.0f));
+    }
+  }
+  spans->starts[out_size] = spans->offsets.size();
+}
+
+}  // namespace
+
 template <typename Device, typename T>
 class ResizeAreaOp : public OpKernel {
  public:
@@ -46,17 +85,6 @@ class ResizeAreaOp : public OpKernel {
 
     if (!context->status().ok()) return;
 
-    typename TTypes<T, 4>::ConstTensor input_data = input.tensor<T, 4>();
-    typename TTypes<float, 4>::Tensor output_data =
-        st.output->tensor<float, 4>();
-
-    // A temporary tensor for computing the sum.
-    Tensor sum_tensor;
-    OP_REQUIRES_OK(context, context->allocate_temp(DataTypeToEnum<float>::value,
-                                                   TensorShape({st.channels}),
-                                                   &sum_tensor));
-    typename TTypes<float, 1>::Tensor sum_data = sum_tensor.vec<float>();
-
     // When using this algorithm for downsizing, the target pixel value is the
     // weighted average of all the source pixels. The weight is determined by
     // the contribution percentage of the source pixel.
@@ -76,46 +104,49 @@ class ResizeAreaOp : public OpKernel {
     //   out[0] = (in[0] * 1.0 + in[1] * 1/3) * scale
     //   out[1] = (in[1] * 2/3 + in[2] * 2/3 * scale
     //   out[2] = (in[3] * 1/3 + in[3] * 1.0) * scale
-    float scale = 1.0 / (st.height_scale * st.width_scale);
-    for (int64 b = 0; b < st.batch_size; ++b) {
-      for (int64 y = 0; y < st.out_height; ++y) {
-        const float in_y = y * st.height_scale;
-        const float in_y1 = (y + 1) * st.height_scale;
-        // The start and end height indices of all the cells that could
-        // contribute to the target cell.
-        int64 y_start = floor(in_y);
-        int64 y_end = ceil(in_y1);
-
-        for (int64 x = 0; x < st.out_width; ++x) {
-          const float in_x = x * st.width_scale;
-          const float in_x1 = (x + 1) * st.width_scale;
-          // The start and end width indices of all the cells that could
-          // contribute to the target cell.
-          int64 x_start = floor(in_x);
-          int64 x_end = ceil(in_x1);
-
-          sum_data.setConstant(0.0);
-          for (int64 i = y_start; i < y_end; ++i) {
-            float scale_y =
-                i < in_y ? i + 1 - in_y : (i + 1 > in_y1 ? in_y1 - i : 1.0);
-            for (int64 j = x_start; j < x_end; ++j) {
-              float scale_x =
-                  j < in_x ? j + 1 - in_x : (j + 1 > in_x1 ? in_x1 - j : 1.0);
-              for (int64 c = 0; c < st.channels; ++c) {
-#define BOUND(val, limit) std::min(((limit)-1ll), (std::max(0ll, (val))))
-                sum_data(c) += float(input_data(b, BOUND(i, st.in_height),
-                                                BOUND(j, st.in_width), c)) *
-                               scale_y * scale_x * scale;
-#undef BOUND
+    const float scale = 1.0 / (st.height_scale * st.width_scale);
+    const int64 channels = st.channels;
+    const int64 in_row_size = st.in_width * channels;
+    const int64 in_batch_size = st.in_height * in_row_size;
+    const int64 out_row_size = st.out_width * channels;
+    CachedSpans ys;
+    CachedSpans xs;
+    ComputeSpans(st.out_height, st.in_height, st.height_scale, in_row_size,
+                 &ys);
+    ComputeSpans(st.out_width, st.in_width, st.width_scale, channels, &xs);
+
+    const T* input_data = input.flat<T>().data();
+    float* output_data = st.output->flat<float>().data();
+
+    auto resize_rows = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 b = i / st.out_height;
+        const int64 y = i % st.out_height;
+        float* out_row = output_data + i * out_row_size;
+        std::fill(out_row, out_row + out_row_size, 0.0f);
+        for (int64 yi = ys.starts[y]; yi < ys.starts[y + 1]; ++yi) {
+          const T* in_row = input_data + b * in_batch_size + ys.offsets[yi];
+          const float scale_y = ys.weights[yi] * scale;
+          float* out = out_row;
+          for (int64 x = 0; x < st.out_width; ++x) {
+            for (int64 xi = xs.starts[x]; xi < xs.starts[x + 1]; ++xi) {
+              const T* in = in_row + xs.offsets[xi];
+              const float weight = scale_y * xs.weights[xi];
+              for (int64 c = 0; c < channels; ++c) {
+                out[c] += static_cast<float>(in[c]) * weight;
               }
             }
-          }
-          for (int64 c = 0; c < st.channels; ++c) {
-            output_data(b, y, x, c) = sum_data(c);
+            out += channels;
           }
         }
       }
-    }
+    };
+    const int64 cost_per_row = (static_cast<int64>(st.height_scale) + 2) *
+                               (static_cast<int64>(st.width_scale) + 2) *
+                               out_row_size * 2;
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          st.batch_size * st.out_height, cost_per_row, resize_rows);
   }
 
  private:
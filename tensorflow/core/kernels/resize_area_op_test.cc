@@ -0,0 +1,118 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+
+class ResizeAreaOpTest : public OpsTestBase {
+ protected:
+  ResizeAreaOpTest() {
+    TF_EXPECT_OK(NodeDefBuilder("resize_area_op", "ResizeArea")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("align_corners", false)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+TEST_F(ResizeAreaOpTest, TestArea4x4To2x2) {
+  // Each output pixel is the average of a 2x2 block.
+  AddInputFromArray<float>(TensorShape({1, 4, 4, 1}),
+                           {1, 2, 3, 4, 5, 6, 7, 8,  //
+                            9, 10, 11, 12, 13, 14, 15, 16});
+  AddInputFromArray<int32>(TensorShape({2}), {2, 2});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2, 2, 1}));
+  test::FillValues<float>(&expected, {3.5, 5.5, 11.5, 13.5});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(ResizeAreaOpTest, TestArea1x4To1x3) {
+  // out[0] = (in[0] + in[1] / 3) * 3 / 4, and so on.
+  AddInputFromArray<float>(TensorShape({1, 1, 4, 1}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({2}), {1, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 1, 3, 1}));
+  test::FillValues<float>(&expected, {1.25, 2.5, 3.75});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(ResizeAreaOpTest, TestArea2x2x2To1x1x2Batch2) {
+  // The channels and the images of the batch are averaged separately.
+  AddInputFromArray<float>(TensorShape({2, 2, 2, 2}),
+                           {1, 10, 2, 20, 3, 30, 4, 40,  //
+                            5, 50, 6, 60, 7, 70, 8, 80});
+  AddInputFromArray<int32>(TensorShape({2}), {1, 1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({2, 1, 1, 2}));
+  test::FillValues<float>(&expected, {2.5, 25, 6.5, 65});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+TEST_F(ResizeAreaOpTest, TestArea2x2To3x3) {
+  // Upsizing: output pixels falling within one input pixel copy it.
+  AddInputFromArray<float>(TensorShape({1, 2, 2, 1}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({2}), {3, 3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 3, 3, 1}));
+  test::FillValues<float>(&expected,
+                          {1, 1.5, 2, 2, 2.5, 3, 3, 3.5, 4});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+static Graph* ResizeArea(int batch_size, int size, int channels) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({batch_size, size, size, channels}));
+  input.flat<float>().setRandom();
+  Tensor shape(DT_INT32, TensorShape({2}));
+  auto shape_t = shape.flat<int32>();
+  shape_t(0) = 0.3 * size;
+  shape_t(1) = 0.7 * size;
+  test::graph::Binary(g, "ResizeArea", test::graph::Constant(g, input),
+                      test::graph::Constant(g, shape));
+  return g;
+}
+
+#define BM_ResizeAreaDev(BATCH, SIZE, CHANNELS)                               \
+  static void BM_ResizeArea##_##BATCH##_##SIZE##_##CHANNELS(int iters) {      \
+    testing::ItemsProcessed(static_cast<int64>(iters) * BATCH * SIZE * SIZE * \
+                            CHANNELS);                                        \
+    test::Benchmark("cpu", ResizeArea(BATCH, SIZE, CHANNELS)).Run(iters);     \
+  }                                                                           \
+  BENCHMARK(BM_ResizeArea##_##BATCH##_##SIZE##_##CHANNELS);
+
+BM_ResizeAreaDev(8, 32, 3);
+BM_ResizeAreaDev(8, 128, 3);
+BM_ResizeAreaDev(8, 512, 3);
+BM_ResizeAreaDev(1, 1024, 3);
+BM_ResizeAreaDev(8, 128, 1);
+BM_ResizeAreaDev(8, 128, 16);
+
+}  // namespace tensorflow
@@ -16,7 +16,9 @@ limitations under the License.
 // See docs in ../ops/image_ops.cc
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -26,11 +28,68 @@ limitations under the License.
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
 
+namespace {
+
+// The two input rows (or columns) that an output row (or column) interpolates
+// between, as offsets into the input, and the weight of the second one.
+struct CachedInterpolation {
+  int64 lower;
+  int64 upper;
+  float lerp;
+};
+
+// Computes the interpolation of each of the "out_size" output positions along
+// a dimension of "in_size" input positions, whose offsets are "stride" apart.
+void ComputeInterpolationWeights(int64 out_size, int64 in_size, float scale,
+                                 int64 stride,
+                                 std::vector<CachedInterpolation>* result) {
+  result->resize(out_size);
+  for (int64 i = 0; i < out_size; ++i) {
+    const float in = i * scale;
+    const int64 lower = static_cast<int64>(floorf(in));
+    const int64 upper = std::min(static_cast<int64>(ceilf(in)), in_size - 1);
+    (*result)[i] = {lower * stride, upper * stride, in - lower};
+  }
+}
+
+inline float ComputeLerp(float top_left, float top_right, float bottom_left,
+                         float bottom_right, float x_lerp, float y_lerp) {
+  const float top = top_left + (top_right - top_left) * x_lerp;
+  const float bottom = bottom_left + (bottom_right - bottom_left) * x_lerp;
+  return top + (bottom - top) * y_lerp;
+}
+
+// Interpolates one output row between the input rows "top" and "bottom".
+// When kChannels is positive it replaces "channels", so that the compiler
+// fully unrolls the innermost loop for the common images.
+template <typename T, int kChannels>
+void ResizeLine(const T* top, const T* bottom,
+                const std::vector<CachedInterpolation>& xs, int64 channels,
+                float y_lerp, float* out) {
+  const int64 num_channels = kChannels > 0 ? kChannels : channels;
+  for (const CachedInterpolation& x : xs) {
+    const T* top_left = top + x.lower;
+    const T* top_right = top + x.upper;
+    const T* bottom_left = bottom + x.lower;
+    const T* bottom_right = bottom + x.upper;
+    for (int64 c = 0; c < num_channels; ++c) {
+      out[c] = ComputeLerp(static_cast<float>(top_left[c]),
+                           static_cast<float>(top_right[c]),
+                           static_cast<float>(bottom_left[c]),
+                           static_cast<float>(bottom_right[c]), x.lerp, y_lerp);
+    }
+    out += num_channels;
+  }
+}
+
+}  // namespace
+
 template <typename Device, typename T>
 class ResizeBilinearOp : public OpKernel {
  public:
@@ -45,38 +104,39 @@ class ResizeBilinearOp : public OpKernel {
 
     if (!context->status().ok()) return;
 
-    typename TTypes<T, 4>::ConstTensor input_data = input.tensor<T, 4>();
-    typename TTypes<float, 4>::Tensor output_data =
-        st.output->tensor<float, 4>();
-
-    for (int b = 0; b < st.batch_size; ++b) {
-      for (int y = 0; y < st.out_height; ++y) {
-        const float in_y = y * st.height_scale;
-        const int64 top_y_index = static_cast<int64>(floorf(in_y));
-        const int64 bottom_y_index =
-            std::min(static_cast<int64>(ceilf(in_y)), (st.in_height - 1));
-        const float y_lerp = in_y - top_y_index;
-        for (int x = 0; x < st.out_width; ++x) {
-          const float in_x = x * st.width_scale;
-          const int64 left_x_index = static_cast<int64>(floorf(in_x));
-          const int64 right_x_index =
-              std::min(static_cast<int64>(ceilf(in_x)), (st.in_width - 1));
-          const float x_lerp = in_x - left_x_index;
-          for (int c = 0; c < st.channels; ++c) {
-            const float top_left(input_data(b, top_y_index, left_x_index, c));
-            const float top_right(input_data(b, top_y_index, right_x_index, c));
-            const float bottom_left(
-                input_data(b, bottom_y_index, left_x_index, c));
-            const float bottom_right(
-                input_data(b, bottom_y_index, right_x_index, c));
-            const float top = top_left + (top_right - top_left) * x_lerp;
-            const float bottom =
-                bottom_left + (bottom_right - bottom_left) * x_lerp;
-            output_data(b, y, x, c) = top + (bottom - top) * y_lerp;
-          }
+    const int64 channels = st.channels;
+    const int64 in_row_size = st.in_width * channels;
+    const int64 in_batch_size = st.in_height * in_row_size;
+    const int64 out_row_size = st.out_width * channels;
+    std::vector<CachedInterpolation> ys;
+    std::vector<CachedInterpolation> xs;
+    ComputeInterpolationWeights(st.out_height, st.in_height, st.height_scale,
+                                in_row_size, &ys);
+    ComputeInterpolationWeights(st.out_width, st.in_width, st.width_scale,
+                                channels, &xs);
+
+    const T* input_data = input.flat<T>().data();
+    float* output_data = st.output->flat<float>().data();
+
+    // Each output row only reads two input rows, so the rows of all the
+    // images are computed in parallel.
+    auto resize_rows = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 b = i / st.out_height;
+        const CachedInterpolation& y = ys[i % st.out_height];
+        const T* top = input_data + b * in_batch_size + y.lower;
+        const T* bottom = input_data + b * in_batch_size + y.upper;
+        float* out = output_data + i * out_row_size;
+        if (channels == 3) {
+          ResizeLine<T, 3>(top, bottom, xs, channels, y.lerp, out);
+        } else {
+          ResizeLine<T, 0>(top, bottom, xs, channels, y.lerp, out);
         }
       }
-    }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          st.batch_size * st.out_height, out_row_size * 10, resize_rows);
   }
 
  private:
@@ -101,11 +161,20 @@ class ResizeBilinearOpGrad : public OpKernel {
     st.ValidateAndCreateOutput(context, input, original_image);
     if (!context->status().ok()) return;
 
-    typename TTypes<float, 4>::ConstTensor input_grad =
-        input.tensor<float, 4>();
-    typename TTypes<T, 4>::Tensor output_grad = st.output->tensor<T, 4>();
-
-    output_grad.setZero();
+    const int64 channels = st.channels;
+    const int64 resized_batch_size =
+        st.resized_height * st.resized_width * channels;
+    const int64 original_row_size = st.original_width * channels;
+    const int64 original_batch_size = st.original_height * original_row_size;
+    std::vector<CachedInterpolation> ys;
+    std::vector<CachedInterpolation> xs;
+    ComputeInterpolationWeights(st.resized_height, st.original_height,
+                                st.height_scale, original_row_size, &ys);
+    ComputeInterpolationWeights(st.resized_width, st.original_width,
+                                st.width_scale, channels, &xs);
+
+    const float* input_grad = input.flat<float>().data();
+    T* output_grad = st.output->flat<T>().data();
 
     // Each resized pixel was computed as a weighted average of four input
     // pixels. Here we find the pixels that contributed to each output pixel
@@ -114,34 +183,33 @@ class ResizeBilinearOpGrad : public OpKernel {
     //                       +  top_right * (1 - y) * x
     //                       +  bottom_left * y * (1 - x)
     //                       +  bottom_right * y * x
-    for (int64 b = 0; b < st.batch_size; ++b) {
-      for (int64 y = 0; y < st.resized_height; ++y) {
-        const float in_y = y * st.height_scale;
-        const int64 top_y_index = static_cast<int>(floorf(in_y));
-        const int64 bottom_y_index =
-            std::min(static_cast<int64>(ceilf(in_y)), (st.original_height - 1));
-        const float y_lerp = in_y - top_y_index;
-        const float inverse_y_lerp = (1.0f - y_lerp);
-        for (int64 x = 0; x < st.resized_width; ++x) {
-          const float in_x = x * st.width_scale;
-          const int64 left_x_index = static_cast<int64>(floorf(in_x));
-          const int64 right_x_index = std::min(static_cast<int64>(ceilf(in_x)),
-                                               (st.original_width - 1));
-          const float x_lerp = in_x - left_x_index;
-          const float inverse_x_lerp = (1.0f - x_lerp);
-          for (int64 c = 0; c < st.channels; ++c) {
-            output_grad(b, top_y_index, left_x_index, c) +=
-                input_grad(b, y, x, c) * inverse_y_lerp * inverse_x_lerp;
-            output_grad(b, top_y_index, right_x_index, c) +=
-                input_grad(b, y, x, c) * inverse_y_lerp * x_lerp;
-            output_grad(b, bottom_y_index, left_x_index, c) +=
-                input_grad(b, y, x, c) * y_lerp * inverse_x_lerp;
-            output_grad(b, bottom_y_index, right_x_index, c) +=
-                input_grad(b, y, x, c) * y_lerp * x_lerp;
+    // Neighboring resized rows add to the same original rows, so the images
+    // of the batch are the units of parallel work.
+    auto resize_images = [&](int64 start, int64 limit) {
+      for (int64 b = start; b < limit; ++b) {
+        const float* in = input_grad + b * resized_batch_size;
+        T* out = output_grad + b * original_batch_size;
+        std::fill(out, out + original_batch_size, T(0));
+        for (const CachedInterpolation& y : ys) {
+          const float inverse_y_lerp = (1.0f - y.lerp);
+          T* top = out + y.lower;
+          T* bottom = out + y.upper;
+          for (const CachedInterpolation& x : xs) {
+            const float inverse_x_lerp = (1.0f - x.lerp);
+            for (int64 c = 0; c < channels; ++c) {
+              top[x.lower + c] += in[c] * inverse_y_lerp * inverse_x_lerp;
+              top[x.upper + c] += in[c] * inverse_y_lerp * x.lerp;
+              bottom[x.lower + c] += in[c] * y.lerp * inverse_x_lerp;
+              bottom[x.upper + c] += in[c] * y.lerp * x.lerp;
+            }
+            in += channels;
           }
         }
       }
-    }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, st.batch_size,
+          resized_batch_size * 20, resize_images);
   }
 
  private:
@@ -13,6 +13,7 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
 #include "tensorflow/core/framework/allocator.h"
 #include "tensorflow/core/framework/fake_input.h"
 #include "tensorflow/core/framework/graph.pb.h"
@@ -22,10 +23,12 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/graph/testlib.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
 
 namespace tensorflow {
 
@@ -318,4 +321,79 @@ TEST_F(ResizeBilinearOpTest, TestInvalidSizeElements) {
   ASSERT_FALSE(RunOpKernel().ok());
 }
 
+class ResizeBilinearOpGradTest : public OpsTestBase {
+ protected:
+  ResizeBilinearOpGradTest() {
+    TF_EXPECT_OK(NodeDefBuilder("resize_bilinear_grad_op", "ResizeBilinearGrad")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_FLOAT))
+                     .Attr("align_corners", false)
+                     .Finalize(node_def()));
+    TF_EXPECT_OK(InitOp());
+  }
+};
+
+TEST_F(ResizeBilinearOpGradTest, TestBilinearGrad3x3To2x2) {
+  // Input gradient of ones, for a 2x2 image resized to 3x3.
+  AddInputFromArray<float>(TensorShape({1, 3, 3, 1}),
+                           {1, 1, 1, 1, 1, 1, 1, 1, 1});
+  AddInputFromArray<float>(TensorShape({1, 2, 2, 1}), {0, 0, 0, 0});
+  TF_ASSERT_OK(RunOpKernel());
+
+  // The resized rows and columns 0, 1 and 2 read the original row or column 0
+  // with weights 1, 1/3 and 0, and the original row or column 1 with weights
+  // 0, 2/3 and 1.
+  Tensor expected(allocator(), DT_FLOAT, TensorShape({1, 2, 2, 1}));
+  test::FillValues<float>(&expected,
+                          {16.0f / 9, 20.0f / 9, 20.0f / 9, 25.0f / 9});
+  test::ExpectTensorNear<float>(expected, *GetOutput(0), 1e-5);
+}
+
+static Graph* ResizeBilinear(int batch_size, int size, int channels,
+                             float scale, bool grad) {
+  Graph* g = new Graph(OpRegistry::Global());
+  const int resized_size = scale * size;
+  Tensor image(DT_FLOAT, TensorShape({batch_size, size, size, channels}));
+  image.flat<float>().setRandom();
+  if (grad) {
+    Tensor resized_grad(
+        DT_FLOAT, TensorShape({batch_size, resized_size, resized_size,
+                               channels}));
+    resized_grad.flat<float>().setRandom();
+    test::graph::Binary(g, "ResizeBilinearGrad",
+                        test::graph::Constant(g, resized_grad),
+                        test::graph::Constant(g, image));
+  } else {
+    Tensor shape(DT_INT32, TensorShape({2}));
+    shape.flat<int32>().setConstant(resized_size);
+    test::graph::Binary(g, "ResizeBilinear", test::graph::Constant(g, image),
+                        test::graph::Constant(g, shape));
+  }
+  return g;
+}
+
+// SCALE is the ratio of the resized size to the image size, in percent.
+#define BM_ResizeBilinearDev(BATCH, SIZE, CHANNELS, SCALE, GRAD)               \
+  static void                                                                  \
+      BM_ResizeBilinear_##BATCH##_##SIZE##_##CHANNELS##_##SCALE##_##GRAD(      \
+          int iters) {                                                         \
+    testing::ItemsProcessed(static_cast<int64>(iters) * BATCH * SIZE *         \
+                            SIZE * CHANNELS);                                  \
+    test::Benchmark("cpu", ResizeBilinear(BATCH, SIZE, CHANNELS,               \
+                                          SCALE / 100.0f, GRAD))               \
+        .Run(iters);                                                           \
+  }                                                                            \
+  BENCHMARK(BM_ResizeBilinear_##BATCH##_##SIZE##_##CHANNELS##_##SCALE##_##GRAD);
+
+BM_ResizeBilinearDev(8, 32, 3, 50, false);
+BM_ResizeBilinearDev(8, 128, 3, 50, false);
+BM_ResizeBilinearDev(8, 512, 3, 50, false);
+BM_ResizeBilinearDev(8, 128, 3, 200, false);
+BM_ResizeBilinearDev(1, 1024, 3, 50, false);
+BM_ResizeBilinearDev(8, 128, 1, 50, false);
+BM_ResizeBilinearDev(8, 128, 16, 50, false);
+BM_ResizeBilinearDev(8, 128, 3, 50, true);
+BM_ResizeBilinearDev(8, 128, 3, 200, true);
+BM_ResizeBilinearDev(8, 128, 16, 50, true);
+
 }  // namespace tensorflow
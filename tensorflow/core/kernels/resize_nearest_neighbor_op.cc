@@ -16,7 +16,9 @@ limitations under the License.
 // See docs in ../ops/image_ops.cc
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <memory>
+#include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
@@ -26,6 +28,7 @@ limitations under the License.
 #include "tensorflow/core/kernels/image_resizer_state.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 #if GOOGLE_CUDA
 #include "tensorflow/core/kernels/resize_nearest_neighbor_op_gpu.h"
@@ -54,24 +57,38 @@ class ResizeNearestNeighborOp : public OpKernel {
                 errors::InvalidArgument("nearest neighbor requires max height "
                                         "& width of 2^24"));
 
-    typename TTypes<T, 4>::ConstTensor input_data = input.tensor<T, 4>();
-    typename TTypes<T, 4>::Tensor output_data = st.output->tensor<T, 4>();
+    const int64 channels = st.channels;
+    const int64 in_row_size = st.in_width * channels;
+    const int64 in_batch_size = st.in_height * in_row_size;
+    const int64 out_row_size = st.out_width * channels;
+    std::vector<int64> in_x_offsets(st.out_width);
+    for (int64 x = 0; x < st.out_width; ++x) {
+      in_x_offsets[x] = std::min(static_cast<int64>(floorf(x * st.width_scale)),
+                                 (st.in_width - 1)) *
+                        channels;
+    }
+
+    const T* input_data = input.flat<T>().data();
+    T* output_data = st.output->flat<T>().data();
 
-    for (int b = 0; b < st.batch_size; ++b) {
-      for (int y = 0; y < st.out_height; ++y) {
+    auto resize_rows = [&](int64 start, int64 limit) {
+      for (int64 i = start; i < limit; ++i) {
+        const int64 b = i / st.out_height;
+        const int64 y = i % st.out_height;
         const int64 in_y =
             std::min(static_cast<int64>(floorf(y * st.height_scale)),
                      (st.in_height - 1));
-        for (int x = 0; x < st.out_width; ++x) {
-          const int64 in_x =
-              std::min(static_cast<int64>(floorf(x * st.width_scale)),
-                       (st.in_width - 1));
-          for (int c = 0; c < st.channels; ++c) {
-            output_data(b, y, x, c) = input_data(b, in_y, in_x, c);
-          }
+        const T* in = input_data + b * in_batch_size + in_y * in_row_size;
+        T* out = output_data + i * out_row_size;
+        for (const int64 in_x_offset : in_x_offsets) {
+          std::copy_n(in + in_x_offset, channels, out);
+          out += channels;
         }
       }
-    }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          st.batch_size * st.out_height, out_row_size * 2, resize_rows);
   }
 
  private:
@@ -122,30 +139,46 @@ class ResizeNearestNeighborOpGrad : public OpKernel {
     const int64 out_height = output->dim_size(1);
     const int64 out_width = output->dim_size(2);
 
-    typename TTypes<T, 4>::ConstTensor input_data = input.tensor<T, 4>();
-    typename TTypes<T, 4>::Tensor output_data = output->tensor<T, 4>();
-
     const float height_scale =
         CalculateResizeScale(out_height, in_height, align_corners_);
     const float width_scale =
         CalculateResizeScale(out_width, in_width, align_corners_);
-    output_data.setZero();
-
-    for (int c = 0; c < channels; ++c) {
-      for (int y = 0; y < in_height; ++y) {
-        const int64 out_y = std::min(
-            static_cast<int64>(floorf(y * height_scale)), (out_height - 1));
-
-        for (int x = 0; x < in_width; ++x) {
-          const int64 out_x = std::min(
-              static_cast<int64>(floorf(x * width_scale)), (out_width - 1));
+    std::vector<int64> out_x_offsets(in_width);
+    for (int64 x = 0; x < in_width; ++x) {
+      out_x_offsets[x] = std::min(static_cast<int64>(floorf(x * width_scale)),
+                                  (out_width - 1)) *
+                         channels;
+    }
 
-          for (int b = 0; b < batch_size; ++b) {
-            output_data(b, out_y, out_x, c) += input_data(b, y, x, c);
+    const T* input_data = input.flat<T>().data();
+    T* output_data = output->flat<T>().data();
+    const int64 in_batch_size = in_height * in_width * channels;
+    const int64 out_row_size = out_width * channels;
+    const int64 out_batch_size = out_height * out_row_size;
+
+    // Several input rows may add to the same output row, so the images of the
+    // batch are the units of parallel work.
+    auto resize_images = [&](int64 start, int64 limit) {
+      for (int64 b = start; b < limit; ++b) {
+        const T* in = input_data + b * in_batch_size;
+        T* out_image = output_data + b * out_batch_size;
+        std::fill(out_image, out_image + out_batch_size, T(0));
+        for (int64 y = 0; y < in_height; ++y) {
+          const int64 out_y = std::min(
+              static_cast<int64>(floorf(y * height_scale)), (out_height - 1));
+          T* out = out_image + out_y * out_row_size;
+          for (const int64 out_x_offset : out_x_offsets) {
+            for (int64 c = 0; c < channels; ++c) {
+              out[out_x_offset + c] += in[c];
+            }
+            in += channels;
           }
         }
       }
-    }
+    };
+    auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+    Shard(worker_threads.num_threads, worker_threads.workers, batch_size,
+          in_batch_size * 2, resize_images);
   }
 
  private:
@@ -39,6 +39,25 @@ static Graph* BM_ResizeNearestNeighbor(int batches, int width, int height) {
   return g;
 }
 
+static Graph* BM_ResizeNearestNeighborGrad(int batches, int width,
+                                           int height) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor in(DT_FLOAT, TensorShape({batches, width * 2, height * 2, 3}));
+  in.flat<float>().setRandom();
+
+  Tensor out_size(DT_INT32, TensorShape({2}));
+  auto out_size_flat = out_size.flat<int32>();
+  out_size_flat(0) = width;
+  out_size_flat(1) = height;
+
+  Node* ret;
+  NodeBuilder(g->NewName("n"), "ResizeNearestNeighborGrad")
+      .Input(test::graph::Constant(g, in))
+      .Input(test::graph::Constant(g, out_size))
+      .Finalize(g, &ret);
+  return g;
+}
+
 #define BM_ResizeNearestNeighborDev(DEVICE, B, W, H)                           \
   static void BM_ResizeNearestNeighbor_##DEVICE##_##B##_##W##_##H(int iters) { \
     testing::ItemsProcessed(iters* B* W* H * 3);                               \
@@ -48,5 +67,21 @@ static Graph* BM_ResizeNearestNeighbor(int batches, int width, int height) {
 
 BM_ResizeNearestNeighborDev(cpu, 1, 499, 499);
 BM_ResizeNearestNeighborDev(gpu, 1, 499, 499);
+BM_ResizeNearestNeighborDev(cpu, 8, 128, 128);
+BM_ResizeNearestNeighborDev(gpu, 8, 128, 128);
+
+#define BM_ResizeNearestNeighborGradDev(DEVICE, B, W, H)                       \
+  static void BM_ResizeNearestNeighborGrad_##DEVICE##_##B##_##W##_##H(         \
+      int iters) {                                                             \
+    testing::ItemsProcessed(iters* B* W* H * 3);                               \
+    test::Benchmark(#DEVICE, BM_ResizeNearestNeighborGrad(B, W, H))            \
+        .Run(iters);                                                           \
+  }                                                                            \
+  BENCHMARK(BM_ResizeNearestNeighborGrad_##DEVICE##_##B##_##W##_##H)
+
+BM_ResizeNearestNeighborGradDev(cpu, 1, 499, 499);
+BM_ResizeNearestNeighborGradDev(gpu, 1, 499, 499);
+BM_ResizeNearestNeighborGradDev(cpu, 8, 128, 128);
+BM_ResizeNearestNeighborGradDev(gpu, 8, 128, 128);
 
 }  // namespace tensorflow
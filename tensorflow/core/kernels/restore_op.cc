@@ -77,4 +77,16 @@ class RestoreSliceOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("RestoreSlice").Device(DEVICE_CPU),
                         RestoreSliceOp);
 
+class RestoreDeltaOp : public OpKernel {
+ public:
+  explicit RestoreDeltaOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    RestoreTensorWithDeltas(context, &checkpoint::OpenTableTensorSliceReader);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("RestoreDelta").Device(DEVICE_CPU),
+                        RestoreDeltaOp);
+
 }  // namespace tensorflow
@@ -25,8 +25,10 @@ limitations under the License.
 #include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/io/path.h"
@@ -420,5 +422,231 @@ TEST_F(RestoreSliceOpTest, RestoreInt) {
   }
 }
 
+class RestoreDeltaOpTest : public OpsTestBase {
+ protected:
+  void MakeRestoreDeltaOp(DataType dt) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "RestoreDelta")
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Attr("dt", dt)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Runs kernel "def" on "values" and returns its status. Sets "*output" to
+  // its first output, if "output" is not null.
+  Status RunKernel(const NodeDef& def,
+                   gtl::InlinedVector<TensorValue, 4> values,
+                   Tensor* output = nullptr) {
+    std::unique_ptr<Device> device(
+        DeviceFactory::NewDevice("CPU", {}, "/job:a/replica:0/task:0"));
+    Status status;
+    std::unique_ptr<OpKernel> op(CreateOpKernel(DEVICE_CPU, device.get(),
+                                                cpu_allocator(), def,
+                                                TF_GRAPH_DEF_VERSION, &status));
+    TF_RETURN_IF_ERROR(status);
+    OpKernelContext::Params params;
+    params.device = device.get();
+    params.frame_iter = FrameAndIter(0, 0);
+    params.inputs = &values;
+    params.op_kernel = op.get();
+    std::vector<AllocatorAttributes> attrs;
+    test::SetOutputAttrs(&params, &attrs);
+    OpKernelContext ctx(&params);
+    op->Compute(&ctx);
+    if (ctx.status().ok() && output != nullptr) {
+      std::unique_ptr<Tensor> out(ctx.release_output(0).tensor);
+      *output = *out;
+    }
+    return ctx.status();
+  }
+
+  // Runs the save kernel "save" on "inputs".
+  void RunSave(const NodeDef& save, const std::vector<Tensor*>& inputs) {
+    gtl::InlinedVector<TensorValue, 4> values;
+    for (Tensor* input : inputs) values.push_back({nullptr, input});
+    TF_ASSERT_OK(RunKernel(save, values));
+  }
+
+  // Saves rows "rows" of "value" as tensor "emb" of a delta checkpoint.
+  Status SaveDelta(const string& filename, const string& base,
+                   const std::vector<int64>& rows, Tensor value) {
+    NodeDef save;
+    TF_CHECK_OK(NodeDefBuilder("save_delta", "SaveDelta")
+                    .Input(FakeInput())
+                    .Input(FakeInput())
+                    .Input(FakeInput())
+                    .Input(FakeInput(1))
+                    .Input(FakeInput({DT_FLOAT}))
+                    .Finalize(&save));
+    Tensor filename_t = test::AsScalar<string>(filename);
+    Tensor base_t = test::AsScalar<string>(base);
+    Tensor names_t = test::AsTensor<string>({"emb"});
+    Tensor rows_t = test::AsTensor<int64>(rows);
+    return RunKernel(save, {{nullptr, &filename_t},
+                            {nullptr, &base_t},
+                            {nullptr, &names_t},
+                            {nullptr, &rows_t},
+                            {nullptr, &value}});
+  }
+
+  // Runs TakeDirtyRows on "var", the value of a variable guarded by "mu".
+  std::vector<int64> TakeDirtyRows(mutex* mu, Tensor* var) {
+    NodeDef take;
+    TF_CHECK_OK(NodeDefBuilder("take", "TakeDirtyRows")
+                    .Input(FakeInput(DT_FLOAT_REF))
+                    .Finalize(&take));
+    Tensor rows;
+    TF_CHECK_OK(RunKernel(take, {{mu, var}}, &rows));
+    auto rows_vec = rows.vec<int64>();
+    return std::vector<int64>(rows_vec.data(),
+                              rows_vec.data() + rows_vec.size());
+  }
+
+  // Runs CommitDirtyRows on "var", the value of a variable guarded by "mu".
+  void CommitDirtyRows(mutex* mu, Tensor* var, const std::vector<int64>& rows) {
+    NodeDef commit;
+    TF_CHECK_OK(NodeDefBuilder("commit", "CommitDirtyRows")
+                    .Input(FakeInput(DT_FLOAT_REF))
+                    .Input(FakeInput())
+                    .Finalize(&commit));
+    Tensor rows_t = test::AsTensor<int64>(rows);
+    TF_CHECK_OK(RunKernel(commit, {{mu, var}, {nullptr, &rows_t}}));
+  }
+
+  // Restores tensor "emb" from the checkpoint "filename".
+  Tensor Restore(const string& filename) {
+    inputs_.clear();
+    AddInput<string>(TensorShape({}),
+                     [&filename](int x) -> string { return filename; });
+    AddInput<string>(TensorShape({}), [](int x) -> string { return "emb"; });
+    TF_CHECK_OK(RunOpKernel());
+    return *GetOutput(0);
+  }
+};
+
+TEST_F(RestoreDeltaOpTest, RestoreChain) {
+  const string base = io::JoinPath(testing::TmpDir(), "delta_base");
+  const string delta1 = io::JoinPath(testing::TmpDir(), "delta_1");
+  const string delta2 = io::JoinPath(testing::TmpDir(), "delta_2");
+
+  // The full checkpoint holds rows 0 to 5.
+  Tensor value(DT_FLOAT, TensorShape({6, 2}));
+  test::FillIota<float>(&value, 0);
+  {
+    NodeDef save;
+    TF_ASSERT_OK(NodeDefBuilder("save", "Save")
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput({DT_FLOAT}))
+                     .Finalize(&save));
+    Tensor filename_t = test::AsScalar<string>(base);
+    Tensor names_t = test::AsTensor<string>({"emb"});
+    RunSave(save, {&filename_t, &names_t, &value});
+  }
+  // Each delta changes some rows, only some of which it saves.
+  for (int64 row : {1, 4}) {
+    value.matrix<float>()(row, 0) += 100;
+    value.matrix<float>()(row, 1) += 100;
+  }
+  TF_ASSERT_OK(SaveDelta(delta1, base, {1, 4}, value));
+  value.matrix<float>()(0, 0) = -1;
+  for (int64 row : {4, 5}) value.matrix<float>()(row, 1) += 1000;
+  TF_ASSERT_OK(SaveDelta(delta2, delta1, {4, 5}, value));
+
+  MakeRestoreDeltaOp(DT_FLOAT);
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11},
+                            TensorShape({6, 2})),
+      Restore(base));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0, 1, 102, 103, 4, 5, 6, 7, 108, 109, 10, 11},
+                            TensorShape({6, 2})),
+      Restore(delta1));
+  test::ExpectTensorEqual<float>(
+      test::AsTensor<float>({0, 1, 102, 103, 4, 5, 6, 7, 108, 1109, 10, 1011},
+                            TensorShape({6, 2})),
+      Restore(delta2));
+}
+
+TEST_F(RestoreDeltaOpTest, PartialCheckpoint) {
+  const string base = io::JoinPath(testing::TmpDir(), "delta_partial_base");
+
+  // The full checkpoint only holds rows 0 to 2 of the 6 rows of the tensor.
+  {
+    NodeDef save;
+    TF_ASSERT_OK(NodeDefBuilder("save", "SaveSlices")
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput({DT_FLOAT}))
+                     .Finalize(&save));
+    Tensor filename_t = test::AsScalar<string>(base);
+    Tensor names_t = test::AsTensor<string>({"emb"});
+    Tensor slices_t = test::AsTensor<string>({"6 2 0,3:-"});
+    Tensor value(DT_FLOAT, TensorShape({3, 2}));
+    test::FillIota<float>(&value, 0);
+    RunSave(save, {&filename_t, &names_t, &slices_t, &value});
+  }
+
+  MakeRestoreDeltaOp(DT_FLOAT);
+  AddInput<string>(TensorShape({}), [&base](int x) -> string { return base; });
+  AddInput<string>(TensorShape({}), [](int x) -> string { return "emb"; });
+  Status status = RunOpKernel();
+  EXPECT_EQ(error::DATA_LOSS, status.code()) << status;
+}
+
+TEST_F(RestoreDeltaOpTest, PlainRestoreRejectsDelta) {
+  const string delta = io::JoinPath(testing::TmpDir(), "delta_plain");
+  Tensor value(DT_FLOAT, TensorShape({4, 2}));
+  test::FillIota<float>(&value, 0);
+  TF_ASSERT_OK(SaveDelta(delta, "some_base", {1, 2}, value));
+
+  // The plain Restore op cannot fill in the rows the delta does not hold.
+  TF_ASSERT_OK(NodeDefBuilder("myop", "Restore")
+                   .Input(FakeInput())
+                   .Input(FakeInput())
+                   .Attr("dt", DT_FLOAT)
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput<string>(TensorShape({}),
+                   [&delta](int x) -> string { return delta; });
+  AddInput<string>(TensorShape({}), [](int x) -> string { return "emb"; });
+  Status status = RunOpKernel();
+  EXPECT_EQ(error::FAILED_PRECONDITION, status.code()) << status;
+}
+
+TEST_F(RestoreDeltaOpTest, FailedSaveKeepsDirtyRows) {
+  const string base = io::JoinPath(testing::TmpDir(), "dirty_base");
+  const string delta1 = io::JoinPath(testing::TmpDir(), "dirty_delta_1");
+  const string delta2 = io::JoinPath(testing::TmpDir(), "dirty_delta_2");
+  // The directory does not exist, so writing the delta fails.
+  const string bad_delta =
+      io::JoinPath(testing::TmpDir(), "missing_dir/dirty_delta_2");
+  mutex mu;
+  Tensor var(DT_FLOAT, TensorShape({4, 2}));
+  test::FillIota<float>(&var, 0);
+
+  std::vector<int64> rows = TakeDirtyRows(&mu, &var);
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3}), rows);
+  TF_ASSERT_OK(SaveDelta(delta1, base, rows, var));
+  CommitDirtyRows(&mu, &var, rows);
+
+  const int64 updated[] = {1, 2, 3};
+  DirtyRowTracker::Global()->MarkRows(&mu, var, updated, 2);
+  rows = TakeDirtyRows(&mu, &var);
+  EXPECT_EQ(std::vector<int64>({1, 2}), rows);
+  EXPECT_FALSE(SaveDelta(bad_delta, delta1, rows, var).ok());
+
+  // The rows of the failed save are taken again.
+  DirtyRowTracker::Global()->MarkRows(&mu, var, updated + 2, 1);
+  rows = TakeDirtyRows(&mu, &var);
+  EXPECT_EQ(std::vector<int64>({1, 2, 3}), rows);
+  TF_ASSERT_OK(SaveDelta(delta2, delta1, rows, var));
+  CommitDirtyRows(&mu, &var, rows);
+  EXPECT_EQ(std::vector<int64>(), TakeDirtyRows(&mu, &var));
+  DirtyRowTracker::Global()->Forget(&mu);
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -48,6 +48,53 @@ class SaveSlicesOp : public OpKernel {
 
 REGISTER_KERNEL_BUILDER(Name("SaveSlices").Device(DEVICE_CPU), SaveSlicesOp);
 
+class SaveSlicesAsyncOp : public OpKernel {
+ public:
+  explicit SaveSlicesAsyncOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    SaveTensorsAsync(context, &checkpoint::CreateTableTensorSliceBuilder, true);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("SaveSlicesAsync").Device(DEVICE_CPU),
+                        SaveSlicesAsyncOp);
+
+class SaveDeltaOp : public OpKernel {
+ public:
+  explicit SaveDeltaOp(OpKernelConstruction* context) : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    SaveTensorDeltas(context, &checkpoint::CreateTableTensorSliceBuilder);
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("SaveDelta").Device(DEVICE_CPU), SaveDeltaOp);
+
+class WaitForSaveOp : public AsyncOpKernel {
+ public:
+  explicit WaitForSaveOp(OpKernelConstruction* context)
+      : AsyncOpKernel(context) {}
+
+  void ComputeAsync(OpKernelContext* context, DoneCallback done) override {
+    const Tensor& filename_t = context->input(0);
+    OP_REQUIRES_ASYNC(
+        context, filename_t.NumElements() == 1,
+        errors::InvalidArgument(
+            "Input 0 (filename) must be a string scalar; got a tensor of ",
+            filename_t.NumElements(), " elements"),
+        done);
+    WaitForAsyncSaves(filename_t.flat<string>()(0),
+                      [context, done](const Status& s) {
+                        context->SetStatus(s);
+                        done();
+                      });
+  }
+};
+
+REGISTER_KERNEL_BUILDER(Name("WaitForSave").Device(DEVICE_CPU), WaitForSaveOp);
+
 class ShardedFilenameOp : public OpKernel {
  public:
   explicit ShardedFilenameOp(OpKernelConstruction* ctx) : OpKernel(ctx) {}
@@ -26,6 +26,8 @@ limitations under the License.
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/kernels/save_restore_tensor.h"
+#include "tensorflow/core/lib/core/notification.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/platform/test.h"
@@ -604,5 +606,101 @@ TEST_F(SaveOpSlices2Test, TwoSlices) {
   }
 }
 
+class SaveSlicesAsyncOpTest : public OpsTestBase {
+ protected:
+  void MakeOp() {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "SaveSlicesAsync")
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput())
+                     .Input(FakeInput({DT_INT32, DT_STRING}))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  Status WaitForSaves(const string& filename) {
+    Status status;
+    Notification n;
+    WaitForAsyncSaves(filename, [&status, &n](const Status& s) {
+      status = s;
+      n.Notify();
+    });
+    n.WaitForNotification();
+    return status;
+  }
+};
+
+TEST_F(SaveSlicesAsyncOpTest, Snapshot) {
+  const string filename = io::JoinPath(testing::TmpDir(), "tensor_async");
+  const string tensornames[] = {"tensor_int", "tensor_string"};
+
+  MakeOp();
+  AddInput<string>(TensorShape({}),
+                   [&filename](int x) -> string { return filename; });
+  AddInput<string>(TensorShape({2}),
+                   [&tensornames](int x) -> string { return tensornames[x]; });
+  AddInput<string>(TensorShape({2}), [](int x) -> string { return ""; });
+  AddInput<int32>(TensorShape({4, 25}), [](int x) -> int32 { return x + 1; });
+  AddInput<string>(TensorShape({2}),
+                   [](int x) -> string { return x ? "yes" : "no"; });
+  TF_ASSERT_OK(RunOpKernel());
+
+  // Updates made after the op has run are not saved.
+  inputs_[3].tensor->flat<int32>().setConstant(-1);
+  inputs_[4].tensor->flat<string>().setConstant("changed");
+  TF_ASSERT_OK(WaitForSaves(filename));
+
+  checkpoint::TensorSliceReader reader(filename,
+                                       checkpoint::OpenTableTensorSliceReader);
+  TF_EXPECT_OK(reader.status());
+  {
+    int32 data[100];
+    EXPECT_TRUE(reader.CopySliceData(
+        "tensor_int", TensorSlice::ParseOrDie("-:-"), data));
+    for (int i = 0; i < 100; ++i) {
+      EXPECT_EQ(i + 1, data[i]);
+    }
+  }
+  {
+    string data[2];
+    EXPECT_TRUE(
+        reader.CopySliceData("tensor_string", TensorSlice::ParseOrDie("-"),
+                             data));
+    EXPECT_EQ("no", data[0]);
+    EXPECT_EQ("yes", data[1]);
+  }
+}
+
+TEST_F(SaveSlicesAsyncOpTest, ReportsErrorOnce) {
+  const string filename = io::JoinPath(
+      io::JoinPath(testing::TmpDir(), "no_such_dir"), "tensor_async");
+  const string tensornames[] = {"tensor_int", "tensor_string"};
+
+  MakeOp();
+  AddInput<string>(TensorShape({}),
+                   [&filename](int x) -> string { return filename; });
+  AddInput<string>(TensorShape({2}),
+                   [&tensornames](int x) -> string { return tensornames[x]; });
+  AddInput<string>(TensorShape({2}), [](int x) -> string { return ""; });
+  AddInput<int32>(TensorShape({3}), [](int x) -> int32 { return x; });
+  AddInput<string>(TensorShape({1}), [](int x) -> string { return "a"; });
+  // The op succeeds, the failure to write the file shows up when waiting.
+  TF_ASSERT_OK(RunOpKernel());
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_FALSE(WaitForSaves(filename).ok());
+  TF_EXPECT_OK(WaitForSaves(filename));
+}
+
+class WaitForSaveOpTest : public OpsTestBase {};
+
+TEST_F(WaitForSaveOpTest, NothingPending) {
+  TF_ASSERT_OK(NodeDefBuilder("myop", "WaitForSave")
+                   .Input(FakeInput())
+                   .Finalize(node_def()));
+  TF_ASSERT_OK(InitOp());
+  AddInput<string>(TensorShape({}), [](int x) -> string { return "unused"; });
+  TF_ASSERT_OK(RunOpKernel());
+}
+
 }  // namespace
 }  // namespace tensorflow
@@ -13,7 +13,12 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
+#define EIGEN_USE_THREADS
+
+#include <algorithm>
+#include <deque>
 #include <unordered_map>
+#include <unordered_set>
 
 #include <vector>
 #include "tensorflow/core/kernels/save_restore_tensor.h"
@@ -22,11 +27,16 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/strings/str_util.h"
 #include "tensorflow/core/lib/strings/strcat.h"
 #include "tensorflow/core/lib/strings/stringprintf.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/platform/thread_annotations.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_reader_cache.h"
@@ -82,10 +92,20 @@ bool ParseShapeAndSlice(const string& shape_and_slice, TensorShape* shape,
 }
 }  // namespace
 
-void SaveTensors(
-    OpKernelContext* context,
-    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
-    bool save_slices) {
+namespace {
+
+// A tensor to save, with the name, shape and slice it is saved as.
+struct SaveEntry {
+  string name;
+  TensorShape shape;
+  TensorSlice slice;
+  Tensor tensor;
+};
+
+// Parses the inputs of a save op (see SaveTensors) into "*filename" and
+// "*entries". Errors are reported through "context".
+void ParseSaveInputs(OpKernelContext* context, bool save_slices,
+                     string* filename, std::vector<SaveEntry>* entries) {
   const Tensor& filename_t = context->input(0);
   {
     const int64 size = filename_t.NumElements();
@@ -124,59 +144,251 @@ void SaveTensors(
                                       N, " names, but received ",
                                       context->num_inputs(), " inputs"));
 
-  VLOG(1) << "About to save tensors to file " << filename_t.flat<string>()(0)
-          << "...";
-  checkpoint::TensorSliceWriter writer(filename_t.flat<string>()(0),
-                                       builder_func);
-
-  Status s;
+  *filename = filename_t.flat<string>()(0);
   auto tensor_names_flat = tensor_names_t.flat<string>();
-
+  entries->resize(N);
   string error;
   for (int i = 0; i < N; ++i) {
-    const string& name = tensor_names_flat(i);
-    const Tensor& input = context->input(i + kFixedInputs);
-    TensorShape shape(input.shape());
-    TensorSlice slice(input.dims());
+    SaveEntry* entry = &(*entries)[i];
+    entry->name = tensor_names_flat(i);
+    entry->tensor = context->input(i + kFixedInputs);
+    entry->shape = entry->tensor.shape();
+    entry->slice = TensorSlice(entry->tensor.dims());
     if (save_slices && !tensor_shapes_and_slices_ptr[i].empty()) {
       const string& shape_spec = tensor_shapes_and_slices_ptr[i];
       TensorShape slice_shape;
-      OP_REQUIRES(context, ParseShapeAndSlice(shape_spec, &shape, &slice,
-                                              &slice_shape, &error),
+      OP_REQUIRES(context, ParseShapeAndSlice(shape_spec, &entry->shape,
+                                              &entry->slice, &slice_shape,
+                                              &error),
                   errors::InvalidArgument(error));
-      OP_REQUIRES(context, slice_shape.IsSameSize(input.shape()),
+      OP_REQUIRES(context, slice_shape.IsSameSize(entry->tensor.shape()),
                   errors::InvalidArgument("Slice in shape_and_slice "
                                           "specification does not match the "
                                           "shape of the tensor to  save: ",
                                           shape_spec, ", tensor: ",
-                                          input.shape().DebugString()));
+                                          entry->tensor.shape().DebugString()));
     }
+  }
+}
+
+// Writes "entries" to "filename" with a writer built from builder_func().
+Status WriteTensors(
+    const string& filename,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    const std::vector<SaveEntry>& entries) {
+  VLOG(1) << "About to save tensors to file " << filename << "...";
+  checkpoint::TensorSliceWriter writer(filename, builder_func);
 
-#define WRITER_ADD(T)                                           \
-  case DataTypeToEnum<T>::value:                                \
-    s = writer.Add(name, shape, slice, input.flat<T>().data()); \
+  for (const SaveEntry& entry : entries) {
+    Status s;
+// The tensors stay alive until the writer has finished, so their buffers
+// are streamed to the file rather than copied.
+#define WRITER_ADD(T)                                             \
+  case DataTypeToEnum<T>::value:                                  \
+    s = writer.AddUnowned(entry.name, entry.shape, entry.slice,   \
+                          entry.tensor.flat<T>().data());         \
     break;
 
-    switch (input.dtype()) {
+    switch (entry.tensor.dtype()) {
       TF_CALL_ALL_TYPES(WRITER_ADD)
       TF_CALL_QUANTIZED_TYPES(WRITER_ADD)
       default:
-        context->SetStatus(errors::Unimplemented("Saving data type ",
-                                                 DataTypeString(input.dtype()),
-                                                 " not yet supported"));
-        return;
+        return errors::Unimplemented("Saving data type ",
+                                     DataTypeString(entry.tensor.dtype()),
+                                     " not yet supported");
     }
 #undef WRITER_ADD
-    if (!s.ok()) {
-      context->SetStatus(s);
-      return;
+    TF_RETURN_IF_ERROR(s);
+  }
+
+  return writer.Finish();
+}
+
+// Runs the background writes of SaveTensorsAsync(). Writes to the same file
+// run one at a time, in the order they were scheduled; writes to different
+// files run in parallel.
+class AsyncSaves {
+ public:
+  static AsyncSaves* Global() {
+    static AsyncSaves* saves = new AsyncSaves;
+    return saves;
+  }
+
+  // Schedules "write" to run in the background as a write to "filename".
+  void Schedule(const string& filename, std::function<Status()> write) {
+    mutex_lock l(mu_);
+    PendingSaves& pending = pending_[filename];
+    pending.writes.push_back(std::move(write));
+    if (!pending.running) {
+      pending.running = true;
+      workers_.Schedule([this, filename]() { RunWrites(filename); });
+    }
+  }
+
+  // Calls "done" with the status of the writes to "filename" scheduled since
+  // the last call, once they have all finished.
+  void Wait(const string& filename, std::function<void(const Status&)> done) {
+    Status status;
+    {
+      mutex_lock l(mu_);
+      auto it = pending_.find(filename);
+      if (it != pending_.end()) {
+        if (it->second.running) {
+          it->second.waiters.push_back(std::move(done));
+          return;
+        }
+        status = it->second.status;
+        pending_.erase(it);
+      }
+    }
+    done(status);
+  }
+
+ private:
+  struct PendingSaves {
+    std::deque<std::function<Status()>> writes;
+    bool running = false;
+    // The first error of the writes since the last Wait().
+    Status status;
+    std::vector<std::function<void(const Status&)>> waiters;
+  };
+
+  AsyncSaves()
+      : workers_(Env::Default(), "async_save",
+                 std::max(1, std::min(4, port::NumSchedulableCPUs()))) {}
+
+  void RunWrites(const string& filename) {
+    while (true) {
+      std::function<Status()> write;
+      std::vector<std::function<void(const Status&)>> waiters;
+      Status status;
+      {
+        mutex_lock l(mu_);
+        PendingSaves& pending = pending_[filename];
+        if (!pending.writes.empty()) {
+          write = std::move(pending.writes.front());
+          pending.writes.pop_front();
+        } else {
+          pending.running = false;
+          if (pending.waiters.empty()) return;
+          // The waiters consume the status: drop the entry.
+          waiters.swap(pending.waiters);
+          status = pending.status;
+          pending_.erase(filename);
+        }
+      }
+      if (!write) {
+        for (const auto& done : waiters) done(status);
+        return;
+      }
+      Status s = write();
+      if (!s.ok()) {
+        LOG(ERROR) << "Asynchronous save to " << filename << " failed: " << s;
+      }
+      // Releases the snapshot as soon as it has been written.
+      write = nullptr;
+      mutex_lock l(mu_);
+      pending_[filename].status.Update(s);
     }
   }
 
-  s = writer.Finish();
-  if (!s.ok()) {
-    context->SetStatus(s);
+  mutex mu_;
+  std::unordered_map<string, PendingSaves> pending_ GUARDED_BY(mu_);
+  thread::ThreadPool workers_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(AsyncSaves);
+};
+
+// Returns the cached reader of "file_pattern", or a reader allocated in
+// "*allocated_reader" if there is none.
+const checkpoint::TensorSliceReader* GetReader(
+    OpKernelContext* context, const string& file_pattern,
+    checkpoint::TensorSliceReader::OpenTableFunction open_func,
+    int preferred_shard,
+    std::unique_ptr<checkpoint::TensorSliceReader>* allocated_reader) {
+  const checkpoint::TensorSliceReader* reader =
+      context->slice_reader_cache()->GetReader(file_pattern, open_func,
+                                               preferred_shard);
+  if (!reader) {
+    allocated_reader->reset(new checkpoint::TensorSliceReader(
+        file_pattern, open_func, preferred_shard));
+    reader = allocated_reader->get();
+  }
+  return CHECK_NOTNULL(reader);
+}
+
+// Copies rows "rows" of "tensor" to "values", which has room for them.
+template <typename T>
+void GatherRows(const Tensor& tensor, const std::vector<int64>& rows,
+                Tensor* values) {
+  auto src = tensor.flat_outer_dims<T>();
+  auto dst = values->flat_outer_dims<T>();
+  const int64 row_elements = src.dimension(1);
+  if (row_elements == 0) return;
+  for (size_t i = 0; i < rows.size(); ++i) {
+    std::copy_n(&src(rows[i], 0), row_elements, &dst(i, 0));
+  }
+}
+
+}  // namespace
+
+void SaveTensors(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    bool save_slices) {
+  string filename;
+  std::vector<SaveEntry> entries;
+  ParseSaveInputs(context, save_slices, &filename, &entries);
+  if (!context->status().ok()) return;
+  OP_REQUIRES_OK(context, WriteTensors(filename, builder_func, entries));
+}
+
+void SaveTensorsAsync(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    bool save_slices) {
+  string filename;
+  std::vector<SaveEntry> entries;
+  ParseSaveInputs(context, save_slices, &filename, &entries);
+  if (!context->status().ok()) return;
+
+  // The inputs usually share their buffers with variables that the following
+  // steps update in place, so the background write needs its own snapshot.
+  // The copies are spread over the intra-op threads.
+  const Eigen::ThreadPoolDevice& device =
+      context->eigen_device<Eigen::ThreadPoolDevice>();
+  for (SaveEntry& entry : entries) {
+    Tensor snapshot;
+    OP_REQUIRES_OK(context, context->allocate_temp(entry.tensor.dtype(),
+                                                   entry.tensor.shape(),
+                                                   &snapshot));
+#define SNAPSHOT_COPY(T)                                                    \
+  case DataTypeToEnum<T>::value:                                            \
+    snapshot.flat<T>().device(device) = entry.tensor.flat<T>();             \
+    break;
+
+    switch (entry.tensor.dtype()) {
+      TF_CALL_ALL_TYPES(SNAPSHOT_COPY)
+      TF_CALL_QUANTIZED_TYPES(SNAPSHOT_COPY)
+      default:
+        context->SetStatus(errors::Unimplemented(
+            "Saving data type ", DataTypeString(entry.tensor.dtype()),
+            " not yet supported"));
+        return;
+    }
+#undef SNAPSHOT_COPY
+    entry.tensor = snapshot;
   }
+
+  AsyncSaves::Global()->Schedule(
+      filename, [filename, builder_func, entries]() {
+        return WriteTensors(filename, builder_func, entries);
+      });
+}
+
+void WaitForAsyncSaves(const string& filename,
+                       std::function<void(const Status&)> done) {
+  AsyncSaves::Global()->Wait(filename, std::move(done));
 }
 
 void RestoreTensor(OpKernelContext* context,
@@ -217,16 +429,9 @@ void RestoreTensor(OpKernelContext* context,
 
   // If we cannot find a cached reader we will allocate our own.
   std::unique_ptr<checkpoint::TensorSliceReader> allocated_reader;
-
-  const checkpoint::TensorSliceReader* reader =
-      context->slice_reader_cache()->GetReader(file_pattern, open_func,
-                                               preferred_shard);
-  if (!reader) {
-    allocated_reader.reset(new checkpoint::TensorSliceReader(
-        file_pattern, open_func, preferred_shard));
-    reader = allocated_reader.get();
-  }
-  OP_REQUIRES_OK(context, CHECK_NOTNULL(reader)->status());
+  const checkpoint::TensorSliceReader* reader = GetReader(
+      context, file_pattern, open_func, preferred_shard, &allocated_reader);
+  OP_REQUIRES_OK(context, reader->status());
 
   // Get the shape and type from the save file.
   DataType type;
@@ -235,6 +440,11 @@ void RestoreTensor(OpKernelContext* context,
       context, reader->HasTensor(tensor_name, &saved_shape, &type),
       errors::NotFound("Tensor name \"", tensor_name,
                        "\" not found in checkpoint files ", file_pattern));
+  // A delta checkpoint only holds some rows of each tensor.
+  OP_REQUIRES(context, reader->delta_base().empty(),
+              errors::FailedPrecondition(
+                  "Checkpoint ", file_pattern, " is a delta checkpoint of ",
+                  reader->delta_base(), ", restore it with RestoreDelta"));
   OP_REQUIRES(
       context, type == context->expected_output_dtype(0),
       errors::InvalidArgument("Expected to restore a tensor of type ",
@@ -265,9 +475,19 @@ void RestoreTensor(OpKernelContext* context,
   Tensor* t = nullptr;
   OP_REQUIRES_OK(context, context->allocate_output(0, output_shape, &t));
 
-#define READER_COPY(T)                                                      \
-  case DataTypeToEnum<T>::value:                                            \
-    reader->CopySliceData(tensor_name, slice_to_load, t->flat<T>().data()); \
+  // Large slices are read and verified on the intra-op threads.
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+
+#define READER_COPY(T)                                                     \
+  case DataTypeToEnum<T>::value:                                           \
+    OP_REQUIRES(context,                                                   \
+                reader->CopySliceData(tensor_name, slice_to_load,          \
+                                      t->flat<T>().data(),                 \
+                                      worker_threads.num_threads,          \
+                                      worker_threads.workers),             \
+                errors::DataLoss("Unable to read tensor ", tensor_name,    \
+                                 " from checkpoint ", file_pattern));      \
     break;
 
   switch (type) {
@@ -280,4 +500,183 @@ void RestoreTensor(OpKernelContext* context,
 #undef READER_COPY
 }
 
+void SaveTensorDeltas(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func) {
+  for (int i = 0; i < 2; ++i) {
+    OP_REQUIRES(context, context->input(i).NumElements() == 1,
+                errors::InvalidArgument(
+                    "Input ", i, " (", i == 0 ? "filename" : "base",
+                    ") must be a string scalar; got a tensor of ",
+                    context->input(i).NumElements(), " elements"));
+  }
+  const string& filename = context->input(0).flat<string>()(0);
+  const string& base = context->input(1).flat<string>()(0);
+  OP_REQUIRES(context, !base.empty(),
+              errors::InvalidArgument("The base of delta checkpoint ",
+                                      filename, " must not be empty"));
+  const Tensor& tensor_names_t = context->input(2);
+  OpInputList rows_list;
+  OpInputList data_list;
+  OP_REQUIRES_OK(context, context->input_list("rows", &rows_list));
+  OP_REQUIRES_OK(context, context->input_list("data", &data_list));
+  const int N = rows_list.size();
+  OP_REQUIRES(context, tensor_names_t.NumElements() == N &&
+                           data_list.size() == N,
+              errors::InvalidArgument(
+                  "Expected ", N, " tensor names and tensors, got ",
+                  tensor_names_t.NumElements(), " names and ",
+                  data_list.size(), " tensors"));
+  auto tensor_names_flat = tensor_names_t.flat<string>();
+
+  VLOG(1) << "About to save tensor deltas to file " << filename << "...";
+  checkpoint::TensorSliceWriter writer(filename, builder_func);
+  writer.SetDeltaBase(base);
+  // The rows of each tensor, gathered into a contiguous buffer that stays
+  // alive until the writer has finished.
+  std::vector<Tensor> values(N);
+  for (int i = 0; i < N; ++i) {
+    const string& name = tensor_names_flat(i);
+    const Tensor& tensor = data_list[i];
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(tensor.shape()),
+                errors::InvalidArgument("Tensor ", name,
+                                        " must be at least 1-D, got shape ",
+                                        tensor.shape().DebugString()));
+    const Tensor& rows_t = rows_list[i];
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(rows_t.shape()),
+                errors::InvalidArgument("The rows of tensor ", name,
+                                        " must be a vector, got shape ",
+                                        rows_t.shape().DebugString()));
+    auto rows_flat = rows_t.flat<int64>();
+    std::vector<int64> rows(rows_flat.size());
+    const int64 num_rows = tensor.dim_size(0);
+    for (size_t r = 0; r < rows.size(); ++r) {
+      rows[r] = internal::SubtleMustCopy(rows_flat(r));
+      OP_REQUIRES(context, FastBoundsCheck(rows[r], num_rows),
+                  errors::InvalidArgument("Row ", rows[r], " of tensor ", name,
+                                          " is not in [0, ", num_rows, ")"));
+    }
+    TensorShape values_shape = tensor.shape();
+    values_shape.set_dim(0, rows.size());
+    OP_REQUIRES_OK(context, context->allocate_temp(tensor.dtype(),
+                                                   values_shape, &values[i]));
+    Status s;
+#define WRITER_ADD_ROWS(T)                                                  \
+  case DataTypeToEnum<T>::value:                                            \
+    GatherRows<T>(tensor, rows, &values[i]);                                \
+    s = writer.AddRowsUnowned(name, tensor.shape(), rows,                   \
+                              values[i].flat<T>().data());                  \
+    break;
+
+    switch (tensor.dtype()) {
+      TF_CALL_ALL_TYPES(WRITER_ADD_ROWS)
+      TF_CALL_QUANTIZED_TYPES(WRITER_ADD_ROWS)
+      default:
+        s = errors::Unimplemented("Saving data type ",
+                                  DataTypeString(tensor.dtype()),
+                                  " not yet supported");
+    }
+#undef WRITER_ADD_ROWS
+    OP_REQUIRES_OK(context, s);
+  }
+  OP_REQUIRES_OK(context, writer.Finish());
+}
+
+void RestoreTensorWithDeltas(
+    OpKernelContext* context,
+    checkpoint::TensorSliceReader::OpenTableFunction open_func) {
+  for (int i = 0; i < 2; ++i) {
+    OP_REQUIRES(context, context->input(i).NumElements() == 1,
+                errors::InvalidArgument(
+                    "Input ", i, " (", i == 0 ? "file_pattern" : "tensor_name",
+                    ") must be a string scalar; got a tensor of ",
+                    context->input(i).NumElements(), " elements"));
+  }
+  const string& file_pattern = context->input(0).flat<string>()(0);
+  const string& tensor_name = context->input(1).flat<string>()(0);
+
+  // The readers of the chain, from the newest checkpoint to the full one.
+  std::vector<const checkpoint::TensorSliceReader*> chain;
+  std::vector<std::unique_ptr<checkpoint::TensorSliceReader>> allocated;
+  std::unordered_set<string> patterns;
+  string pattern = file_pattern;
+  while (true) {
+    OP_REQUIRES(context, patterns.insert(pattern).second,
+                errors::DataLoss("The chain of delta checkpoints of ",
+                                 file_pattern, " loops back to ", pattern));
+    allocated.emplace_back();
+    const checkpoint::TensorSliceReader* reader =
+        GetReader(context, pattern, open_func,
+                  checkpoint::TensorSliceReader::kLoadAllShards,
+                  &allocated.back());
+    OP_REQUIRES_OK(context, reader->status());
+    chain.push_back(reader);
+    pattern = reader->delta_base();
+    if (pattern.empty()) break;
+  }
+
+  const checkpoint::TensorSliceReader* full = chain.back();
+  DataType type;
+  TensorShape shape;
+  OP_REQUIRES(
+      context, full->HasTensor(tensor_name, &shape, &type),
+      errors::NotFound("Tensor name \"", tensor_name,
+                       "\" not found in checkpoint files ",
+                       full->filepattern()));
+  OP_REQUIRES(
+      context, type == context->expected_output_dtype(0),
+      errors::InvalidArgument("Expected to restore a tensor of type ",
+                              DataTypeString(context->expected_output_dtype(0)),
+                              ", got a tensor of type ", DataTypeString(type),
+                              " instead: tensor_name = ", tensor_name));
+  // The deltas that hold the tensor, oldest first.
+  std::vector<const checkpoint::TensorSliceReader*> deltas;
+  for (size_t i = chain.size() - 1; i-- > 0;) {
+    DataType delta_type;
+    TensorShape delta_shape;
+    if (!chain[i]->HasTensor(tensor_name, &delta_shape, &delta_type)) continue;
+    OP_REQUIRES(context, delta_type == type && delta_shape.IsSameSize(shape),
+                errors::InvalidArgument(
+                    "Tensor ", tensor_name, " has type ",
+                    DataTypeString(delta_type), " and shape ",
+                    delta_shape.DebugString(), " in delta checkpoint ",
+                    chain[i]->filepattern(), ", but type ",
+                    DataTypeString(type), " and shape ", shape.DebugString(),
+                    " in ", full->filepattern()));
+    deltas.push_back(chain[i]);
+  }
+
+  Tensor* t = nullptr;
+  OP_REQUIRES_OK(context, context->allocate_output(0, shape, &t));
+  const DeviceBase::CpuWorkerThreads& worker_threads =
+      *context->device()->tensorflow_cpu_worker_threads();
+
+  // Applies the deltas oldest first, so that newer rows win.
+#define READER_APPLY(T)                                                      \
+  case DataTypeToEnum<T>::value:                                             \
+    OP_REQUIRES(context,                                                     \
+                full->CopySliceData(tensor_name, TensorSlice(shape.dims()),  \
+                                    t->flat<T>().data(),                     \
+                                    worker_threads.num_threads,              \
+                                    worker_threads.workers),                 \
+                errors::DataLoss("Unable to read tensor ", tensor_name,      \
+                                 " from checkpoint ", full->filepattern())); \
+    for (const checkpoint::TensorSliceReader* delta : deltas) {              \
+      OP_REQUIRES_OK(context,                                                \
+                     delta->CopyDeltaRows(tensor_name, t->flat<T>().data(),  \
+                                          worker_threads.num_threads,        \
+                                          worker_threads.workers));          \
+    }                                                                        \
+    break;
+
+  switch (type) {
+    TF_CALL_ALL_TYPES(READER_APPLY)
+    TF_CALL_QUANTIZED_TYPES(READER_APPLY)
+    default:
+      context->SetStatus(errors::Unimplemented(
+          "Restoring data type ", DataTypeString(type), " not yet supported"));
+  }
+#undef READER_APPLY
+}
+
 }  // namespace tensorflow
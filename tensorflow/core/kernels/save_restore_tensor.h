@@ -16,6 +16,10 @@ limitations under the License.
 #ifndef TENSORFLOW_KERNELS_SAVE_RESTORE_TENSOR_H_
 #define TENSORFLOW_KERNELS_SAVE_RESTORE_TENSOR_H_
 
+#include <functional>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/tensor_slice_reader.h"
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
@@ -35,6 +39,45 @@ void SaveTensors(
     checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
     bool save_slices);
 
+// Same as SaveTensors(), but returns as soon as the inputs have been copied,
+// and writes the copies on a background thread. Writes to the same file run
+// in the order they were started. Their status is reported by
+// WaitForAsyncSaves().
+void SaveTensorsAsync(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func,
+    bool save_slices);
+
+// Calls "done" once all the asynchronous saves to "filename" started so far
+// have finished, with the first error any of the saves started since the
+// previous call for "filename" ran into. Calls "done" right away with an OK
+// status if there are no such saves.
+void WaitForAsyncSaves(const string& filename,
+                       std::function<void(const Status&)> done);
+
+// Saves rows of the input tensors in *context to a delta checkpoint written
+// by a writer built from builder_func().
+// context must have the following inputs:
+//  0: a single element string tensor that contains the file name.
+//  1: a single element string tensor that contains the file pattern of the
+//     base checkpoint.
+//  2: names for the N tensors to save.
+//  3 to N + 2: the rows of each tensor to save.
+//  rest: tensors whose rows to save.
+void SaveTensorDeltas(
+    OpKernelContext* context,
+    checkpoint::TensorSliceWriter::CreateBuilderFunction builder_func);
+
+// Reads a tensor from the chain of delta checkpoints that ends with the
+// checkpoint built from open_func(), and produces it as context->output(0).
+// context must have the following inputs:
+//  0: a single element string tensor that contains the file pattern of the
+//     newest checkpoint.
+//  1: a single element string tensor that names the output to be restored.
+void RestoreTensorWithDeltas(
+    OpKernelContext* context,
+    checkpoint::TensorSliceReader::OpenTableFunction open_func);
+
 // Reads a tensor from the reader built from open_func() and produces it as
 // context->output(0).  "preferred_shard" is the same the TensorSliceReader
 // preferred_shard parameter.
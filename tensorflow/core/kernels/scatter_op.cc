@@ -21,6 +21,8 @@ limitations under the License.
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
+#include "tensorflow/core/kernels/sparse_update_sharder.h"
 #include "tensorflow/core/platform/mutex.h"
 #include "tensorflow/core/platform/types.h"
 #include "tensorflow/core/util/util.h"
@@ -115,6 +117,7 @@ class ScatterUpdateOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 
   void DoCompute(OpKernelContext* c) {
     Tensor params = c->mutable_input(0, use_exclusive_lock_);
@@ -146,9 +149,17 @@ class ScatterUpdateOp : public OpKernel {
       auto params_flat = params.flat_outer_dims<T>();
       auto updates_flat = updates.shaped<T, 2>({N, updates.NumElements() / N});
 
+      // The updated rows are marked dirty when "marker" goes out of scope.
+      // The indices of GPU kernels live on the device, so those mark all the
+      // rows instead.
+      ScopedDirtyRowMarker<Index> marker(&dirty_rows_, c, indices);
+      if (std::is_same<Device, CPUDevice>::value) {
+        marker.Add(0, params);
+      }
       functor::ScatterFunctor<Device, T, Index, op> functor;
       const Index bad_i = functor(c, c->template eigen_device<Device>(),
                                   params_flat, updates_flat, indices_flat);
+      if (!std::is_same<Device, CPUDevice>::value) dirty_rows_.MarkAll(c, {0});
       OP_REQUIRES(
           c, bad_i < 0,
           errors::InvalidArgument(
@@ -159,7 +170,9 @@ class ScatterUpdateOp : public OpKernel {
 };
 
 namespace functor {
-// Implementation of update functor for CPU.
+// Implementation of update functor for CPU.  The updates are partitioned by
+// row across the intra-op thread pool, so that each row is updated by a
+// single thread in the order of the indices.
 template <typename T, typename Index, scatter_op::UpdateOp op>
 struct ScatterFunctor<CPUDevice, T, Index, op> {
   Index operator()(OpKernelContext* c, const CPUDevice& d,
@@ -167,19 +180,15 @@ struct ScatterFunctor<CPUDevice, T, Index, op> {
                    typename TTypes<T>::ConstMatrix updates,
                    typename TTypes<Index>::ConstFlat indices) {
     // indices and params sizes were validated in DoCompute().
-    const Index N = static_cast<Index>(indices.size());
     const Index limit = static_cast<Index>(params.dimension(0));
-    for (Index i = 0; i < N; i++) {
-      // Grab the index and check its validity.  An earlier version of the
-      // code checked it and then grabbed it from memory a second time, which
-      // was a security risk since it could have changed in between.
-      const Index index = internal::SubtleMustCopy(indices(i));
-      if (!FastBoundsCheck(index, limit)) return i;
-      // Copy last Ndim-1 dimensions of updates[i] to params[index]
-      Assign<op>::Run(params.template chip<0>(index),
-                      updates.template chip<0>(i));
-    }
-    return -1;
+    const int64 cost_per_update = 10 + updates.dimension(1);
+    return static_cast<Index>(ShardUpdatesByRow<Index>(
+        *c->device()->tensorflow_cpu_worker_threads(), indices, limit,
+        cost_per_update, [&params, &updates](int64 i, Index index) {
+          // Copy last Ndim-1 dimensions of updates[i] to params[index]
+          Assign<op>::Run(params.template chip<0>(index),
+                          updates.template chip<0>(i));
+        }));
   }
 };
 }  // namespace functor
@@ -25,6 +25,7 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
@@ -93,6 +94,42 @@ TEST_F(ScatterUpdateOpTest, Simple_TwoD32) {
   test::ExpectTensorEqual<float>(expected, params_tensor);
 }
 
+TEST_F(ScatterUpdateOpTest, MarksDirtyRows) {
+  DirtyRowTracker* tracker = DirtyRowTracker::Global();
+  MakeOp(DT_FLOAT_REF, DT_INT32);
+  AddInputFromArray<float>(TensorShape({5, 1}), {0, 0, 0, 0, 0});
+  AddInputFromArray<int32>(TensorShape({2}), {4, 1});
+  AddInputFromArray<float>(TensorShape({2, 1}), {1, 2});
+  const Tensor& params = *mutable_input(0).tensor;
+  auto take_rows = [this, tracker, &params]() {
+    std::vector<int64> rows;
+    tracker->TakeRows(&lock_for_refs_, params, &rows);
+    tracker->CommitRows(&lock_for_refs_, params, rows.data(), rows.size());
+    return rows;
+  };
+
+  // Rows updated before the variable is tracked are not marked.
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), take_rows());
+  EXPECT_EQ(std::vector<int64>(), take_rows());
+
+  // The kernel finds the variable once it is tracked, and keeps marking its
+  // rows.
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(std::vector<int64>({1, 4}), take_rows());
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(std::vector<int64>({1, 4}), take_rows());
+
+  // Once the variable is forgotten, the kernel no longer marks its rows, and
+  // finds it again when it is tracked again.
+  tracker->Forget(&lock_for_refs_);
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(std::vector<int64>({0, 1, 2, 3, 4}), take_rows());
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ(std::vector<int64>({1, 4}), take_rows());
+  tracker->Forget(&lock_for_refs_);
+}
+
 TEST_F(ScatterUpdateOpTest, Simple_Two64) {
   MakeOp(DT_FLOAT_REF, DT_INT64);
 
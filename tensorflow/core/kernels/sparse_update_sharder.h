@@ -0,0 +1,98 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_KERNELS_SPARSE_UPDATE_SHARDER_H_
+#define TENSORFLOW_KERNELS_SPARSE_UPDATE_SHARDER_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "tensorflow/core/framework/device_base.h"
+#include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+// Applies the sparse updates i = 0, ..., indices.size() - 1 to the rows
+// indices(i) of one or more variables, in parallel over "worker_threads",
+// by calling update(i, indices(i)) once for each i.
+//
+// The updates are partitioned by the row they write: all the updates of a
+// row are applied by the same thread, in increasing order of i, and no two
+// threads touch the same row.  So "update" needs no synchronization as long
+// as it only writes row indices(i), and the result is the same as applying
+// the updates one after the other, duplicates included.
+//
+// All the indices are checked against [0, limit) first.  If one is out of
+// range, no update is applied and the smallest such i is returned;
+// otherwise returns -1.  Each index is read once, so the updates see the
+// indices that were checked even if "indices" changes concurrently.
+//
+// "cost_per_update" is the rough cost of one update, as for Shard().
+template <typename Index, typename UpdateFn>
+int64 ShardUpdatesByRow(const DeviceBase::CpuWorkerThreads& worker_threads,
+                        typename TTypes<Index>::ConstFlat indices, Index limit,
+                        int64 cost_per_update, UpdateFn update) {
+  const int64 n = indices.size();
+  std::vector<Index> rows(n);
+  for (int64 i = 0; i < n; ++i) {
+    rows[i] = internal::SubtleMustCopy(indices(i));
+    if (!FastBoundsCheck(rows[i], limit)) return i;
+  }
+
+  // Not worth partitioning when the updates would run on a single thread
+  // anyway (see Shard()).
+  static const int64 kMinCostPerBucket = 10000;
+  const int64 num_buckets = std::min<int64>(
+      worker_threads.num_threads, n * cost_per_update / kMinCostPerBucket);
+  if (num_buckets <= 1) {
+    for (int64 i = 0; i < n; ++i) update(i, rows[i]);
+    return -1;
+  }
+
+  // Counting sort of the updates into buckets by a hash of their row, which
+  // keeps the updates of each row in order.  The multiplicative hash spreads
+  // strided rows evenly over the buckets.
+  auto bucket_of = [num_buckets](Index row) {
+    const uint64 h = static_cast<uint64>(row) * 0x9E3779B97F4A7C15ull;
+    return static_cast<int64>((h >> 32) % num_buckets);
+  };
+  std::vector<int64> bucket_starts(num_buckets + 1, 0);
+  for (int64 i = 0; i < n; ++i) ++bucket_starts[bucket_of(rows[i]) + 1];
+  for (int64 b = 0; b < num_buckets; ++b) {
+    bucket_starts[b + 1] += bucket_starts[b];
+  }
+  std::vector<int64> order(n);
+  {
+    std::vector<int64> next(bucket_starts.begin(), bucket_starts.end() - 1);
+    for (int64 i = 0; i < n; ++i) order[next[bucket_of(rows[i])]++] = i;
+  }
+
+  Shard(worker_threads.num_threads, worker_threads.workers, num_buckets,
+        n / num_buckets * cost_per_update,
+        [&rows, &bucket_starts, &order, &update](int64 start, int64 end) {
+          for (int64 j = bucket_starts[start]; j < bucket_starts[end]; ++j) {
+            const int64 i = order[j];
+            update(i, rows[i]);
+          }
+        });
+  return -1;
+}
+
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_KERNELS_SPARSE_UPDATE_SHARDER_H_
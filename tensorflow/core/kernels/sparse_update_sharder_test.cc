@@ -0,0 +1,91 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/kernels/sparse_update_sharder.h"
+
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+class ShardUpdatesByRowTest : public ::testing::Test {
+ protected:
+  ShardUpdatesByRowTest() : pool_(Env::Default(), "test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+  }
+
+  // Applies updates to "num_rows" rows from "indices", and returns the
+  // updates applied to each row, in the order they were applied.
+  int64 Apply(const std::vector<int32>& indices, int32 num_rows,
+              int64 cost_per_update,
+              std::vector<std::vector<int64>>* applied) {
+    const Tensor t = test::AsTensor<int32>(indices);
+    applied->assign(num_rows, {});
+    return ShardUpdatesByRow<int32>(
+        worker_threads_, t.flat<int32>(), num_rows, cost_per_update,
+        [applied](int64 i, int32 row) { (*applied)[row].push_back(i); });
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(ShardUpdatesByRowTest, Serial) {
+  std::vector<std::vector<int64>> applied;
+  EXPECT_EQ(-1, Apply({2, 0, 2, 1}, 3, 1, &applied));
+  EXPECT_EQ(std::vector<int64>({1}), applied[0]);
+  EXPECT_EQ(std::vector<int64>({3}), applied[1]);
+  EXPECT_EQ(std::vector<int64>({0, 2}), applied[2]);
+}
+
+TEST_F(ShardUpdatesByRowTest, ParallelKeepsTheOrderOfEachRow) {
+  // Expensive enough updates to be partitioned across the threads, with
+  // many duplicate rows.
+  const int32 kRows = 1000;
+  const int kUpdates = 20000;
+  std::vector<int32> indices(kUpdates);
+  for (int i = 0; i < kUpdates; ++i) indices[i] = (i * 7919) % kRows;
+  std::vector<std::vector<int64>> applied;
+  EXPECT_EQ(-1, Apply(indices, kRows, 10000, &applied));
+  int64 total = 0;
+  for (int32 row = 0; row < kRows; ++row) {
+    for (size_t j = 0; j < applied[row].size(); ++j) {
+      EXPECT_EQ(row, indices[applied[row][j]]);
+      if (j > 0) EXPECT_LT(applied[row][j - 1], applied[row][j]);
+    }
+    total += applied[row].size();
+  }
+  EXPECT_EQ(kUpdates, total);
+}
+
+TEST_F(ShardUpdatesByRowTest, BadIndex) {
+  std::vector<int32> indices(20000, 1);
+  indices[500] = 3;
+  indices[700] = -1;
+  std::vector<std::vector<int64>> applied;
+  EXPECT_EQ(500, Apply(indices, 3, 10000, &applied));
+  // Nothing is applied.
+  for (const auto& rows : applied) EXPECT_TRUE(rows.empty());
+}
+
+}  // namespace
+}  // namespace tensorflow
@@ -14,6 +14,7 @@ limitations under the License.
 ==============================================================================*/
 
 #include <string>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/tensor.h"
@@ -21,9 +22,43 @@ limitations under the License.
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/hash/hash.h"
 #include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+// Rough cost of hashing one string, for sharding.
+static const int64 kCostPerString = 100;
+
+// Sets each element of the "output" of "context" to "hash" of the same
+// element of its first input, modulo "num_buckets".  The strings are hashed
+// by shards in parallel.
+template <typename Hasher>
+static void HashToBuckets(OpKernelContext* context, int64 num_buckets,
+                          Hasher hash) {
+  const Tensor& input_tensor = context->input(0);
+  const auto& input_flat = input_tensor.flat<string>();
+
+  Tensor* output_tensor = nullptr;
+  OP_REQUIRES_OK(context,
+                 context->allocate_output("output", input_tensor.shape(),
+                                          &output_tensor));
+  auto output_flat = output_tensor->flat<int64>();
+
+  auto worker_threads = *(context->device()->tensorflow_cpu_worker_threads());
+  Shard(worker_threads.num_threads, worker_threads.workers, input_flat.size(),
+        kCostPerString,
+        [&input_flat, &output_flat, num_buckets, &hash](int64 start,
+                                                        int64 limit) {
+          for (int64 i = start; i < limit; ++i) {
+            const uint64 bucket_id = hash(input_flat(i)) % num_buckets;
+            // The number of buckets is always in the positive range of int64
+            // so is the resulting bucket_id. Casting the bucket_id from uint64
+            // to int64 is safe.
+            output_flat(i) = static_cast<int64>(bucket_id);
+          }
+        });
+}
+
 class StringToHashBucketOp : public OpKernel {
  public:
   explicit StringToHashBucketOp(OpKernelConstruction* ctx) : OpKernel(ctx) {
@@ -31,25 +66,8 @@ class StringToHashBucketOp : public OpKernel {
   }
 
   void Compute(OpKernelContext* context) override {
-    const Tensor* input_tensor;
-    OP_REQUIRES_OK(context, context->input("string_tensor", &input_tensor));
-    const auto& input_flat = input_tensor->flat<string>();
-
-    Tensor* output_tensor = nullptr;
-    OP_REQUIRES_OK(context,
-                   context->allocate_output("output", input_tensor->shape(),
-                                            &output_tensor));
-    auto output_flat = output_tensor->flat<int64>();
-
-    typedef decltype(input_flat.size()) Index;
-    for (Index i = 0; i < input_flat.size(); ++i) {
-      const uint64 input_hash = Hash64(input_flat(i));
-      const uint64 bucket_id = input_hash % num_buckets_;
-      // The number of buckets is always in the positive range of int64 so is
-      // the resulting bucket_id. Casting the bucket_id from uint64 to int64 is
-      // safe.
-      output_flat(i) = static_cast<int64>(bucket_id);
-    }
+    HashToBuckets(context, num_buckets_,
+                  [](const string& s) { return Hash64(s); });
   }
 
  private:
@@ -61,4 +79,34 @@ class StringToHashBucketOp : public OpKernel {
 REGISTER_KERNEL_BUILDER(Name("StringToHashBucket").Device(DEVICE_CPU),
                         StringToHashBucketOp);
 
+class StringToHashBucketStrongOp : public OpKernel {
+ public:
+  explicit StringToHashBucketStrongOp(OpKernelConstruction* ctx)
+      : OpKernel(ctx) {
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("num_buckets", &num_buckets_));
+    std::vector<int64> key;
+    OP_REQUIRES_OK(ctx, ctx->GetAttr("key", &key));
+    OP_REQUIRES(ctx, key.size() == 2,
+                errors::InvalidArgument("Key must have 2 elements, got ",
+                                        key.size()));
+    key_[0] = static_cast<uint64>(key[0]);
+    key_[1] = static_cast<uint64>(key[1]);
+  }
+
+  void Compute(OpKernelContext* context) override {
+    const uint64* key = key_;
+    HashToBuckets(context, num_buckets_,
+                  [key](const string& s) { return KeyedHash64(key, s); });
+  }
+
+ private:
+  int64 num_buckets_;
+  uint64 key_[2];
+
+  TF_DISALLOW_COPY_AND_ASSIGN(StringToHashBucketStrongOp);
+};
+
+REGISTER_KERNEL_BUILDER(Name("StringToHashBucketStrong").Device(DEVICE_CPU),
+                        StringToHashBucketStrongOp);
+
 }  // namespace tensorflow
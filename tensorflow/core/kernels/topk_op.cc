@@ -17,16 +17,85 @@ limitations under the License.
 
 #define EIGEN_USE_THREADS
 
+#include <algorithm>
 #include <vector>
 #include "third_party/eigen3/unsupported/Eigen/CXX11/Tensor"
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
+#include "tensorflow/core/lib/core/bits.h"
 #include "tensorflow/core/lib/gtl/top_n.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
+namespace {
+
+// The second element of the pair is the negated index, so that lower-index
+// elements are considered larger than higher-index elements in case of ties.
+template <typename T>
+using TopKFilter = gtl::TopN<std::pair<T, int32>>;
+
+// Pushes the top k of row[begin, end) into "filter".
+template <typename T>
+void PushTopK(const T* row, int32 begin, int32 end, int k,
+              TopKFilter<T>* filter) {
+  if (k == 1) {
+    // Argmax: the first of the largest elements.
+    if (begin == end) return;
+    int32 best = begin;
+    T best_value = row[begin];
+    for (int32 c = begin + 1; c < end; ++c) {
+      if (row[c] > best_value) {
+        best = c;
+        best_value = row[c];
+      }
+    }
+    filter->push(std::make_pair(best_value, -best));
+    return;
+  }
+  int32 c = begin;
+  for (; c < end && filter->size() < k; ++c) {
+    filter->push(std::make_pair(row[c], -c));
+  }
+  if (c == end) return;
+  // Once there are k elements, only the elements larger than the smallest of
+  // them can get in: an equal element has a higher index.  Most elements are
+  // rejected with a single comparison.
+  T bottom = filter->peek_bottom().first;
+  for (; c < end; ++c) {
+    if (row[c] > bottom) {
+      filter->push(std::make_pair(row[c], -c));
+      bottom = filter->peek_bottom().first;
+    }
+  }
+}
+
+// Writes the elements of "filter" to "values" and "indices", sorted by
+// decreasing value if "sorted", and resets "filter".
+template <typename T>
+void PopTopK(bool sorted, TopKFilter<T>* filter, T* values, int32* indices) {
+  int32 i = 0;
+  if (sorted && filter->limit() > 1) {
+    std::unique_ptr<std::vector<std::pair<T, int32>>> top_k(filter->Extract());
+    for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
+         ++top_k_it, ++i) {
+      values[i] = top_k_it->first;
+      indices[i] = -top_k_it->second;
+    }
+  } else {
+    for (auto top_k_it = filter->unsorted_begin();
+         top_k_it != filter->unsorted_end(); ++top_k_it, ++i) {
+      values[i] = top_k_it->first;
+      indices[i] = -top_k_it->second;
+    }
+  }
+  filter->Reset();
+}
+
+}  // namespace
+
 template <typename T>
 class TopK : public OpKernel {
  public:
@@ -71,37 +140,79 @@ class TopK : public OpKernel {
     OP_REQUIRES_OK(context,
                    context->allocate_output(1, output_shape, &indices_out));
 
-    // Nothing to do for top-nothing.
-    if (k == 0) return;
+    // Nothing to do for top-nothing or for no rows.
+    if (k == 0 || num_rows == 0) return;
 
     auto values = values_out->flat_inner_dims<T>();
     auto indices = indices_out->flat_inner_dims<int32>();
-    gtl::TopN<std::pair<T, int32>> filter(k);
-    for (int r = 0; r < num_rows; r++) {
-      for (int32 c = 0; c < num_cols; ++c) {
-        // The second element is the negated index, so that lower-index elements
-        // are considered larger than higher-index elements in case of ties.
-        filter.push(std::make_pair(input(r, c), -c));
-      }
-
-      int32 i = 0;
-      if (sorted_ && k > 1) {
-        std::unique_ptr<std::vector<std::pair<T, int32>>> top_k(
-            filter.Extract());
-        for (auto top_k_it = top_k->begin(); top_k_it != top_k->end();
-             ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    const bool sorted = sorted_;
+
+    // Rough cost of looking at one element, and of sorting the results.
+    static const int64 kCostPerElement = 4;
+    const int64 extract_cost =
+        sorted ? k * Log2Ceiling(k + 1) * kCostPerElement : k;
+
+    // When there are too few rows to keep the threads busy, the rows are
+    // also cut into chunks, each of them large compared to k: the top k of
+    // each chunk are selected in parallel, and then merged.
+    static const int64 kMinChunkSize = 16384;
+    const int64 max_chunks = num_cols / std::max<int64>(kMinChunkSize, 4 * k);
+    const int64 num_chunks = std::min<int64>(
+        max_chunks,
+        (worker_threads.num_threads + num_rows - 1) / num_rows);
+
+    if (num_chunks <= 1) {
+      auto shard = [&input, &values, &indices, num_cols, k, sorted](
+          int64 start, int64 limit) {
+        TopKFilter<T> filter(k);
+        for (int64 r = start; r < limit; ++r) {
+          PushTopK(&input(r, 0), 0, num_cols, k, &filter);
+          PopTopK(sorted, &filter, &values(r, 0), &indices(r, 0));
         }
-      } else {
-        for (auto top_k_it = filter.unsorted_begin();
-             top_k_it != filter.unsorted_end(); ++top_k_it, ++i) {
-          values(r, i) = top_k_it->first;
-          indices(r, i) = -top_k_it->second;
+      };
+      Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+            num_cols * kCostPerElement + extract_cost, shard);
+      return;
+    }
+
+    const int64 chunk_size = (num_cols + num_chunks - 1) / num_chunks;
+    std::vector<T> chunk_values(num_rows * num_chunks * k);
+    std::vector<int32> chunk_indices(num_rows * num_chunks * k);
+    std::vector<int32> chunk_counts(num_rows * num_chunks);
+    auto select_chunks = [&input, &chunk_values, &chunk_indices,
+                          &chunk_counts, num_cols, num_chunks, chunk_size, k](
+        int64 start, int64 limit) {
+      TopKFilter<T> filter(k);
+      for (int64 u = start; u < limit; ++u) {
+        const int64 r = u / num_chunks;
+        const int32 begin = (u % num_chunks) * chunk_size;
+        const int32 end = std::min<int64>(begin + chunk_size, num_cols);
+        PushTopK(&input(r, 0), begin, end, k, &filter);
+        chunk_counts[u] = filter.size();
+        PopTopK(false, &filter, &chunk_values[u * k], &chunk_indices[u * k]);
+      }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers,
+          num_rows * num_chunks, chunk_size * kCostPerElement + k,
+          select_chunks);
+
+    auto merge = [&chunk_values, &chunk_indices, &chunk_counts, &values,
+                  &indices, num_chunks, k, sorted](int64 start, int64 limit) {
+      TopKFilter<T> filter(k);
+      for (int64 r = start; r < limit; ++r) {
+        for (int64 u = r * num_chunks; u < (r + 1) * num_chunks; ++u) {
+          for (int32 i = 0; i < chunk_counts[u]; ++i) {
+            filter.push(std::make_pair(chunk_values[u * k + i],
+                                       -chunk_indices[u * k + i]));
+          }
         }
+        PopTopK(sorted, &filter, &values(r, 0), &indices(r, 0));
       }
-      filter.Reset();
-    }
+    };
+    Shard(worker_threads.num_threads, worker_threads.workers, num_rows,
+          num_chunks * k * kCostPerElement + extract_cost, merge);
   }
 
  private:
@@ -0,0 +1,180 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
+#include "tensorflow/core/framework/op_kernel.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/framework/types.h"
+#include "tensorflow/core/graph/node_builder.h"
+#include "tensorflow/core/graph/testlib.h"
+#include "tensorflow/core/kernels/ops_testutil.h"
+#include "tensorflow/core/kernels/ops_util.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+class TopKOpTest : public OpsTestBase {
+ protected:
+  // Runs the kernel on 4 threads, so that wide rows are cut into chunks
+  // whatever the number of cores.
+  TopKOpTest() : pool_(Env::Default(), "test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  void MakeOp(bool sorted) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", "TopKV2")
+                     .Input(FakeInput(DT_FLOAT))
+                     .Input(FakeInput(DT_INT32))
+                     .Attr("sorted", sorted)
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Checks the top k of each row of a random [rows, cols] input, with many
+  // ties, against a stable sort.
+  void CheckRandom(int rows, int cols, int k, bool sorted) {
+    MakeOp(sorted);
+    random::PhiloxRandom philox(301, 17);
+    random::SimplePhilox rnd(&philox);
+    std::vector<float> input(rows * cols);
+    for (float& x : input) x = rnd.Uniform(cols / 2);
+    AddInputFromArray<float>(TensorShape({rows, cols}), input);
+    AddInputFromArray<int32>(TensorShape({}), {k});
+    TF_ASSERT_OK(RunOpKernel());
+
+    auto values = GetOutput(0)->matrix<float>();
+    auto indices = GetOutput(1)->matrix<int32>();
+    for (int r = 0; r < rows; ++r) {
+      std::vector<int32> expected(cols);
+      for (int c = 0; c < cols; ++c) expected[c] = c;
+      const float* row = &input[r * cols];
+      std::stable_sort(expected.begin(), expected.end(),
+                       [row](int32 a, int32 b) { return row[a] > row[b]; });
+      expected.resize(k);
+      std::vector<int32> actual(&indices(r, 0), &indices(r, 0) + k);
+      if (!sorted) std::sort(actual.begin(), actual.end());
+      if (!sorted) std::sort(expected.begin(), expected.end());
+      EXPECT_EQ(expected, actual) << "row " << r;
+      for (int i = 0; i < k; ++i) {
+        EXPECT_EQ(row[indices(r, i)], values(r, i));
+      }
+    }
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(TopKOpTest, Sorted) {
+  MakeOp(true);
+  AddInputFromArray<float>(TensorShape({2, 4}), {1, 3, 2, 3, 4, 1, 4, 0});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({2, 3}));
+  test::FillValues<float>(&expected_values, {3, 3, 2, 4, 4, 1});
+  test::ExpectTensorEqual<float>(expected_values, *GetOutput(0));
+  Tensor expected_indices(allocator(), DT_INT32, TensorShape({2, 3}));
+  test::FillValues<int32>(&expected_indices, {1, 3, 2, 0, 2, 1});
+  test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(1));
+}
+
+TEST_F(TopKOpTest, Argmax) {
+  MakeOp(true);
+  AddInputFromArray<float>(TensorShape({3, 3}), {1, 3, 3, 5, 4, 5, 0, 0, 0});
+  AddInputFromArray<int32>(TensorShape({}), {1});
+  TF_ASSERT_OK(RunOpKernel());
+
+  Tensor expected_values(allocator(), DT_FLOAT, TensorShape({3, 1}));
+  test::FillValues<float>(&expected_values, {3, 5, 0});
+  test::ExpectTensorEqual<float>(expected_values, *GetOutput(0));
+  Tensor expected_indices(allocator(), DT_INT32, TensorShape({3, 1}));
+  test::FillValues<int32>(&expected_indices, {1, 0, 0});
+  test::ExpectTensorEqual<int32>(expected_indices, *GetOutput(1));
+}
+
+TEST_F(TopKOpTest, Zero) {
+  MakeOp(true);
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({}), {0});
+  TF_ASSERT_OK(RunOpKernel());
+  EXPECT_EQ("[2,0]", GetOutput(0)->shape().DebugString());
+  EXPECT_EQ("[2,0]", GetOutput(1)->shape().DebugString());
+}
+
+TEST_F(TopKOpTest, ManyRows) { CheckRandom(100, 300, 10, true); }
+
+TEST_F(TopKOpTest, WideRows) {
+  // Few enough rows for each of them to be cut into chunks.
+  CheckRandom(2, 100000, 100, true);
+}
+
+TEST_F(TopKOpTest, WideRowsUnsorted) { CheckRandom(1, 100000, 7, false); }
+
+TEST_F(TopKOpTest, WideRowsArgmax) { CheckRandom(3, 70000, 1, true); }
+
+TEST_F(TopKOpTest, KTooLarge) {
+  MakeOp(true);
+  AddInputFromArray<float>(TensorShape({2, 2}), {1, 2, 3, 4});
+  AddInputFromArray<int32>(TensorShape({}), {3});
+  Status s = RunOpKernel();
+  EXPECT_TRUE(StringPiece(s.ToString()).contains("at least k columns")) << s;
+}
+
+// Takes the top k of each row of a random [batch, vocab] matrix.
+static Graph* TopK(int batch, int vocab, int k) {
+  Graph* g = new Graph(OpRegistry::Global());
+  Tensor input(DT_FLOAT, TensorShape({batch, vocab}));
+  input.flat<float>().setRandom();
+  Tensor k_tensor(DT_INT32, TensorShape({}));
+  k_tensor.scalar<int32>()() = k;
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "TopKV2")
+                  .Input(test::graph::Constant(g, input))
+                  .Input(test::graph::Constant(g, k_tensor))
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_TOPK(BATCH, K)                                                  \
+  static void BM_TopK_##BATCH##_##K(int iters, int vocab) {                \
+    testing::UseRealTime();                                                \
+    testing::ItemsProcessed(static_cast<int64>(iters) * BATCH * vocab);   \
+    test::Benchmark("cpu", TopK(BATCH, vocab, K)).Run(iters);              \
+  }                                                                        \
+  BENCHMARK(BM_TopK_##BATCH##_##K)->Arg(1000)->Arg(100000)->Arg(1000000);
+
+BM_TOPK(1, 1);
+BM_TOPK(1, 100);
+BM_TOPK(32, 1);
+BM_TOPK(32, 100);
+
+}  // namespace
+}  // namespace tensorflow
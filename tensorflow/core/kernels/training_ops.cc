@@ -17,6 +17,8 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/training_ops.h"
 #include "tensorflow/core/kernels/bounds_check.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
+#include "tensorflow/core/kernels/sparse_update_sharder.h"
 
 #include "tensorflow/core/framework/op_kernel.h"
 
@@ -208,11 +210,13 @@ class ApplyGradientDescentOp : public OpKernel {
     functor::ApplyGradientDescent<Device, T>()(
         device, var.flat<T>(), alpha.scalar<T>(), delta.flat<T>());
 
+    dirty_rows_.MarkAll(ctx, {0});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 #define REGISTER_KERNELS(D, T)                                                \
@@ -268,11 +272,13 @@ class ApplyAdadeltaOp : public OpKernel {
       if (!ctx->status().ok()) return;
       DoCompute(ctx);
     }
+    dirty_rows_.MarkAll(ctx, {0, 1, 2});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 
   void DoValidate(OpKernelContext* ctx) {
     Tensor var = ctx->mutable_input(0, use_exclusive_lock_);
@@ -448,17 +454,12 @@ class SparseApplyAdadeltaOp : public OpKernel {
             "grad must be the same size as indices in the first dimension."));
 
     if (N > 0) {
+      ScopedDirtyRowMarker<Tindex> marker(&dirty_rows_, ctx, indices);
+      marker.Add(0, var);
+      marker.Add(1, accum_grad);
+      marker.Add(2, accum_update);
       const Tindex first_dim_size = var.dim_size(0);
-      // Validate all the indices are in range
       auto indices_vec = indices.vec<Tindex>();
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        OP_REQUIRES(ctx, index >= 0 && index < first_dim_size,
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-      }
-
       auto var_flat = var.flat_outer_dims<T>();
       auto accum_grad_flat = accum_grad.flat_outer_dims<T>();
       auto accum_update_flat = accum_update.flat_outer_dims<T>();
@@ -467,23 +468,36 @@ class SparseApplyAdadeltaOp : public OpKernel {
       const T rho_scalar = rho.scalar<T>()();
       const T epsilon_scalar = epsilon.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = indices_vec(i);
-        auto accum_ = accum_grad_flat.template chip<0>(index);
-        auto accum_update_ = accum_update_flat.template chip<0>(index);
-        auto grad_ = grad_flat.template chip<0>(i);
-
-        accum_ = accum_ * accum_.constant(rho_scalar) +
-                 grad_.square() * grad_.constant(T(1) - rho_scalar);
-        const auto update =
-            (accum_update_ + accum_update_.constant(epsilon_scalar)).sqrt() *
-            (accum_ + accum_.constant(epsilon_scalar)).rsqrt() * grad_;
-        accum_update_ =
-            accum_update_ * accum_update_.constant(rho_scalar) +
-            update.square() * update.constant(static_cast<T>(1) - rho_scalar);
-
-        auto v = var_flat.template chip<0>(index);
-        v -= update * update.constant(lr_scalar);
+      // All the indices are validated before any row is updated.
+      const int64 bad_i = ShardUpdatesByRow<Tindex>(
+          *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+          first_dim_size, 10 + 10 * grad_flat.dimension(1),
+          [&](int64 i, Tindex index) {
+            auto accum_ = accum_grad_flat.template chip<0>(index);
+            auto accum_update_ = accum_update_flat.template chip<0>(index);
+            auto grad_ = grad_flat.template chip<0>(i);
+
+            accum_ = accum_ * accum_.constant(rho_scalar) +
+                     grad_.square() * grad_.constant(T(1) - rho_scalar);
+            const auto update =
+                (accum_update_ + accum_update_.constant(epsilon_scalar))
+                    .sqrt() *
+                (accum_ + accum_.constant(epsilon_scalar)).rsqrt() * grad_;
+            accum_update_ = accum_update_ * accum_update_.constant(rho_scalar) +
+                            update.square() *
+                                update.constant(static_cast<T>(1) - rho_scalar);
+
+            auto v = var_flat.template chip<0>(index);
+            v -= update * update.constant(lr_scalar);
+          });
+      if (bad_i >= 0) {
+        if (use_exclusive_lock_) {
+          mu_var->unlock();
+        }
+        ctx->SetStatus(errors::InvalidArgument(
+            strings::StrCat("Index ", indices_vec(bad_i), " at offset ", bad_i,
+                            " in indices is out of range")));
+        return;
       }
     }
     if (use_exclusive_lock_) {
@@ -495,6 +509,7 @@ class SparseApplyAdadeltaOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -552,11 +567,13 @@ class ApplyAdagradOp : public OpKernel {
     functor::ApplyAdagrad<Device, T>()(device, var.flat<T>(), accum.flat<T>(),
                                        lr.scalar<T>(), grad.flat<T>());
 
+    dirty_rows_.MarkAll(ctx, {0, 1});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -670,6 +687,11 @@ class SparseApplyAdagradOp : public OpKernel {
             "grad must be the same size as indices in the first dimension."));
 
     if (N > 0) {
+      ScopedDirtyRowMarker<Tindex> marker(&dirty_rows_, ctx, indices);
+      marker.Add(0, var);
+      marker.Add(1, accum);
+      // All the indices are validated before any row is updated.
+      int64 bad_i = -1;
       if (inner_dim > 1) {
         const Tindex first_dim_size = var.dim_size(0);
         auto indices_vec = indices.vec<Tindex>();
@@ -678,20 +700,16 @@ class SparseApplyAdagradOp : public OpKernel {
         auto grad_flat = grad.flat_outer_dims<T>();
         T lr_scalar = lr.scalar<T>()();
 
-        // Note(yonghui): It might be worth multi-threading square() and
-        // rsqrt().
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto a = accum_flat.template chip<0>(index);
-          auto g = grad_flat.template chip<0>(i);
-          auto v = var_flat.template chip<0>(index);
-          a += g.square();
-          v -= g.constant(lr_scalar) * g * a.rsqrt();
-        }
+        bad_i = ShardUpdatesByRow<Tindex>(
+            *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+            first_dim_size, 10 + 10 * grad_flat.dimension(1),
+            [&](int64 i, Tindex index) {
+              auto a = accum_flat.template chip<0>(index);
+              auto g = grad_flat.template chip<0>(i);
+              auto v = var_flat.template chip<0>(index);
+              a += g.square();
+              v -= g.constant(lr_scalar) * g * a.rsqrt();
+            });
       } else {
         CHECK_EQ(1, inner_dim);
         auto indices_vec = indices.vec<Tindex>();
@@ -701,18 +719,19 @@ class SparseApplyAdagradOp : public OpKernel {
         T lr_scalar = lr.scalar<T>()();
         const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          const T& g = grad_flat(i);
-          a += g * g;
-          var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
-        }
+        bad_i = ShardUpdatesByRow<Tindex>(
+            *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+            first_dim_size, 20, [&](int64 i, Tindex index) {
+              T& a = accum_flat(index);
+              const T& g = grad_flat(i);
+              a += g * g;
+              var_flat(index) -= lr_scalar * g / Eigen::numext::sqrt(a);
+            });
       }
+      OP_REQUIRES(ctx, bad_i < 0,
+                  errors::InvalidArgument(strings::StrCat(
+                      "Index ", indices.vec<Tindex>()(bad_i), " at offset ",
+                      bad_i, " in indices is out of range")));
     }
 
     ctx->forward_ref_input_to_ref_output(0, 0);
@@ -720,6 +739,7 @@ class SparseApplyAdagradOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -806,11 +826,13 @@ class ApplyFtrlOp : public OpKernel {
                                     lr.scalar<T>(), l1.scalar<T>(),
                                     l2.scalar<T>(), lr_power.scalar<T>());
 
+    dirty_rows_.MarkAll(ctx, {0, 1, 2});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -902,6 +924,12 @@ class SparseApplyFtrlOp : public OpKernel {
             "grad must be the same size as indices in the first dimension."));
 
     if (N > 0) {
+      ScopedDirtyRowMarker<Tindex> marker(&dirty_rows_, ctx, indices);
+      marker.Add(0, var);
+      marker.Add(1, accum);
+      marker.Add(2, linear);
+      // All the indices are validated before any row is updated.
+      int64 bad_i = -1;
       if (inner_dim > 1) {
         const Tindex first_dim_size = var.dim_size(0);
         auto indices_vec = indices.vec<Tindex>();
@@ -914,42 +942,40 @@ class SparseApplyFtrlOp : public OpKernel {
         T l2_scalar = l2.scalar<T>()();
         T lr_power_scalar = lr_power.scalar<T>()();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          auto accum = accum_flat.template chip<0>(index);
-          auto linear = linear_flat.template chip<0>(index);
-          auto grad = grad_flat.template chip<0>(i);
-          auto var = var_flat.template chip<0>(index);
-
-          auto new_accum = accum + grad.square();
-          if (lr_power_scalar == static_cast<T>(-0.5)) {
-            linear +=
-                grad - (new_accum.sqrt() - accum.sqrt()) / lr_scalar * var;
-          } else {
-            linear += grad -
-                      (new_accum.pow(-lr_power_scalar) -
-                       accum.pow(-lr_power_scalar)) /
-                          lr_scalar * var;
-          }
-          auto x = (linear.constant(l1_scalar) * linear.sign() - linear);
-          if (lr_power_scalar == static_cast<T>(-0.5)) {
-            auto y = new_accum.sqrt() / new_accum.constant(lr_scalar) +
-                     linear.constant(static_cast<T>(2) * l2_scalar);
-            var = x / y;
-          } else {
-            auto y = new_accum.pow(-lr_power_scalar) /
-                         new_accum.constant(lr_scalar) +
-                     linear.constant(static_cast<T>(2) * l2_scalar);
-            var = x / y;
-          }
-          var = (linear.abs() > linear.constant(l1_scalar))
-                    .select(var, var.constant(static_cast<T>(0)));
-          accum += grad.square();
-        }
+        bad_i = ShardUpdatesByRow<Tindex>(
+            *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+            first_dim_size, 10 + 30 * grad_flat.dimension(1),
+            [&](int64 i, Tindex index) {
+              auto accum = accum_flat.template chip<0>(index);
+              auto linear = linear_flat.template chip<0>(index);
+              auto grad = grad_flat.template chip<0>(i);
+              auto var = var_flat.template chip<0>(index);
+
+              auto new_accum = accum + grad.square();
+              if (lr_power_scalar == static_cast<T>(-0.5)) {
+                linear +=
+                    grad - (new_accum.sqrt() - accum.sqrt()) / lr_scalar * var;
+              } else {
+                linear += grad -
+                          (new_accum.pow(-lr_power_scalar) -
+                           accum.pow(-lr_power_scalar)) /
+                              lr_scalar * var;
+              }
+              auto x = (linear.constant(l1_scalar) * linear.sign() - linear);
+              if (lr_power_scalar == static_cast<T>(-0.5)) {
+                auto y = new_accum.sqrt() / new_accum.constant(lr_scalar) +
+                         linear.constant(static_cast<T>(2) * l2_scalar);
+                var = x / y;
+              } else {
+                auto y = new_accum.pow(-lr_power_scalar) /
+                             new_accum.constant(lr_scalar) +
+                         linear.constant(static_cast<T>(2) * l2_scalar);
+                var = x / y;
+              }
+              var = (linear.abs() > linear.constant(l1_scalar))
+                        .select(var, var.constant(static_cast<T>(0)));
+              accum += grad.square();
+            });
       } else {
         CHECK_EQ(1, inner_dim);
         auto indices_vec = indices.vec<Tindex>();
@@ -963,28 +989,30 @@ class SparseApplyFtrlOp : public OpKernel {
         T lr_power_scalar = lr_power.scalar<T>()();
         const Tindex first_dim_size = accum_flat.size();
 
-        for (Tindex i = 0; i < N; i++) {
-          const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-          OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                      errors::InvalidArgument(
-                          strings::StrCat("Index ", index, " at offset ", i,
-                                          " in indices is out of range")));
-          T& a = accum_flat(index);
-          T& l = linear_flat(index);
-          T& v = var_flat(index);
-          const T& g = grad_flat(i);
-
-          T updated_a = a + g * g;
-          using Eigen::numext::pow;
-          T sigma = pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
-          sigma /= lr_scalar;
-          T updated_l = l + g - sigma * v;
-          v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar, l2_scalar,
-                          lr_power_scalar);
-          a = updated_a;
-          l = updated_l;
-        }
+        bad_i = ShardUpdatesByRow<Tindex>(
+            *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+            first_dim_size, 100, [&](int64 i, Tindex index) {
+              T& a = accum_flat(index);
+              T& l = linear_flat(index);
+              T& v = var_flat(index);
+              const T& g = grad_flat(i);
+
+              T updated_a = a + g * g;
+              using Eigen::numext::pow;
+              T sigma =
+                  pow(updated_a, -lr_power_scalar) - pow(a, -lr_power_scalar);
+              sigma /= lr_scalar;
+              T updated_l = l + g - sigma * v;
+              v = FtrlCompute(updated_a, updated_l, lr_scalar, l1_scalar,
+                              l2_scalar, lr_power_scalar);
+              a = updated_a;
+              l = updated_l;
+            });
       }
+      OP_REQUIRES(ctx, bad_i < 0,
+                  errors::InvalidArgument(strings::StrCat(
+                      "Index ", indices.vec<Tindex>()(bad_i), " at offset ",
+                      bad_i, " in indices is out of range")));
     }
 
     ctx->forward_ref_input_to_ref_output(0, 0);
@@ -992,6 +1020,7 @@ class SparseApplyFtrlOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -1054,11 +1083,13 @@ class ApplyMomentumOp : public OpKernel {
     functor::ApplyMomentum<Device, T>()(device, var.flat<T>(), accum.flat<T>(),
                                         lr.scalar<T>(), grad.flat<T>(),
                                         momentum.scalar<T>());
+    dirty_rows_.MarkAll(ctx, {0, 1});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -1151,6 +1182,9 @@ class SparseApplyMomentumOp : public OpKernel {
                                         momentum.shape().DebugString()));
 
     if (N > 0) {
+      ScopedDirtyRowMarker<Tindex> marker(&dirty_rows_, ctx, indices);
+      marker.Add(0, var);
+      marker.Add(1, accum);
       const Tindex first_dim_size = var.dim_size(0);
       auto indices_vec = indices.vec<Tindex>();
       auto var_flat = var.flat_outer_dims<T>();
@@ -1159,18 +1193,21 @@ class SparseApplyMomentumOp : public OpKernel {
       T lr_scalar = lr.scalar<T>()();
       T momentum_scalar = momentum.scalar<T>()();
 
-      for (Tindex i = 0; i < N; i++) {
-        const Tindex index = internal::SubtleMustCopy(indices_vec(i));
-        OP_REQUIRES(ctx, FastBoundsCheck(index, first_dim_size),
-                    errors::InvalidArgument(
-                        strings::StrCat("Index ", index, " at offset ", i,
-                                        " in indices is out of range")));
-        auto a = accum_flat.template chip<0>(index);
-        auto g = grad_flat.template chip<0>(i);
-        auto v = var_flat.template chip<0>(index);
-        a = a * a.constant(momentum_scalar) + g;
-        v -= a.constant(lr_scalar) * a;
-      }
+      // All the indices are validated before any row is updated.
+      const int64 bad_i = ShardUpdatesByRow<Tindex>(
+          *ctx->device()->tensorflow_cpu_worker_threads(), indices_vec,
+          first_dim_size, 10 + 5 * grad_flat.dimension(1),
+          [&](int64 i, Tindex index) {
+            auto a = accum_flat.template chip<0>(index);
+            auto g = grad_flat.template chip<0>(i);
+            auto v = var_flat.template chip<0>(index);
+            a = a * a.constant(momentum_scalar) + g;
+            v -= a.constant(lr_scalar) * a;
+          });
+      OP_REQUIRES(ctx, bad_i < 0,
+                  errors::InvalidArgument(strings::StrCat(
+                      "Index ", indices_vec(bad_i), " at offset ", bad_i,
+                      " in indices is out of range")));
     }
 
     ctx->forward_ref_input_to_ref_output(0, 0);
@@ -1178,6 +1215,7 @@ class SparseApplyMomentumOp : public OpKernel {
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 #define REGISTER_KERNELS(T, Tindices)                                \
@@ -1269,11 +1307,13 @@ class ApplyAdamOp : public OpKernel {
                                     beta1.scalar<T>(), beta2.scalar<T>(),
                                     epsilon.scalar<T>(), grad.flat<T>());
 
+    dirty_rows_.MarkAll(ctx, {0, 1, 2});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
@@ -1384,11 +1424,13 @@ class ApplyRMSPropOp : public OpKernel {
                                        rho.scalar<T>(), momentum.scalar<T>(),
                                        epsilon.scalar<T>(), grad.flat<T>());
 
+    dirty_rows_.MarkAll(ctx, {0, 1, 2});
     ctx->forward_ref_input_to_ref_output(0, 0);
   }
 
  private:
   bool use_exclusive_lock_;
+  DirtyRowMarker dirty_rows_;
 };
 
 typedef Eigen::ThreadPoolDevice CPUDevice;
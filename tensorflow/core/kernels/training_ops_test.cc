@@ -117,6 +117,55 @@ static void BM_Adagrad(int iters, int params) {
 }
 BENCHMARK(BM_Adagrad)->Arg(128 << 10)->Arg(256 << 10);
 
+// Applies "num_updates" rows of gradient to random rows, with duplicates, of
+// a [64K, 64] variable.
+static void SparseAdagrad(int32 num_updates, Graph** init_g,
+                          Graph** train_g) {
+  const int32 kRows = 64 << 10;
+  const int32 kDim = 64;
+  TensorShape shape({kRows, kDim});
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = test::graph::Var(g, DT_FLOAT, shape);
+    auto accum = test::graph::Var(g, DT_FLOAT, shape);
+    Tensor zero(DT_FLOAT, shape);
+    zero.flat<float>().setZero();
+    test::graph::Assign(g, var, test::graph::Constant(g, zero));
+    test::graph::Assign(g, accum, test::graph::Constant(g, zero));
+    *init_g = g;
+  }
+  {
+    Graph* g = new Graph(OpRegistry::Global());
+    auto var = test::graph::Var(g, DT_FLOAT, shape);
+    auto accum = test::graph::Var(g, DT_FLOAT, shape);
+    auto lr = Scalar(g, 0.01);
+    Tensor grad(DT_FLOAT, TensorShape({num_updates, kDim}));
+    grad.flat<float>().setRandom();
+    Tensor indices(DT_INT32, TensorShape({num_updates}));
+    for (int32 i = 0; i < num_updates; ++i) {
+      indices.flat<int32>()(i) = (i * 7919) % (kRows / 4);
+    }
+    test::graph::Multi(g, "SparseApplyAdagrad",
+                       {var, accum, lr, test::graph::Constant(g, grad),
+                        test::graph::Constant(g, indices)});
+    *train_g = g;
+  }
+}
+
+// Sparse updates are partitioned across the intra-op thread pool, so they
+// run with the default options.
+static void BM_SparseAdagrad(int iters, int num_updates) {
+  const int64 tot = static_cast<int64>(iters) * num_updates * 64;
+  testing::UseRealTime();
+  testing::ItemsProcessed(tot);
+  testing::BytesProcessed(tot * sizeof(float));
+  Graph* init;
+  Graph* train;
+  SparseAdagrad(num_updates, &init, &train);
+  test::Benchmark("cpu", train, nullptr, init).Run(iters);
+}
+BENCHMARK(BM_SparseAdagrad)->Arg(1 << 10)->Arg(16 << 10);
+
 static void Momentum(int32 n, Graph** init_g, Graph** train_g) {
   TensorShape shape({n});
   {
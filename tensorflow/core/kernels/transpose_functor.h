@@ -18,6 +18,7 @@ limitations under the License.
 
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_types.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
 
 namespace tensorflow {
 
@@ -47,6 +48,17 @@ void ComputeStride(const TensorShape& shape, Index* strides) {
   }
 }
 
+// Rewrites the transpose of a tensor of shape "shape" by "perm" into the
+// same transpose of a tensor of lower rank: dimensions of size 1 are dropped
+// and input dimensions that stay adjacent, and in order, in the output are
+// merged.  On return, "dims" holds the input dimensions and "new_perm" the
+// permutation of the equivalent transpose.  E.g., shape [2, 1, 3, 4] and
+// perm [1, 2, 3, 0] becomes dims [2, 12] and new_perm [1, 0].
+void ReduceTransposeDimensions(const TensorShape& shape,
+                               gtl::ArraySlice<int32> perm,
+                               gtl::InlinedVector<int64, 8>* dims,
+                               gtl::InlinedVector<int32, 8>* new_perm);
+
 // Device-specific naive implementation for transpose.
 template <typename Device, typename T>
 void TransposeSimple(const Device& d, const Tensor& in,
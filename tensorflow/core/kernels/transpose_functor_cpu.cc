@@ -17,52 +17,196 @@ limitations under the License.
 
 #include "tensorflow/core/kernels/transpose_functor.h"
 
+#include <algorithm>
+
 namespace tensorflow {
 namespace internal {
 
-template <typename Device, typename T>
-void TransposeSimple(const Device& d, const Tensor& in,
-                     const gtl::ArraySlice<int32> perm, Tensor* out) {
-  const int ndims = in.dims();
+void ReduceTransposeDimensions(const TensorShape& shape,
+                               gtl::ArraySlice<int32> perm,
+                               gtl::InlinedVector<int64, 8>* dims,
+                               gtl::InlinedVector<int32, 8>* new_perm) {
+  const int ndims = shape.dims();
+  // Drops the dimensions of size 1.
+  gtl::InlinedVector<int32, 8> new_index(ndims, -1);
+  gtl::InlinedVector<int64, 8> kept_dims;
+  for (int i = 0; i < ndims; ++i) {
+    if (shape.dim_size(i) != 1) {
+      new_index[i] = kept_dims.size();
+      kept_dims.push_back(shape.dim_size(i));
+    }
+  }
+  gtl::InlinedVector<int32, 8> kept_perm;
+  for (int i = 0; i < ndims; ++i) {
+    if (new_index[perm[i]] >= 0) kept_perm.push_back(new_index[perm[i]]);
+  }
+
+  // Groups the output dimensions whose input dimensions are consecutive.
+  // group_of[j] is the group of kept input dimension j, and a group is
+  // numbered by its first output dimension.
+  const int kept = kept_perm.size();
+  gtl::InlinedVector<int32, 8> group_of(kept, -1);
+  int num_groups = 0;
+  for (int i = 0; i < kept; ++i) {
+    if (i == 0 || kept_perm[i] != kept_perm[i - 1] + 1) ++num_groups;
+    group_of[kept_perm[i]] = num_groups - 1;
+  }
+
+  // The groups, in input order, are the new input dimensions.
+  dims->clear();
+  gtl::InlinedVector<int32, 8> input_position(num_groups);
+  for (int j = 0; j < kept; ++j) {
+    if (j == 0 || group_of[j] != group_of[j - 1]) {
+      input_position[group_of[j]] = dims->size();
+      dims->push_back(kept_dims[j]);
+    } else {
+      dims->back() *= kept_dims[j];
+    }
+  }
+  new_perm->resize(num_groups);
+  for (int g = 0; g < num_groups; ++g) (*new_perm)[g] = input_position[g];
+}
+
+namespace {
+
+// Transposes "in" into "out" when the innermost dimension is not permuted:
+// the output is a sequence of runs of "run" elements, each of them
+// contiguous in the input.  The runs are sharded across the threads of "d".
+template <typename T>
+void TransposeRuns(const Eigen::ThreadPoolDevice& d, const T* in,
+                   gtl::ArraySlice<int64> dims, gtl::ArraySlice<int32> perm,
+                   T* out) {
+  const int ndims = dims.size();
+  const int64 run = dims[ndims - 1];
   gtl::InlinedVector<int64, 8> in_strides(ndims);
-  ComputeStride(in.shape(), in_strides.data());
+  int64 nelem = 1;
+  for (int i = ndims - 1; i >= 0; --i) {
+    in_strides[i] = nelem;
+    nelem *= dims[i];
+  }
+  const int64 num_runs = nelem / run;
+  auto work = [in, out, ndims, run, &dims, &perm, &in_strides](
+      Eigen::Index first, Eigen::Index last) {
+    // Index of the first run along the outer output dimensions, and the
+    // offset of the run in the input.  Both are then updated incrementally.
+    gtl::InlinedVector<int64, 8> index(ndims - 1);
+    int64 in_offset = 0;
+    int64 t = first;
+    for (int i = ndims - 2; i >= 0; --i) {
+      index[i] = t % dims[perm[i]];
+      t /= dims[perm[i]];
+      in_offset += index[i] * in_strides[perm[i]];
+    }
+    T* dst = out + first * run;
+    for (Eigen::Index r = first; r < last; ++r) {
+      std::copy(in + in_offset, in + in_offset + run, dst);
+      dst += run;
+      for (int i = ndims - 2; i >= 0; --i) {
+        in_offset += in_strides[perm[i]];
+        if (++index[i] < dims[perm[i]]) break;
+        in_offset -= index[i] * in_strides[perm[i]];
+        index[i] = 0;
+      }
+    }
+  };
+  d.parallelFor(num_runs,
+                Eigen::TensorOpCost(run * sizeof(T), run * sizeof(T), ndims),
+                work);
+}
+
+// Transposes "in" into "out" when the innermost dimension is permuted.  The
+// innermost output dimension and the output dimension that is innermost in
+// the input are cut into square tiles, so that both the reads and the
+// writes of a tile stay within a few cache lines per row.  Each shard is a
+// range of tiles, outer output dimensions included.
+template <typename T>
+void TransposeTiles(const Eigen::ThreadPoolDevice& d, const T* in,
+                    gtl::ArraySlice<int64> dims, gtl::ArraySlice<int32> perm,
+                    T* out) {
+  const int ndims = dims.size();
+  gtl::InlinedVector<int64, 8> in_strides(ndims);
+  int64 nelem = 1;
+  for (int i = ndims - 1; i >= 0; --i) {
+    in_strides[i] = nelem;
+    nelem *= dims[i];
+  }
+  gtl::InlinedVector<int64, 8> out_dims(ndims);
   gtl::InlinedVector<int64, 8> out_strides(ndims);
-  ComputeStride(out->shape(), out_strides.data());
-  const int64 nelem = in.NumElements();
-  const T* p = reinterpret_cast<const T*>(in.tensor_data().data());
-  T* q = reinterpret_cast<T*>(const_cast<char*>((out->tensor_data().data())));
+  int64 stride = 1;
+  for (int i = ndims - 1; i >= 0; --i) {
+    out_dims[i] = dims[perm[i]];
+    out_strides[i] = stride;
+    stride *= out_dims[i];
+  }
+
+  // Output dimension "a" is contiguous in the output, and output dimension
+  // "b" is contiguous in the input.
+  const int a = ndims - 1;
+  const int b = std::find(perm.begin(), perm.end(), ndims - 1) - perm.begin();
+  const int64 a_size = out_dims[a];
+  const int64 b_size = out_dims[b];
+  const int64 a_in_stride = in_strides[perm[a]];
+  const int64 b_out_stride = out_strides[b];
+  // 128 bytes along each side: 32x32 tiles of 4 byte elements.
+  const int64 tile = std::max<int64>(8, 128 / sizeof(T));
+  const int64 a_tiles = (a_size + tile - 1) / tile;
+  const int64 b_tiles = (b_size + tile - 1) / tile;
+  const int64 num_outer = nelem / (a_size * b_size);
 
-  // TODO(zhifengc): Shard by range.
-  // TODO(zhifengc): Avoids the division.
-  for (int64 o_idx = 0; o_idx < nelem; ++o_idx) {
-    int64 i_idx = 0;
-    int64 t = o_idx;
-    for (int i = 0; i < ndims; ++i) {
-      i_idx += (t / out_strides[i]) * in_strides[perm[i]];
-      t = t % out_strides[i];
+  auto work = [=, &out_dims, &out_strides, &in_strides, &perm](
+      Eigen::Index first, Eigen::Index last) {
+    for (Eigen::Index u = first; u < last; ++u) {
+      const int64 a0 = (u % a_tiles) * tile;
+      const int64 a1 = std::min(a0 + tile, a_size);
+      const int64 b0 = (u / a_tiles % b_tiles) * tile;
+      const int64 b1 = std::min(b0 + tile, b_size);
+      int64 t = u / (a_tiles * b_tiles);
+      int64 in_offset = 0;
+      int64 out_offset = 0;
+      for (int i = ndims - 2; i >= 0; --i) {
+        if (i == b) continue;
+        const int64 index = t % out_dims[i];
+        t /= out_dims[i];
+        in_offset += index * in_strides[perm[i]];
+        out_offset += index * out_strides[i];
+      }
+      for (int64 j = b0; j < b1; ++j) {
+        const T* src = in + in_offset + j + a0 * a_in_stride;
+        T* dst = out + out_offset + j * b_out_stride + a0;
+        for (int64 i = 0; i < a1 - a0; ++i) {
+          dst[i] = src[i * a_in_stride];
+        }
+      }
     }
-    q[o_idx] = p[i_idx];
-  }
+  };
+  const double tile_bytes = tile * tile * sizeof(T);
+  d.parallelFor(num_outer * a_tiles * b_tiles,
+                Eigen::TensorOpCost(tile_bytes, tile_bytes, tile * tile),
+                work);
 }
 
-template <typename Device, typename T, int NDIMS>
-void TransposeUsingEigen(const Device& d, const Tensor& in,
-                         const gtl::ArraySlice<int32> perm, Tensor* out) {
-  Eigen::array<int, NDIMS> p;
-  for (int i = 0; i < NDIMS; ++i) p[i] = perm[i];
-  auto x = typename TTypes<T, NDIMS>::ConstTensor(
-      reinterpret_cast<const T*>(in.tensor_data().data()),
-      in.shape().AsEigenDSizes<NDIMS>());
-  auto y = typename TTypes<T, NDIMS>::Tensor(
-      reinterpret_cast<T*>(const_cast<char*>(out->tensor_data().data())),
-      out->shape().AsEigenDSizes<NDIMS>());
-  auto nelem = in.NumElements();
-  static const int64 kInlineThreshold = 131072;
-  if (nelem * sizeof(T) < kInlineThreshold) {
-    // Don't bother multi-threaded transpose if 'in' is small.
-    y = x.shuffle(p);
+}  // namespace
+
+template <typename T>
+void TransposeCpu(const Eigen::ThreadPoolDevice& d, const Tensor& in,
+                  const gtl::ArraySlice<int32> perm, Tensor* out) {
+  const T* p = reinterpret_cast<const T*>(in.tensor_data().data());
+  T* q = reinterpret_cast<T*>(const_cast<char*>((out->tensor_data().data())));
+  const int64 nelem = in.NumElements();
+  if (nelem == 0) return;
+  gtl::InlinedVector<int64, 8> dims;
+  gtl::InlinedVector<int32, 8> new_perm;
+  ReduceTransposeDimensions(in.shape(), perm, &dims, &new_perm);
+  if (dims.size() <= 1) {
+    // Nothing is actually permuted.
+    d.parallelFor(nelem, Eigen::TensorOpCost(sizeof(T), sizeof(T), 0),
+                  [p, q](Eigen::Index first, Eigen::Index last) {
+                    std::copy(p + first, p + last, q + first);
+                  });
+  } else if (new_perm.back() == new_perm.size() - 1) {
+    TransposeRuns<T>(d, p, dims, new_perm, q);
   } else {
-    y.device(d) = x.shuffle(p);
+    TransposeTiles<T>(d, p, dims, new_perm, q);
   }
 }
 
@@ -83,7 +227,7 @@ Status DoTranspose<Device>(const Device& d, const Tensor& in,
     case DT_QINT8:
     case DT_QUINT8:
     case DT_UINT8:
-      internal::Transpose<Device, uint8>(d, in, perm, out);
+      internal::TransposeCpu<uint8>(d, in, perm, out);
       break;
 
     case DT_BFLOAT16:
@@ -91,23 +235,23 @@ Status DoTranspose<Device>(const Device& d, const Tensor& in,
     case DT_QINT16:
     case DT_QUINT16:
     case DT_UINT16:
-      internal::Transpose<Device, uint16>(d, in, perm, out);
+      internal::TransposeCpu<uint16>(d, in, perm, out);
       break;
 
     case DT_FLOAT:
     case DT_INT32:
     case DT_QINT32:
-      internal::Transpose<Device, uint32>(d, in, perm, out);
+      internal::TransposeCpu<uint32>(d, in, perm, out);
       break;
 
     case DT_COMPLEX64:
     case DT_DOUBLE:
     case DT_INT64:
-      internal::Transpose<Device, uint64>(d, in, perm, out);
+      internal::TransposeCpu<uint64>(d, in, perm, out);
       break;
 
     case DT_STRING:
-      internal::Transpose<Device, string>(d, in, perm, out);
+      internal::TransposeCpu<string>(d, in, perm, out);
       break;
 
     default:
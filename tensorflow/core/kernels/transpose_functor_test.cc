@@ -0,0 +1,213 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#define EIGEN_USE_THREADS
+
+#include "tensorflow/core/kernels/transpose_functor.h"
+
+#include <vector>
+
+#include "tensorflow/core/common_runtime/eigen_thread_pool.h"
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+
+namespace tensorflow {
+namespace {
+
+// Transposes "in" one element at a time.
+template <typename T>
+Tensor ReferenceTranspose(const Tensor& in, const std::vector<int32>& perm) {
+  const int ndims = in.dims();
+  TensorShape out_shape;
+  for (int i = 0; i < ndims; ++i) out_shape.AddDim(in.dim_size(perm[i]));
+  Tensor out(in.dtype(), out_shape);
+  std::vector<int64> in_strides(ndims);
+  internal::ComputeStride(in.shape(), in_strides.data());
+  std::vector<int64> out_strides(ndims);
+  internal::ComputeStride(out_shape, out_strides.data());
+  auto x = in.flat<T>();
+  auto y = out.flat<T>();
+  for (int64 o = 0; o < out.NumElements(); ++o) {
+    int64 i = 0;
+    int64 t = o;
+    for (int d = 0; d < ndims; ++d) {
+      i += (t / out_strides[d]) * in_strides[perm[d]];
+      t %= out_strides[d];
+    }
+    y(o) = x(i);
+  }
+  return out;
+}
+
+class TransposeFunctorTest : public ::testing::Test {
+ protected:
+  TransposeFunctorTest()
+      : pool_(Env::Default(), "test", 4),
+        wrapper_(&pool_),
+        device_(&wrapper_, 4) {}
+
+  template <typename T>
+  void Check(const Tensor& in, const std::vector<int32>& perm) {
+    Tensor expected = ReferenceTranspose<T>(in, perm);
+    Tensor out(in.dtype(), expected.shape());
+    TF_ASSERT_OK(DoTranspose(device_, in, perm, &out));
+    test::ExpectTensorEqual<T>(expected, out);
+  }
+
+  void CheckFloat(const std::vector<int64>& dims,
+                  const std::vector<int32>& perm) {
+    Tensor in(DT_FLOAT, TensorShape(dims));
+    test::FillIota<float>(&in, 0);
+    Check<float>(in, perm);
+  }
+
+  thread::ThreadPool pool_;
+  EigenThreadPoolWrapper wrapper_;
+  Eigen::ThreadPoolDevice device_;
+};
+
+TEST_F(TransposeFunctorTest, ReduceDimensions) {
+  gtl::InlinedVector<int64, 8> dims;
+  gtl::InlinedVector<int32, 8> perm;
+  internal::ReduceTransposeDimensions(TensorShape({2, 1, 3, 4}), {1, 2, 3, 0},
+                                      &dims, &perm);
+  EXPECT_EQ((gtl::InlinedVector<int64, 8>{2, 12}), dims);
+  EXPECT_EQ((gtl::InlinedVector<int32, 8>{1, 0}), perm);
+
+  // NHWC to NCHW.
+  internal::ReduceTransposeDimensions(TensorShape({8, 5, 6, 3}), {0, 3, 1, 2},
+                                      &dims, &perm);
+  EXPECT_EQ((gtl::InlinedVector<int64, 8>{8, 30, 3}), dims);
+  EXPECT_EQ((gtl::InlinedVector<int32, 8>{0, 2, 1}), perm);
+
+  // Nothing is permuted.
+  internal::ReduceTransposeDimensions(TensorShape({1, 3, 4, 1}), {3, 1, 2, 0},
+                                      &dims, &perm);
+  EXPECT_EQ((gtl::InlinedVector<int64, 8>{12}), dims);
+  EXPECT_EQ((gtl::InlinedVector<int32, 8>{0}), perm);
+}
+
+TEST_F(TransposeFunctorTest, Identity) {
+  CheckFloat({3, 4}, {0, 1});
+  CheckFloat({1, 7, 1}, {2, 1, 0});
+}
+
+TEST_F(TransposeFunctorTest, Empty) { CheckFloat({3, 0, 2}, {2, 0, 1}); }
+
+TEST_F(TransposeFunctorTest, Matrix) {
+  CheckFloat({2, 3}, {1, 0});
+  // Spans several tiles along both dimensions, with partial tiles.
+  CheckFloat({100, 70}, {1, 0});
+  CheckFloat({1000, 300}, {1, 0});
+}
+
+TEST_F(TransposeFunctorTest, TrailingDimensionUnchanged) {
+  CheckFloat({4, 5, 6}, {1, 0, 2});
+  CheckFloat({64, 32, 16, 8}, {2, 0, 1, 3});
+  CheckFloat({300, 200, 2}, {1, 0, 2});
+}
+
+TEST_F(TransposeFunctorTest, Layouts) {
+  // NHWC to NCHW and back.
+  CheckFloat({8, 28, 28, 64}, {0, 3, 1, 2});
+  CheckFloat({8, 64, 28, 28}, {0, 2, 3, 1});
+  // Attention heads: [batch, time, heads, depth] to [batch, heads, time,
+  // depth].
+  CheckFloat({4, 50, 8, 64}, {0, 2, 1, 3});
+}
+
+TEST_F(TransposeFunctorTest, Random) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  for (int iter = 0; iter < 200; ++iter) {
+    const int ndims = 2 + rnd.Uniform(5);
+    std::vector<int64> dims(ndims);
+    for (int i = 0; i < ndims; ++i) dims[i] = 1 + rnd.Uniform(12);
+    std::vector<int32> perm(ndims);
+    for (int i = 0; i < ndims; ++i) perm[i] = i;
+    for (int i = ndims - 1; i > 0; --i) {
+      std::swap(perm[i], perm[rnd.Uniform(i + 1)]);
+    }
+    CheckFloat(dims, perm);
+  }
+}
+
+TEST_F(TransposeFunctorTest, Types) {
+  Tensor bytes(DT_UINT8, TensorShape({33, 65, 3}));
+  test::FillFn<uint8>(&bytes, [](int i) { return i * 7; });
+  Check<uint8>(bytes, {2, 0, 1});
+  Tensor doubles(DT_DOUBLE, TensorShape({17, 9, 40}));
+  test::FillIota<double>(&doubles, 0);
+  Check<double>(doubles, {2, 1, 0});
+  Tensor strings(DT_STRING, TensorShape({10, 11, 3}));
+  test::FillFn<string>(&strings, [](int i) { return strings::StrCat(i); });
+  Check<string>(strings, {1, 2, 0});
+  Check<string>(strings, {1, 0, 2});
+}
+
+static void BM_Transpose(int iters, int num_threads,
+                         const std::vector<int64>& dims,
+                         const std::vector<int32>& perm) {
+  testing::StopTiming();
+  thread::ThreadPool pool(Env::Default(), "test", num_threads);
+  EigenThreadPoolWrapper wrapper(&pool);
+  Eigen::ThreadPoolDevice device(&wrapper, num_threads);
+  Tensor in(DT_FLOAT, TensorShape(dims));
+  in.flat<float>().setRandom();
+  TensorShape out_shape;
+  for (int32 d : perm) out_shape.AddDim(dims[d]);
+  Tensor out(DT_FLOAT, out_shape);
+  testing::BytesProcessed(static_cast<int64>(iters) * in.TotalBytes());
+  testing::UseRealTime();
+  testing::StartTiming();
+  for (int i = 0; i < iters; ++i) {
+    TF_CHECK_OK(DoTranspose(device, in, perm, &out));
+  }
+}
+
+static void BM_Transpose_NHWC_to_NCHW(int iters, int num_threads) {
+  BM_Transpose(iters, num_threads, {32, 56, 56, 64}, {0, 3, 1, 2});
+}
+BENCHMARK(BM_Transpose_NHWC_to_NCHW)->Arg(1)->Arg(4);
+
+static void BM_Transpose_NCHW_to_NHWC(int iters, int num_threads) {
+  BM_Transpose(iters, num_threads, {32, 64, 56, 56}, {0, 2, 3, 1});
+}
+BENCHMARK(BM_Transpose_NCHW_to_NHWC)->Arg(1)->Arg(4);
+
+static void BM_Transpose_Attention(int iters, int num_threads) {
+  BM_Transpose(iters, num_threads, {32, 128, 8, 64}, {0, 2, 1, 3});
+}
+BENCHMARK(BM_Transpose_Attention)->Arg(1)->Arg(4);
+
+static void BM_Transpose_Matrix(int iters, int num_threads) {
+  BM_Transpose(iters, num_threads, {2048, 2048}, {1, 0});
+}
+BENCHMARK(BM_Transpose_Matrix)->Arg(1)->Arg(4);
+
+static void BM_Transpose_Rank5(int iters, int num_threads) {
+  BM_Transpose(iters, num_threads, {8, 16, 12, 20, 24}, {4, 2, 0, 3, 1});
+}
+BENCHMARK(BM_Transpose_Rank5)->Arg(1)->Arg(4);
+
+}  // namespace
+}  // namespace tensorflow
@@ -13,14 +13,18 @@ See the License for the specific language governing permissions and
 limitations under the License.
 ==============================================================================*/
 
-#include <unordered_map>
+#include <algorithm>
+#include <functional>
 #include <utility>
+#include <vector>
 
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/tensor.h"
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/gtl/flatmap.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -49,23 +53,29 @@ class UniqueOp : public OpKernel {
     OP_REQUIRES_OK(context, context->allocate_output(1, input.shape(), &idx));
     auto idx_vec = idx->template vec<int32>();
 
-    std::unordered_map<T, int32> uniq;
-    uniq.reserve(2 * N);
-    for (int64 i = 0, j = 0; i < N; ++i) {
-      auto it = uniq.insert(std::make_pair(Tin(i), j));
-      idx_vec(i) = it.first->second;
-      if (it.second) {
-        ++j;
+    const DeviceBase::CpuWorkerThreads& worker_threads =
+        *(context->device()->tensorflow_cpu_worker_threads());
+    std::vector<T> uniq;
+    if (N < kMinParallelSize || worker_threads.num_threads <= 1) {
+      gtl::FlatMap<T, int32> ids(N < kMaxReserve ? N : kMaxReserve);
+      for (int64 i = 0; i < N; ++i) {
+        auto it =
+            ids.insert(std::make_pair(Tin(i), static_cast<int32>(uniq.size())));
+        idx_vec(i) = it.first->second;
+        if (it.second) {
+          uniq.push_back(Tin(i));
+        }
       }
+    } else {
+      ParallelUnique(worker_threads, Tin, idx_vec, &uniq);
     }
     int64 uniq_size = static_cast<int64>(uniq.size());
     Tensor* output = nullptr;
     OP_REQUIRES_OK(context, context->allocate_output(
                                 0, TensorShape({uniq_size}), &output));
     auto output_vec = output->template vec<T>();
-
-    for (auto it : uniq) {
-      output_vec(it.second) = it.first;
+    for (int64 j = 0; j < uniq_size; ++j) {
+      output_vec(j) = uniq[j];
     }
 
     if (num_outputs() > 2) {
@@ -78,6 +88,80 @@ class UniqueOp : public OpKernel {
       }
     }
   }
+
+ private:
+  // Inputs smaller than this are deduplicated by one thread.
+  static const int64 kMinParallelSize = 1 << 16;
+  // The map grows beyond this as needed; reserving room for every element
+  // would spread a few distinct values over a table much larger than cache.
+  static const int64 kMaxReserve = 1 << 14;
+
+  // Deduplicates "x" across "worker_threads": the elements are partitioned
+  // by a hash of their value, and each partition finds the first occurrence
+  // of each of its elements with its own map.  The ids are then assigned in
+  // order of first occurrence, as with a single map.
+  static void ParallelUnique(
+      const DeviceBase::CpuWorkerThreads& worker_threads,
+      typename TTypes<T>::ConstVec x, typename TTypes<int32>::Vec idx,
+      std::vector<T>* uniq) {
+    const int64 n = x.size();
+    const int num_parts = std::min(worker_threads.num_threads, 256);
+    // Rough cost of hashing an element, and of a map insertion.
+    static const int64 kHashCost = 10;
+    static const int64 kInsertCost = 50;
+
+    // The input is cut into "num_parts" contiguous chunks, each of which is
+    // scanned once to split its elements among the partitions:
+    // buckets[c * num_parts + p] holds the positions in chunk "c" of the
+    // elements of partition "p", in increasing order.
+    const int64 chunk_size = (n + num_parts - 1) / num_parts;
+    std::vector<std::vector<int32>> buckets(num_parts * num_parts);
+    Shard(worker_threads.num_threads, worker_threads.workers, num_parts,
+          chunk_size * kHashCost,
+          [&x, &buckets, n, num_parts, chunk_size](int64 start, int64 limit) {
+            std::hash<T> hasher;
+            for (int64 c = start; c < limit; ++c) {
+              std::vector<int32>* chunk_buckets = &buckets[c * num_parts];
+              for (int p = 0; p < num_parts; ++p) {
+                chunk_buckets[p].reserve(chunk_size / num_parts);
+              }
+              const int64 end = std::min(n, (c + 1) * chunk_size);
+              for (int64 i = c * chunk_size; i < end; ++i) {
+                const uint64 h = static_cast<uint64>(hasher(x(i))) *
+                                 0x9E3779B97F4A7C15ull;
+                chunk_buckets[(h >> 32) % num_parts].push_back(i);
+              }
+            }
+          });
+
+    // first[i] is the first occurrence of x(i).  Each partition visits its
+    // buckets in chunk order, so its elements in increasing position.
+    std::vector<int32> first(n);
+    Shard(worker_threads.num_threads, worker_threads.workers, num_parts,
+          n / num_parts * kInsertCost,
+          [&x, &buckets, &first, n, num_parts](int64 start, int64 limit) {
+            const int64 reserve =
+                n / num_parts < kMaxReserve ? n / num_parts : kMaxReserve;
+            for (int64 p = start; p < limit; ++p) {
+              gtl::FlatMap<T, int32> firsts(reserve);
+              for (int c = 0; c < num_parts; ++c) {
+                for (const int32 i : buckets[c * num_parts + p]) {
+                  first[i] = firsts.insert(std::make_pair(x(i), i))
+                                 .first->second;
+                }
+              }
+            }
+          });
+
+    for (int64 i = 0; i < n; ++i) {
+      if (first[i] == i) {
+        idx(i) = uniq->size();
+        uniq->push_back(x(i));
+      } else {
+        idx(i) = idx(first[i]);
+      }
+    }
+  }
 };
 
 #define REGISTER_UNIQUE(type)                                                \
@@ -15,9 +15,14 @@ limitations under the License.
 
 #include <functional>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/common_runtime/kernel_benchmark_testlib.h"
+#include "tensorflow/core/framework/fake_input.h"
+#include "tensorflow/core/framework/node_def_builder.h"
 #include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
 #include "tensorflow/core/framework/types.h"
 #include "tensorflow/core/framework/types.pb.h"
 #include "tensorflow/core/graph/node_builder.h"
@@ -25,6 +30,9 @@ limitations under the License.
 #include "tensorflow/core/kernels/ops_testutil.h"
 #include "tensorflow/core/kernels/ops_util.h"
 #include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/test.h"
 #include "tensorflow/core/platform/test_benchmark.h"
 
@@ -32,6 +40,91 @@ namespace tensorflow {
 
 namespace {
 
+class UniqueOpTest : public OpsTestBase {
+ protected:
+  // Runs the kernel on 4 threads, so that large inputs are partitioned
+  // whatever the number of cores.
+  UniqueOpTest() : pool_(Env::Default(), "test", 4) {
+    worker_threads_.num_threads = 4;
+    worker_threads_.workers = &pool_;
+    device_->set_tensorflow_cpu_worker_threads(&worker_threads_);
+  }
+
+  void MakeOp(const string& op) {
+    TF_ASSERT_OK(NodeDefBuilder("myop", op)
+                     .Input(FakeInput(DT_INT64))
+                     .Finalize(node_def()));
+    TF_ASSERT_OK(InitOp());
+  }
+
+  // Checks the outputs of UniqueWithCounts on "x" against a std map.
+  void Check(const std::vector<int64>& x) {
+    MakeOp("UniqueWithCounts");
+    AddInputFromArray<int64>(TensorShape({static_cast<int64>(x.size())}), x);
+    TF_ASSERT_OK(RunOpKernel());
+
+    std::unordered_map<int64, int32> ids;
+    std::vector<int64> y;
+    std::vector<int32> idx;
+    std::vector<int32> count;
+    for (int64 v : x) {
+      auto it = ids.insert(std::make_pair(v, y.size()));
+      if (it.second) {
+        y.push_back(v);
+        count.push_back(0);
+      }
+      idx.push_back(it.first->second);
+      ++count[it.first->second];
+    }
+    test::ExpectTensorEqual<int64>(test::AsTensor<int64>(y), *GetOutput(0));
+    test::ExpectTensorEqual<int32>(test::AsTensor<int32>(idx), *GetOutput(1));
+    test::ExpectTensorEqual<int32>(test::AsTensor<int32>(count),
+                                   *GetOutput(2));
+  }
+
+  thread::ThreadPool pool_;
+  DeviceBase::CpuWorkerThreads worker_threads_;
+};
+
+TEST_F(UniqueOpTest, Small) {
+  MakeOp("Unique");
+  AddInputFromArray<int64>(TensorShape({6}), {5, 3, 5, 7, 3, 5});
+  TF_ASSERT_OK(RunOpKernel());
+
+  test::ExpectTensorEqual<int64>(test::AsTensor<int64>({5, 3, 7}),
+                                 *GetOutput(0));
+  test::ExpectTensorEqual<int32>(test::AsTensor<int32>({0, 1, 0, 2, 1, 0}),
+                                 *GetOutput(1));
+}
+
+TEST_F(UniqueOpTest, Empty) { Check({}); }
+
+TEST_F(UniqueOpTest, WithCounts) { Check({1, 2, 1, 1, 4, 2}); }
+
+TEST_F(UniqueOpTest, Large) {
+  // Large enough to be partitioned across the threads.
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> x(200000);
+  for (int64& v : x) v = rnd.Uniform(20000);
+  Check(x);
+}
+
+TEST_F(UniqueOpTest, LargeUnevenChunks) {
+  // The chunks scanned by each thread are not all the same size.
+  random::PhiloxRandom philox(302, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> x(100003);
+  for (int64& v : x) v = rnd.Uniform(300);
+  Check(x);
+}
+
+TEST_F(UniqueOpTest, LargeAllDistinct) {
+  std::vector<int64> x(100000);
+  for (int i = 0; i < x.size(); ++i) x[i] = x.size() - i;
+  Check(x);
+}
+
 static void BM_Unique(int iters, int dim) {
   testing::StopTiming();
   Graph* g = new Graph(OpRegistry::Global());
@@ -60,5 +153,31 @@ BENCHMARK(BM_Unique)
     ->Arg(64 * 1024)
     ->Arg(256 * 1024);
 
+// Deduplicates "n" ids drawn from [0, distinct).
+static Graph* UniqueIds(int n, int distinct) {
+  Graph* g = new Graph(OpRegistry::Global());
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Tensor x(DT_INT64, TensorShape({n}));
+  for (int i = 0; i < n; ++i) x.flat<int64>()(i) = rnd.Uniform64(distinct);
+  Node* ret;
+  TF_CHECK_OK(NodeBuilder(g->NewName("n"), "Unique")
+                  .Input(test::graph::Constant(g, x))
+                  .Finalize(g, &ret));
+  return g;
+}
+
+#define BM_UNIQUE_IDS(DISTINCT)                                    \
+  static void BM_UniqueIds_##DISTINCT(int iters, int n) {          \
+    testing::UseRealTime();                                        \
+    testing::ItemsProcessed(static_cast<int64>(iters) * n);        \
+    test::Benchmark("cpu", UniqueIds(n, DISTINCT)).Run(iters);     \
+  }                                                                \
+  BENCHMARK(BM_UniqueIds_##DISTINCT)->Arg(10000)->Arg(1000000);
+
+BM_UNIQUE_IDS(1000);
+BM_UNIQUE_IDS(100000);
+BM_UNIQUE_IDS(100000000);
+
 }  // namespace
 }  // namespace tensorflow
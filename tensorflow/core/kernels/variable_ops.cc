@@ -30,6 +30,10 @@ REGISTER_KERNEL_BUILDER(Name("DestroyTemporaryVariable").Device(DEVICE_CPU),
                         DestroyTemporaryVariableOp);
 REGISTER_KERNEL_BUILDER(Name("IsVariableInitialized").Device(DEVICE_CPU),
                         IsVariableInitializedOp);
+REGISTER_KERNEL_BUILDER(Name("TakeDirtyRows").Device(DEVICE_CPU),
+                        TakeDirtyRowsOp);
+REGISTER_KERNEL_BUILDER(Name("CommitDirtyRows").Device(DEVICE_CPU),
+                        CommitDirtyRowsOp);
 
 #if GOOGLE_CUDA
 // Only register 'Variable' on GPU for the subset of types also supported by
@@ -50,7 +54,17 @@ REGISTER_KERNEL_BUILDER(Name("IsVariableInitialized").Device(DEVICE_CPU),
                               .Device(DEVICE_GPU)                        \
                               .TypeConstraint<type>("dtype")             \
                               .HostMemory("is_initialized"),             \
-                          IsVariableInitializedOp);
+                          IsVariableInitializedOp);                      \
+  REGISTER_KERNEL_BUILDER(Name("TakeDirtyRows")                          \
+                              .Device(DEVICE_GPU)                        \
+                              .TypeConstraint<type>("T")                 \
+                              .HostMemory("rows"),                       \
+                          TakeDirtyRowsOp);                              \
+  REGISTER_KERNEL_BUILDER(Name("CommitDirtyRows")                        \
+                              .Device(DEVICE_GPU)                        \
+                              .TypeConstraint<type>("T")                 \
+                              .HostMemory("rows"),                       \
+                          CommitDirtyRowsOp);
 
 TF_CALL_GPU_NUMBER_TYPES(REGISTER_GPU_KERNELS);
 #undef REGISTER_GPU_KERNELS
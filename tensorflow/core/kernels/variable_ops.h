@@ -19,6 +19,7 @@ limitations under the License.
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/register_types.h"
 #include "tensorflow/core/framework/resource_mgr.h"
+#include "tensorflow/core/kernels/dirty_rows.h"
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/mutex.h"
@@ -74,7 +75,7 @@ class VariableOp : public OpKernel {
     mutex mu_;
     Tensor tensor_;
 
-    ~Var() override {}
+    ~Var() override { DirtyRowTracker::Global()->Forget(&mu_); }
     TF_DISALLOW_COPY_AND_ASSIGN(Var);
   };
 
@@ -174,6 +175,50 @@ class IsVariableInitializedOp : public OpKernel {
   }
 };
 
+class TakeDirtyRowsOp : public OpKernel {
+ public:
+  explicit TakeDirtyRowsOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor var = context->mutable_input(0, false);
+    OP_REQUIRES(context, var.IsInitialized(),
+                errors::FailedPrecondition(
+                    "Attempting to use uninitialized variable: ",
+                    def().input(0)));
+    OP_REQUIRES(context, TensorShapeUtils::IsVectorOrHigher(var.shape()),
+                errors::InvalidArgument("ref must be at least 1-D, got shape ",
+                                        var.shape().DebugString()));
+    std::vector<int64> rows;
+    DirtyRowTracker::Global()->TakeRows(context->input_ref_mutex(0), var,
+                                        &rows);
+    Tensor* output = nullptr;
+    OP_REQUIRES_OK(context,
+                   context->allocate_output(
+                       0, TensorShape({static_cast<int64>(rows.size())}),
+                       &output));
+    std::copy(rows.begin(), rows.end(), output->vec<int64>().data());
+  }
+};
+
+class CommitDirtyRowsOp : public OpKernel {
+ public:
+  explicit CommitDirtyRowsOp(OpKernelConstruction* context)
+      : OpKernel(context) {}
+
+  void Compute(OpKernelContext* context) override {
+    const Tensor var = context->mutable_input(0, false);
+    const Tensor& rows = context->input(1);
+    OP_REQUIRES(context, TensorShapeUtils::IsVector(rows.shape()),
+                errors::InvalidArgument("rows must be a vector, got shape ",
+                                        rows.shape().DebugString()));
+    if (!var.IsInitialized()) return;
+    DirtyRowTracker::Global()->CommitRows(context->input_ref_mutex(0), var,
+                                          rows.vec<int64>().data(),
+                                          rows.NumElements());
+  }
+};
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_KERNELS_VARIABLE_OPS_H_
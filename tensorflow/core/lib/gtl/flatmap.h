@@ -0,0 +1,164 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LIB_GTL_FLATMAP_H_
+#define TENSORFLOW_LIB_GTL_FLATMAP_H_
+
+#include <stddef.h>
+#include <functional>
+#include <initializer_list>
+#include <tuple>
+#include <utility>
+
+#include "tensorflow/core/lib/gtl/flatrep.h"
+
+namespace tensorflow {
+namespace gtl {
+
+// FlatMap<K,V,...> provides a map from K to V.
+//
+// The map is implemented using an open-addressed hash table.  A single
+// array holds the entries, so there is no allocation per entry, and a probe
+// looks at the control bytes of 8 entries at once (see FlatRep).
+//
+// The interface is a subset of std::unordered_map.  Differences:
+//
+// * Inserting or erasing may invalidate all iterators, pointers and
+//   references to the entries; inserting may move the entries.
+// * reserve(n) makes room for n entries without rehashing, and the
+//   constructor reserves room for its first argument.
+// * There are no buckets, and no bucket interface.
+template <class Key, class Val, class Hash = std::hash<Key>,
+          class Eq = std::equal_to<Key>>
+class FlatMap {
+ private:
+  struct KeyOf {
+    const Key& operator()(const std::pair<const Key, Val>& v) const {
+      return v.first;
+    }
+  };
+  typedef internal::FlatRep<Key, std::pair<const Key, Val>, Hash, Eq, KeyOf>
+      Rep;
+
+ public:
+  typedef Key key_type;
+  typedef Val mapped_type;
+  typedef Hash hasher;
+  typedef Eq key_equal;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef std::pair<const Key, Val> value_type;
+  typedef value_type* pointer;
+  typedef const value_type* const_pointer;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+  typedef internal::FlatRepIterator<Rep, value_type> iterator;
+  typedef internal::FlatRepIterator<const Rep, const value_type>
+      const_iterator;
+
+  explicit FlatMap(size_t n = 0, const Hash& hf = Hash(), const Eq& eq = Eq())
+      : rep_(n, hf, eq) {}
+
+  template <typename InputIter>
+  FlatMap(InputIter first, InputIter last, size_t n = 0,
+          const Hash& hf = Hash(), const Eq& eq = Eq())
+      : FlatMap(n, hf, eq) {
+    insert(first, last);
+  }
+
+  FlatMap(std::initializer_list<value_type> init, size_t n = 0,
+          const Hash& hf = Hash(), const Eq& eq = Eq())
+      : FlatMap(init.begin(), init.end(), n, hf, eq) {}
+
+  FlatMap(const FlatMap&) = default;
+  FlatMap(FlatMap&&) = default;  // NOLINT(build/c++11)
+  FlatMap& operator=(const FlatMap&) = default;
+
+  size_t size() const { return rep_.size(); }
+  bool empty() const { return size() == 0; }
+  // Number of entries the map can hold without rehashing.
+  size_t capacity() const { return rep_.capacity() - rep_.capacity() / 8; }
+
+  hasher hash_function() const { return rep_.hash_function(); }
+  key_equal key_eq() const { return rep_.key_eq(); }
+
+  void clear() { rep_.clear(); }
+  void reserve(size_t n) { rep_.reserve(n); }
+  void swap(FlatMap& x) { rep_.swap(x.rep_); }
+
+  iterator begin() { return iterator(&rep_, rep_.SkipUnused(0)); }
+  iterator end() { return iterator(&rep_, rep_.capacity()); }
+  const_iterator begin() const {
+    return const_iterator(&rep_, rep_.SkipUnused(0));
+  }
+  const_iterator end() const {
+    return const_iterator(&rep_, rep_.capacity());
+  }
+
+  size_t count(const Key& k) const {
+    return rep_.Find(k) == rep_.capacity() ? 0 : 1;
+  }
+  iterator find(const Key& k) { return iterator(&rep_, rep_.Find(k)); }
+  const_iterator find(const Key& k) const {
+    return const_iterator(&rep_, rep_.Find(k));
+  }
+
+  // Inserts the entry of "k", constructing its value from "args", if there
+  // is none (as std::unordered_map::try_emplace does).
+  template <typename... Args>
+  std::pair<iterator, bool> try_emplace(const Key& k, Args&&... args) {
+    auto r = rep_.Emplace(k, std::piecewise_construct, std::forward_as_tuple(k),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+    return std::make_pair(iterator(&rep_, r.first), r.second);
+  }
+
+  std::pair<iterator, bool> insert(const value_type& v) {
+    auto r = rep_.Emplace(v.first, v);
+    return std::make_pair(iterator(&rep_, r.first), r.second);
+  }
+  template <typename InputIter>
+  void insert(InputIter first, InputIter last) {
+    for (; first != last; ++first) insert(*first);
+  }
+
+  Val& operator[](const Key& k) { return try_emplace(k).first->second; }
+
+  Val& at(const Key& k) {
+    const size_t i = rep_.Find(k);
+    CHECK_NE(i, rep_.capacity()) << "FlatMap::at: key not found";
+    return rep_.slot(i).second;
+  }
+  const Val& at(const Key& k) const {
+    const size_t i = rep_.Find(k);
+    CHECK_NE(i, rep_.capacity()) << "FlatMap::at: key not found";
+    return rep_.slot(i).second;
+  }
+
+  size_t erase(const Key& k) {
+    const size_t i = rep_.Find(k);
+    if (i == rep_.capacity()) return 0;
+    rep_.Erase(i);
+    return 1;
+  }
+  void erase(iterator pos) { rep_.Erase(pos.index()); }
+
+ private:
+  Rep rep_;
+};
+
+}  // namespace gtl
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_GTL_FLATMAP_H_
@@ -0,0 +1,269 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/gtl/flatmap.h"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensorflow/core/lib/random/simple_philox.h"
+#include "tensorflow/core/lib/strings/strcat.h"
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/test_benchmark.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace gtl {
+namespace {
+
+typedef FlatMap<int64, int32> NumMap;
+
+// Returns the value of "k" in "map", or -1.
+int32 Get(const NumMap& map, int64 k) {
+  auto it = map.find(k);
+  return it == map.end() ? -1 : it->second;
+}
+
+// Returns the sorted contents of "map".
+std::vector<std::pair<int64, int32>> Contents(const NumMap& map) {
+  std::vector<std::pair<int64, int32>> result(map.begin(), map.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(FlatMapTest, Find) {
+  NumMap map;
+  EXPECT_EQ(-1, Get(map, 1));
+  EXPECT_TRUE(map.insert({1, 100}).second);
+  EXPECT_TRUE(map.insert({2, 200}).second);
+  EXPECT_EQ(100, Get(map, 1));
+  EXPECT_EQ(200, Get(map, 2));
+  EXPECT_EQ(-1, Get(map, 3));
+  EXPECT_EQ(1, map.count(1));
+  EXPECT_EQ(0, map.count(3));
+}
+
+TEST(FlatMapTest, Insert) {
+  NumMap map;
+  auto result = map.insert({1, 100});
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(1, result.first->first);
+  EXPECT_EQ(100, result.first->second);
+  // The existing value is kept.
+  result = map.insert({1, 200});
+  EXPECT_FALSE(result.second);
+  EXPECT_EQ(100, result.first->second);
+  EXPECT_EQ(1, map.size());
+
+  std::vector<std::pair<const int64, int32>> v = {{2, 200}, {3, 300}};
+  map.insert(v.begin(), v.end());
+  EXPECT_EQ(Contents(NumMap({{1, 100}, {2, 200}, {3, 300}})), Contents(map));
+}
+
+TEST(FlatMapTest, TryEmplaceAndIndex) {
+  FlatMap<int64, string> map;
+  EXPECT_TRUE(map.try_emplace(1, 3, 'x').second);
+  EXPECT_FALSE(map.try_emplace(1, "y").second);
+  EXPECT_EQ("xxx", map[1]);
+  map[2] = "z";
+  map[1] += "w";
+  EXPECT_EQ("xxxw", map.at(1));
+  EXPECT_EQ("z", map.at(2));
+  EXPECT_EQ("", map[3]);
+  EXPECT_EQ(3, map.size());
+}
+
+TEST(FlatMapTest, Erase) {
+  NumMap map;
+  EXPECT_EQ(0, map.erase(1));
+  map[1] = 100;
+  map[2] = 200;
+  EXPECT_EQ(1, map.erase(1));
+  EXPECT_EQ(0, map.erase(1));
+  EXPECT_EQ(-1, Get(map, 1));
+  EXPECT_EQ(200, Get(map, 2));
+  map.erase(map.find(2));
+  EXPECT_TRUE(map.empty());
+  EXPECT_TRUE(map.begin() == map.end());
+}
+
+TEST(FlatMapTest, Iterate) {
+  NumMap map;
+  for (int i = 0; i < 100; ++i) map[i] = i * 10;
+  std::vector<std::pair<int64, int32>> expected;
+  for (int i = 0; i < 100; ++i) expected.push_back({i, i * 10});
+  EXPECT_EQ(expected, Contents(map));
+
+  // Values can be changed through the iterators.
+  for (auto& entry : map) entry.second += 1;
+  EXPECT_EQ(11, Get(map, 1));
+}
+
+TEST(FlatMapTest, Reserve) {
+  NumMap map(1000);
+  const size_t capacity = map.capacity();
+  EXPECT_LE(1000, capacity);
+  for (int i = 0; i < 1000; ++i) map[i] = i;
+  EXPECT_EQ(capacity, map.capacity());
+  map.reserve(10);
+  EXPECT_EQ(capacity, map.capacity());
+}
+
+TEST(FlatMapTest, Clear) {
+  NumMap map;
+  for (int i = 0; i < 100; ++i) map[i] = i;
+  const size_t capacity = map.capacity();
+  map.clear();
+  EXPECT_TRUE(map.empty());
+  EXPECT_EQ(-1, Get(map, 1));
+  EXPECT_EQ(capacity, map.capacity());
+  map[5] = 1;
+  EXPECT_EQ(1, map.size());
+}
+
+TEST(FlatMapTest, CopyAndMove) {
+  NumMap src({{1, 100}, {2, 200}});
+  NumMap copy(src);
+  EXPECT_EQ(Contents(src), Contents(copy));
+  copy[3] = 300;
+  EXPECT_EQ(2, src.size());
+
+  NumMap assigned;
+  assigned[7] = 700;
+  assigned = copy;
+  EXPECT_EQ(Contents(copy), Contents(assigned));
+
+  NumMap moved(std::move(copy));
+  EXPECT_EQ(Contents(assigned), Contents(moved));
+
+  moved.swap(src);
+  EXPECT_EQ(2, moved.size());
+  EXPECT_EQ(3, src.size());
+}
+
+TEST(FlatMapTest, MovableValues) {
+  FlatMap<int64, std::unique_ptr<int64>> map;
+  for (int64 i = 0; i < 100; ++i) map[i].reset(new int64(i));
+  for (int64 i = 0; i < 100; ++i) EXPECT_EQ(i, *map[i]);
+}
+
+TEST(FlatMapTest, StringKeys) {
+  FlatMap<string, int32> map;
+  for (int i = 0; i < 1000; ++i) map[strings::StrCat("key", i)] = i;
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(i, map[strings::StrCat("key", i)]);
+  }
+  EXPECT_EQ(0, map.count("key1000"));
+}
+
+// All the keys collide, so every probe goes through many groups.
+struct BadHash {
+  size_t operator()(int64 k) const { return k % 3; }
+};
+
+TEST(FlatMapTest, Collisions) {
+  FlatMap<int64, int32, BadHash> map;
+  for (int i = 0; i < 200; ++i) map[i] = i;
+  for (int i = 0; i < 200; ++i) EXPECT_EQ(i, map[i]);
+  for (int i = 0; i < 200; i += 2) map.erase(i);
+  for (int i = 0; i < 200; ++i) EXPECT_EQ(i % 2, map.count(i));
+}
+
+// Compares FlatMap with std::unordered_map under random operations, with
+// many erased entries.
+TEST(FlatMapTest, Random) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  NumMap map;
+  std::unordered_map<int64, int32> shadow;
+  for (int i = 0; i < 100000; ++i) {
+    const int64 k = rnd.Uniform(1000);
+    switch (rnd.Uniform(3)) {
+      case 0:
+        map[k] = i;
+        shadow[k] = i;
+        break;
+      case 1:
+        EXPECT_EQ(shadow.erase(k), map.erase(k));
+        break;
+      case 2:
+        EXPECT_EQ(shadow.count(k) ? shadow[k] : -1, Get(map, k));
+        break;
+    }
+    ASSERT_EQ(shadow.size(), map.size());
+  }
+  std::vector<std::pair<int64, int32>> expected(shadow.begin(), shadow.end());
+  std::sort(expected.begin(), expected.end());
+  EXPECT_EQ(expected, Contents(map));
+  // Erased entries do not make the table grow without bound.
+  EXPECT_GE(4096, map.capacity());
+}
+
+template <typename Map>
+void BM_Insert(int iters, int n) {
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  std::vector<int64> keys(n);
+  for (int64& k : keys) k = rnd.Rand64();
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  while (--iters >= 0) {
+    Map map;
+    map.reserve(n);
+    for (int64 k : keys) map[k] = 1;
+  }
+}
+
+template <typename Map>
+void BM_Find(int iters, int n) {
+  testing::StopTiming();
+  random::PhiloxRandom philox(301, 17);
+  random::SimplePhilox rnd(&philox);
+  Map map;
+  std::vector<int64> keys(n);
+  for (int64& k : keys) {
+    k = rnd.Rand64();
+    map[k] = 1;
+  }
+  testing::ItemsProcessed(static_cast<int64>(iters) * n);
+  testing::StartTiming();
+  int64 found = 0;
+  while (--iters >= 0) {
+    for (int64 k : keys) found += map.count(k);
+  }
+  CHECK_GT(found, 0);
+}
+
+static void BM_FlatMapInsert(int iters, int n) {
+  BM_Insert<NumMap>(iters, n);
+}
+static void BM_UnorderedMapInsert(int iters, int n) {
+  BM_Insert<std::unordered_map<int64, int32>>(iters, n);
+}
+static void BM_FlatMapFind(int iters, int n) { BM_Find<NumMap>(iters, n); }
+static void BM_UnorderedMapFind(int iters, int n) {
+  BM_Find<std::unordered_map<int64, int32>>(iters, n);
+}
+BENCHMARK(BM_FlatMapInsert)->Arg(1000)->Arg(1000000);
+BENCHMARK(BM_UnorderedMapInsert)->Arg(1000)->Arg(1000000);
+BENCHMARK(BM_FlatMapFind)->Arg(1000)->Arg(1000000);
+BENCHMARK(BM_UnorderedMapFind)->Arg(1000)->Arg(1000000);
+
+}  // namespace
+}  // namespace gtl
+}  // namespace tensorflow
@@ -0,0 +1,365 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LIB_GTL_FLATREP_H_
+#define TENSORFLOW_LIB_GTL_FLATREP_H_
+
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace gtl {
+namespace internal {
+
+// Internal representation shared by FlatMap and FlatSet: an open-addressing
+// hash table whose "Slot"s (the map entries, or the set keys) are stored in
+// one array, with no per-entry allocation.
+//
+// Each slot has a control byte in a separate array: kEmpty, kDeleted (an
+// erased slot, which probes go past), or 7 bits of the hash of its key.
+// Probes read the control bytes kWidth at a time as one 64-bit word, and
+// compare the key only for the slots whose 7 bits match, which on average is
+// less than once per failed lookup.  The group of kWidth bytes starting at
+// any slot is contiguous: the first kWidth control bytes are mirrored after
+// the last one.
+//
+// The capacity is a power of 2 (or 0), and at most 7/8 of the slots are in
+// use, erased slots included.  Consecutive groups are probed at increasing
+// strides, which visits every slot of a power of 2 table.
+//
+// KeyOf maps a Slot to its key.
+template <typename Key, typename Slot, class Hash, class Eq, class KeyOf>
+class FlatRep {
+ public:
+  static const int kWidth = 8;
+
+  FlatRep(size_t n, const Hash& hash, const Eq& eq) : hash_(hash), eq_(eq) {
+    Init();
+    reserve(n);
+  }
+  FlatRep(const FlatRep& src) : hash_(src.hash_), eq_(src.eq_) {
+    Init();
+    CopyFrom(src);
+  }
+  FlatRep(FlatRep&& src)  // NOLINT(build/c++11)
+      : hash_(src.hash_), eq_(src.eq_) {
+    Init();
+    swap(src);
+  }
+  ~FlatRep() { Free(); }
+
+  FlatRep& operator=(const FlatRep& src) {
+    if (this != &src) {
+      clear();
+      hash_ = src.hash_;
+      eq_ = src.eq_;
+      CopyFrom(src);
+    }
+    return *this;
+  }
+
+  void swap(FlatRep& x) {
+    using std::swap;
+    swap(hash_, x.hash_);
+    swap(eq_, x.eq_);
+    swap(ctrl_, x.ctrl_);
+    swap(slots_, x.slots_);
+    swap(capacity_, x.capacity_);
+    swap(size_, x.size_);
+    swap(growth_left_, x.growth_left_);
+  }
+
+  const Hash& hash_function() const { return hash_; }
+  const Eq& key_eq() const { return eq_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  // Destroys all the slots but keeps the capacity.
+  void clear() {
+    for (size_t i = 0; i < capacity_; ++i) {
+      if (IsFull(ctrl_[i])) slots_[i].~Slot();
+    }
+    if (capacity_ > 0) {
+      memset(ctrl_, kEmpty, capacity_ + kWidth);
+    }
+    size_ = 0;
+    growth_left_ = MaxSize(capacity_);
+  }
+
+  // Makes room for "n" slots without rehashing.
+  void reserve(size_t n) {
+    if (n > MaxSize(capacity_)) {
+      size_t capacity = kWidth;
+      while (MaxSize(capacity) < n) capacity *= 2;
+      Resize(capacity);
+    }
+  }
+
+  // Returns the index of the slot of "k", or capacity() if there is none.
+  size_t Find(const Key& k) const {
+    if (size_ == 0) return capacity_;
+    return FindHashed(k, Mix(hash_(k)));
+  }
+
+  // Returns the index of the slot of "k", and false, if there is one.
+  // Otherwise constructs a slot from "args" and returns its index, and true.
+  template <typename... Args>
+  std::pair<size_t, bool> Emplace(const Key& k, Args&&... args) {
+    const size_t h = Mix(hash_(k));
+    size_t i = size_ == 0 ? capacity_ : FindHashed(k, h);
+    if (i != capacity_) return std::make_pair(i, false);
+    if (capacity_ == 0) Grow();
+    i = FindFree(h);
+    if (ctrl_[i] != kDeleted && growth_left_ == 0) {
+      Grow();
+      i = FindFree(h);
+    }
+    new (&slots_[i]) Slot(std::forward<Args>(args)...);
+    if (ctrl_[i] != kDeleted) --growth_left_;
+    SetCtrl(i, h & 0x7f);
+    ++size_;
+    return std::make_pair(i, true);
+  }
+
+  // Destroys slot "i", which must be in use.
+  void Erase(size_t i) {
+    DCHECK(IsFull(ctrl_[i]));
+    slots_[i].~Slot();
+    SetCtrl(i, kDeleted);
+    --size_;
+  }
+
+  bool IsFull(size_t i) const { return IsFull(ctrl_[i]); }
+  Slot& slot(size_t i) { return slots_[i]; }
+  const Slot& slot(size_t i) const { return slots_[i]; }
+
+  // Returns the index of the first slot in use at or after "i", or
+  // capacity() if there is none.
+  size_t SkipUnused(size_t i) const {
+    while (i < capacity_ && !IsFull(ctrl_[i])) ++i;
+    return i;
+  }
+
+ private:
+  static const int8 kEmpty = -128;   // 0b10000000
+  static const int8 kDeleted = -2;   // 0b11111110
+
+  // kWidth control bytes, read at once.
+  class Group {
+   public:
+    explicit Group(const int8* ctrl) {
+      memcpy(&word_, ctrl, sizeof(word_));
+      if (!port::kLittleEndian) word_ = __builtin_bswap64(word_);
+    }
+
+    // Returns a mask with the high bit set of the bytes that equal "h2",
+    // and rarely of a byte that does not (a borrow from a matching byte),
+    // so the keys must still be compared.
+    uint64 Match(int8 h2) const {
+      const uint64 x = word_ ^ (kLsbs * static_cast<uint8>(h2));
+      return (x - kLsbs) & ~x & kMsbs;
+    }
+
+    // Returns a mask with the high bit set of the kEmpty bytes: the only
+    // ones with their high bit set and the next bit clear.
+    uint64 MatchEmpty() const { return word_ & ~(word_ << 1) & kMsbs; }
+
+    // Returns a mask with the high bit set of the kEmpty or kDeleted bytes.
+    uint64 MatchEmptyOrDeleted() const { return word_ & kMsbs; }
+
+    // Returns the first byte set in the non-zero "mask".
+    static int First(uint64 mask) { return __builtin_ctzll(mask) >> 3; }
+
+   private:
+    static const uint64 kLsbs = 0x0101010101010101ull;
+    static const uint64 kMsbs = 0x8080808080808080ull;
+    uint64 word_;
+  };
+
+  static bool IsFull(int8 c) { return c >= 0; }
+
+  // At most 7/8 of the slots are used.
+  static size_t MaxSize(size_t capacity) { return capacity - capacity / 8; }
+
+  // Hashes such as std::hash<int64> are the identity: mixes all the bits so
+  // that both the position and the 7 bits of the control byte depend on
+  // all of them.
+  static size_t Mix(size_t h) {
+    uint64 x = h;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return static_cast<size_t>(x);
+  }
+
+  void Init() {
+    ctrl_ = nullptr;
+    slots_ = nullptr;
+    capacity_ = 0;
+    size_ = 0;
+    growth_left_ = 0;
+  }
+
+  void Free() {
+    clear();
+    delete[] ctrl_;
+    std::allocator<Slot>().deallocate(slots_, capacity_);
+    Init();
+  }
+
+  void CopyFrom(const FlatRep& src) {
+    reserve(src.size_);
+    for (size_t i = 0; i < src.capacity_; ++i) {
+      if (src.IsFull(i)) {
+        Emplace(KeyOf()(src.slots_[i]), src.slots_[i]);
+      }
+    }
+  }
+
+  void SetCtrl(size_t i, int8 c) {
+    ctrl_[i] = c;
+    // Keeps the mirror of the first group up to date.
+    if (i < kWidth) ctrl_[capacity_ + i] = c;
+  }
+
+  // Returns the index of the slot of "k", whose mixed hash is "h", or
+  // capacity() if there is none.
+  size_t FindHashed(const Key& k, size_t h) const {
+    const size_t mask = capacity_ - 1;
+    size_t pos = (h >> 7) & mask;
+    const int8 h2 = h & 0x7f;
+    for (size_t stride = kWidth;; stride += kWidth) {
+      const Group g(ctrl_ + pos);
+      for (uint64 m = g.Match(h2); m != 0; m &= m - 1) {
+        const size_t i = (pos + Group::First(m)) & mask;
+        if (eq_(KeyOf()(slots_[i]), k)) return i;
+      }
+      if (g.MatchEmpty() != 0) return capacity_;
+      pos = (pos + stride) & mask;
+    }
+  }
+
+  // Returns the first empty or erased slot in the probe sequence of "h".
+  size_t FindFree(size_t h) const {
+    const size_t mask = capacity_ - 1;
+    size_t pos = (h >> 7) & mask;
+    for (size_t stride = kWidth;; stride += kWidth) {
+      const uint64 m = Group(ctrl_ + pos).MatchEmptyOrDeleted();
+      if (m != 0) return (pos + Group::First(m)) & mask;
+      pos = (pos + stride) & mask;
+    }
+  }
+
+  // Makes room for one more slot: rehashes in place if erased slots take
+  // much of the table, and doubles it otherwise.
+  void Grow() {
+    if (capacity_ > 0 && size_ <= MaxSize(capacity_) / 2) {
+      Resize(capacity_);
+    } else {
+      Resize(capacity_ == 0 ? kWidth : capacity_ * 2);
+    }
+  }
+
+  // Moves all the slots into a new table of "capacity" slots.
+  void Resize(size_t capacity) {
+    int8* old_ctrl = ctrl_;
+    Slot* old_slots = slots_;
+    const size_t old_capacity = capacity_;
+
+    ctrl_ = new int8[capacity + kWidth];
+    memset(ctrl_, kEmpty, capacity + kWidth);
+    slots_ = std::allocator<Slot>().allocate(capacity);
+    capacity_ = capacity;
+    growth_left_ = MaxSize(capacity) - size_;
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (IsFull(old_ctrl[i])) {
+        Slot& old = old_slots[i];
+        const size_t h = Mix(hash_(KeyOf()(old)));
+        const size_t j = FindFree(h);
+        new (&slots_[j]) Slot(std::move(old));  // NOLINT(build/c++11)
+        old.~Slot();
+        SetCtrl(j, h & 0x7f);
+      }
+    }
+    delete[] old_ctrl;
+    std::allocator<Slot>().deallocate(old_slots, old_capacity);
+  }
+
+  Hash hash_;
+  Eq eq_;
+  int8* ctrl_;      // capacity_ + kWidth control bytes
+  Slot* slots_;     // capacity_ slots
+  size_t capacity_;
+  size_t size_;         // Slots in use
+  size_t growth_left_;  // Empty slots that can still be used
+};
+
+// Iterator over the slots in use of a FlatRep, with "Value" the (possibly
+// const) type it points to.
+template <typename Rep, typename Value>
+class FlatRepIterator {
+ public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef Value value_type;
+  typedef ptrdiff_t difference_type;
+  typedef Value* pointer;
+  typedef Value& reference;
+
+  FlatRepIterator() : rep_(nullptr), i_(0) {}
+  FlatRepIterator(Rep* rep, size_t i) : rep_(rep), i_(i) {}
+
+  // Conversion from iterator to const_iterator.
+  template <typename OtherRep, typename OtherValue>
+  FlatRepIterator(const FlatRepIterator<OtherRep, OtherValue>& x)
+      : rep_(x.rep_), i_(x.i_) {}
+
+  reference operator*() const { return rep_->slot(i_); }
+  pointer operator->() const { return &rep_->slot(i_); }
+
+  FlatRepIterator& operator++() {
+    i_ = rep_->SkipUnused(i_ + 1);
+    return *this;
+  }
+  FlatRepIterator operator++(int) {
+    FlatRepIterator tmp = *this;
+    ++*this;
+    return tmp;
+  }
+
+  bool operator==(const FlatRepIterator& x) const { return i_ == x.i_; }
+  bool operator!=(const FlatRepIterator& x) const { return i_ != x.i_; }
+
+  size_t index() const { return i_; }
+
+ private:
+  template <typename OtherRep, typename OtherValue>
+  friend class FlatRepIterator;
+
+  Rep* rep_;
+  size_t i_;
+};
+
+}  // namespace internal
+}  // namespace gtl
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_GTL_FLATREP_H_
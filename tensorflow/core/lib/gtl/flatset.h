@@ -0,0 +1,120 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LIB_GTL_FLATSET_H_
+#define TENSORFLOW_LIB_GTL_FLATSET_H_
+
+#include <stddef.h>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+
+#include "tensorflow/core/lib/gtl/flatrep.h"
+
+namespace tensorflow {
+namespace gtl {
+
+// FlatSet<K,...> provides a set of K.
+//
+// The set is implemented using an open-addressed hash table, like FlatMap,
+// and has the same differences with std::unordered_set as FlatMap has with
+// std::unordered_map.
+template <class Key, class Hash = std::hash<Key>,
+          class Eq = std::equal_to<Key>>
+class FlatSet {
+ private:
+  struct KeyOf {
+    const Key& operator()(const Key& k) const { return k; }
+  };
+  typedef internal::FlatRep<Key, Key, Hash, Eq, KeyOf> Rep;
+
+ public:
+  typedef Key key_type;
+  typedef Key value_type;
+  typedef Hash hasher;
+  typedef Eq key_equal;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+  typedef value_type* pointer;
+  typedef const value_type* const_pointer;
+  typedef value_type& reference;
+  typedef const value_type& const_reference;
+  // The keys cannot be changed in place.
+  typedef internal::FlatRepIterator<const Rep, const Key> iterator;
+  typedef iterator const_iterator;
+
+  explicit FlatSet(size_t n = 0, const Hash& hf = Hash(), const Eq& eq = Eq())
+      : rep_(n, hf, eq) {}
+
+  template <typename InputIter>
+  FlatSet(InputIter first, InputIter last, size_t n = 0,
+          const Hash& hf = Hash(), const Eq& eq = Eq())
+      : FlatSet(n, hf, eq) {
+    insert(first, last);
+  }
+
+  FlatSet(std::initializer_list<value_type> init, size_t n = 0,
+          const Hash& hf = Hash(), const Eq& eq = Eq())
+      : FlatSet(init.begin(), init.end(), n, hf, eq) {}
+
+  FlatSet(const FlatSet&) = default;
+  FlatSet(FlatSet&&) = default;  // NOLINT(build/c++11)
+  FlatSet& operator=(const FlatSet&) = default;
+
+  size_t size() const { return rep_.size(); }
+  bool empty() const { return size() == 0; }
+  // Number of keys the set can hold without rehashing.
+  size_t capacity() const { return rep_.capacity() - rep_.capacity() / 8; }
+
+  hasher hash_function() const { return rep_.hash_function(); }
+  key_equal key_eq() const { return rep_.key_eq(); }
+
+  void clear() { rep_.clear(); }
+  void reserve(size_t n) { rep_.reserve(n); }
+  void swap(FlatSet& x) { rep_.swap(x.rep_); }
+
+  iterator begin() const { return iterator(&rep_, rep_.SkipUnused(0)); }
+  iterator end() const { return iterator(&rep_, rep_.capacity()); }
+
+  size_t count(const Key& k) const {
+    return rep_.Find(k) == rep_.capacity() ? 0 : 1;
+  }
+  iterator find(const Key& k) const { return iterator(&rep_, rep_.Find(k)); }
+
+  std::pair<iterator, bool> insert(const Key& k) {
+    auto r = rep_.Emplace(k, k);
+    return std::make_pair(iterator(&rep_, r.first), r.second);
+  }
+  template <typename InputIter>
+  void insert(InputIter first, InputIter last) {
+    for (; first != last; ++first) insert(*first);
+  }
+
+  size_t erase(const Key& k) {
+    const size_t i = rep_.Find(k);
+    if (i == rep_.capacity()) return 0;
+    rep_.Erase(i);
+    return 1;
+  }
+  void erase(iterator pos) { rep_.Erase(pos.index()); }
+
+ private:
+  Rep rep_;
+};
+
+}  // namespace gtl
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_GTL_FLATSET_H_
@@ -0,0 +1,84 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/gtl/flatset.h"
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tensorflow/core/platform/test.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace gtl {
+namespace {
+
+typedef FlatSet<int64> NumSet;
+
+// Returns the sorted contents of "set".
+std::vector<int64> Contents(const NumSet& set) {
+  std::vector<int64> result(set.begin(), set.end());
+  std::sort(result.begin(), result.end());
+  return result;
+}
+
+TEST(FlatSetTest, Insert) {
+  NumSet set;
+  EXPECT_EQ(0, set.count(1));
+  auto result = set.insert(1);
+  EXPECT_TRUE(result.second);
+  EXPECT_EQ(1, *result.first);
+  EXPECT_FALSE(set.insert(1).second);
+  EXPECT_EQ(1, set.count(1));
+  EXPECT_EQ(1, set.size());
+  EXPECT_TRUE(set.find(2) == set.end());
+
+  std::vector<int64> v = {2, 3, 2};
+  set.insert(v.begin(), v.end());
+  EXPECT_EQ(std::vector<int64>({1, 2, 3}), Contents(set));
+}
+
+TEST(FlatSetTest, Erase) {
+  NumSet set({1, 2, 3});
+  EXPECT_EQ(1, set.erase(2));
+  EXPECT_EQ(0, set.erase(2));
+  set.erase(set.find(3));
+  EXPECT_EQ(std::vector<int64>({1}), Contents(set));
+}
+
+TEST(FlatSetTest, ManyKeys) {
+  NumSet set(10);
+  for (int64 i = 0; i < 10000; i += 3) set.insert(i);
+  for (int64 i = 0; i < 10000; ++i) {
+    EXPECT_EQ(i % 3 == 0 ? 1 : 0, set.count(i)) << i;
+  }
+  NumSet copy(set);
+  set.clear();
+  EXPECT_TRUE(set.empty());
+  EXPECT_EQ(3334, copy.size());
+}
+
+TEST(FlatSetTest, StringKeys) {
+  FlatSet<string> set({"a", "b"});
+  EXPECT_EQ(1, set.count("a"));
+  EXPECT_EQ(0, set.count("c"));
+  set.insert("c");
+  EXPECT_EQ(3, set.size());
+}
+
+}  // namespace
+}  // namespace gtl
+}  // namespace tensorflow
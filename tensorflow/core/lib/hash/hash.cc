@@ -126,4 +126,75 @@ uint64 Hash64(const char* data, size_t n, uint64 seed) {
   return h;
 }
 
+static inline uint64 Rotate64(uint64 x, int b) {
+  return (x << b) | (x >> (64 - b));
+}
+
+// One SipRound over the state (v0, v1, v2, v3).
+static inline void SipRound(uint64* v0, uint64* v1, uint64* v2, uint64* v3) {
+  *v0 += *v1;
+  *v1 = Rotate64(*v1, 13);
+  *v1 ^= *v0;
+  *v0 = Rotate64(*v0, 32);
+  *v2 += *v3;
+  *v3 = Rotate64(*v3, 16);
+  *v3 ^= *v2;
+  *v0 += *v3;
+  *v3 = Rotate64(*v3, 21);
+  *v3 ^= *v0;
+  *v2 += *v1;
+  *v1 = Rotate64(*v1, 17);
+  *v1 ^= *v2;
+  *v2 = Rotate64(*v2, 32);
+}
+
+uint64 KeyedHash64(const uint64 key[2], const char* data, size_t n) {
+  uint64 v0 = key[0] ^ 0x736f6d6570736575ULL;
+  uint64 v1 = key[1] ^ 0x646f72616e646f6dULL;
+  uint64 v2 = key[0] ^ 0x6c7967656e657261ULL;
+  uint64 v3 = key[1] ^ 0x7465646279746573ULL;
+
+  // The last word holds the remaining bytes and, in its top byte, the length.
+  uint64 last = static_cast<uint64>(n) << 56;
+  const char* end = data + (n & ~static_cast<size_t>(7));
+  for (; data != end; data += 8) {
+    const uint64 m = core::DecodeFixed64(data);
+    v3 ^= m;
+    SipRound(&v0, &v1, &v2, &v3);
+    SipRound(&v0, &v1, &v2, &v3);
+    v0 ^= m;
+  }
+
+  switch (n & 7) {
+    case 7:
+      last |= ByteAs64(data[6]) << 48;
+      TF_FALLTHROUGH_INTENDED;
+    case 6:
+      last |= ByteAs64(data[5]) << 40;
+      TF_FALLTHROUGH_INTENDED;
+    case 5:
+      last |= ByteAs64(data[4]) << 32;
+      TF_FALLTHROUGH_INTENDED;
+    case 4:
+      last |= ByteAs64(data[3]) << 24;
+      TF_FALLTHROUGH_INTENDED;
+    case 3:
+      last |= ByteAs64(data[2]) << 16;
+      TF_FALLTHROUGH_INTENDED;
+    case 2:
+      last |= ByteAs64(data[1]) << 8;
+      TF_FALLTHROUGH_INTENDED;
+    case 1:
+      last |= ByteAs64(data[0]);
+  }
+  v3 ^= last;
+  SipRound(&v0, &v1, &v2, &v3);
+  SipRound(&v0, &v1, &v2, &v3);
+  v0 ^= last;
+
+  v2 ^= 0xff;
+  for (int i = 0; i < 4; ++i) SipRound(&v0, &v1, &v2, &v3);
+  return v0 ^ v1 ^ v2 ^ v3;
+}
+
 }  // namespace tensorflow
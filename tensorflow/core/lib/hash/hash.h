@@ -38,6 +38,22 @@ inline uint64 Hash64(const string& str) {
   return Hash64(str.data(), str.size());
 }
 
+// Returns the SipHash-2-4 of data[0,n-1] under the 128-bit key formed by
+// key[0] (low half) and key[1] (high half).  Unlike Hash64, its output is
+// part of the interface and never changes: values may be persisted or
+// shared between processes.  Without the key, an adversary cannot craft
+// inputs that collide.
+extern uint64 KeyedHash64(const uint64 key[2], const char* data, size_t n);
+
+inline uint64 KeyedHash64(const uint64 key[2], const string& str) {
+  return KeyedHash64(key, str.data(), str.size());
+}
+
+// Returns a hash of the sequence of hashes "a", "b".  Not commutative.
+inline uint64 Hash64Combine(uint64 a, uint64 b) {
+  return a ^ (b + 0x9e3779b97f4a7800ULL + (a << 10) + (a >> 4));
+}
+
 }  // namespace tensorflow
 
 #endif  // TENSORFLOW_LIB_HASH_HASH_H_
@@ -65,6 +65,44 @@ TEST(Hash, SignedUnsignedIssue) {
   }
 }
 
+TEST(Hash, KeyedHash64) {
+  // Test vectors of the SipHash-2-4 reference implementation, for the key
+  // 00 01 ... 0f and the messages 00 01 ... (n-1).
+  const uint64 key[2] = {0x0706050403020100ull, 0x0f0e0d0c0b0a0908ull};
+  std::string input;
+  for (int i = 0; i < 64; ++i) input.push_back(static_cast<char>(i));
+
+  struct Case {
+    size_t size;
+    uint64 hash;
+  };
+  for (Case c : std::vector<Case>{
+           {0, 0x726fdb47dd0e0e31ull},
+           {1, 0x74f839c593dc67fdull},
+           {2, 0x0d6c8009d9a94f5aull},
+           {3, 0x85676696d7fb7e2dull},
+           {15, 0xa129ca6149be45e5ull},
+           {63, 0x958a324ceb064572ull},
+       }) {
+    EXPECT_EQ(c.hash, KeyedHash64(key, input.data(), c.size)) << c.size;
+    EXPECT_EQ(c.hash, KeyedHash64(key, input.substr(0, c.size)));
+
+    // Check hashes with inputs aligned differently.
+    for (int align = 1; align <= 7; align++) {
+      std::string aligned(align, 'x');
+      aligned.append(input, 0, c.size);
+      EXPECT_EQ(c.hash, KeyedHash64(key, &aligned[align], c.size));
+    }
+  }
+}
+
+TEST(Hash, Hash64Combine) {
+  const uint64 a = Hash64("a");
+  const uint64 b = Hash64("b");
+  EXPECT_NE(Hash64Combine(a, b), Hash64Combine(b, a));
+  EXPECT_NE(Hash64Combine(a, a), Hash64Combine(b, b));
+}
+
 static void BM_Hash32(int iters, int len) {
   std::string input(len, 'x');
   uint32 h = 0;
@@ -76,4 +114,27 @@ static void BM_Hash32(int iters, int len) {
 }
 BENCHMARK(BM_Hash32)->Range(1, 1024);
 
+static void BM_Hash64(int iters, int len) {
+  std::string input(len, 'x');
+  uint64 h = 0;
+  for (int i = 0; i < iters; i++) {
+    h = Hash64(input.data(), len, 1);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * len);
+  VLOG(1) << h;
+}
+BENCHMARK(BM_Hash64)->Range(1, 1024);
+
+static void BM_KeyedHash64(int iters, int len) {
+  std::string input(len, 'x');
+  const uint64 key[2] = {1, 2};
+  uint64 h = 0;
+  for (int i = 0; i < iters; i++) {
+    h = KeyedHash64(key, input.data(), len);
+  }
+  testing::BytesProcessed(static_cast<int64>(iters) * len);
+  VLOG(1) << h;
+}
+BENCHMARK(BM_KeyedHash64)->Range(1, 1024);
+
 }  // namespace tensorflow
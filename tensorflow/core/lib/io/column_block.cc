@@ -0,0 +1,216 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/column_block.h"
+
+#include <string.h>
+#include <limits>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/raw_coding.h"
+#include "tensorflow/core/platform/host_info.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/snappy.h"
+
+namespace tensorflow {
+namespace io {
+
+// Values are copied to and from the block without byte swapping.
+static_assert(port::kLittleEndian, "Column blocks require a little-endian host");
+
+size_t ColumnTypeSize(ColumnType type) {
+  switch (type) {
+    case kColumnFloat:
+      return sizeof(float);
+    case kColumnDouble:
+      return sizeof(double);
+    case kColumnInt32:
+      return sizeof(int32);
+    case kColumnInt64:
+      return sizeof(int64);
+  }
+  return 0;
+}
+
+ColumnBlockBuilder::ColumnBlockBuilder(int64 num_rows,
+                                       table::CompressionType compression)
+    : num_rows_(num_rows), compression_(compression) {}
+
+void ColumnBlockBuilder::AddColumn(ColumnType type, int64 values_per_row,
+                                   StringPiece data) {
+  CHECK_EQ(data.size(), num_rows_ * values_per_row * ColumnTypeSize(type));
+  Column column;
+  column.type = type;
+  column.compression = table::kNoCompression;
+  column.values_per_row = values_per_row;
+  if (compression_ == table::kSnappyCompression &&
+      port::Snappy_Compress(data.data(), data.size(), &column.data) &&
+      column.data.size() < data.size() - (data.size() / 8u)) {
+    column.compression = table::kSnappyCompression;
+  } else {
+    // Snappy not supported, or compressed less than 12.5%, so just
+    // store uncompressed form
+    column.data.assign(data.data(), data.size());
+  }
+  columns_.push_back(std::move(column));
+}
+
+static size_t AlignColumnOffset(size_t offset) {
+  return (offset + kColumnAlignment - 1) / kColumnAlignment * kColumnAlignment;
+}
+
+string ColumnBlockBuilder::Finish() {
+  // The header size does not depend on the column offsets, since those are
+  // stored as fixed64, so it can be computed up front.
+  string header;
+  core::PutFixed32(&header, kColumnBlockMagic);
+  core::PutVarint64(&header, num_rows_);
+  core::PutVarint32(&header, columns_.size());
+  size_t header_size = header.size();
+  for (const Column& column : columns_) {
+    header_size += 2 + core::VarintLength(column.values_per_row) +
+                   2 * sizeof(uint64);
+  }
+
+  size_t offset = AlignColumnOffset(header_size);
+  for (const Column& column : columns_) {
+    header.push_back(static_cast<char>(column.type));
+    header.push_back(static_cast<char>(column.compression));
+    core::PutVarint64(&header, column.values_per_row);
+    core::PutFixed64(&header, offset);
+    core::PutFixed64(&header, column.data.size());
+    offset = AlignColumnOffset(offset + column.data.size());
+  }
+  DCHECK_EQ(header.size(), header_size);
+
+  string result = std::move(header);
+  for (const Column& column : columns_) {
+    result.resize(AlignColumnOffset(result.size()), '\0');
+    result.append(column.data);
+  }
+  columns_.clear();
+  return result;
+}
+
+Status ColumnBlockReader::Init(StringPiece contents) {
+  const StringPiece block = contents;
+  StringPiece input = contents;
+  uint64 num_rows;
+  uint32 num_columns;
+  if (input.size() < sizeof(uint32) ||
+      core::DecodeFixed32(input.data()) != kColumnBlockMagic) {
+    return errors::DataLoss("Not a column block (bad magic number)");
+  }
+  input.remove_prefix(sizeof(uint32));
+  if (!core::GetVarint64(&input, &num_rows) ||
+      !core::GetVarint32(&input, &num_columns)) {
+    return errors::DataLoss("Truncated column block header");
+  }
+  // Each column entry takes at least 19 bytes of the header: its type and
+  // compression, a varint and two fixed64.  Checking this first bounds the
+  // memory reserved below by the size of the block.
+  static const size_t kMinColumnEntrySize = 2 + 1 + 2 * sizeof(uint64);
+  if (num_columns > input.size() / kMinColumnEntrySize) {
+    return errors::DataLoss("Column block header declares ", num_columns,
+                            " columns but only has ", input.size(),
+                            " bytes left");
+  }
+  // The per-column size check below does not bound the number of rows of
+  // a block without values.
+  if (num_rows > static_cast<uint64>(kint64max)) {
+    return errors::DataLoss("Column block header declares ", num_rows,
+                            " rows");
+  }
+  num_rows_ = num_rows;
+  columns_.clear();
+  columns_.reserve(num_columns);
+  for (uint32 c = 0; c < num_columns; ++c) {
+    Column column;
+    uint64 values_per_row;
+    if (input.size() < 2) {
+      return errors::DataLoss("Truncated column block header");
+    }
+    column.type = static_cast<ColumnType>(static_cast<uint8>(input[0]));
+    column.compression =
+        static_cast<table::CompressionType>(static_cast<uint8>(input[1]));
+    input.remove_prefix(2);
+    if (!core::GetVarint64(&input, &values_per_row) ||
+        input.size() < 2 * sizeof(uint64)) {
+      return errors::DataLoss("Truncated column block header");
+    }
+    const uint64 offset = core::DecodeFixed64(input.data());
+    const uint64 size = core::DecodeFixed64(input.data() + sizeof(uint64));
+    input.remove_prefix(2 * sizeof(uint64));
+    column.values_per_row = values_per_row;
+
+    const size_t type_size = ColumnTypeSize(column.type);
+    if (type_size == 0) {
+      return errors::DataLoss("Column ", c, " has unknown type ",
+                              static_cast<int>(column.type));
+    }
+    if (values_per_row != 0 &&
+        num_rows > std::numeric_limits<int64>::max() / type_size /
+                       values_per_row) {
+      return errors::DataLoss("Column ", c, " is too large");
+    }
+    if (column.compression != table::kNoCompression &&
+        column.compression != table::kSnappyCompression) {
+      return errors::DataLoss("Column ", c, " has unknown compression ",
+                              static_cast<int>(column.compression));
+    }
+    if (offset > block.size() || size > block.size() - offset) {
+      return errors::DataLoss("Column ", c, " extends past the end of block");
+    }
+    column.data = StringPiece(block.data() + offset, size);
+    columns_.push_back(column);
+    if (column.compression == table::kNoCompression &&
+        column.data.size() != decoded_size(c)) {
+      return errors::DataLoss("Column ", c, " has ", column.data.size(),
+                              " bytes but ", decoded_size(c), " expected");
+    }
+  }
+  return Status::OK();
+}
+
+Status ColumnBlockReader::ReadColumn(int column, char* dst) const {
+  const Column& c = columns_[column];
+  const size_t size = decoded_size(column);
+  switch (c.compression) {
+    case table::kNoCompression:
+      memcpy(dst, c.data.data(), size);
+      return Status::OK();
+    case table::kSnappyCompression: {
+      size_t uncompressed_size;
+      if (!port::Snappy_GetUncompressedLength(c.data.data(), c.data.size(),
+                                              &uncompressed_size)) {
+        return errors::DataLoss("Corrupted compressed column ", column);
+      }
+      if (uncompressed_size != size) {
+        return errors::DataLoss("Compressed column ", column, " has ",
+                                uncompressed_size, " bytes but ", size,
+                                " expected");
+      }
+      if (!port::Snappy_Uncompress(c.data.data(), c.data.size(), dst)) {
+        return errors::DataLoss("Corrupted compressed column ", column);
+      }
+      return Status::OK();
+    }
+  }
+  return errors::DataLoss("Column ", column, " has unknown compression");
+}
+
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,153 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LIB_IO_COLUMN_BLOCK_H_
+#define TENSORFLOW_LIB_IO_COLUMN_BLOCK_H_
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/io/table_options.h"
+#include "tensorflow/core/platform/macros.h"
+#include "tensorflow/core/platform/types.h"
+
+namespace tensorflow {
+namespace io {
+
+// A column block holds a batch of rows of dense numeric data, stored column
+// by column. Each column has a fixed number of values per row, and its
+// values are stored contiguously in row-major order, optionally compressed,
+// so that decoding an uncompressed column is a single copy.
+//
+// Blocks are self-contained strings and carry no checksums of their own;
+// they are meant to be framed by a container that does, e.g. one block per
+// record of a RecordWriter file.
+//
+// Format of a block:
+//   fixed32    magic (kColumnBlockMagic)
+//   varint64   number of rows
+//   varint32   number of columns
+//   for each column:
+//     byte       value type (ColumnType)
+//     byte       compression (table::CompressionType)
+//     varint64   values per row
+//     fixed64    offset of the column data from the start of the block
+//     fixed64    size of the stored column data
+//   padding, then the data of each column.
+//
+// Column data starts at offsets that are multiples of kColumnAlignment.
+// Values are stored in little-endian order.
+
+static const uint32 kColumnBlockMagic = 0x314b4243;  // "CBK1"
+static const size_t kColumnAlignment = 64;
+
+enum ColumnType {
+  // NOTE: do not change the values of existing entries, as these are
+  // part of the persistent format on disk.
+  kColumnFloat = 1,
+  kColumnDouble = 2,
+  kColumnInt32 = 3,
+  kColumnInt64 = 4,
+};
+
+// Returns the size in bytes of a single value of "type", or 0 if "type" is
+// not a valid ColumnType.
+size_t ColumnTypeSize(ColumnType type);
+
+// Builds a serialized column block.
+class ColumnBlockBuilder {
+ public:
+  // Create a builder for a block of "num_rows" rows. Each column is
+  // compressed with "compression" unless that saves less than 12.5%.
+  ColumnBlockBuilder(int64 num_rows, table::CompressionType compression);
+
+  // Appends a column holding "values_per_row" values of "type" per row.
+  // "data" must hold exactly num_rows * values_per_row values.
+  void AddColumn(ColumnType type, int64 values_per_row, StringPiece data);
+
+  // Convenience wrapper for typed data.
+  template <typename T>
+  void AddColumn(ColumnType type, int64 values_per_row, const T* values) {
+    AddColumn(type, values_per_row,
+              StringPiece(reinterpret_cast<const char*>(values),
+                          num_rows_ * values_per_row * sizeof(T)));
+  }
+
+  // Returns the serialized block. Must be called once, after all columns
+  // have been added.
+  string Finish();
+
+ private:
+  struct Column {
+    ColumnType type;
+    table::CompressionType compression;
+    int64 values_per_row;
+    string data;
+  };
+
+  const int64 num_rows_;
+  const table::CompressionType compression_;
+  std::vector<Column> columns_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ColumnBlockBuilder);
+};
+
+// Reads the columns of a serialized column block.
+class ColumnBlockReader {
+ public:
+  ColumnBlockReader() {}
+
+  // Parses the header of the block in "contents". "contents" must remain
+  // live while this reader is in use. On failure, returns a non-OK status
+  // and the reader must not be used.
+  Status Init(StringPiece contents);
+
+  int64 num_rows() const { return num_rows_; }
+  int num_columns() const { return columns_.size(); }
+
+  ColumnType type(int column) const { return columns_[column].type; }
+  int64 values_per_row(int column) const {
+    return columns_[column].values_per_row;
+  }
+
+  // Size in bytes of the decoded values of "column".
+  size_t decoded_size(int column) const {
+    return num_rows_ * columns_[column].values_per_row *
+           ColumnTypeSize(columns_[column].type);
+  }
+
+  // Decodes the values of "column" into "dst", which must have room for
+  // decoded_size(column) bytes.
+  Status ReadColumn(int column, char* dst) const;
+
+ private:
+  struct Column {
+    ColumnType type;
+    table::CompressionType compression;
+    int64 values_per_row;
+    StringPiece data;
+  };
+
+  int64 num_rows_ = 0;
+  std::vector<Column> columns_;
+
+  TF_DISALLOW_COPY_AND_ASSIGN(ColumnBlockReader);
+};
+
+}  // namespace io
+}  // namespace tensorflow
+
+#endif  // TENSORFLOW_LIB_IO_COLUMN_BLOCK_H_
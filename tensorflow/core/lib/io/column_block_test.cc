@@ -0,0 +1,147 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/column_block.h"
+
+#include <vector>
+
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace io {
+namespace {
+
+TEST(ColumnBlockTest, RoundTrip) {
+  const int64 kRows = 100;
+  std::vector<float> floats(kRows * 3);
+  std::vector<int64> ints(kRows);
+  std::vector<double> doubles(kRows * 2);
+  for (int64 i = 0; i < kRows; ++i) {
+    floats[3 * i] = i * 0.5f;
+    floats[3 * i + 1] = -i;
+    floats[3 * i + 2] = i * i;
+    ints[i] = i * 1000000007LL;
+    // Compressible.
+    doubles[2 * i] = 1.0;
+    doubles[2 * i + 1] = 2.0;
+  }
+
+  ColumnBlockBuilder builder(kRows, table::kSnappyCompression);
+  builder.AddColumn(kColumnFloat, 3, floats.data());
+  builder.AddColumn(kColumnInt64, 1, ints.data());
+  builder.AddColumn(kColumnDouble, 2, doubles.data());
+  const string block = builder.Finish();
+
+  ColumnBlockReader reader;
+  TF_ASSERT_OK(reader.Init(block));
+  EXPECT_EQ(kRows, reader.num_rows());
+  ASSERT_EQ(3, reader.num_columns());
+  EXPECT_EQ(kColumnFloat, reader.type(0));
+  EXPECT_EQ(kColumnInt64, reader.type(1));
+  EXPECT_EQ(kColumnDouble, reader.type(2));
+  EXPECT_EQ(3, reader.values_per_row(0));
+  EXPECT_EQ(1, reader.values_per_row(1));
+  EXPECT_EQ(2, reader.values_per_row(2));
+
+  std::vector<float> floats_out(kRows * 3);
+  std::vector<int64> ints_out(kRows);
+  std::vector<double> doubles_out(kRows * 2);
+  TF_ASSERT_OK(
+      reader.ReadColumn(0, reinterpret_cast<char*>(floats_out.data())));
+  TF_ASSERT_OK(reader.ReadColumn(1, reinterpret_cast<char*>(ints_out.data())));
+  TF_ASSERT_OK(
+      reader.ReadColumn(2, reinterpret_cast<char*>(doubles_out.data())));
+  EXPECT_EQ(floats, floats_out);
+  EXPECT_EQ(ints, ints_out);
+  EXPECT_EQ(doubles, doubles_out);
+}
+
+TEST(ColumnBlockTest, Uncompressed) {
+  const int32 values[] = {1, 2, 3, 4, 5, 6};
+  ColumnBlockBuilder builder(3, table::kNoCompression);
+  builder.AddColumn(kColumnInt32, 2, values);
+  const string block = builder.Finish();
+
+  ColumnBlockReader reader;
+  TF_ASSERT_OK(reader.Init(block));
+  ASSERT_EQ(sizeof(values), reader.decoded_size(0));
+  // The values are stored as is, at an aligned offset.
+  EXPECT_EQ(StringPiece(reinterpret_cast<const char*>(values), sizeof(values)),
+            StringPiece(block).substr(kColumnAlignment, sizeof(values)));
+  int32 values_out[6];
+  TF_ASSERT_OK(reader.ReadColumn(0, reinterpret_cast<char*>(values_out)));
+  EXPECT_EQ(std::vector<int32>(values, values + 6),
+            std::vector<int32>(values_out, values_out + 6));
+}
+
+TEST(ColumnBlockTest, Empty) {
+  ColumnBlockBuilder builder(0, table::kSnappyCompression);
+  builder.AddColumn(kColumnFloat, 4, StringPiece());
+  ColumnBlockReader reader;
+  TF_ASSERT_OK(reader.Init(builder.Finish()));
+  EXPECT_EQ(0, reader.num_rows());
+  EXPECT_EQ(1, reader.num_columns());
+  EXPECT_EQ(0, reader.decoded_size(0));
+}
+
+TEST(ColumnBlockTest, Corrupted) {
+  const float values[] = {1, 2, 3, 4};
+  ColumnBlockBuilder builder(4, table::kNoCompression);
+  builder.AddColumn(kColumnFloat, 1, values);
+  const string block = builder.Finish();
+
+  ColumnBlockReader reader;
+  EXPECT_TRUE(errors::IsDataLoss(reader.Init("")));
+  EXPECT_TRUE(errors::IsDataLoss(reader.Init("not a column block")));
+  // Truncated column data.
+  EXPECT_TRUE(
+      errors::IsDataLoss(reader.Init(StringPiece(block).substr(
+          0, block.size() - 1))));
+  // Truncated header.
+  EXPECT_TRUE(errors::IsDataLoss(reader.Init(StringPiece(block).substr(0, 7))));
+}
+
+TEST(ColumnBlockTest, TooManyColumns) {
+  // A header declaring 2^32 - 1 columns, with none of their entries.
+  string block;
+  core::PutFixed32(&block, kColumnBlockMagic);
+  core::PutVarint64(&block, 1);
+  core::PutVarint32(&block, 0xffffffffu);
+  block.append(100, '\0');
+  ColumnBlockReader reader;
+  Status s = reader.Init(block);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+  EXPECT_TRUE(StringPiece(s.error_message()).contains("4294967295 columns"))
+      << s;
+}
+
+TEST(ColumnBlockTest, TooManyRows) {
+  // A header declaring 2^63 rows, which do not fit in an int64, and no
+  // columns.
+  string block;
+  core::PutFixed32(&block, kColumnBlockMagic);
+  core::PutVarint64(&block, 1ULL << 63);
+  core::PutVarint32(&block, 0);
+  ColumnBlockReader reader;
+  Status s = reader.Init(block);
+  EXPECT_TRUE(errors::IsDataLoss(s)) << s;
+}
+
+}  // namespace
+}  // namespace io
+}  // namespace tensorflow
@@ -0,0 +1,137 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "tensorflow/core/lib/io/filter_block.h"
+
+#include <memory>
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace table {
+namespace {
+
+string Key(int i) {
+  string result;
+  core::PutFixed32(&result, i);
+  return result;
+}
+
+class BloomTest : public ::testing::Test {
+ protected:
+  BloomTest() : policy_(NewBloomFilterPolicy(10)) {}
+
+  void Build(int n) {
+    std::vector<string> keys;
+    for (int i = 0; i < n; ++i) keys.push_back(Key(i));
+    std::vector<StringPiece> pieces(keys.begin(), keys.end());
+    filter_.clear();
+    policy_->CreateFilter(pieces.data(), pieces.size(), &filter_);
+  }
+
+  bool Matches(const string& key) {
+    return policy_->KeyMayMatch(key, filter_);
+  }
+
+  std::unique_ptr<const FilterPolicy> policy_;
+  string filter_;
+};
+
+TEST_F(BloomTest, EmptyFilter) {
+  Build(0);
+  EXPECT_FALSE(Matches("hello"));
+  EXPECT_FALSE(Matches("world"));
+}
+
+TEST_F(BloomTest, VaryingLengths) {
+  for (int n : {1, 10, 100, 1000, 10000}) {
+    Build(n);
+    EXPECT_LE(filter_.size(), (n * 10 / 8) + 40) << n;
+    // All added keys must match.
+    for (int i = 0; i < n; ++i) {
+      ASSERT_TRUE(Matches(Key(i))) << "Length " << n << "; key " << i;
+    }
+    // Check false positive rate.
+    int false_positives = 0;
+    for (int i = 0; i < 10000; ++i) {
+      if (Matches(Key(i + 1000000000))) ++false_positives;
+    }
+    EXPECT_LE(false_positives, 200) << n;  // At most 2%.
+  }
+}
+
+TEST(FilterBlockTest, EmptyBuilder) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  FilterBlockBuilder builder(policy.get());
+  StringPiece block = builder.Finish();
+  EXPECT_EQ(StringPiece("\x00\x00\x00\x00\x0b", 5), block);
+  FilterBlockReader reader(policy.get(), block);
+  EXPECT_TRUE(reader.KeyMayMatch(0, "foo"));
+  EXPECT_TRUE(reader.KeyMayMatch(100000, "foo"));
+}
+
+TEST(FilterBlockTest, MultiChunk) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  FilterBlockBuilder builder(policy.get());
+
+  // First filter
+  builder.StartBlock(0);
+  builder.AddKey("foo");
+  builder.StartBlock(2000);
+  builder.AddKey("bar");
+
+  // Second filter
+  builder.StartBlock(3100);
+  builder.AddKey("box");
+
+  // Third filter is empty
+
+  // Last filter
+  builder.StartBlock(9000);
+  builder.AddKey("box");
+  builder.AddKey("hello");
+
+  StringPiece block = builder.Finish();
+  FilterBlockReader reader(policy.get(), block);
+
+  // Check first filter
+  EXPECT_TRUE(reader.KeyMayMatch(0, "foo"));
+  EXPECT_TRUE(reader.KeyMayMatch(2000, "bar"));
+  EXPECT_FALSE(reader.KeyMayMatch(0, "box"));
+  EXPECT_FALSE(reader.KeyMayMatch(0, "hello"));
+
+  // Check second filter
+  EXPECT_TRUE(reader.KeyMayMatch(3100, "box"));
+  EXPECT_FALSE(reader.KeyMayMatch(3100, "foo"));
+  EXPECT_FALSE(reader.KeyMayMatch(3100, "bar"));
+  EXPECT_FALSE(reader.KeyMayMatch(3100, "hello"));
+
+  // Check third filter (empty)
+  EXPECT_FALSE(reader.KeyMayMatch(4100, "foo"));
+  EXPECT_FALSE(reader.KeyMayMatch(4100, "bar"));
+  EXPECT_FALSE(reader.KeyMayMatch(4100, "box"));
+  EXPECT_FALSE(reader.KeyMayMatch(4100, "hello"));
+
+  // Check last filter
+  EXPECT_TRUE(reader.KeyMayMatch(9000, "box"));
+  EXPECT_TRUE(reader.KeyMayMatch(9000, "hello"));
+  EXPECT_FALSE(reader.KeyMayMatch(9000, "foo"));
+  EXPECT_FALSE(reader.KeyMayMatch(9000, "bar"));
+}
+
+}  // namespace
+}  // namespace table
+}  // namespace tensorflow
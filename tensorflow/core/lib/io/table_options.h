@@ -21,6 +21,9 @@ limitations under the License.
 namespace tensorflow {
 namespace table {
 
+class Cache;
+class FilterPolicy;
+
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
 // being stored in a file.  The following enum describes which
@@ -60,6 +63,24 @@ struct Options {
   // incompressible, the kSnappyCompression implementation will
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression = kSnappyCompression;
+
+  // If non-NULL, use the specified cache for blocks read by Table::Open
+  // and its iterators.  The cache may be shared by several tables, and
+  // must outlive all of them.  Blocks are charged their uncompressed size.
+  // Only used when reading.
+  //
+  // Default: NULL, blocks are read and decoded on every access.
+  Cache* block_cache = nullptr;
+
+  // If non-NULL, use the specified filter policy to reduce disk reads.
+  // When building a table, a filter block is written for the keys of
+  // each data block; when reading, Table::InternalGet consults the filter
+  // block written with a policy of the same name, if any, before reading
+  // a data block.  Many applications will benefit from passing the result
+  // of NewBloomFilterPolicy() here.
+  //
+  // Default: NULL
+  const FilterPolicy* filter_policy = nullptr;
 };
 
 }  // namespace table
@@ -16,16 +16,21 @@ limitations under the License.
 #include "tensorflow/core/lib/io/table.h"
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/io/block.h"
 #include "tensorflow/core/lib/io/block_builder.h"
+#include "tensorflow/core/lib/io/cache.h"
+#include "tensorflow/core/lib/io/filter_policy.h"
 #include "tensorflow/core/lib/io/format.h"
 #include "tensorflow/core/lib/io/iterator.h"
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/random/simple_philox.h"
 #include "tensorflow/core/lib/strings/str_util.h"
+#include "tensorflow/core/lib/strings/stringprintf.h"
 #include "tensorflow/core/platform/env.h"
 #include "tensorflow/core/platform/snappy.h"
 #include "tensorflow/core/platform/test.h"
@@ -218,12 +223,13 @@ class TableConstructor : public Constructor {
 
     // Open the table
     source_ = new StringSource(sink.contents());
-    Options table_options;
-    return Table::Open(table_options, source_, sink.contents().size(), &table_);
+    return Table::Open(options, source_, sink.contents().size(), &table_);
   }
 
   virtual Iterator* NewIterator() const { return table_->NewIterator(); }
 
+  Table* table() const { return table_; }
+
   uint64 ApproximateOffsetOf(const StringPiece& key) const {
     return table_->ApproximateOffsetOf(key);
   }
@@ -609,5 +615,77 @@ TEST(TableTest, SeekToFirstKeyDoesNotReadTooMuch) {
   EXPECT_LT(c.BytesRead(), 200);
 }
 
+static void SaveValue(void* arg, const StringPiece& k, const StringPiece& v) {
+  std::pair<string, string>* result =
+      reinterpret_cast<std::pair<string, string>*>(arg);
+  result->first = k.ToString();
+  result->second = v.ToString();
+}
+
+TEST(TableTest, BlockCache) {
+  std::unique_ptr<Cache> cache(NewLRUCache(1 << 20));
+  TableConstructor c;
+  c.Add("k01", string(1000, 'a'));
+  c.Add("k02", string(1000, 'b'));
+  c.Add("k03", string(1000, 'c'));
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.block_cache = cache.get();
+  c.Finish(options, &keys, &kvmap);
+
+  std::vector<uint64> bytes_read;
+  for (int i = 0; i < 2; ++i) {
+    std::pair<string, string> result;
+    TF_EXPECT_OK(c.table()->InternalGet("k02", &result, &SaveValue));
+    EXPECT_EQ("k02", result.first);
+    EXPECT_EQ(string(1000, 'b'), result.second);
+    bytes_read.push_back(c.BytesRead());
+  }
+  // The block of "k02" is only read once.
+  EXPECT_EQ(bytes_read[0], bytes_read[1]);
+  Iterator* iter = c.NewIterator();
+  iter->Seek("k02");
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_EQ(string(1000, 'b'), iter->value().ToString());
+  delete iter;
+  EXPECT_EQ(bytes_read[0], c.BytesRead());
+  EXPECT_GT(cache->TotalCharge(), 1000);
+}
+
+TEST(TableTest, BloomFilter) {
+  std::unique_ptr<const FilterPolicy> policy(NewBloomFilterPolicy(10));
+  TableConstructor c;
+  for (int i = 0; i < 100; ++i) {
+    c.Add(strings::Printf("k%03d", 2 * i), string(100, 'x'));
+  }
+  std::vector<string> keys;
+  KVMap kvmap;
+  Options options;
+  options.block_size = 1024;
+  options.compression = kNoCompression;
+  options.filter_policy = policy.get();
+  c.Finish(options, &keys, &kvmap);
+
+  for (const string& key : keys) {
+    std::pair<string, string> result;
+    TF_EXPECT_OK(c.table()->InternalGet(key, &result, &SaveValue));
+    EXPECT_EQ(key, result.first);
+  }
+  // Absent keys rarely read a data block.
+  const uint64 bytes_read = c.BytesRead();
+  int false_positives = 0;
+  for (int i = 0; i < 100; ++i) {
+    std::pair<string, string> result;
+    TF_EXPECT_OK(c.table()->InternalGet(strings::Printf("k%03d", 2 * i + 1),
+                                        &result, &SaveValue));
+    if (!result.first.empty()) ++false_positives;
+  }
+  EXPECT_LE(false_positives, 5);
+  EXPECT_LT(c.BytesRead() - bytes_read, 5 * 1200);
+}
+
 }  // namespace table
 }  // namespace tensorflow
@@ -54,6 +54,16 @@ struct UncompressFlags {
   // equal to width*components*sizeof(JSAMPLE).  If 0 is passed, the stride
   // used will be this minimal value.
   int stride = 0;
+
+  // If true, only the window of crop_width x crop_height pixels whose top left
+  // corner is (crop_x, crop_y) is returned.  The window is in pixels of the
+  // scaled image, and must fit in it.  The lines below the window are never
+  // decoded.
+  bool crop = false;
+  int crop_x = 0;
+  int crop_y = 0;
+  int crop_width = 0;
+  int crop_height = 0;
 };
 
 // Uncompress some raw JPEG data given by the pointer srcdata and the length
@@ -21,6 +21,7 @@ limitations under the License.
 #include <string.h>
 
 #include <memory>
+#include <vector>
 
 #include "tensorflow/core/lib/jpeg/jpeg_handle.h"
 #include "tensorflow/core/platform/env.h"
@@ -95,6 +96,84 @@ TEST(JpegMemTest, Jpeg) {
   TestJPEG(env, data_path + "jpeg_merge_test1_cmyk.jpg");
 }
 
+// Checks that crops of "jpegfile" match the same window of the whole image.
+void TestCrop(Env* env, const string& jpegfile) {
+  string jpeg;
+  ReadFileToStringOrDie(env, jpegfile, &jpeg);
+
+  for (const int ratio : {1, 2}) {
+    UncompressFlags flags;
+    flags.components = 3;
+    flags.ratio = ratio;
+    int w, h, c;
+    std::unique_ptr<uint8[]> full(
+        Uncompress(jpeg.data(), jpeg.size(), flags, &w, &h, &c, nullptr));
+    CHECK(full.get() != nullptr);
+
+    struct Window {
+      int x, y, width, height;
+    };
+    for (const Window& window : std::vector<Window>{{0, 0, w, h},
+                                                    {0, 0, w, 7},
+                                                    {5, 3, 17, 11},
+                                                    {0, h / 2, w / 3, 1},
+                                                    {w - 9, h - 13, 9, 13}}) {
+      flags.crop = true;
+      flags.crop_x = window.x;
+      flags.crop_y = window.y;
+      flags.crop_width = window.width;
+      flags.crop_height = window.height;
+      int crop_w, crop_h, crop_c;
+      std::unique_ptr<uint8[]> crop(Uncompress(jpeg.data(), jpeg.size(), flags,
+                                               &crop_w, &crop_h, &crop_c,
+                                               nullptr));
+      CHECK(crop.get() != nullptr);
+      CHECK_EQ(window.width, crop_w);
+      CHECK_EQ(window.height, crop_h);
+      CHECK_EQ(3, crop_c);
+      for (int y = 0; y < window.height; ++y) {
+        CHECK_EQ(0, memcmp(&crop[y * crop_w * 3],
+                           &full[((window.y + y) * w + window.x) * 3],
+                           crop_w * 3))
+            << jpegfile << " ratio " << ratio << " line " << y;
+      }
+    }
+
+    // Windows which do not fit in the image.
+    for (const Window& window : std::vector<Window>{{-1, 0, 5, 5},
+                                                    {0, 0, w + 1, 5},
+                                                    {1, 0, w, 5},
+                                                    {0, h - 4, 5, 5},
+                                                    {0, 0, 0, 5}}) {
+      flags.crop_x = window.x;
+      flags.crop_y = window.y;
+      flags.crop_width = window.width;
+      flags.crop_height = window.height;
+      CHECK(Uncompress(jpeg.data(), jpeg.size(), flags, &w, &h, &c, nullptr) ==
+            nullptr);
+    }
+  }
+
+  // Only the lines down to the window are needed, so a window at the top of a
+  // truncated file is decoded in full.
+  UncompressFlags flags;
+  flags.components = 3;
+  flags.crop = true;
+  flags.crop_width = 16;
+  flags.crop_height = 16;
+  int w, h, c;
+  std::unique_ptr<uint8[]> crop(
+      Uncompress(jpeg.data(), jpeg.size() / 2, flags, &w, &h, &c, nullptr));
+  CHECK(crop.get() != nullptr);
+}
+
+TEST(JpegMemTest, Crop) {
+  Env* env = Env::Default();
+  const string data_path = kTestData;
+  TestCrop(env, data_path + "jpeg_merge_test1.jpg");
+  TestCrop(env, data_path + "jpeg_merge_test1_cmyk.jpg");
+}
+
 TEST(JpegMemTest, Jpeg2) {
   // create known data, for size in_w x in_h
   const int in_w = 256;
@@ -545,6 +545,26 @@ this operation will permute `params` accordingly.
 </div>
 )doc");
 
+REGISTER_OP("_FusedGather")
+    .Input("params: Tparams")
+    .Input("indices: Tindices")
+    .Input("bias: Tparams")
+    .Attr("validate_indices: bool = true")
+    .Output("output: Tparams")
+    .Attr("Tparams: {float, double}")
+    .Attr("Tindices: {int32,int64}")
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .Doc(R"doc(
+Computes activation(Gather(params, indices) + bias) in one pass.
+
+Inserted by the graph optimizer in place of a Gather followed by a BiasAdd and
+optionally a Relu, so that the bias and the activation are applied to each
+gathered row as it is copied.
+
+bias: 1-D with the size of the last dimension of the output.
+activation: The activation applied after adding the bias.
+)doc");
+
 // --------------------------------------------------------------------------
 REGISTER_OP("GatherNd")
     .Input("params: Tparams")
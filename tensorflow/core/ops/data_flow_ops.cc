@@ -371,6 +371,33 @@ handle: The handle to a queue.
 size: The number of elements in the given queue.
 )doc");
 
+REGISTER_OP("QueueStats")
+    .Input("handle: Ref(string)")
+    .Output("summary: string")
+    .SetIsStateful()
+    .Doc(R"doc(
+Outputs a `Summary` protocol buffer with statistics about the given queue.
+
+The summary has values tagged `queue/<name>/<statistic>`, where `<name>` is
+the shared name of the queue, for:
+
+* `size`: The number of elements in the queue.
+* `enqueued`, `dequeued`: The number of elements enqueued and dequeued since
+  the queue was created.
+* `enqueue_rate`, `dequeue_rate`: The number of elements enqueued and
+  dequeued per second since the previous `QueueStats` op on the queue ran.
+* `enqueue_wait_usecs`, `dequeue_wait_usecs`: Histograms of how long
+  enqueue and dequeue operations blocked, in microseconds, with their mean,
+  median and 99th percentile as separate values (`.../mean`, `.../p50` and
+  `.../p99`).  Consumers that wait much longer than producers indicate an
+  input pipeline that does not keep up.
+* `occupancy`: A histogram of the number of elements in the queue after each
+  enqueue or dequeue, and its mean, median and 99th percentile.
+
+handle: The handle to a queue.
+summary: Scalar. Serialized `Summary` protocol buffer.
+)doc");
+
 // --------------------------------------------------------------------------
 
 REGISTER_OP("Stack")
@@ -678,6 +705,44 @@ values: Same shape as `keys`.  Values found in the table, or `default_values`
    for missing keys.
 )doc");
 
+REGISTER_OP("LookupTableInsert")
+    .Input("table_handle: Ref(string)")
+    .Input("keys: Tin")
+    .Input("values: Tout")
+    .Attr("Tin: type")
+    .Attr("Tout: type")
+    .Doc(R"doc(
+Updates the table to associate keys with values.
+
+The tensor `keys` must be of the same type as the keys of the table.
+The tensor `values` must be of the type of the table values.  Keys already
+in the table get the new values.  If a key is repeated in `keys`, the table
+gets the last of its values.
+
+The table must support updates, as `MutableHashTable` does.
+
+table_handle: Handle to the table.
+keys:  Any shape.  Keys to insert.
+values: Same shape as `keys`.  Values to associate with keys.
+)doc");
+
+REGISTER_OP("LookupTableExport")
+    .Input("table_handle: Ref(string)")
+    .Output("keys: Tkeys")
+    .Output("values: Tvalues")
+    .Attr("Tkeys: type")
+    .Attr("Tvalues: type")
+    .Doc(R"doc(
+Outputs all keys and values in the table.
+
+The table must support exports, as `MutableHashTable` does.  The entries are
+output in no particular order.
+
+table_handle: Handle to the table.
+keys: Vector of all keys present in the table.
+values: Vector of the values of `keys`.
+)doc");
+
 REGISTER_OP("LookupTableSize")
     .Input("table_handle: Ref(string)")
     .Output("size: int64")
@@ -711,6 +776,30 @@ key_dtype: Type of the table keys.
 value_dtype: Type of the table values.
 )doc");
 
+REGISTER_OP("MutableHashTable")
+    .Output("table_handle: Ref(string)")
+    .Attr("container: string = ''")
+    .Attr("shared_name: string = ''")
+    .Attr("key_dtype: type")
+    .Attr("value_dtype: type")
+    .SetIsStateful()
+    .Doc(R"doc(
+Creates an empty hash table.
+
+This op creates a mutable hash table, specifying the type of its keys and
+values.  Each value must be a scalar.  Data can be inserted into the table
+using the insert operations, at any time and concurrently with lookups.  It
+does not support the initialization operation.
+
+table_handle: Handle to a table.
+container: If non-empty, this table is placed in the given container.
+  Otherwise, a default container is used.
+shared_name: If non-empty, this table is shared under the given name across
+  multiple sessions.
+key_dtype: Type of the table keys.
+value_dtype: Type of the table values.
+)doc");
+
 REGISTER_OP("InitializeTable")
     .Input("table_handle: Ref(string)")
     .Input("keys: Tkey")
@@ -213,6 +213,42 @@ acceptable_fraction: The minimum required fraction of lines before a truncated
 image: 3-D with shape `[height, width, channels]`..
 )doc");
 
+// --------------------------------------------------------------------------
+REGISTER_OP("DecodeCropAndResizeJpeg")
+    .Input("contents: string")
+    .Input("crop_window: int32")
+    .Input("size: int32")
+    .Attr("channels: int = 0")
+    .Attr("fancy_upscaling: bool = true")
+    .Attr("align_corners: bool = false")
+    .Output("resized_image: float")
+    .Doc(R"doc(
+Decode a window of a JPEG-encoded image and resize it with bilinear
+interpolation.
+
+The result is close to that of `DecodeJpeg`, followed by a crop of the window
+and by `ResizeBilinear`, but much cheaper: the window is decoded at the lowest
+of the scales 1/8, 1/4, 1/2 and 1 at which it is not smaller than `size`, and
+the lines below the window are not decoded.  When the window is decoded at full
+scale, the result is the same.
+
+The attr `channels` is as in `DecodeJpeg`.
+
+contents: 0-D.  The JPEG-encoded image.
+crop_window: 1-D of 4 elements, `[offset_height, offset_width, target_height,
+  target_width]`.  The window to decode, in pixels of the image.
+size: A 1-D int32 Tensor of 2 elements: `new_height, new_width`.  The
+  new size for the window.
+channels: Number of color channels for the decoded image.
+fancy_upscaling: If true use a slower but nicer upscaling of the
+  chroma planes (yuv420/422 only).
+align_corners: If true, rescale the window by (new_height - 1) / (height - 1),
+  which exactly aligns the 4 corners of the window and of the resized image.
+  If false, rescale by new_height / height.  Treat similarly the width
+  dimension.
+resized_image: 3-D with shape `[new_height, new_width, channels]`.
+)doc");
+
 // --------------------------------------------------------------------------
 REGISTER_OP("EncodeJpeg")
     .Input("image: uint8")
@@ -75,6 +75,44 @@ shapes_and_slices: Shape `[N]`.  The shapes and slice specifications to use when
 data: `N` tensors to save.
 )doc");
 
+REGISTER_OP("SaveSlicesAsync")
+    .Input("filename: string")
+    .Input("tensor_names: string")
+    .Input("shapes_and_slices: string")
+    .Input("data: T")
+    .Attr("T: list(type)")
+    .Doc(R"doc(
+Saves input tensors slices to disk in the background.
+
+This is like `SaveSlices` except that the op only copies the input tensors and
+returns, while the copies are written to `filename` by a background thread.
+Training can then go on while the checkpoint is being written.
+
+Saves to the same file are written one after the other, in the order in which
+the ops ran. Use `WaitForSave` to wait for them to finish and get their status.
+
+filename: Must have a single element. The name of the file to which we write the
+  tensor.
+tensor_names: Shape `[N]`. The names of the tensors to be saved.
+shapes_and_slices: Shape `[N]`.  The shapes and slice specifications to use when
+  saving the tensors.
+data: `N` tensors to save.
+)doc");
+
+REGISTER_OP("WaitForSave")
+    .Input("filename: string")
+    .SetIsStateful()
+    .Doc(R"doc(
+Waits for the background saves to a file to finish.
+
+Completes once all the `SaveSlicesAsync` ops that have run so far for
+`filename` have written their checkpoint, and fails with the first error that
+the saves started since the previous `WaitForSave` for `filename` ran into.
+Completes right away if no such save is pending.
+
+filename: Must have a single element. The name of the file to wait for.
+)doc");
+
 REGISTER_OP("Restore")
     .Input("file_pattern: string")
     .Input("tensor_name: string")
@@ -140,6 +178,54 @@ preferred_shard: Index of file to open first if multiple files match
   `file_pattern`. See the documentation for `Restore`.
 )doc");
 
+REGISTER_OP("SaveDelta")
+    .Input("filename: string")
+    .Input("base: string")
+    .Input("tensor_names: string")
+    .Input("rows: N * int64")
+    .Input("data: T")
+    .Attr("N: int >= 1")
+    .Attr("T: list(type)")
+    .Doc(R"doc(
+Saves the changed rows of the input tensors to a delta checkpoint.
+
+A delta checkpoint only holds the rows of each tensor listed in `rows`, which
+are usually the rows that changed since the checkpoint `base` was saved, as
+returned by `TakeDirtyRows`. `base` may be a delta checkpoint itself: use
+`RestoreDelta` to restore a tensor from a chain of delta checkpoints.
+
+filename: Must have a single element. The name of the file to which we write
+  the rows.
+base: Must have a single element. The file pattern of the checkpoint the
+  rows apply to.
+tensor_names: Shape `[N]`. The names of the tensors to be saved.
+rows: `N` vectors of indices along the first dimension of the tensors in
+  `data`. Only these rows are saved.
+data: `N` tensors, each at least 1-D, whose rows to save.
+)doc");
+
+REGISTER_OP("RestoreDelta")
+    .Input("file_pattern: string")
+    .Input("tensor_name: string")
+    .Output("tensor: dt")
+    .Attr("dt: type")
+    .Doc(R"doc(
+Restores a tensor from a chain of delta checkpoints.
+
+Follows the chain of `base` checkpoints of the delta checkpoint `file_pattern`,
+saved by `SaveDelta`, back to a full checkpoint, restores the tensor from that
+checkpoint, and then applies the rows saved in each delta, oldest first.
+Deltas that do not hold the tensor leave it unchanged. If `file_pattern` is a
+full checkpoint, this is the same as `Restore`.
+
+file_pattern: Must have a single element. The pattern of the files of the
+  newest checkpoint of the chain.
+tensor_name: Must have a single element. The name of the tensor to be
+  restored.
+tensor: The restored tensor.
+dt: The type of the tensor to be restored.
+)doc");
+
 REGISTER_OP("ShardedFilename")
     .Input("basename: string")
     .Input("shard: int32")
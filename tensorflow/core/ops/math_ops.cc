@@ -593,6 +593,26 @@ transpose_a: If true, "a" is transposed before multiplication.
 transpose_b: If true, "b" is transposed before multiplication.
 )doc");
 
+REGISTER_OP("_FusedMatMul")
+    .Input("a: T")
+    .Input("b: T")
+    .Input("bias: T")
+    .Output("product: T")
+    .Attr("transpose_a: bool = false")
+    .Attr("transpose_b: bool = false")
+    .Attr("T: {float, double}")
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .Doc(R"doc(
+Computes activation(MatMul(a, b) + bias) in one pass.
+
+Inserted by the graph optimizer in place of a MatMul followed by a BiasAdd and
+optionally a Relu, so that the bias and the activation are applied to each
+block of the product while it is still in cache.
+
+bias: 1-D with the size of the last dimension of the product.
+activation: The activation applied after adding the bias.
+)doc");
+
 REGISTER_OP("SparseMatMul")
     .Input("a: float")
     .Input("b: float")
@@ -1047,6 +1067,70 @@ segment_ids: segment_ids passed to the corresponding SparseSegmentSqrtN op.
 output_dim0: dimension 0 of "data" passed to SparseSegmentSqrtN op.
 )doc");
 
+REGISTER_OP("EmbeddingLookupSparse")
+    .Input("params: T")
+    .Input("ids: Tidx")
+    .Input("weights: T")
+    .Input("segment_ids: int32")
+    .Output("output: T")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64}")
+    .Doc(R"doc(
+Looks up rows of `params` and combines them along sparse segments.
+
+Computes the same result as gathering `params[ids]`, scaling each row by its
+weight and reducing the rows of each segment with `combiner`, but accumulates
+the rows straight into the output without materializing the gathered rows.
+
+For segment `i`, with `w` the weights of the entries in the segment:
+
+* "sum" computes `sum(w[j] * params[ids[j]])`.
+* "mean" divides that sum by `sum(w[j])`.
+* "sqrtn" divides that sum by `sqrt(sum(w[j] ** 2))`.
+
+Segments without entries are zero.
+
+params: The embedding tensor.
+ids: A 1-D tensor of rows of `params` to look up.
+weights: A 1-D tensor with the weight of each entry, of the same size as
+  `ids`, or an empty tensor to take all weights to be 1.
+segment_ids: A 1-D tensor with the segment of each entry, of the same size as
+  `ids`. Values should be sorted and can be repeated.
+output: Has same shape as params, except for dimension 0 which has size `k`,
+  the last segment id plus one.
+)doc");
+
+REGISTER_OP("EmbeddingLookupSparseGrad")
+    .Input("grad: T")
+    .Input("params: T")
+    .Input("ids: Tidx")
+    .Input("weights: T")
+    .Input("segment_ids: int32")
+    .Input("output: T")
+    .Output("params_grad: T")
+    .Output("weights_grad: T")
+    .Attr("combiner: {'sum', 'mean', 'sqrtn'}")
+    .Attr("T: {float, double}")
+    .Attr("Tidx: {int32, int64}")
+    .Doc(R"doc(
+Computes gradients for EmbeddingLookupSparse.
+
+The gradient with respect to `params` is returned as one row per entry, to be
+scattered to the rows `ids` of `params`.
+
+grad: gradient propagated to the EmbeddingLookupSparse op.
+params: params passed to the corresponding EmbeddingLookupSparse op.
+ids: ids passed to the corresponding EmbeddingLookupSparse op.
+weights: weights passed to the corresponding EmbeddingLookupSparse op.
+segment_ids: segment_ids passed to the corresponding EmbeddingLookupSparse op.
+output: output of the corresponding EmbeddingLookupSparse op.
+params_grad: Has same shape as params, except for dimension 0 which has the
+  size of `ids`. Row `j` is the gradient with respect to `params[ids[j]]`.
+weights_grad: The gradient with respect to `weights`, or an empty tensor if
+  `weights` is empty.
+)doc");
+
 REGISTER_OP("All")
     .Input("input: bool")
     .Input("reduction_indices: int32")
@@ -264,6 +264,27 @@ data_format: Specify the data format of the input and output data. With the
         [batch, in_channels, in_height, in_width].
 )doc");
 
+REGISTER_OP("_FusedConv2D")
+    .Input("input: T")
+    .Input("filter: T")
+    .Input("bias: T")
+    .Output("output: T")
+    .Attr("T: {float}")
+    .Attr("strides: list(int)")
+    .Attr("use_cudnn_on_gpu: bool = true")
+    .Attr(GetPaddingAttrString())
+    .Attr(GetConvnetDataFormatAttrString())
+    .Attr("activation: {'None', 'Relu'} = 'None'")
+    .Doc(R"doc(
+Computes activation(Conv2D(input, filter) + bias) in one pass.
+
+Inserted by the graph optimizer in place of a Conv2D followed by a BiasAdd and
+optionally a Relu.  Only the "NHWC" data format is supported.
+
+bias: 1-D with the size of the last dimension of the output.
+activation: The activation applied after adding the bias.
+)doc");
+
 REGISTER_OP("Conv2DBackpropInput")
     .Input("input_sizes: int32")
     .Input("filter: T")
@@ -206,6 +206,25 @@ field_delim: delimiter to separate fields in a record.
 output: Each tensor will have the same shape as records.
 )doc");
 
+REGISTER_OP("DecodeColumnBlock")
+    .Input("block: string")
+    .Output("output: dtypes")
+    .Attr("dtypes: list({float,double,int32,int64}) >= 1")
+    .Attr("row_shapes: list(shape) >= 1")
+    .Doc(R"doc(
+Decodes a column block into one dense tensor per column.
+
+A column block stores a batch of rows column by column, each column holding
+a fixed number of typed values per row (see lib/io/column_block.h). Columns
+stored uncompressed are decoded with a single copy.
+
+block: A scalar string holding one serialized column block, e.g. a record
+  read by a TFRecordReader.
+dtypes: The type of each column.
+row_shapes: The shape of a single row of each column.
+output: One tensor per column, of shape `[num_rows] + row_shapes[i]`.
+)doc");
+
 REGISTER_OP("StringToNumber")
     .Input("string_tensor: string")
     .Output("output: out_type")
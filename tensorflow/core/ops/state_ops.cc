@@ -54,6 +54,47 @@ ref: Should be from a `Variable` node. May be uninitialized.
 dtype: The type of elements in the variable tensor.
 )doc");
 
+REGISTER_OP("TakeDirtyRows")
+    .Input("ref: Ref(T)")
+    .Output("rows: int64")
+    .Attr("T: type")
+    .SetIsStateful()
+    .Doc(R"doc(
+Returns the rows of a variable that changed since they were last committed.
+
+The first call for a variable starts tracking which of its rows are updated by
+`ScatterUpdate`, `ScatterAdd`, `ScatterSub` and the sparse training ops, and
+returns all of its rows. Later calls return, in increasing order, the rows
+updated since the previous call and the rows returned by earlier calls that
+were not committed with `CommitDirtyRows` since. Updates that may change any
+row, such as `Assign`, and a change of the buffer or shape of the variable make
+the next call return all the rows again.
+
+This is meant to select the rows that a delta checkpoint saves, see
+`SaveDelta`. Commit the rows once the delta is saved: if the save fails, the
+next call returns them again. Rows updated while the delta is being saved are
+returned again by the next call either way.
+
+ref: Should be from a `Variable` node. Must be at least 1-D.
+rows: Indices along the first dimension of `ref`.
+)doc");
+
+REGISTER_OP("CommitDirtyRows")
+    .Input("ref: Ref(T)")
+    .Input("rows: int64")
+    .Attr("T: type")
+    .SetIsStateful()
+    .Doc(R"doc(
+Records that rows returned by `TakeDirtyRows` were saved.
+
+The committed rows are no longer returned by `TakeDirtyRows`, unless they are
+updated again. Rows that are out of range, and rows taken before the buffer or
+shape of the variable changed, are ignored.
+
+ref: Should be from a `Variable` node. Must be at least 1-D.
+rows: Rows of `ref` returned by `TakeDirtyRows`.
+)doc");
+
 REGISTER_OP("TemporaryVariable")
     .Output("ref: Ref(dtype)")
     .Attr("shape: shape")
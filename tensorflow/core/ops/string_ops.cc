@@ -33,6 +33,49 @@ num_buckets: The number of buckets.
 output: A Tensor of the same shape as the input `string_tensor`.
 )doc");
 
+REGISTER_OP("StringToHashBucketStrong")
+    .Input("input: string")
+    .Output("output: int64")
+    .Attr("num_buckets: int >= 1")
+    .Attr("key: list(int)")
+    .Doc(R"doc(
+Converts each string in the input Tensor to its keyed hash mod by a number of
+buckets.
+
+The hash is SipHash-2-4 under the 128-bit key `key`, given as two 64-bit
+integers, low half first.  Unlike `StringToHashBucket`, its output never
+changes, so bucket ids may be stored and compared across processes and
+releases.  Without the key, inputs that collide cannot be crafted.
+
+input: The strings to assign a hash bucket.
+num_buckets: The number of buckets.
+key: The key of the hash function, a list of two integers.
+output: A Tensor of the same shape as `input`.
+)doc");
+
+REGISTER_OP("CrossToHashBucket")
+    .Input("inputs: Tin")
+    .Output("output: int64")
+    .Attr("num_buckets: int >= 1")
+    .Attr("key: list(int)")
+    .Attr("Tin: list({int64, string}) >= 1")
+    .Doc(R"doc(
+Hashes the cross of features to a number of buckets.
+
+The inputs all have the same shape.  For each index, the elements of the inputs
+at that index form a cross, which is hashed without building the concatenation
+of its features.  Each feature is hashed with the keyed hash of
+`StringToHashBucketStrong`, int64 features as their 8 little-endian bytes, and
+the hashes are combined in input order.  As with `StringToHashBucketStrong`,
+the output never changes.
+
+inputs: The features to cross, string or int64 Tensors of the same shape.
+  Integer features are typically bucket ids.
+num_buckets: The number of buckets.
+key: The key of the hash function, a list of two integers.
+output: A Tensor of the same shape as the inputs.
+)doc");
+
 REGISTER_OP("ReduceJoin")
     .Input("inputs: string")
     .Input("reduction_indices: int32")
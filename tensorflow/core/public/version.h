@@ -77,8 +77,13 @@ limitations under the License.
 //
 // 0. Checkpoints saved before checkpoint versioning.
 // 1. First real version (10feb2015).
+// 2. Slices may store their data out of line, in chunks (SavedSliceChunks).
+//    Only files that do so require consumer version 2.
+// 3. Delta checkpoints, which only hold the changed rows of their tensors
+//    (SavedTensorSliceMeta.delta_base). Only delta checkpoints require
+//    consumer version 3.
 #define TF_CHECKPOINT_VERSION_MIN_PRODUCER 0
 #define TF_CHECKPOINT_VERSION_MIN_CONSUMER 0
-#define TF_CHECKPOINT_VERSION 1
+#define TF_CHECKPOINT_VERSION 3
 
 #endif  // TENSORFLOW_CORE_PUBLIC_VERSION_H_
@@ -0,0 +1,637 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
+
+#include <map>
+#include <unordered_map>
+
+#include "tensorflow/core/example/feature.pb.h"
+#include "tensorflow/core/example/feature.pb_text.h"
+#include "tensorflow/core/lib/core/casts.h"
+#include "tensorflow/core/lib/core/coding.h"
+#include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/core/raw_coding.h"
+#include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/gtl/inlined_vector.h"
+#include "tensorflow/core/platform/logging.h"
+#include "tensorflow/core/platform/mutex.h"
+#include "tensorflow/core/util/work_sharder.h"
+
+namespace tensorflow {
+
+namespace {
+
+// Protocol buffer wire types, see
+// https://developers.google.com/protocol-buffers/docs/encoding.
+enum WireType {
+  kVarint = 0,
+  kFixed64 = 1,
+  kLengthDelimited = 2,
+  kFixed32 = 5,
+};
+
+inline bool ReadTag(StringPiece* input, uint32* field, uint32* wire_type) {
+  uint32 tag;
+  if (!core::GetVarint32(input, &tag)) return false;
+  *field = tag >> 3;
+  *wire_type = tag & 0x7;
+  return true;
+}
+
+inline bool ReadLengthDelimited(StringPiece* input, StringPiece* result) {
+  uint32 length;
+  if (!core::GetVarint32(input, &length) || length > input->size()) {
+    return false;
+  }
+  *result = StringPiece(input->data(), length);
+  input->remove_prefix(length);
+  return true;
+}
+
+// Skips over an unknown field. Groups are not supported; none of the
+// messages in example.proto or feature.proto use them.
+bool SkipField(StringPiece* input, uint32 wire_type) {
+  switch (wire_type) {
+    case kVarint: {
+      uint64 unused;
+      return core::GetVarint64(input, &unused);
+    }
+    case kFixed64:
+      if (input->size() < sizeof(uint64)) return false;
+      input->remove_prefix(sizeof(uint64));
+      return true;
+    case kLengthDelimited: {
+      StringPiece unused;
+      return ReadLengthDelimited(input, &unused);
+    }
+    case kFixed32:
+      if (input->size() < sizeof(uint32)) return false;
+      input->remove_prefix(sizeof(uint32));
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The serialized list held by one Feature message. Protobuf merges repeated
+// occurrences of the same oneof member, so the list may come in several
+// pieces; an occurrence of a different member replaces the earlier ones.
+struct FeatureView {
+  int kind = Feature::KIND_NOT_SET;
+  gtl::InlinedVector<StringPiece, 2> pieces;
+};
+
+bool ParseFeature(StringPiece input, FeatureView* feature) {
+  while (!input.empty()) {
+    uint32 field, wire_type;
+    if (!ReadTag(&input, &field, &wire_type)) return false;
+    if (field >= Feature::kBytesList && field <= Feature::kInt64List &&
+        wire_type == kLengthDelimited) {
+      StringPiece piece;
+      if (!ReadLengthDelimited(&input, &piece)) return false;
+      if (static_cast<int>(field) != feature->kind) {
+        feature->kind = field;
+        feature->pieces.clear();
+      }
+      feature->pieces.push_back(piece);
+    } else if (!SkipField(&input, wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int KindForType(DataType dtype) {
+  switch (dtype) {
+    case DT_INT64:
+      return Feature::kInt64List;
+    case DT_FLOAT:
+      return Feature::kFloatList;
+    case DT_STRING:
+      return Feature::kBytesList;
+    default:
+      return Feature::KIND_NOT_SET;
+  }
+}
+
+// ListParser<T>::Parse() decodes every value of a serialized Int64List,
+// FloatList or BytesList and hands it to sink->Push(). The numeric lists are
+// accepted in both the packed and the unpacked encoding, as the protobuf
+// parser does.
+template <typename T>
+struct ListParser;
+
+template <>
+struct ListParser<int64> {
+  template <typename Sink>
+  static bool Parse(StringPiece input, Sink* sink) {
+    while (!input.empty()) {
+      uint32 field, wire_type;
+      if (!ReadTag(&input, &field, &wire_type)) return false;
+      uint64 value;
+      if (field == 1 && wire_type == kLengthDelimited) {
+        StringPiece packed;
+        if (!ReadLengthDelimited(&input, &packed)) return false;
+        while (!packed.empty()) {
+          if (!core::GetVarint64(&packed, &value)) return false;
+          sink->Push(static_cast<int64>(value));
+        }
+      } else if (field == 1 && wire_type == kVarint) {
+        if (!core::GetVarint64(&input, &value)) return false;
+        sink->Push(static_cast<int64>(value));
+      } else if (!SkipField(&input, wire_type)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <>
+struct ListParser<float> {
+  template <typename Sink>
+  static bool Parse(StringPiece input, Sink* sink) {
+    while (!input.empty()) {
+      uint32 field, wire_type;
+      if (!ReadTag(&input, &field, &wire_type)) return false;
+      if (field == 1 && wire_type == kLengthDelimited) {
+        StringPiece packed;
+        if (!ReadLengthDelimited(&input, &packed) ||
+            packed.size() % sizeof(float) != 0) {
+          return false;
+        }
+        for (const char* p = packed.data(); p < packed.data() + packed.size();
+             p += sizeof(float)) {
+          sink->Push(bit_cast<float>(core::DecodeFixed32(p)));
+        }
+      } else if (field == 1 && wire_type == kFixed32) {
+        if (input.size() < sizeof(float)) return false;
+        sink->Push(bit_cast<float>(core::DecodeFixed32(input.data())));
+        input.remove_prefix(sizeof(float));
+      } else if (!SkipField(&input, wire_type)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+template <>
+struct ListParser<string> {
+  template <typename Sink>
+  static bool Parse(StringPiece input, Sink* sink) {
+    while (!input.empty()) {
+      uint32 field, wire_type;
+      if (!ReadTag(&input, &field, &wire_type)) return false;
+      if (field == 1 && wire_type == kLengthDelimited) {
+        StringPiece value;
+        if (!ReadLengthDelimited(&input, &value)) return false;
+        sink->Push(value);
+      } else if (!SkipField(&input, wire_type)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+inline void AssignValue(int64 value, int64* out) { *out = value; }
+inline void AssignValue(float value, float* out) { *out = value; }
+inline void AssignValue(StringPiece value, string* out) {
+  out->assign(value.data(), value.size());
+}
+
+// Writes the values of a dense feature into its row of the output tensor.
+// Values past the end of the row are counted but dropped, so that a size
+// mismatch can be reported with the actual number of values.
+template <typename T>
+class DenseSink {
+ public:
+  DenseSink(T* out, std::size_t size) : out_(out), size_(size) {}
+
+  template <typename V>
+  void Push(V value) {
+    if (count_ < size_) AssignValue(value, out_ + count_);
+    ++count_;
+  }
+
+  std::size_t count() const { return count_; }
+
+ private:
+  T* const out_;
+  const std::size_t size_;
+  std::size_t count_ = 0;
+};
+
+// Appends the values of a sparse feature to a temporary buffer.
+template <typename T>
+class SparseSink {
+ public:
+  explicit SparseSink(std::vector<T>* out) : out_(out) {}
+
+  template <typename V>
+  void Push(V value) {
+    out_->emplace_back();
+    AssignValue(value, &out_->back());
+  }
+
+ private:
+  std::vector<T>* const out_;
+};
+
+template <typename T, typename Sink>
+bool ParseFeatureValues(const FeatureView& feature, Sink* sink) {
+  for (StringPiece piece : feature.pieces) {
+    if (!ListParser<T>::Parse(piece, sink)) return false;
+  }
+  return true;
+}
+
+// Sparse values of one feature, for a contiguous range of Examples.
+struct SparseBuffer {
+  std::vector<int64> int64_list;
+  std::vector<float> float_list;
+  std::vector<string> bytes_list;
+  // Number of values in the buffer after each Example of the range.
+  std::vector<std::size_t> example_end_indices;
+};
+
+template <typename T>
+std::vector<T>* GetListFromBuffer(SparseBuffer* buffer);
+
+template <>
+std::vector<int64>* GetListFromBuffer<int64>(SparseBuffer* buffer) {
+  return &buffer->int64_list;
+}
+template <>
+std::vector<float>* GetListFromBuffer<float>(SparseBuffer* buffer) {
+  return &buffer->float_list;
+}
+template <>
+std::vector<string>* GetListFromBuffer<string>(SparseBuffer* buffer) {
+  return &buffer->bytes_list;
+}
+
+std::size_t BufferSize(const SparseBuffer& buffer, DataType dtype) {
+  switch (dtype) {
+    case DT_INT64:
+      return buffer.int64_list.size();
+    case DT_FLOAT:
+      return buffer.float_list.size();
+    case DT_STRING:
+      return buffer.bytes_list.size();
+    default:
+      LOG(FATAL) << "Not supposed to be here.  Saw dtype: " << dtype;
+  }
+}
+
+// Maps the requested feature names to slots. Dense and sparse features that
+// share a name share a slot.
+struct FeatureIndex {
+  std::unordered_map<StringPiece, int, StringPiece::Hasher> slots;
+  std::vector<int> dense_slots;
+  std::vector<int> sparse_slots;
+
+  int AddKey(const string& key) {
+    auto inserted = slots.insert({StringPiece(key), slots.size()});
+    return inserted.first->second;
+  }
+};
+
+// The serialized Feature found for each slot in the current Example. A later
+// map entry for the same key replaces an earlier one, as it does in the
+// protobuf parser.
+struct FoundFeature {
+  bool found;
+  StringPiece serialized;
+};
+
+bool ParseMapEntry(StringPiece input, StringPiece* key, StringPiece* value) {
+  while (!input.empty()) {
+    uint32 field, wire_type;
+    if (!ReadTag(&input, &field, &wire_type)) return false;
+    if (field == 1 && wire_type == kLengthDelimited) {
+      if (!ReadLengthDelimited(&input, key)) return false;
+    } else if (field == 2 && wire_type == kLengthDelimited) {
+      if (!ReadLengthDelimited(&input, value)) return false;
+    } else if (!SkipField(&input, wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ParseFeatures(StringPiece input, const FeatureIndex& index,
+                   std::vector<FoundFeature>* found) {
+  while (!input.empty()) {
+    uint32 field, wire_type;
+    if (!ReadTag(&input, &field, &wire_type)) return false;
+    if (field == 1 && wire_type == kLengthDelimited) {
+      StringPiece entry;
+      if (!ReadLengthDelimited(&input, &entry)) return false;
+      StringPiece key;
+      StringPiece value;
+      if (!ParseMapEntry(entry, &key, &value)) return false;
+      auto slot = index.slots.find(key);
+      if (slot != index.slots.end()) {
+        (*found)[slot->second] = {true, value};
+      }
+    } else if (!SkipField(&input, wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Walks the Features map of a serialized Example and records where the
+// requested features are. Nothing is copied.
+bool ParseExample(StringPiece input, const FeatureIndex& index,
+                  std::vector<FoundFeature>* found) {
+  for (FoundFeature& f : *found) f.found = false;
+  while (!input.empty()) {
+    uint32 field, wire_type;
+    if (!ReadTag(&input, &field, &wire_type)) return false;
+    if (field == 1 && wire_type == kLengthDelimited) {
+      StringPiece features;
+      if (!ReadLengthDelimited(&input, &features)) return false;
+      if (!ParseFeatures(features, index, found)) return false;
+    } else if (!SkipField(&input, wire_type)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Status ParseError(const string& serialized) {
+  return errors::InvalidArgument("Could not parse example input, value: '",
+                                 serialized, "'");
+}
+
+Status TypeMismatchError(StringPiece example_name, const string& key,
+                         DataType dtype, StringPiece serialized_feature) {
+  // Only reached on the error path, so a full parse is fine here.
+  Feature feature;
+  feature.ParseFromArray(serialized_feature.data(), serialized_feature.size());
+  return errors::InvalidArgument("Name: ", example_name, ", Feature: ", key,
+                                 ".  Data types don't match. ",
+                                 "Expected type: ", DataTypeString(dtype),
+                                 "  Feature is: ", ProtoDebugString(feature));
+}
+
+template <typename T>
+Status ParseDenseFeature(const string& serialized, StringPiece example_name,
+                         int64 batch_index, const FixedLenFeature& config,
+                         const FeatureView& feature, Tensor* out) {
+  const std::size_t num_elements = config.shape.num_elements();
+  DenseSink<T> sink(out->flat<T>().data() + batch_index * num_elements,
+                    num_elements);
+  if (!ParseFeatureValues<T>(feature, &sink)) return ParseError(serialized);
+  if (sink.count() != num_elements) {
+    return errors::InvalidArgument(
+        "Name: ", example_name, ", Key: ", config.key, ", Index: ", batch_index,
+        ".  Number of ", DataTypeString(config.dtype),
+        " values != expected.  values size: ", sink.count(),
+        " but output shape: ", config.shape.DebugString());
+  }
+  return Status::OK();
+}
+
+template <typename T>
+Status ParseSparseFeature(const string& serialized, const FeatureView& feature,
+                          SparseBuffer* buffer) {
+  SparseSink<T> sink(GetListFromBuffer<T>(buffer));
+  if (!ParseFeatureValues<T>(feature, &sink)) return ParseError(serialized);
+  return Status::OK();
+}
+
+Status ParseOneExample(const string& serialized, StringPiece example_name,
+                       int64 batch_index,
+                       const std::vector<FixedLenFeature>& fixed_len_features,
+                       const std::vector<VarLenFeature>& var_len_features,
+                       const FeatureIndex& index,
+                       std::vector<FoundFeature>* found,
+                       std::vector<Tensor*>* dense_values,
+                       std::vector<SparseBuffer>* sparse_buffers) {
+  if (!ParseExample(serialized, index, found)) return ParseError(serialized);
+
+  // Handle dense features.
+  for (size_t d = 0; d < fixed_len_features.size(); ++d) {
+    const FixedLenFeature& config = fixed_len_features[d];
+    const FoundFeature& f = (*found)[index.dense_slots[d]];
+    Tensor* out = (*dense_values)[d];
+    if (!f.found) {
+      if (config.default_value.NumElements() == 0) {
+        return errors::InvalidArgument("Name: ", example_name, ", Feature: ",
+                                       config.key,
+                                       " is required but could not be found.");
+      }
+      RowDenseCopy(batch_index, config.dtype, config.default_value, out);
+      continue;
+    }
+    FeatureView feature;
+    if (!ParseFeature(f.serialized, &feature)) return ParseError(serialized);
+    if (feature.kind != KindForType(config.dtype)) {
+      return TypeMismatchError(example_name, config.key, config.dtype,
+                               f.serialized);
+    }
+    switch (config.dtype) {
+      case DT_INT64:
+        TF_RETURN_IF_ERROR(ParseDenseFeature<int64>(
+            serialized, example_name, batch_index, config, feature, out));
+        break;
+      case DT_FLOAT:
+        TF_RETURN_IF_ERROR(ParseDenseFeature<float>(
+            serialized, example_name, batch_index, config, feature, out));
+        break;
+      case DT_STRING:
+        TF_RETURN_IF_ERROR(ParseDenseFeature<string>(
+            serialized, example_name, batch_index, config, feature, out));
+        break;
+      default:
+        return errors::InvalidArgument("Invalid input dtype: ",
+                                       DataTypeString(config.dtype));
+    }
+  }
+
+  // Handle sparse features.
+  for (size_t d = 0; d < var_len_features.size(); ++d) {
+    const VarLenFeature& config = var_len_features[d];
+    const FoundFeature& f = (*found)[index.sparse_slots[d]];
+    SparseBuffer* buffer = &(*sparse_buffers)[d];
+    if (f.found) {
+      FeatureView feature;
+      if (!ParseFeature(f.serialized, &feature)) return ParseError(serialized);
+      // A Feature with no list set is treated as missing.
+      if (feature.kind != Feature::KIND_NOT_SET) {
+        if (feature.kind != KindForType(config.dtype)) {
+          return TypeMismatchError(example_name, config.key, config.dtype,
+                                   f.serialized);
+        }
+        switch (config.dtype) {
+          case DT_INT64:
+            TF_RETURN_IF_ERROR(
+                ParseSparseFeature<int64>(serialized, feature, buffer));
+            break;
+          case DT_FLOAT:
+            TF_RETURN_IF_ERROR(
+                ParseSparseFeature<float>(serialized, feature, buffer));
+            break;
+          case DT_STRING:
+            TF_RETURN_IF_ERROR(
+                ParseSparseFeature<string>(serialized, feature, buffer));
+            break;
+          default:
+            return errors::InvalidArgument("Invalid input dtype: ",
+                                           DataTypeString(config.dtype));
+        }
+      }
+    }
+    buffer->example_end_indices.push_back(BufferSize(*buffer, config.dtype));
+  }
+  return Status::OK();
+}
+
+// Moves the values of one shard's buffer into the output values tensor,
+// starting at "offset".
+template <typename T>
+void MoveSparseValues(SparseBuffer* buffer, int64 offset, Tensor* values) {
+  std::vector<T>* list = GetListFromBuffer<T>(buffer);
+  std::move(list->begin(), list->end(), values->flat<T>().data() + offset);
+}
+
+// Everything produced by parsing one shard [start, limit) of the batch.
+struct ShardResult {
+  Status status;
+  std::vector<SparseBuffer> sparse;
+};
+
+}  // namespace
+
+Status FastParseExample(const std::vector<FixedLenFeature>& fixed_len_features,
+                        const std::vector<VarLenFeature>& var_len_features,
+                        gtl::ArraySlice<string> serialized,
+                        gtl::ArraySlice<string> example_names, int num_workers,
+                        thread::ThreadPool* workers,
+                        std::vector<Tensor*>* dense_values,
+                        const SparseOutputAllocator& allocate_sparse) {
+  const int64 batch_size = serialized.size();
+  const bool has_names = !example_names.empty();
+  if (has_names && example_names.size() != serialized.size()) {
+    return errors::InvalidArgument(
+        "Expected len(names) == len(serialized), but got: ",
+        example_names.size(), " vs. ", serialized.size());
+  }
+  CHECK_EQ(dense_values->size(), fixed_len_features.size());
+
+  FeatureIndex index;
+  for (const FixedLenFeature& config : fixed_len_features) {
+    index.dense_slots.push_back(index.AddKey(config.key));
+  }
+  for (const VarLenFeature& config : var_len_features) {
+    index.sparse_slots.push_back(index.AddKey(config.key));
+  }
+
+  // Estimate the cost of parsing each batch element.
+  int64 work_unit_size = 100 + 100 * var_len_features.size();
+  for (const FixedLenFeature& config : fixed_len_features) {
+    work_unit_size += config.shape.num_elements();
+  }
+
+  mutex mu;
+  // Keyed by the first batch index of each shard, so that iterating the map
+  // visits the shards in batch order.
+  std::map<int64, ShardResult> shard_results;
+
+  auto parse_range = [&](int64 start, int64 limit) {
+    ShardResult result;
+    result.sparse.resize(var_len_features.size());
+    std::vector<FoundFeature> found(index.slots.size());
+    for (int64 b = start; b < limit; ++b) {
+      const StringPiece example_name =
+          has_names ? StringPiece(example_names[b]) : StringPiece("<unknown>");
+      result.status = ParseOneExample(
+          serialized[b], example_name, b, fixed_len_features,
+          var_len_features, index, &found, dense_values, &result.sparse);
+      if (!result.status.ok()) break;
+    }
+    mutex_lock l(mu);
+    shard_results[start] = std::move(result);
+  };
+  Shard(num_workers, workers, batch_size, work_unit_size, parse_range);
+
+  for (const auto& shard : shard_results) {
+    TF_RETURN_IF_ERROR(shard.second.status);
+  }
+
+  // Now that the number of values of each sparse feature is known, allocate
+  // the sparse outputs and move the buffered values into them.
+  for (size_t d = 0; d < var_len_features.size(); ++d) {
+    const DataType dtype = var_len_features[d].dtype;
+    int64 total_num_features = 0;
+    int64 max_num_features = 0;
+    for (const auto& shard : shard_results) {
+      const SparseBuffer& buffer = shard.second.sparse[d];
+      std::size_t begin = 0;
+      for (std::size_t end : buffer.example_end_indices) {
+        max_num_features =
+            std::max(max_num_features, static_cast<int64>(end - begin));
+        begin = end;
+      }
+      total_num_features += begin;
+    }
+
+    Tensor* indices = nullptr;
+    Tensor* values = nullptr;
+    Tensor* shape = nullptr;
+    TF_RETURN_IF_ERROR(
+        allocate_sparse(d, total_num_features, &indices, &values, &shape));
+    shape->vec<int64>()(0) = batch_size;
+    shape->vec<int64>()(1) = max_num_features;
+
+    auto ix_t = indices->matrix<int64>();
+    int64 offset = 0;
+    int64 batch_index = 0;
+    for (auto& shard : shard_results) {
+      SparseBuffer* buffer = &shard.second.sparse[d];
+      std::size_t begin = 0;
+      for (std::size_t end : buffer->example_end_indices) {
+        for (std::size_t i = begin; i < end; ++i) {
+          ix_t(offset + i, 0) = batch_index;  // Column 0 stores the batch entry
+          ix_t(offset + i, 1) = i - begin;  // Column 1 stores the index in it
+        }
+        begin = end;
+        ++batch_index;
+      }
+      switch (dtype) {
+        case DT_INT64:
+          MoveSparseValues<int64>(buffer, offset, values);
+          break;
+        case DT_FLOAT:
+          MoveSparseValues<float>(buffer, offset, values);
+          break;
+        case DT_STRING:
+          MoveSparseValues<string>(buffer, offset, values);
+          break;
+        default:
+          return errors::InvalidArgument("Invalid input dtype: ",
+                                         DataTypeString(dtype));
+      }
+      offset += begin;
+    }
+  }
+  return Status::OK();
+}
+
+}  // namespace tensorflow
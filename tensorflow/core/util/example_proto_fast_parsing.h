@@ -0,0 +1,70 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
+#define THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
+
+#include <functional>
+#include <vector>
+
+#include "tensorflow/core/framework/tensor.h"
+#include "tensorflow/core/lib/core/status.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
+#include "tensorflow/core/platform/types.h"
+#include "tensorflow/core/util/example_proto_helper.h"
+
+// This is a wire-format parser for batches of serialized tensorflow::Example
+// protos. Unlike SingleExampleProtoToTensors, it never materializes the
+// Example message: the Features map is walked once, entries for keys that
+// were not requested are skipped without copying, and the values of the
+// requested features are decoded straight into the output tensors.
+namespace tensorflow {
+
+// Allocates the sparse outputs of feature "d" for "num_values" values and
+// points "indices", "values" and "shape" at them.
+typedef std::function<Status(int d, int64 num_values, Tensor** indices,
+                             Tensor** values, Tensor** shape)>
+    SparseOutputAllocator;
+
+// Parses every element of "serialized" as a tensorflow::Example and fills the
+// outputs the same way ExampleParserOp does.
+//
+// "example_names" is either empty or has one name per serialized Example; it
+// is only used in error messages.
+//
+// "dense_values" must hold one preallocated tensor per entry of
+// "fixed_len_features", of shape [batch_size] + fixed_len_features[d].shape.
+// Dense values are written into them in place.
+//
+// The sparse outputs of var_len_features[d] are allocated by
+// "allocate_sparse" once their number of values is known: indices of shape
+// [num_values, 2], values of shape [num_values] and dtype
+// var_len_features[d].dtype, and a shape of shape [2].
+//
+// The batch is sharded over "num_workers" threads of "workers", see
+// tensorflow::Shard.  On failure, the error of the lowest-indexed malformed
+// Example is returned.
+Status FastParseExample(const std::vector<FixedLenFeature>& fixed_len_features,
+                        const std::vector<VarLenFeature>& var_len_features,
+                        gtl::ArraySlice<string> serialized,
+                        gtl::ArraySlice<string> example_names, int num_workers,
+                        thread::ThreadPool* workers,
+                        std::vector<Tensor*>* dense_values,
+                        const SparseOutputAllocator& allocate_sparse);
+
+}  // namespace tensorflow
+
+#endif  // THIRD_PARTY_TENSORFLOW_CORE_UTIL_EXAMPLE_PROTO_FAST_PARSING_H_
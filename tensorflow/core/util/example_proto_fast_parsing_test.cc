@@ -0,0 +1,269 @@
+/* Copyright 2016 Google Inc. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+#include "tensorflow/core/util/example_proto_fast_parsing.h"
+
+#include "tensorflow/core/example/example.pb.h"
+#include "tensorflow/core/framework/allocator.h"
+#include "tensorflow/core/framework/tensor_testutil.h"
+#include "tensorflow/core/lib/core/status_test_util.h"
+#include "tensorflow/core/lib/core/threadpool.h"
+#include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/test.h"
+
+namespace tensorflow {
+namespace {
+
+constexpr char kDenseInt64Key[] = "dense_int64";
+constexpr char kDenseFloatKey[] = "dense_float";
+constexpr char kDenseStringKey[] = "dense_string";
+
+constexpr char kSparseInt64Key[] = "sparse_int64";
+constexpr char kSparseFloatKey[] = "sparse_float";
+constexpr char kSparseStringKey[] = "sparse_string";
+
+// Note that the kernel using this parser is also extensively tested by the
+// python unit test: tensorflow/python/kernel_tests/parsing_ops_test.py
+class FastParseExampleTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    FixedLenFeature int64_dense_config;
+    int64_dense_config.key = kDenseInt64Key;
+    int64_dense_config.dtype = DT_INT64;
+    int64_dense_config.shape = TensorShape({2});
+    int64_dense_config.default_value = Tensor(DT_INT64, TensorShape({2}));
+    int64_dense_config.default_value.vec<int64>().setConstant(-1);
+    dense_vec_.push_back(int64_dense_config);
+
+    FixedLenFeature float_dense_config;
+    float_dense_config.key = kDenseFloatKey;
+    float_dense_config.dtype = DT_FLOAT;
+    float_dense_config.shape = TensorShape({1});
+    float_dense_config.default_value = Tensor(DT_FLOAT, TensorShape({1}));
+    float_dense_config.default_value.vec<float>()(0) = 0.5;
+    dense_vec_.push_back(float_dense_config);
+
+    FixedLenFeature string_dense_config;
+    string_dense_config.key = kDenseStringKey;
+    string_dense_config.dtype = DT_STRING;
+    string_dense_config.shape = TensorShape({1});
+    string_dense_config.default_value = Tensor(DT_STRING, TensorShape({1}));
+    string_dense_config.default_value.vec<string>()(0) = "default";
+    dense_vec_.push_back(string_dense_config);
+
+    VarLenFeature int64_sparse_config;
+    int64_sparse_config.key = kSparseInt64Key;
+    int64_sparse_config.dtype = DT_INT64;
+    sparse_vec_.push_back(int64_sparse_config);
+
+    VarLenFeature float_sparse_config;
+    float_sparse_config.key = kSparseFloatKey;
+    float_sparse_config.dtype = DT_FLOAT;
+    sparse_vec_.push_back(float_sparse_config);
+
+    VarLenFeature string_sparse_config;
+    string_sparse_config.key = kSparseStringKey;
+    string_sparse_config.dtype = DT_STRING;
+    sparse_vec_.push_back(string_sparse_config);
+  }
+
+  // Returns an allocator of the sparse outputs that stores them in "indices",
+  // "values" and "shapes", which must hold one tensor per sparse feature.
+  SparseOutputAllocator AllocateSparse(std::vector<Tensor>* indices,
+                                       std::vector<Tensor>* values,
+                                       std::vector<Tensor>* shapes) {
+    return [this, indices, values, shapes](int d, int64 num_values,
+                                           Tensor** indices_out,
+                                           Tensor** values_out,
+                                           Tensor** shape_out) {
+      (*indices)[d] = Tensor(DT_INT64, TensorShape({num_values, 2}));
+      (*values)[d] = Tensor(sparse_vec_[d].dtype, TensorShape({num_values}));
+      (*shapes)[d] = Tensor(DT_INT64, TensorShape({2}));
+      *indices_out = &(*indices)[d];
+      *values_out = &(*values)[d];
+      *shape_out = &(*shapes)[d];
+      return Status::OK();
+    };
+  }
+
+  // Parses "serialized" with FastParseExample and checks that the result
+  // matches what the proto based BatchExampleProtoToTensors produces.
+  void ParseAndCompare(const std::vector<string>& serialized,
+                       thread::ThreadPool* pool, int num_workers) {
+    const int batch_size = serialized.size();
+    std::vector<Example> examples(batch_size);
+    for (int b = 0; b < batch_size; ++b) {
+      ASSERT_TRUE(examples[b].ParseFromString(serialized[b]));
+    }
+    std::vector<Tensor> expected_dense(dense_vec_.size());
+    std::vector<Tensor> expected_indices(sparse_vec_.size());
+    std::vector<Tensor> expected_values(sparse_vec_.size());
+    std::vector<Tensor> expected_shapes(sparse_vec_.size());
+    TF_ASSERT_OK(BatchExampleProtoToTensors(
+        examples, {}, dense_vec_, sparse_vec_, cpu_allocator(),
+        &expected_dense, &expected_indices, &expected_values,
+        &expected_shapes));
+
+    std::vector<Tensor> dense(dense_vec_.size());
+    std::vector<Tensor*> dense_ptrs(dense_vec_.size());
+    for (int d = 0; d < dense_vec_.size(); ++d) {
+      TensorShape shape({batch_size});
+      shape.AppendShape(dense_vec_[d].shape);
+      dense[d] = Tensor(dense_vec_[d].dtype, shape);
+      dense_ptrs[d] = &dense[d];
+    }
+    std::vector<Tensor> indices(sparse_vec_.size());
+    std::vector<Tensor> values(sparse_vec_.size());
+    std::vector<Tensor> shapes(sparse_vec_.size());
+    TF_ASSERT_OK(FastParseExample(dense_vec_, sparse_vec_, serialized, {},
+                                  num_workers, pool, &dense_ptrs,
+                                  AllocateSparse(&indices, &values, &shapes)));
+
+    test::ExpectTensorEqual<int64>(expected_dense[0], dense[0]);
+    test::ExpectTensorEqual<float>(expected_dense[1], dense[1]);
+    test::ExpectTensorEqual<string>(expected_dense[2], dense[2]);
+    for (int d = 0; d < sparse_vec_.size(); ++d) {
+      test::ExpectTensorEqual<int64>(expected_indices[d], indices[d]);
+      test::ExpectTensorEqual<int64>(expected_shapes[d], shapes[d]);
+    }
+    test::ExpectTensorEqual<int64>(expected_values[0], values[0]);
+    test::ExpectTensorEqual<float>(expected_values[1], values[1]);
+    test::ExpectTensorEqual<string>(expected_values[2], values[2]);
+  }
+
+  Status Parse(const Example& example) {
+    std::vector<Tensor> dense(dense_vec_.size());
+    std::vector<Tensor*> dense_ptrs(dense_vec_.size());
+    for (int d = 0; d < dense_vec_.size(); ++d) {
+      TensorShape shape({1});
+      shape.AppendShape(dense_vec_[d].shape);
+      dense[d] = Tensor(dense_vec_[d].dtype, shape);
+      dense_ptrs[d] = &dense[d];
+    }
+    std::vector<Tensor> indices(sparse_vec_.size());
+    std::vector<Tensor> values(sparse_vec_.size());
+    std::vector<Tensor> shapes(sparse_vec_.size());
+    std::vector<string> serialized = {example.SerializeAsString()};
+    return FastParseExample(dense_vec_, sparse_vec_, serialized, {"ex0"}, 1,
+                            nullptr, &dense_ptrs,
+                            AllocateSparse(&indices, &values, &shapes));
+  }
+
+  std::vector<FixedLenFeature> dense_vec_;
+  std::vector<VarLenFeature> sparse_vec_;
+};
+
+void AddInt64(Example* ex, const string& key, std::initializer_list<int64> v) {
+  auto* list = (*ex->mutable_features()->mutable_feature())[key]
+                   .mutable_int64_list();
+  for (int64 x : v) list->add_value(x);
+}
+
+void AddFloat(Example* ex, const string& key, std::initializer_list<float> v) {
+  auto* list = (*ex->mutable_features()->mutable_feature())[key]
+                   .mutable_float_list();
+  for (float x : v) list->add_value(x);
+}
+
+void AddBytes(Example* ex, const string& key,
+              std::initializer_list<string> v) {
+  auto* list = (*ex->mutable_features()->mutable_feature())[key]
+                   .mutable_bytes_list();
+  for (const string& x : v) list->add_value(x);
+}
+
+TEST_F(FastParseExampleTest, MatchesProtoParsing) {
+  std::vector<string> serialized;
+  for (int b = 0; b < 37; ++b) {
+    Example ex;
+    if (b % 3 != 0) AddInt64(&ex, kDenseInt64Key, {b, -b});
+    if (b % 4 != 0) AddFloat(&ex, kDenseFloatKey, {b * 0.25f});
+    if (b % 5 != 0) AddBytes(&ex, kDenseStringKey, {strings::StrCat("s", b)});
+    for (int i = 0; i < b % 7; ++i) {
+      AddInt64(&ex, kSparseInt64Key, {i * 1000000007LL});
+      AddFloat(&ex, kSparseFloatKey, {i * -1.5f});
+      AddBytes(&ex, kSparseStringKey, {strings::StrCat(b, "_", i)});
+    }
+    // Features that were not requested are skipped.
+    AddFloat(&ex, "unrequested", {1, 2, 3});
+    AddBytes(&ex, "unrequested_bytes", {"abc"});
+    serialized.push_back(ex.SerializeAsString());
+  }
+  ParseAndCompare(serialized, nullptr, 1);
+
+  thread::ThreadPool pool(Env::Default(), "test", 4);
+  ParseAndCompare(serialized, &pool, 4);
+}
+
+TEST_F(FastParseExampleTest, EmptyBatch) {
+  ParseAndCompare({}, nullptr, 1);
+}
+
+TEST_F(FastParseExampleTest, LastMapEntryWins) {
+  Example first;
+  AddInt64(&first, kDenseInt64Key, {1, 2});
+  AddBytes(&first, kSparseStringKey, {"first"});
+  Example second;
+  AddInt64(&second, kDenseInt64Key, {3, 4});
+  AddBytes(&second, kSparseStringKey, {"second", "third"});
+  // Concatenated serialized messages merge, and repeated map keys take the
+  // last value.
+  ParseAndCompare({first.SerializeAsString() + second.SerializeAsString()},
+                  nullptr, 1);
+}
+
+TEST_F(FastParseExampleTest, MissingRequiredFeature) {
+  dense_vec_[0].default_value = Tensor(DT_INT64, TensorShape({0}));
+  Example ex;
+  AddFloat(&ex, kDenseFloatKey, {1});
+  Status s = Parse(ex);
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Name: ex0, Feature: dense_int64 is required"))
+      << s;
+}
+
+TEST_F(FastParseExampleTest, WrongNumberOfDenseValues) {
+  Example ex;
+  AddInt64(&ex, kDenseInt64Key, {1, 2, 3});
+  Status s = Parse(ex);
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Name: ex0, Key: dense_int64, Index: 0.  Number "
+                            "of int64 values != expected.  values size: 3"))
+      << s;
+}
+
+TEST_F(FastParseExampleTest, TypeMismatch) {
+  Example ex;
+  AddFloat(&ex, kSparseInt64Key, {1});
+  Status s = Parse(ex);
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Feature: sparse_int64.  Data types don't match."))
+      << s;
+}
+
+TEST_F(FastParseExampleTest, MalformedInput) {
+  std::vector<Tensor*> dense_ptrs;
+  std::vector<Tensor> indices(sparse_vec_.size());
+  std::vector<Tensor> values(sparse_vec_.size());
+  std::vector<Tensor> shapes(sparse_vec_.size());
+  Status s = FastParseExample({}, sparse_vec_, {"\x0a\x10garbage"}, {}, 1,
+                              nullptr, &dense_ptrs,
+                              AllocateSparse(&indices, &values, &shapes));
+  EXPECT_TRUE(StringPiece(s.error_message())
+                  .contains("Could not parse example input"))
+      << s;
+}
+
+}  // namespace
+}  // namespace tensorflow
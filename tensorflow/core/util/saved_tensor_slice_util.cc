@@ -41,6 +41,14 @@ string EncodeTensorNameSlice(const string& name, const TensorSlice& slice) {
   return buffer;
 }
 
+string EncodeTensorNameSliceChunk(const string& name,
+                                  const tensorflow::TensorSlice& slice,
+                                  int64 chunk) {
+  string buffer = EncodeTensorNameSlice(name, slice);
+  tensorflow::strings::OrderedCode::WriteNumIncreasing(&buffer, chunk);
+  return buffer;
+}
+
 Status DecodeTensorNameSlice(const string& code, string* name,
                              tensorflow::TensorSlice* slice) {
   StringPiece src(code);
@@ -46,6 +46,14 @@ extern const char kSavedTensorSlicesKey[];
 string EncodeTensorNameSlice(const string& name,
                              const tensorflow::TensorSlice& slice);
 
+// Encode the key of chunk "chunk" of the data of a tensor slice that is stored
+// out of line (see SavedSliceChunks). This is the key of the slice followed by
+// the ordered code of "chunk", so the chunks of a slice sort right after the
+// slice itself and before any other slice.
+string EncodeTensorNameSliceChunk(const string& name,
+                                  const tensorflow::TensorSlice& slice,
+                                  int64 chunk);
+
 // Parse out the name and the slice from string encoded as an ordered code.
 Status DecodeTensorNameSlice(const string& code, string* name,
                              tensorflow::TensorSlice* slice);
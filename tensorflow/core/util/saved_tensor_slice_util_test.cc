@@ -40,6 +40,26 @@ TEST(TensorShapeUtilTest, TensorNameSliceToOrderedCode) {
   }
 }
 
+// The chunks of a slice must sort right after the slice and before the next
+// one, so that they can be added to a table builder in key order.
+TEST(TensorShapeUtilTest, TensorNameSliceChunkOrder) {
+  const TensorSlice s0 = TensorSlice::ParseOrDie("-:1,3");
+  const TensorSlice s1 = TensorSlice::ParseOrDie("-:1,4");
+  const TensorSlice s2 = TensorSlice::ParseOrDie("-:2,1");
+  const string key0 = EncodeTensorNameSlice("foo", s0);
+  const string key1 = EncodeTensorNameSlice("foo", s1);
+  const string key2 = EncodeTensorNameSlice("foo", s2);
+  string previous = key0;
+  for (int64 chunk : {0, 1, 255, 256, 1 << 20}) {
+    const string key = EncodeTensorNameSliceChunk("foo", s0, chunk);
+    EXPECT_LT(previous, key);
+    EXPECT_LT(key, key1);
+    EXPECT_LT(key, key2);
+    EXPECT_LT(key, EncodeTensorNameSlice("foo0", s0));
+    previous = key;
+  }
+}
+
 }  // namespace
 
 }  // namespace checkpoint
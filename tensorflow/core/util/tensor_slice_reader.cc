@@ -18,18 +18,23 @@ limitations under the License.
 #include <vector>
 #include "tensorflow/core/framework/types.pb_text.h"
 #include "tensorflow/core/framework/versions.h"
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/gtl/stl_util.h"
+#include "tensorflow/core/lib/io/cache.h"
 #include "tensorflow/core/lib/io/iterator.h"
 #include "tensorflow/core/lib/io/match.h"
 #include "tensorflow/core/lib/io/table.h"
 #include "tensorflow/core/lib/io/table_options.h"
 #include "tensorflow/core/platform/env.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/protobuf.h"
 #include "tensorflow/core/public/version.h"
 #include "tensorflow/core/util/saved_tensor_slice_util.h"
 #include "tensorflow/core/util/tensor_slice_util.h"
+#include "tensorflow/core/util/work_sharder.h"
 
 namespace tensorflow {
 
@@ -37,7 +42,41 @@ namespace checkpoint {
 
 TensorSliceReader::Table::~Table() {}
 
+bool TensorSliceReader::Table::Visit(
+    const string& key, const std::function<void(StringPiece)>& fn) {
+  string value;
+  if (!Get(key, &value)) return false;
+  fn(value);
+  return true;
+}
+
 namespace {
+// A RandomAccessFile that serves reads straight out of a memory mapped file,
+// so that the blocks of a table opened on it are used in place.
+class MemoryRegionFile : public RandomAccessFile {
+ public:
+  explicit MemoryRegionFile(ReadOnlyMemoryRegion* region) : region_(region) {}
+
+  Status Read(uint64 offset, size_t n, StringPiece* result,
+              char* scratch) const override {
+    const uint64 length = region_->length();
+    if (offset > length) {
+      *result = StringPiece();
+      return errors::OutOfRange("Read past the end of the file");
+    }
+    const size_t available = std::min<uint64>(n, length - offset);
+    *result = StringPiece(
+        static_cast<const char*>(region_->data()) + offset, available);
+    if (available < n) {
+      return errors::OutOfRange("Read fewer bytes than requested");
+    }
+    return Status::OK();
+  }
+
+ private:
+  std::unique_ptr<ReadOnlyMemoryRegion> region_;
+};
+
 class TensorSliceReaderTable : public TensorSliceReader::Table {
  public:
   explicit TensorSliceReaderTable(RandomAccessFile* f, table::Table* t)
@@ -49,21 +88,47 @@ class TensorSliceReaderTable : public TensorSliceReader::Table {
   }
 
   bool Get(const string& key, string* value) override {
-    std::unique_ptr<table::Iterator> iter(table_->NewIterator());
-    iter->Seek(key);
-    if (iter->Valid() && iter->key() == key) {
-      StringPiece v = iter->value();
+    return Visit(key, [value](StringPiece v) {
       value->assign(v.data(), v.size());
-      return true;
-    } else {
-      return false;
-    }
+    });
+  }
+
+  bool Visit(const string& key,
+             const std::function<void(StringPiece)>& fn) override {
+    Lookup lookup = {&key, &fn, false};
+    Status s = table_->InternalGet(key, &lookup, &Lookup::Handle);
+    return s.ok() && lookup.found;
   }
 
  private:
+  struct Lookup {
+    const string* key;
+    const std::function<void(StringPiece)>* fn;
+    bool found;
+
+    static void Handle(void* arg, const StringPiece& k, const StringPiece& v) {
+      Lookup* lookup = static_cast<Lookup*>(arg);
+      if (k == *lookup->key) {
+        (*lookup->fn)(v);
+        lookup->found = true;
+      }
+    }
+  };
+
   RandomAccessFile* file_;
   table::Table* table_;
 };
+
+// Capacity of the block cache shared by the checkpoint tables.
+const size_t kBlockCacheBytes = 64 << 20;
+
+// Returns the block cache shared by all the tables opened by
+// OpenTableTensorSliceReader. Restoring a checkpoint looks up many records
+// that live in the same blocks, which are then only read and verified once.
+table::Cache* BlockCache() {
+  static table::Cache* cache = table::NewLRUCache(kBlockCacheBytes);
+  return cache;
+}
 }  // namespace
 
 Status OpenTableTensorSliceReader(const string& fname,
@@ -71,24 +136,36 @@ Status OpenTableTensorSliceReader(const string& fname,
   *result = nullptr;
   Env* env = Env::Default();
   RandomAccessFile* f = nullptr;
-  Status s = env->NewRandomAccessFile(fname, &f);
+  uint64 file_size;
+  // Memory map the file when the file system supports it, so that the data of
+  // the table is read without going through intermediate buffers.
+  ReadOnlyMemoryRegion* region = nullptr;
+  Status s = env->NewReadOnlyMemoryRegionFromFile(fname, &region);
   if (s.ok()) {
-    uint64 file_size;
-    s = env->GetFileSize(fname, &file_size);
+    f = new MemoryRegionFile(region);
+    file_size = region->length();
+  } else {
+    VLOG(1) << "Could not memory map " << fname << ", reading it instead: "
+            << s;
+    s = env->NewRandomAccessFile(fname, &f);
     if (s.ok()) {
-      table::Options options;
-      table::Table* table;
-      s = table::Table::Open(options, f, file_size, &table);
-      if (s.ok()) {
-        *result = new TensorSliceReaderTable(f, table);
-        return Status::OK();
-      } else {
-        s = Status(s.code(),
-                   strings::StrCat(s.error_message(),
-                                   ": perhaps your file is in a different "
-                                   "file format and you need to use a "
-                                   "different restore operator?"));
-      }
+      s = env->GetFileSize(fname, &file_size);
+    }
+  }
+  if (s.ok()) {
+    table::Options options;
+    options.block_cache = BlockCache();
+    table::Table* table;
+    s = table::Table::Open(options, f, file_size, &table);
+    if (s.ok()) {
+      *result = new TensorSliceReaderTable(f, table);
+      return Status::OK();
+    } else {
+      s = Status(s.code(),
+                 strings::StrCat(s.error_message(),
+                                 ": perhaps your file is in a different "
+                                 "file format and you need to use a "
+                                 "different restore operator?"));
     }
   }
   LOG(WARNING) << "Could not open " << fname << ": " << s;
@@ -142,30 +219,80 @@ void TensorSliceReader::LoadShard(int shard) const {
   if (sss_[shard] || !status_.ok()) {
     return;  // Already loaded, or invalid.
   }
-  string value;
+  std::unique_ptr<Table> table;
   SavedTensorSlices sts;
-  const string fname = fnames_[shard];
+  Status s = OpenShard(fnames_[shard], &table, &sts);
+  RegisterShard(shard, s, std::move(table), sts);
+}
+
+void TensorSliceReader::LoadAllShards() const {
+  VLOG(1) << "Loading all shards for " << filepattern_;
+  std::vector<int> shards;
+  for (size_t i = 0; i < fnames_.size(); ++i) {
+    if (!sss_[i]) shards.push_back(i);
+  }
+  if (shards.size() > 1 && status_.ok()) {
+    // Opening a shard reads and parses all of its metadata, so open them
+    // concurrently and only register the slices serially.
+    std::vector<std::unique_ptr<Table>> tables(shards.size());
+    std::vector<SavedTensorSlices> metas(shards.size());
+    std::vector<Status> statuses(shards.size());
+    {
+      thread::ThreadPool pool(
+          Env::Default(), "load_shards",
+          std::min<int>(shards.size(), port::NumSchedulableCPUs()));
+      for (size_t i = 0; i < shards.size(); ++i) {
+        pool.Schedule([this, &shards, &tables, &metas, &statuses, i]() {
+          statuses[i] = OpenShard(fnames_[shards[i]], &tables[i], &metas[i]);
+        });
+      }
+      // The destructor of the pool waits for all the shards to be opened.
+    }
+    for (size_t i = 0; i < shards.size() && status_.ok(); ++i) {
+      RegisterShard(shards[i], statuses[i], std::move(tables[i]), metas[i]);
+    }
+  } else {
+    for (size_t i = 0; i < shards.size() && status_.ok(); ++i) {
+      LoadShard(shards[i]);
+    }
+  }
+  all_shards_loaded_ = true;
+}
+
+Status TensorSliceReader::OpenShard(const string& fname,
+                                    std::unique_ptr<Table>* table,
+                                    SavedTensorSlices* sts) const {
   VLOG(1) << "Reading meta data from file " << fname << "...";
-  Table* table;
-  Status s = open_function_(fname, &table);
+  Table* t;
+  Status s = open_function_(fname, &t);
   if (!s.ok()) {
-    status_ = errors::DataLoss("Unable to open table file ", fname, ": ",
-                               s.ToString());
-    return;
+    return errors::DataLoss("Unable to open table file ", fname, ": ",
+                            s.ToString());
   }
-  sss_[shard].reset(table);
-  if (!(table->Get(kSavedTensorSlicesKey, &value) &&
-        ParseProtoUnlimited(&sts, value))) {
-    status_ = errors::Internal(
+  table->reset(t);
+  string value;
+  if (!(t->Get(kSavedTensorSlicesKey, &value) &&
+        ParseProtoUnlimited(sts, value))) {
+    return errors::Internal(
         "Failed to find the saved tensor slices at the beginning of the "
         "checkpoint file: ",
         fname);
-    return;
   }
-  status_ = CheckVersions(sts.meta().versions(), TF_CHECKPOINT_VERSION,
-                          TF_CHECKPOINT_VERSION_MIN_PRODUCER, "Checkpoint",
-                          "checkpoint");
+  return CheckVersions(sts->meta().versions(), TF_CHECKPOINT_VERSION,
+                       TF_CHECKPOINT_VERSION_MIN_PRODUCER, "Checkpoint",
+                       "checkpoint");
+}
+
+void TensorSliceReader::RegisterShard(int shard, const Status& s,
+                                      std::unique_ptr<Table> table,
+                                      const SavedTensorSlices& sts) const {
+  sss_[shard] = std::move(table);
+  status_ = s;
   if (!status_.ok()) return;
+  const string& fname = fnames_[shard];
+  if (!sts.meta().delta_base().empty()) {
+    delta_base_ = sts.meta().delta_base();
+  }
   for (const SavedSliceMeta& ssm : sts.meta().tensor()) {
     TensorShape ssm_shape(ssm.shape());
     for (const TensorSliceProto& tsp : ssm.slice()) {
@@ -175,14 +302,6 @@ void TensorSliceReader::LoadShard(int shard) const {
   }
 }
 
-void TensorSliceReader::LoadAllShards() const {
-  VLOG(1) << "Loading all shards for " << filepattern_;
-  for (size_t i = 0; i < fnames_.size() && status_.ok(); ++i) {
-    LoadShard(i);
-  }
-  all_shards_loaded_ = true;
-}
-
 const TensorSliceSet* TensorSliceReader::FindTensorSlice(
     const string& name, const TensorSlice& slice,
     std::vector<std::pair<TensorSlice, string>>* details) const {
@@ -193,6 +312,81 @@ const TensorSliceSet* TensorSliceReader::FindTensorSlice(
   return tss;
 }
 
+namespace {
+// Verifies chunk "index" of a slice of tensor "name", stored in "value", and
+// copies its "size" bytes of data to "dst".
+Status CopySliceChunk(const string& name, const TensorSlice& slice,
+                      int64 index, StringPiece value, char* dst, size_t size) {
+  if (value.size() != size + sizeof(uint32)) {
+    return errors::DataLoss("Chunk ", index, " of tensor ", name, ", slice ",
+                            slice.DebugString(), " has ", value.size(),
+                            " bytes, expected ", size + sizeof(uint32));
+  }
+  const uint32 crc = crc32c::Unmask(core::DecodeFixed32(value.data() + size));
+  if (crc32c::Value(value.data(), size) != crc) {
+    return errors::DataLoss("Checksum mismatch in chunk ", index,
+                            " of tensor ", name, ", slice ",
+                            slice.DebugString());
+  }
+  memcpy(dst, value.data(), size);
+  return Status::OK();
+}
+}  // namespace
+
+Status TensorSliceReader::ReadSliceChunks(Table* table, const string& name,
+                                          const TensorSlice& slice,
+                                          const SavedSliceChunks& chunks,
+                                          char* dst, size_t size,
+                                          int num_workers,
+                                          thread::ThreadPool* workers) {
+  if (chunks.size() != static_cast<int64>(size) || chunks.chunk_size() <= 0) {
+    return errors::DataLoss("Unexpected data size for tensor ", name,
+                            ", slice ", slice.DebugString(), ": expected ",
+                            size, " bytes in chunks of ", chunks.chunk_size(),
+                            ", got ", chunks.size());
+  }
+  const int64 chunk_size = chunks.chunk_size();
+  const int64 num_chunks = (chunks.size() + chunk_size - 1) / chunk_size;
+  mutex mu;
+  Status status;
+  auto read_chunks = [table, &name, &slice, dst, size, chunk_size, &mu,
+                      &status](int64 start, int64 limit) {
+    for (int64 index = start; index < limit; ++index) {
+      const int64 offset = index * chunk_size;
+      const size_t expected = std::min<int64>(chunk_size, size - offset);
+      Status s;
+      const string key = EncodeTensorNameSliceChunk(name, slice, index);
+      if (!table->Visit(key, [&](StringPiece value) {
+            s = CopySliceChunk(name, slice, index, value, dst + offset,
+                               expected);
+          })) {
+        s = errors::DataLoss("Missing chunk ", index, " of tensor ", name,
+                             ", slice ", slice.DebugString());
+      }
+      if (!s.ok()) {
+        mutex_lock l(mu);
+        status.Update(s);
+        return;
+      }
+    }
+  };
+  // Each chunk is checksummed and copied, which costs a few cycles per byte.
+  Shard(num_workers, workers, num_chunks, chunk_size, read_chunks);
+  return status;
+}
+
+template <>
+Status TensorSliceReader::CopyChunkedSliceData(Table* table, const string& name,
+                                               const TensorShape& shape,
+                                               const TensorSlice& slice_s,
+                                               const SavedSliceChunks& chunks,
+                                               const TensorSlice& slice,
+                                               string* data, int num_workers,
+                                               thread::ThreadPool* workers) {
+  return errors::DataLoss("Unexpected chunked string data for tensor ", name,
+                          ", slice ", slice_s.DebugString());
+}
+
 TensorSliceReader::~TensorSliceReader() { gtl::STLDeleteValues(&tensors_); }
 
 void TensorSliceReader::RegisterTensorSlice(const string& name,
@@ -20,6 +20,9 @@ limitations under the License.
 #ifndef TENSORFLOW_UTIL_TENSOR_SLICE_READER_H_
 #define TENSORFLOW_UTIL_TENSOR_SLICE_READER_H_
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <unordered_map>
 
 #include <vector>
@@ -27,8 +30,10 @@ limitations under the License.
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
 #include "tensorflow/core/framework/types.pb.h"
+#include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/core/threadpool.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
@@ -59,6 +64,12 @@ class TensorSliceReader {
    public:
     virtual ~Table();
     virtual bool Get(const string& key, string* value) = 0;
+
+    // If "key" is present, calls "fn" with its value and returns true. The
+    // value is only valid during the call, which lets implementations avoid
+    // copying it. The default implementation copies the value with Get().
+    virtual bool Visit(const string& key,
+                       const std::function<void(StringPiece)>& fn);
   };
   typedef std::function<Status(const string&, Table**)> OpenTableFunction;
 
@@ -86,11 +97,39 @@ class TensorSliceReader {
 
   // Checks if the reader contains all the data about a tensor slice, and if
   // yes, copies the data of the slice to "data". The caller needs to make sure
-  // that "data" points to a buffer that holds enough data.
+  // that "data" points to a buffer that holds enough data. Also returns false,
+  // leaving "data" partly written, if the chunks of the slice are corrupt.
   // This is a slow function since it needs to read sstables.
   template <typename T>
   bool CopySliceData(const string& name, const TensorSlice& slice,
-                     T* data) const;
+                     T* data) const {
+    return CopySliceData(name, slice, data, 1, nullptr);
+  }
+
+  // Same as above, but the chunks of slices that are stored out of line are
+  // read and verified in parallel on up to "num_workers" threads of
+  // "workers". "workers" may be nullptr if "num_workers" is 1.
+  template <typename T>
+  bool CopySliceData(const string& name, const TensorSlice& slice, T* data,
+                     int num_workers, thread::ThreadPool* workers) const;
+
+  // Returns the file pattern of the checkpoint that this delta checkpoint
+  // applies to, or an empty string if this is a full checkpoint. The slices
+  // of a delta checkpoint cannot be read with CopySliceData().
+  string delta_base() const {
+    mutex_lock l(mu_);
+    return delta_base_;
+  }
+
+  // Copies the rows of tensor "name" saved in this delta checkpoint to their
+  // places in "data", which holds the whole tensor. Other rows of "data" are
+  // left unchanged. Returns NotFound if the tensor is not in the checkpoint,
+  // FailedPrecondition if this is not a delta checkpoint, and DataLoss if the
+  // saved rows cannot be read or one of them is out of range; "data" is left
+  // unchanged in all of these cases.
+  template <typename T>
+  Status CopyDeltaRows(const string& name, T* data, int num_workers,
+                     thread::ThreadPool* workers) const;
 
   // Get the tensors.
   const std::unordered_map<string, TensorSliceSet*>& Tensors() const {
@@ -114,6 +153,15 @@ class TensorSliceReader {
 
   void LoadShard(int shard) const;
   void LoadAllShards() const;
+
+  // Opens shard "fname" and parses its metadata into "sts". Does not touch
+  // the state of the reader, so several shards can be opened concurrently.
+  Status OpenShard(const string& fname, std::unique_ptr<Table>* table,
+                   SavedTensorSlices* sts) const;
+  // Registers the slices of shard "shard", opened by OpenShard with status
+  // "s", and takes ownership of its table.
+  void RegisterShard(int shard, const Status& s, std::unique_ptr<Table> table,
+                     const SavedTensorSlices& sts) const;
   void RegisterTensorSlice(const string& name, const TensorShape& shape,
                            DataType type, const string& tag,
                            const TensorSlice& slice) const;
@@ -122,6 +170,28 @@ class TensorSliceReader {
       const string& name, const TensorSlice& slice,
       std::vector<std::pair<TensorSlice, string>>* details) const;
 
+  // Reads the data of a slice that is stored out of line into "dst", which
+  // must have room for "size" bytes, verifying the checksum of every chunk.
+  // The chunks are sharded over "num_workers" threads of "workers".
+  static Status ReadSliceChunks(Table* table, const string& name,
+                                const TensorSlice& slice,
+                                const SavedSliceChunks& chunks, char* dst,
+                                size_t size, int num_workers,
+                                thread::ThreadPool* workers);
+
+  // Copies the part of slice "slice_s" of tensor "name", whose data is stored
+  // out of line in "table", that intersects "slice" to "data". When the two
+  // slices are the same, the chunks are read straight into "data". Returns
+  // DataLoss if a chunk is missing or corrupt.
+  template <typename T>
+  static Status CopyChunkedSliceData(Table* table, const string& name,
+                                   const TensorShape& shape,
+                                   const TensorSlice& slice_s,
+                                   const SavedSliceChunks& chunks,
+                                   const TensorSlice& slice, T* data,
+                                   int num_workers,
+                                   thread::ThreadPool* workers);
+
   const string filepattern_;
   const OpenTableFunction open_function_;
   std::vector<string> fnames_;
@@ -133,6 +203,7 @@ class TensorSliceReader {
   mutable std::vector<std::unique_ptr<Table>> sss_;
   mutable std::unordered_map<string, TensorSliceSet*> tensors_;
   mutable Status status_;
+  mutable string delta_base_;
 
   TF_DISALLOW_COPY_AND_ASSIGN(TensorSliceReader);
 };
@@ -140,9 +211,47 @@ class TensorSliceReader {
 Status OpenTableTensorSliceReader(const string& fname,
                                   TensorSliceReader::Table** table);
 
+template <typename T>
+Status TensorSliceReader::CopyChunkedSliceData(Table* table, const string& name,
+                                               const TensorShape& shape,
+                                               const TensorSlice& slice_s,
+                                               const SavedSliceChunks& chunks,
+                                               const TensorSlice& slice,
+                                               T* data, int num_workers,
+                                               thread::ThreadPool* workers) {
+  TensorShape shape_s;
+  TF_RETURN_IF_ERROR(slice_s.SliceTensorShape(shape, &shape_s));
+  const int64 num_elements = shape_s.num_elements();
+  if (slice_s == slice) {
+    return ReadSliceChunks(table, name, slice_s, chunks,
+                           reinterpret_cast<char*>(data),
+                           num_elements * sizeof(T), num_workers, workers);
+  }
+  std::unique_ptr<T[]> buffer(new T[num_elements]);
+  TF_RETURN_IF_ERROR(ReadSliceChunks(table, name, slice_s, chunks,
+                                     reinterpret_cast<char*>(buffer.get()),
+                                     num_elements * sizeof(T), num_workers,
+                                     workers));
+  CopyDataFromTensorSliceToTensorSlice(shape, slice_s, slice, buffer.get(),
+                                       data);
+  return Status::OK();
+}
+
+// Strings are never stored in chunks.
+template <>
+Status TensorSliceReader::CopyChunkedSliceData(Table* table, const string& name,
+                                             const TensorShape& shape,
+                                             const TensorSlice& slice_s,
+                                             const SavedSliceChunks& chunks,
+                                             const TensorSlice& slice,
+                                             string* data, int num_workers,
+                                             thread::ThreadPool* workers);
+
 template <typename T>
 bool TensorSliceReader::CopySliceData(const string& name,
-                                      const TensorSlice& slice, T* data) const {
+                                      const TensorSlice& slice, T* data,
+                                      int num_workers,
+                                      thread::ThreadPool* workers) const {
   std::vector<std::pair<TensorSlice, string>> details;
   const TensorSliceSet* tss;
   {
@@ -158,6 +267,11 @@ bool TensorSliceReader::CopySliceData(const string& name,
       // No such tensor
       return false;
     }
+    if (!delta_base_.empty()) {
+      LOG(ERROR) << "Cannot copy slices of tensor " << name
+                 << " out of delta checkpoint " << filepattern_;
+      return false;
+    }
   }
   // We have the data -- copy it over.
   string value;
@@ -175,13 +289,105 @@ bool TensorSliceReader::CopySliceData(const string& name,
     CHECK(ParseProtoUnlimited(&sts, value))
         << "Failed to parse the record for tensor " << name << ", slice "
         << slice_s.DebugString() << ": computed key = " << key;
-    CopyDataFromTensorSliceToTensorSlice(
-        tss->shape(), slice_s, slice,
-        checkpoint::TensorProtoData<T>(sts.data().data()), data);
+    if (sts.data().has_chunks()) {
+      // The data is stored in raw chunks that follow the record.
+      const DataType dt = DataTypeToEnum<T>::value;
+      CHECK_EQ(dt, tss->type()) << "Mismatching types for tensor " << name;
+      const Status s = CopyChunkedSliceData(
+          sss_[idx].get(), name, tss->shape(), slice_s, sts.data().chunks(),
+          slice, data, num_workers, workers);
+      if (!s.ok()) {
+        LOG(ERROR) << "Cannot read tensor " << name << " from "
+                   << filepattern_ << ": " << s;
+        return false;
+      }
+    } else {
+      CopyDataFromTensorSliceToTensorSlice(
+          tss->shape(), slice_s, slice,
+          checkpoint::TensorProtoData<T>(sts.data().data()), data);
+    }
   }
   return true;
 }
 
+template <typename T>
+Status TensorSliceReader::CopyDeltaRows(const string& name, T* data,
+                                        int num_workers,
+                                        thread::ThreadPool* workers) const {
+  std::vector<std::pair<TensorSlice, string>> details;
+  const TensorSliceSet* tss;
+  {
+    mutex_lock l(mu_);
+    if (!all_shards_loaded_) LoadAllShards();
+    tss = gtl::FindPtrOrNull(tensors_, name);
+    if (!tss) {
+      return errors::NotFound("Tensor ", name, " not found in checkpoint ",
+                              filepattern_);
+    }
+    if (delta_base_.empty()) {
+      return errors::FailedPrecondition("Checkpoint ", filepattern_,
+                                        " is not a delta checkpoint");
+    }
+    tss->QueryMeta(TensorSlice(tss->shape().dims()), &details);
+  }
+  // Every tensor of a delta checkpoint is saved as a single slice.
+  if (details.size() != 1) {
+    return errors::DataLoss("Tensor ", name, " in delta checkpoint ",
+                            filepattern_, " is saved as ", details.size(),
+                            " slices instead of one");
+  }
+  if (DataTypeToEnum<T>::value != tss->type()) {
+    return errors::InvalidArgument(
+        "Tensor ", name, " in ", filepattern_, " has type ",
+        DataTypeString(tss->type()), ", not ",
+        DataTypeString(DataTypeToEnum<T>::value));
+  }
+  const int64 num_rows = tss->shape().dim_size(0);
+  const int64 row_elements =
+      num_rows == 0 ? 0 : tss->shape().num_elements() / num_rows;
+  const TensorSlice& slice_s = details[0].first;
+  const int idx = gtl::FindWithDefault(fname_to_index_, details[0].second, -1);
+  if (idx < 0) {
+    return errors::Internal("Failed to find the index for filename ",
+                            details[0].second);
+  }
+  const string key = EncodeTensorNameSlice(name, slice_s);
+  string value;
+  SavedTensorSlices sts;
+  if (!sss_[idx]->Get(key, &value) || !ParseProtoUnlimited(&sts, value)) {
+    return errors::DataLoss("Unable to read the rows of tensor ", name,
+                            " from ", filepattern_);
+  }
+  const auto& rows = sts.data().rows();
+  for (const int64 row : rows) {
+    if (row < 0 || row >= num_rows) {
+      return errors::DataLoss("Row ", row, " of tensor ", name, " in ",
+                              filepattern_, " is not in [0, ", num_rows, ")");
+    }
+  }
+  const int64 num_elements = rows.size() * row_elements;
+  std::unique_ptr<T[]> values(new T[num_elements]);
+  if (sts.data().has_chunks()) {
+    TF_RETURN_IF_ERROR(ReadSliceChunks(sss_[idx].get(), name, slice_s,
+                                       sts.data().chunks(),
+                                       reinterpret_cast<char*>(values.get()),
+                                       num_elements * sizeof(T), num_workers,
+                                       workers));
+  } else {
+    // Converts the data from the type it is saved as.
+    const TensorSlice all_rows(2);
+    CopyDataFromTensorSliceToTensorSlice(
+        TensorShape({rows.size(), row_elements}), all_rows, all_rows,
+        checkpoint::TensorProtoData<T>(sts.data().data()), values.get());
+  }
+  for (int i = 0; i < rows.size(); ++i) {
+    const int64 row = rows.Get(i);
+    std::copy_n(values.get() + i * row_elements, row_elements,
+                data + row * row_elements);
+  }
+  return Status::OK();
+}
+
 }  // namespace checkpoint
 
 }  // namespace tensorflow
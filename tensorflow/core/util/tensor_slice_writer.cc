@@ -15,7 +15,9 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
+#include "tensorflow/core/lib/core/coding.h"
 #include "tensorflow/core/lib/core/errors.h"
+#include "tensorflow/core/lib/hash/crc32c.h"
 #include "tensorflow/core/lib/io/table_builder.h"
 #include "tensorflow/core/lib/random/random.h"
 #include "tensorflow/core/lib/strings/strcat.h"
@@ -80,15 +82,128 @@ Status CreateTableTensorSliceBuilder(const string& name,
 
 TensorSliceWriter::TensorSliceWriter(const string& filename,
                                      CreateBuilderFunction create_builder)
+    : TensorSliceWriter(filename, create_builder, kDefaultMaxChunkBytes) {}
+
+TensorSliceWriter::TensorSliceWriter(const string& filename,
+                                     CreateBuilderFunction create_builder,
+                                     size_t max_chunk_bytes)
     : filename_(filename),
       create_builder_(create_builder),
       tmpname_(strings::StrCat(filename, ".tempstate", random::New64())),
+      max_chunk_bytes_(max_chunk_bytes),
+      has_chunks_(false),
+      delta_(false),
       slices_(0) {
   VersionDef* versions = sts_.mutable_meta()->mutable_versions();
   versions->set_producer(TF_CHECKPOINT_VERSION);
   versions->set_min_consumer(TF_CHECKPOINT_VERSION_MIN_CONSUMER);
 }
 
+void TensorSliceWriter::SetDeltaBase(const string& base) {
+  CHECK_EQ(0, slices_) << "The delta base of " << filename_
+                       << " must be set before adding tensors";
+  sts_.mutable_meta()->set_delta_base(base);
+  delta_ = true;
+}
+
+Status TensorSliceWriter::CheckDelta(const string& name, bool delta) const {
+  if (delta_ == delta) return Status::OK();
+  if (delta_) {
+    return errors::InvalidArgument("Tensor ", name, " of delta checkpoint ",
+                                   filename_,
+                                   " must be added with AddRowsUnowned()");
+  }
+  return errors::InvalidArgument("Cannot add rows of tensor ", name, " to ",
+                                 filename_, ", which is not a delta checkpoint");
+}
+
+Status TensorSliceWriter::AddSliceMeta(const string& name,
+                                       const TensorShape& shape, DataType dt,
+                                       const TensorSlice& slice,
+                                       int64* num_elements) {
+  // The tensor and the slice have to be compatible
+  if (shape.dims() != slice.dims()) {
+    return errors::Internal("Incompatible tensor shape and slice: ", "shape = ",
+                            shape.DebugString(), ", slice = ",
+                            slice.DebugString());
+  }
+  // We need to add an entry for "name" if there isn't an entry already.
+  int index = gtl::FindWithDefault(name_to_index_, name, -1);
+  if (index >= 0) {
+    // The same tensor has been registered -- we verify that the shapes and the
+    // type agree.
+    const SavedSliceMeta& ssm = sts_.meta().tensor(index);
+    CHECK_EQ(name, ssm.name()) << ProtoShortDebugString(ssm);
+    TensorShape ssm_shape(ssm.shape());
+    if (!shape.IsSameSize(ssm_shape)) {
+      return errors::Internal("Mismatching shapes: existing tensor = ",
+                              ssm_shape.DebugString(), ", trying to add name ",
+                              name, ", shape = ", shape.DebugString());
+    }
+    if (dt != ssm.type()) {
+      return errors::Internal(
+          "Mismatching types: existing type = ", DataTypeString(ssm.type()),
+          ", trying to add name ", name, ", type = ", DataTypeString(dt));
+    }
+  } else {
+    // Insert the new tensor name with the shape information
+    index = sts_.meta().tensor_size();
+    name_to_index_.insert(std::make_pair(name, index));
+    SavedSliceMeta* ssm = sts_.mutable_meta()->add_tensor();
+    ssm->set_name(name);
+    shape.AsProto(ssm->mutable_shape());
+    ssm->set_type(dt);
+  }
+  // Now we need to add the slice info the list of slices.
+  SavedSliceMeta* ssm = sts_.mutable_meta()->mutable_tensor(index);
+  slice.AsProto(ssm->add_slice());
+
+  TensorShape sliced_shape;
+  TF_RETURN_IF_ERROR(slice.SliceTensorShape(shape, &sliced_shape));
+  *num_elements = sliced_shape.num_elements();
+  return Status::OK();
+}
+
+Status TensorSliceWriter::WritePendingSlice(const string& key,
+                                            const PendingSlice& pending,
+                                            Builder* builder) const {
+  SavedTensorSlices sts;
+  SavedSlice* ss = sts.mutable_data();
+  ss->set_name(pending.name);
+  pending.slice.AsProto(ss->mutable_slice());
+  for (const int64 row : pending.rows) ss->add_rows(row);
+  if (pending.raw_data == nullptr) {
+    pending.fill(ss->mutable_data());
+    string record;
+    if (!sts.AppendToString(&record)) {
+      return errors::Internal("Error writing Tensor ", pending.name,
+                              ". Possible size overflow.");
+    }
+    builder->Add(key, record);
+    return Status::OK();
+  }
+
+  SavedSliceChunks* chunks = ss->mutable_chunks();
+  chunks->set_size(pending.raw_size);
+  chunks->set_chunk_size(pending.chunk_size);
+  builder->Add(key, sts.SerializeAsString());
+  // Only one chunk is held in memory at a time.
+  string chunk;
+  int64 index = 0;
+  for (size_t offset = 0; offset < pending.raw_size;
+       offset += pending.chunk_size) {
+    const char* data = pending.raw_data + offset;
+    const size_t size = std::min(pending.chunk_size, pending.raw_size - offset);
+    chunk.reserve(size + sizeof(uint32));
+    chunk.assign(data, size);
+    core::PutFixed32(&chunk, crc32c::Mask(crc32c::Value(data, size)));
+    builder->Add(EncodeTensorNameSliceChunk(pending.name, pending.slice, index),
+                 chunk);
+    ++index;
+  }
+  return Status::OK();
+}
+
 Status TensorSliceWriter::Finish() {
   Builder* b;
   Status s = create_builder_(tmpname_, &b);
@@ -98,18 +213,36 @@ Status TensorSliceWriter::Finish() {
   }
   std::unique_ptr<Builder> builder(b);
 
+  // Chunked slices (version 2) and delta checkpoints (version 3) can only be
+  // read by readers that know about them.
+  if (delta_) {
+    sts_.mutable_meta()->mutable_versions()->set_min_consumer(3);
+  } else if (has_chunks_) {
+    sts_.mutable_meta()->mutable_versions()->set_min_consumer(2);
+  }
+
   // We save the saved tensor slice metadata as the first element.
   string meta;
   sts_.AppendToString(&meta);
   builder->Add(kSavedTensorSlicesKey, meta);
 
-  // Go through all the data and add them
-  for (const auto& x : data_) {
-    builder->Add(x.first, x.second);
+  // Go through all the data and add them, in key order. The records of
+  // slices added with Add() are released as soon as they are written.
+  for (auto& x : data_) {
+    PendingSlice& pending = x.second;
+    if (pending.record.empty()) {
+      s = WritePendingSlice(x.first, pending, builder.get());
+      if (!s.ok()) break;
+    } else {
+      builder->Add(x.first, pending.record);
+      string().swap(pending.record);
+    }
   }
 
   int64 file_size;
-  s = builder->Finish(&file_size);
+  // The builder still needs to be finished to release the file.
+  Status finish_status = builder->Finish(&file_size);
+  if (s.ok()) s = finish_status;
   // We need to rename the file to the proper name
   if (s.ok()) {
     s = Env::Default()->RenameFile(tmpname_, filename_);
@@ -20,7 +20,11 @@ limitations under the License.
 #ifndef TENSORFLOW_UTIL_TENSOR_SLICE_WRITER_H_
 #define TENSORFLOW_UTIL_TENSOR_SLICE_WRITER_H_
 
+#include <algorithm>
+#include <functional>
+#include <map>
 #include <unordered_map>
+#include <vector>
 
 #include "tensorflow/core/framework/tensor_shape.h"
 #include "tensorflow/core/framework/tensor_slice.h"
@@ -28,7 +32,9 @@ limitations under the License.
 #include "tensorflow/core/lib/core/errors.h"
 #include "tensorflow/core/lib/core/status.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
+#include "tensorflow/core/lib/gtl/array_slice.h"
 #include "tensorflow/core/lib/gtl/map_util.h"
+#include "tensorflow/core/platform/host_info.h"
 #include "tensorflow/core/platform/logging.h"
 #include "tensorflow/core/platform/macros.h"
 #include "tensorflow/core/platform/types.h"
@@ -51,17 +57,87 @@ class TensorSliceWriter {
   };
   typedef std::function<Status(const string&, Builder**)> CreateBuilderFunction;
 
+  // Slice data added with AddUnowned() is written in chunks of at most this
+  // many bytes by default.
+  static const size_t kDefaultMaxChunkBytes = 16 << 20;
+
   TensorSliceWriter(const string& filename,
                     CreateBuilderFunction create_builder);
+  TensorSliceWriter(const string& filename,
+                    CreateBuilderFunction create_builder,
+                    size_t max_chunk_bytes);
   virtual ~TensorSliceWriter() {}
   // Adds a slice. We support float and int32 for now.
   // TODO(yangke): add more supports
   template <typename T>
   Status Add(const string& name, const TensorShape& shape,
              const TensorSlice& slice, const T* data);
+
+  // Same as Add(), but does not copy "data", which must stay valid and
+  // unchanged until Finish() returns. Finish() then streams the data of the
+  // slice to the builder instead of buffering a serialized copy of it: for
+  // types that can be memcpy'd, as raw little-endian chunks of at most
+  // "max_chunk_bytes" bytes, each with its own crc32c; other types are
+  // serialized one slice at a time. Chunked slices are not subject to the
+  // 2GB limit on protocol buffers.
+  template <typename T>
+  Status AddUnowned(const string& name, const TensorShape& shape,
+                    const TensorSlice& slice, const T* data);
+
+  // Makes this a delta checkpoint of the checkpoint with file pattern "base",
+  // see SavedTensorSliceMeta.delta_base. Must be called before any tensor is
+  // added; the tensors of a delta checkpoint are added with AddRowsUnowned().
+  void SetDeltaBase(const string& base);
+
+  // Adds rows "rows" of tensor "name" to a delta checkpoint. "data" holds the
+  // values of these rows, in the same order, and is written as with
+  // AddUnowned(), so it must stay valid and unchanged until Finish() returns.
+  template <typename T>
+  Status AddRowsUnowned(const string& name, const TensorShape& shape,
+                        gtl::ArraySlice<int64> rows, const T* data);
+
   Status Finish();
 
  private:
+  // A slice whose data is written to the builder by Finish(), in key order.
+  struct PendingSlice {
+    // The serialized SavedTensorSlices record of a slice added with Add().
+    // Empty for slices added with AddUnowned(), which use the fields below.
+    string record;
+
+    string name;
+    TensorSlice slice;
+    // The data of slices that are written in chunks.
+    const char* raw_data = nullptr;
+    size_t raw_size = 0;
+    size_t chunk_size = 0;
+    // Fills in the data of slices that are not written in chunks.
+    std::function<void(TensorProto*)> fill;
+    // The rows of slices added with AddRowsUnowned().
+    std::vector<int64> rows;
+  };
+
+  // Adds the metadata of a slice of tensor "name" to sts_, after checking
+  // that it is consistent with the slices of "name" added so far. Sets
+  // "*num_elements" to the number of elements in the slice.
+  Status AddSliceMeta(const string& name, const TensorShape& shape,
+                      DataType dt, const TensorSlice& slice,
+                      int64* num_elements);
+
+  // Queues the "num_elements" elements of "data" to be written by Finish()
+  // as the data of "pending".
+  template <typename T>
+  void AddPending(const string& key, const T* data, int64 num_elements,
+                  PendingSlice pending);
+
+  // Returns an error if a tensor is added with the wrong method for this
+  // (delta or full) checkpoint.
+  Status CheckDelta(const string& name, bool delta) const;
+
+  // Writes the records of a slice added with AddUnowned().
+  Status WritePendingSlice(const string& key, const PendingSlice& pending,
+                           Builder* builder) const;
+
   // Allocate "num_elements" elements in "ss" and save the data in "data"
   // there.
   template <typename T>
@@ -70,13 +146,18 @@ class TensorSliceWriter {
   const string filename_;
   const CreateBuilderFunction create_builder_;
   const string tmpname_;
+  const size_t max_chunk_bytes_;
 
   // A mapping from the tensor names to their index in meta_.saved_slice_meta()
   std::unordered_map<string, int> name_to_index_;
   // The metadata that holds all the saved tensor slices.
   SavedTensorSlices sts_;
-  // The data to be written to the builder
-  std::map<string, string> data_;
+  // The data to be written to the builder, keyed by the slice keys.
+  std::map<string, PendingSlice> data_;
+  // Whether any slice is written in chunks.
+  bool has_chunks_;
+  // Whether this is a delta checkpoint.
+  bool delta_;
   // Total number of slices written
   int slices_;
   TF_DISALLOW_COPY_AND_ASSIGN(TensorSliceWriter);
@@ -85,43 +166,10 @@ class TensorSliceWriter {
 template <typename T>
 Status TensorSliceWriter::Add(const string& name, const TensorShape& shape,
                               const TensorSlice& slice, const T* data) {
-  // The tensor and the slice have to be compatible
-  if (shape.dims() != slice.dims()) {
-    return errors::Internal("Incompatible tensor shape and slice: ", "shape = ",
-                            shape.DebugString(), ", slice = ",
-                            slice.DebugString());
-  }
-  DataType dt = DataTypeToEnum<T>::value;
-  // We need to add an entry for "name" if there isn't an entry already.
-  int index = gtl::FindWithDefault(name_to_index_, name, -1);
-  if (index >= 0) {
-    // The same tensor has been registered -- we verify that the shapes and the
-    // type agree.
-    const SavedSliceMeta& ssm = sts_.meta().tensor(index);
-    CHECK_EQ(name, ssm.name()) << ProtoShortDebugString(ssm);
-    TensorShape ssm_shape(ssm.shape());
-    if (!shape.IsSameSize(ssm_shape)) {
-      return errors::Internal("Mismatching shapes: existing tensor = ",
-                              ssm_shape.DebugString(), ", trying to add name ",
-                              name, ", shape = ", shape.DebugString());
-    }
-    if (dt != ssm.type()) {
-      return errors::Internal(
-          "Mismatching types: existing type = ", DataTypeString(ssm.type()),
-          ", trying to add name ", name, ", type = ", DataTypeString(dt));
-    }
-  } else {
-    // Insert the new tensor name with the shape information
-    index = sts_.meta().tensor_size();
-    name_to_index_.insert(std::make_pair(name, index));
-    SavedSliceMeta* ssm = sts_.mutable_meta()->add_tensor();
-    ssm->set_name(name);
-    shape.AsProto(ssm->mutable_shape());
-    ssm->set_type(dt);
-  }
-  // Now we need to add the slice info the list of slices.
-  SavedSliceMeta* ssm = sts_.mutable_meta()->mutable_tensor(index);
-  slice.AsProto(ssm->add_slice());
+  TF_RETURN_IF_ERROR(CheckDelta(name, false));
+  int64 num_elements;
+  TF_RETURN_IF_ERROR(AddSliceMeta(name, shape, DataTypeToEnum<T>::value, slice,
+                                  &num_elements));
 
   // Now we need to add the real data.
   {
@@ -129,24 +177,93 @@ Status TensorSliceWriter::Add(const string& name, const TensorShape& shape,
     SavedSlice* ss = sts.mutable_data();
     ss->set_name(name);
     slice.AsProto(ss->mutable_slice());
-    TensorShape saved_shape(ssm->shape());
-    TensorShape sliced_shape;
-    TF_RETURN_IF_ERROR(slice.SliceTensorShape(saved_shape, &sliced_shape));
-    SaveData(data, sliced_shape.num_elements(), ss);
+    SaveData(data, num_elements, ss);
     string key = EncodeTensorNameSlice(name, slice);
     // TODO(yangke): consider doing a two-pass thing where the first pass just
     // list the tensor slices we want to save and then another pass to actually
     // set the data. Need to figure out if the interface works well.
-    std::pair<string, string> key_value(key, "");
-    if (!sts.AppendToString(&key_value.second)) {
+    PendingSlice pending;
+    if (!sts.AppendToString(&pending.record)) {
       return errors::Internal("Error writing Tensor. Possible size overflow.");
     }
-    data_.insert(key_value);
+    data_.insert(std::make_pair(std::move(key), std::move(pending)));
   }
   ++slices_;
   return Status::OK();
 }
 
+template <typename T>
+Status TensorSliceWriter::AddUnowned(const string& name,
+                                     const TensorShape& shape,
+                                     const TensorSlice& slice, const T* data) {
+  TF_RETURN_IF_ERROR(CheckDelta(name, false));
+  int64 num_elements;
+  TF_RETURN_IF_ERROR(AddSliceMeta(name, shape, DataTypeToEnum<T>::value, slice,
+                                  &num_elements));
+
+  PendingSlice pending;
+  pending.name = name;
+  pending.slice = slice;
+  AddPending(EncodeTensorNameSlice(name, slice), data, num_elements,
+             std::move(pending));
+  return Status::OK();
+}
+
+template <typename T>
+Status TensorSliceWriter::AddRowsUnowned(const string& name,
+                                         const TensorShape& shape,
+                                         gtl::ArraySlice<int64> rows,
+                                         const T* data) {
+  TF_RETURN_IF_ERROR(CheckDelta(name, true));
+  if (shape.dims() < 1) {
+    return errors::InvalidArgument("Tensor ", name,
+                                   " must be at least 1-D to save its rows, "
+                                   "got shape ",
+                                   shape.DebugString());
+  }
+  const TensorSlice slice(shape.dims());
+  int64 num_elements;
+  TF_RETURN_IF_ERROR(AddSliceMeta(name, shape, DataTypeToEnum<T>::value, slice,
+                                  &num_elements));
+  const int64 num_rows = shape.dim_size(0);
+  for (const int64 row : rows) {
+    if (row < 0 || row >= num_rows) {
+      return errors::InvalidArgument("Row ", row, " of tensor ", name,
+                                     " is not in [0, ", num_rows, ")");
+    }
+  }
+
+  PendingSlice pending;
+  pending.name = name;
+  pending.slice = slice;
+  pending.rows.assign(rows.begin(), rows.end());
+  const int64 row_elements = num_rows == 0 ? 0 : num_elements / num_rows;
+  AddPending(EncodeTensorNameSlice(name, slice), data,
+             row_elements * static_cast<int64>(rows.size()),
+             std::move(pending));
+  return Status::OK();
+}
+
+template <typename T>
+void TensorSliceWriter::AddPending(const string& key, const T* data,
+                                   int64 num_elements, PendingSlice pending) {
+  const DataType dt = DataTypeToEnum<T>::value;
+  if (DataTypeCanUseMemcpy(dt) && port::kLittleEndian && num_elements > 0) {
+    pending.raw_data = reinterpret_cast<const char*>(data);
+    pending.raw_size = num_elements * sizeof(T);
+    // Chunks hold whole elements.
+    pending.chunk_size =
+        std::max(max_chunk_bytes_ / sizeof(T), size_t{1}) * sizeof(T);
+    has_chunks_ = true;
+  } else {
+    pending.fill = [data, num_elements](TensorProto* t) {
+      Fill(data, num_elements, t);
+    };
+  }
+  data_.insert(std::make_pair(key, std::move(pending)));
+  ++slices_;
+}
+
 template <typename T>
 void TensorSliceWriter::SaveData(const T* data, int num_elements,
                                  SavedSlice* ss) {
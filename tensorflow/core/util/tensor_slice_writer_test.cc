@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "tensorflow/core/util/tensor_slice_writer.h"
 
+#include "tensorflow/core/lib/core/status_test_util.h"
 #include "tensorflow/core/lib/core/stringpiece.h"
 #include "tensorflow/core/lib/io/path.h"
 #include "tensorflow/core/platform/logging.h"
@@ -116,6 +117,170 @@ TEST(TensorSliceWriteTest, SimpleWrite) {
   TensorSliceWriteTestHelper::CheckEntries(filename);
 }
 
+// Slices added with AddUnowned() are streamed in chunks, and can be read back
+// whole or in part.
+TEST(TensorSliceWriteTest, UnownedChunkedWrite) {
+  const string filename = io::JoinPath(testing::TmpDir(), "chunked");
+
+  // 16 byte chunks: 4 floats, 8 int16s, the last chunks are partial.
+  TensorSliceWriter writer(filename, CreateTableTensorSliceBuilder, 16);
+  float float_data[30];
+  for (int i = 0; i < 30; ++i) float_data[i] = i * 0.5f;
+  const int16 int16_data[] = {10, 11, 12, 13, 14};
+  const string string_data[] = {"a", "bc", "def"};
+  TF_CHECK_OK(writer.AddUnowned("floats", TensorShape({5, 6}),
+                                TensorSlice::ParseOrDie("-:-"), float_data));
+  TF_CHECK_OK(writer.AddUnowned("int16", TensorShape({5, 10}),
+                                TensorSlice::ParseOrDie("-:3,1"), int16_data));
+  TF_CHECK_OK(writer.AddUnowned("strings", TensorShape({3}),
+                                TensorSlice::ParseOrDie("-"), string_data));
+  // Copied slices can be mixed with unowned ones.
+  {
+    const int32 int32_data[] = {1, 2, 3};
+    TF_CHECK_OK(writer.Add("int32", TensorShape({3}),
+                           TensorSlice::ParseOrDie("-"), int32_data));
+  }
+  TF_CHECK_OK(writer.Finish());
+
+  {
+    TensorSliceReader::Table* tptr;
+    TF_CHECK_OK(OpenTableTensorSliceReader(filename, &tptr));
+    std::unique_ptr<TensorSliceReader::Table> table(tptr);
+    string value;
+    ASSERT_TRUE(table->Get(kSavedTensorSlicesKey, &value));
+    SavedTensorSlices sts;
+    ASSERT_TRUE(ParseProtoUnlimited(&sts, value));
+    EXPECT_EQ(2, sts.meta().versions().min_consumer());
+
+    SavedSlice ss;
+    TensorSliceWriteTestHelper::GetData(table.get(), "floats", TensorSlice(2),
+                                        &ss);
+    EXPECT_EQ(0, ss.data().float_val_size());
+    EXPECT_EQ(30 * sizeof(float), ss.chunks().size());
+    EXPECT_EQ(16, ss.chunks().chunk_size());
+    // 120 bytes in 16 byte chunks.
+    EXPECT_TRUE(table->Get(
+        EncodeTensorNameSliceChunk("floats", TensorSlice(2), 7), &value));
+    EXPECT_EQ(8 + sizeof(uint32), value.size());
+    EXPECT_FALSE(table->Get(
+        EncodeTensorNameSliceChunk("floats", TensorSlice(2), 8), &value));
+
+    TensorSliceWriteTestHelper::GetData(table.get(), "strings", TensorSlice(1),
+                                        &ss);
+    EXPECT_FALSE(ss.has_chunks());
+    EXPECT_EQ(3, ss.data().string_val_size());
+  }
+
+  TensorSliceReader reader(filename, OpenTableTensorSliceReader);
+  TF_ASSERT_OK(reader.status());
+  {
+    float copy[30];
+    EXPECT_TRUE(
+        reader.CopySliceData("floats", TensorSlice::ParseOrDie("-:-"), copy));
+    ExpectIdenticalFloatArrays(float_data, 30, copy);
+    float part[10];
+    EXPECT_TRUE(
+        reader.CopySliceData("floats", TensorSlice::ParseOrDie("-:2,2"), part));
+    for (int i = 0; i < 5; ++i) {
+      EXPECT_EQ(float_data[i * 6 + 2], part[i * 2]);
+      EXPECT_EQ(float_data[i * 6 + 3], part[i * 2 + 1]);
+    }
+  }
+  {
+    int16 copy[5];
+    EXPECT_TRUE(
+        reader.CopySliceData("int16", TensorSlice::ParseOrDie("-:3,1"), copy));
+    ExpectIdenticalIntArrays(int16_data, 5, copy);
+  }
+  {
+    string copy[3];
+    EXPECT_TRUE(
+        reader.CopySliceData("strings", TensorSlice::ParseOrDie("-"), copy));
+    for (int i = 0; i < 3; ++i) EXPECT_EQ(string_data[i], copy[i]);
+  }
+  {
+    int32 copy[3];
+    EXPECT_TRUE(
+        reader.CopySliceData("int32", TensorSlice::ParseOrDie("-"), copy));
+    EXPECT_EQ(1, copy[0]);
+    EXPECT_EQ(3, copy[2]);
+  }
+}
+
+// Delta checkpoints hold rows of their tensors, which are applied in place.
+TEST(TensorSliceWriteTest, DeltaWrite) {
+  const string filename = io::JoinPath(testing::TmpDir(), "delta");
+
+  TensorSliceWriter writer(filename, CreateTableTensorSliceBuilder, 8);
+  writer.SetDeltaBase("base_pattern");
+  // Rows 3 and 0 of a 4x3 tensor, written in 8 byte chunks.
+  const float float_rows[] = {30, 31, 32, 0, 1, 2};
+  TF_ASSERT_OK(writer.AddRowsUnowned("floats", TensorShape({4, 3}), {3, 0},
+                                     float_rows));
+  const string string_rows[] = {"b"};
+  TF_ASSERT_OK(
+      writer.AddRowsUnowned("strings", TensorShape({3}), {1}, string_rows));
+  // Tensors without changed rows are saved too.
+  TF_ASSERT_OK(writer.AddRowsUnowned<int32>("empty", TensorShape({2}), {},
+                                            nullptr));
+  // Rows must be in range, and whole tensors cannot be mixed in.
+  EXPECT_FALSE(
+      writer.AddRowsUnowned("bad", TensorShape({4, 3}), {4}, float_rows).ok());
+  EXPECT_FALSE(writer
+                   .AddUnowned("whole", TensorShape({2}),
+                               TensorSlice::ParseOrDie("-"), float_rows)
+                   .ok());
+  TF_ASSERT_OK(writer.Finish());
+
+  {
+    TensorSliceReader::Table* tptr;
+    TF_CHECK_OK(OpenTableTensorSliceReader(filename, &tptr));
+    std::unique_ptr<TensorSliceReader::Table> table(tptr);
+    string value;
+    ASSERT_TRUE(table->Get(kSavedTensorSlicesKey, &value));
+    SavedTensorSlices sts;
+    ASSERT_TRUE(ParseProtoUnlimited(&sts, value));
+    EXPECT_EQ(3, sts.meta().versions().min_consumer());
+    EXPECT_EQ("base_pattern", sts.meta().delta_base());
+
+    SavedSlice ss;
+    TensorSliceWriteTestHelper::GetData(table.get(), "floats", TensorSlice(2),
+                                        &ss);
+    ASSERT_EQ(2, ss.rows_size());
+    EXPECT_EQ(3, ss.rows(0));
+    EXPECT_EQ(0, ss.rows(1));
+    EXPECT_EQ(6 * sizeof(float), ss.chunks().size());
+  }
+
+  TensorSliceReader reader(filename, OpenTableTensorSliceReader);
+  TF_ASSERT_OK(reader.status());
+  EXPECT_EQ("base_pattern", reader.delta_base());
+  {
+    float copy[12];
+    EXPECT_FALSE(
+        reader.CopySliceData("floats", TensorSlice::ParseOrDie("-:-"), copy));
+    std::fill_n(copy, 12, -1.0f);
+    TF_EXPECT_OK(reader.CopyDeltaRows("floats", copy, 1, nullptr));
+    const float expected[] = {0, 1, 2, -1, -1, -1, -1, -1, -1, 30, 31, 32};
+    ExpectIdenticalFloatArrays(expected, 12, copy);
+  }
+  {
+    string copy[3] = {"x", "y", "z"};
+    TF_EXPECT_OK(reader.CopyDeltaRows("strings", copy, 1, nullptr));
+    EXPECT_EQ("x", copy[0]);
+    EXPECT_EQ("b", copy[1]);
+    EXPECT_EQ("z", copy[2]);
+  }
+  {
+    int32 copy[2] = {7, 8};
+    TF_EXPECT_OK(reader.CopyDeltaRows("empty", copy, 1, nullptr));
+    EXPECT_EQ(7, copy[0]);
+    EXPECT_EQ(8, copy[1]);
+    EXPECT_EQ(error::NOT_FOUND,
+              reader.CopyDeltaRows("missing", copy, 1, nullptr).code());
+  }
+}
+
 }  // namespace
 
 void TensorSliceWriteTestHelper::GetData(TensorSliceReader::Table* table,
@@ -108,6 +108,16 @@ class BatchMatmulOpTest(tf.test.TestCase):
                     self._randFloat([10, 30, 75]), False, True, use_gpu)
       self._compare(self._randFloat([10, 75, 64]),
                     self._randFloat([10, 30, 75]), True, True, use_gpu)
+      self._compare(self._randFloat([3, 100, 80]),
+                    self._randFloat([3, 80, 90]), False, False, use_gpu)
+
+  def testSquareFloat(self):
+    # Includes the sizes with fixed-size CPU kernels.
+    for n in [2, 3, 4, 8, 16, 17]:
+      for adj_x in [False, True]:
+        for adj_y in [False, True]:
+          self._compare(self._randFloat([6, n, n]), self._randFloat([6, n, n]),
+                        adj_x, adj_y)
 
   def testHighNDims(self):
     for use_gpu in [False, True]:
@@ -137,6 +147,12 @@ class BatchMatmulOpTest(tf.test.TestCase):
     self._compare(self._randComplex([7, 3, 2]),
                   self._randComplex([7, 5, 3]), True, True)
 
+  def testSquareComplex(self):
+    for adj_x in [False, True]:
+      for adj_y in [False, True]:
+        self._compare(self._randComplex([3, 4, 4]),
+                      self._randComplex([3, 4, 4]), adj_x, adj_y)
+
   def testLargeComplex(self):
     self._compare(self._randComplex([10, 64, 75]),
                   self._randComplex([10, 75, 30]), False,
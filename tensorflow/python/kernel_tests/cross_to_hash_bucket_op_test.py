@@ -0,0 +1,67 @@
+# Copyright 2016 Google Inc. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# ==============================================================================
+
+"""Tests for CrossToHashBucket op from string_ops."""
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+
+import tensorflow as tf
+
+
+class CrossToHashBucketOpTest(tf.test.TestCase):
+
+  def testCross(self):
+    with self.test_session():
+      output = tf.cross_to_hash_bucket(
+          [tf.constant([['a', 'b'], ['c', 'a']]),
+           tf.constant([[1, 2], [3, 1]], dtype=tf.int64)],
+          1000, key=[98765, 132])
+      self.assertEqual([2, 2], output.get_shape())
+      # The keyed hash is stable, so the buckets never change.
+      self.assertAllEqual([[937, 635], [728, 937]], output.eval())
+
+  def testSingleFeatureMatchesStringToHashBucketStrong(self):
+    with self.test_session():
+      strings = tf.constant(['a', 'b', 'c', 'd'])
+      cross = tf.cross_to_hash_bucket([strings], 1 << 30, key=[1, 2])
+      buckets = tf.string_to_hash_bucket_strong(strings, 1 << 30, key=[1, 2])
+      self.assertAllEqual(buckets.eval(), cross.eval())
+
+  def testCrossDependsOnOrder(self):
+    with self.test_session():
+      x = tf.constant(['a', 'b', 'c'])
+      y = tf.constant(['d', 'e', 'f'])
+      xy = tf.cross_to_hash_bucket([x, y], 1 << 30, key=[1, 2])
+      yx = tf.cross_to_hash_bucket([y, x], 1 << 30, key=[1, 2])
+      self.assertFalse((xy.eval() == yx.eval()).any())
+
+  def testDifferentShapes(self):
+    with self.test_session():
+      x = tf.placeholder(tf.string)
+      y = tf.placeholder(tf.int64)
+      output = tf.cross_to_hash_bucket([x, y], 10, key=[1, 2])
+      with self.assertRaisesOpError('All inputs must have the same shape'):
+        output.eval(feed_dict={x: ['a', 'b'], y: [1, 2, 3]})
+
+  def testStaticShapeMismatch(self):
+    with self.assertRaises(ValueError):
+      tf.cross_to_hash_bucket(
+          [tf.constant(['a', 'b']), tf.constant([1, 2, 3], dtype=tf.int64)],
+          10, key=[1, 2])
+
+
+if __name__ == '__main__':
+  tf.test.main()
@@ -231,6 +231,47 @@ class FIFOQueueTest(tf.test.TestCase):
       dequeued_t.op.run()
       self.assertEqual(0, size.eval())
 
+  def testStepStatsAnnotation(self):
+    with self.test_session() as sess:
+      q = tf.FIFOQueue(10, tf.float32, shapes=())
+      enqueue_op = q.enqueue_many(([10.0, 20.0, 30.0],))
+      dequeued_t = q.dequeue_many(2)
+      enqueue_op.run()
+
+      run_options = tf.RunOptions(trace_level=tf.RunOptions.FULL_TRACE)
+      run_metadata = tf.RunMetadata()
+      sess.run(dequeued_t, options=run_options, run_metadata=run_metadata)
+      labels = [node_stats.timeline_label
+                for dev_stats in run_metadata.step_stats.dev_stats
+                for node_stats in dev_stats.node_stats]
+      self.assertTrue(
+          any("[dequeued 2 after waiting " in label and
+              "us, queue size 1]" in label for label in labels), labels)
+
+  def testStats(self):
+    with self.test_session():
+      q = tf.FIFOQueue(10, tf.float32, shapes=(), shared_name="stats_queue")
+      enqueue_op = q.enqueue_many(([10.0, 20.0, 30.0],))
+      dequeued_t = q.dequeue_many(2)
+      stats = q.stats()
+      self.assertEqual([], stats.get_shape())
+
+      enqueue_op.run()
+      dequeued_t.op.run()
+      summary = tf.Summary()
+      summary.ParseFromString(stats.eval())
+      values = {v.tag: v for v in summary.value}
+      self.assertEqual(1, values["queue/stats_queue/size"].simple_value)
+      self.assertEqual(3, values["queue/stats_queue/enqueued"].simple_value)
+      self.assertEqual(2, values["queue/stats_queue/dequeued"].simple_value)
+      self.assertEqual(
+          1, values["queue/stats_queue/enqueue_wait_usecs"].histo.num)
+      self.assertEqual(
+          1, values["queue/stats_queue/dequeue_wait_usecs"].histo.num)
+      self.assertEqual(2, values["queue/stats_queue/occupancy"].histo.num)
+      self.assertEqual(
+          2, values["queue/stats_queue/occupancy/mean"].simple_value)
+
   def testEnqueueMany(self):
     with self.test_session():
       q = tf.FIFOQueue(10, tf.float32)
@@ -542,6 +583,36 @@ class FIFOQueueTest(tf.test.TestCase):
       enqueue_thread.join()
       self.assertEqual(0, q.size().eval())
 
+  def testEnqueueManyAndDequeueManyWrapAround(self):
+    with self.test_session():
+      q = tf.FIFOQueue(100, (tf.int32, tf.string), shapes=((2,), ()))
+      count_placeholder = tf.placeholder(tf.int32, shape=())
+      int_placeholder = tf.placeholder(tf.int32, shape=(None, 2))
+      string_placeholder = tf.placeholder(tf.string, shape=(None,))
+      enqueue_op = q.enqueue_many((int_placeholder, string_placeholder))
+      dequeued_t = q.dequeue_many(count_placeholder)
+
+      # Interleave batches of different sizes so that they cross the end of
+      # the queue's storage, which also grows while the queue is not empty.
+      elements_enqueued = 0
+      elements_dequeued = 0
+      for count in [3, 2, 14, 60, 30, 50, 95]:
+        if elements_enqueued - elements_dequeued < count:
+          elems = np.arange(elements_enqueued, elements_enqueued + count,
+                            dtype=np.int32)
+          enqueue_op.run({int_placeholder: np.stack([elems, -elems], axis=1),
+                          string_placeholder: [str(x) for x in elems]})
+          elements_enqueued += count
+        else:
+          elems = np.arange(elements_dequeued, elements_dequeued + count,
+                            dtype=np.int32)
+          int_val, string_val = dequeued_t.eval({count_placeholder: count})
+          self.assertAllEqual(np.stack([elems, -elems], axis=1), int_val)
+          self.assertAllEqual([str(x).encode() for x in elems], string_val)
+          elements_dequeued += count
+      self.assertEqual(elements_enqueued - elements_dequeued,
+                       q.size().eval())
+
   def testBlockingDequeueMany(self):
     with self.test_session() as sess:
       q = tf.FIFOQueue(10, tf.float32, ())
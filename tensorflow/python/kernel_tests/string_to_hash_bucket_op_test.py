@@ -46,6 +46,29 @@ class StringToHashBucketOpTest(tf.test.TestCase):
       # Hash64('c') -> 14899841994519054197 -> mod 10 -> 7
       self.assertAllEqual([8, 0, 7], result)
 
+  def testStringToHashBucketsStrong(self):
+    with self.test_session():
+      input_string = tf.constant(['a', 'b', 'c'])
+      output = tf.string_to_hash_bucket_strong(input_string, 10,
+                                               key=[98765, 132])
+      # The keyed hash is stable, so the buckets never change.
+      self.assertAllEqual([4, 2, 8], output.eval())
+
+  def testStringToHashBucketsStrongDependsOnKey(self):
+    with self.test_session():
+      input_string = tf.constant(['a', 'b', 'c', 'd', 'e', 'f'])
+      output1 = tf.string_to_hash_bucket_strong(input_string, 1 << 30,
+                                                key=[1, 2])
+      output2 = tf.string_to_hash_bucket_strong(input_string, 1 << 30,
+                                                key=[2, 1])
+      self.assertFalse((output1.eval() == output2.eval()).any())
+
+  def testStringToHashBucketsStrongInvalidKey(self):
+    with self.test_session():
+      output = tf.string_to_hash_bucket_strong(['a'], 10, key=[98765])
+      with self.assertRaisesOpError('Key must have 2 elements'):
+        output.eval()
+
 
 if __name__ == '__main__':
   tf.test.main()
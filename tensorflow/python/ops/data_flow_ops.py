@@ -388,6 +388,26 @@ class QueueBase(object):
       name = "%s_Size" % self._name
     return gen_data_flow_ops._queue_size(self._queue_ref, name=name)
 
+  def stats(self, name=None):
+    """Returns a summary with statistics about this queue.
+
+    The summary reports how many elements went through the queue and at
+    what rate, how long enqueue and dequeue operations blocked, and how full
+    the queue was.  Rates are computed over the time since the previous
+    evaluation of a `stats()` op for this queue.
+
+    Args:
+      name: A name for the operation (optional).
+
+    Returns:
+      A scalar `Tensor` of type `string`. The serialized `Summary` protocol
+      buffer, which can be passed to a `SummaryWriter` or merged with other
+      summaries.
+    """
+    if name is None:
+      name = "%s_Stats" % self._name
+    return gen_data_flow_ops._queue_stats(self._queue_ref, name=name)
+
 
 class RandomShuffleQueue(QueueBase):
   """A queue implementation that dequeues elements in a random order.
@@ -578,12 +598,16 @@ def initialize_all_tables(name="init_all_tables"):
 
 
 ops.NoGradient("LookupTableFind")
+ops.NoGradient("LookupTableInsert")
 ops.NoGradient("LookupTableSize")
+ops.NoGradient("LookupTableExport")
 ops.NoGradient("HashTable")
+ops.NoGradient("MutableHashTable")
 ops.NoGradient("InitializeTable")
 
 
 ops.RegisterShape("QueueSize")(common_shapes.scalar_shape)
+ops.RegisterShape("QueueStats")(common_shapes.scalar_shape)
 ops.RegisterShape("Queue")(common_shapes.scalar_shape)
 ops.RegisterShape("FIFOQueue")(common_shapes.scalar_shape)
 ops.RegisterShape("PaddingFIFOQueue")(common_shapes.scalar_shape)
@@ -660,6 +684,21 @@ def _LookupTableFindShape(op):
   return [shape_in]
 
 
+@ops.RegisterShape("LookupTableInsert")
+def _LookupTableInsertShape(op):
+  """Shape function for data_flow_ops._lookup_table_insert."""
+  op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  op.inputs[2].get_shape().merge_with(op.inputs[1].get_shape())
+  return []
+
+
+@ops.RegisterShape("LookupTableExport")
+def _LookupTableExportShape(op):
+  """Shape function for data_flow_ops._lookup_table_export."""
+  op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  return [tensor_shape.vector(None), tensor_shape.vector(None)]
+
+
 @ops.RegisterShape("LookupTableSize")
 def _LookupTableSizeShape(op):
   """Shape function for data_flow_ops._lookup_table_find."""
@@ -673,6 +712,12 @@ def _HashTableShape(_):
   return [tensor_shape.scalar()]
 
 
+@ops.RegisterShape("MutableHashTable")
+def _MutableHashTableShape(_):
+  """Shape function for data_flow_ops._mutable_hash_table."""
+  return [tensor_shape.scalar()]
+
+
 @ops.RegisterShape("InitializeTable")
 def _InitializeLookupTableShape(op):
   """Shape function for data_flow_ops._initialize_table."""
@@ -25,6 +25,7 @@ from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import constant_op
 from tensorflow.python.ops import data_flow_ops
+from tensorflow.python.ops import gen_math_ops
 from tensorflow.python.ops import math_ops
 
 
@@ -258,6 +259,22 @@ def embedding_lookup_sparse(params, sp_ids, sp_weights,
     if segment_ids.dtype != dtypes.int32:
       segment_ids = math_ops.cast(segment_ids, dtypes.int32)
 
+    if (len(params) == 1 and
+        params[0].dtype.base_dtype in (dtypes.float32, dtypes.float64)):
+      # A single embedding tensor is looked up and combined by one kernel,
+      # which does not materialize the gathered rows.
+      with ops.colocate_with(params[0]):
+        embeddings = ops.convert_to_tensor(params[0], name="params")
+      if ignore_weights:
+        weights = array_ops.zeros([0], dtype=embeddings.dtype)
+      else:
+        weights = sp_weights.values
+        if weights.dtype != embeddings.dtype:
+          weights = math_ops.cast(weights, embeddings.dtype)
+      return gen_math_ops._embedding_lookup_sparse(
+          embeddings, sp_ids.values, weights, segment_ids, combiner=combiner,
+          name=name)
+
     ids = sp_ids.values
     if ignore_weights:
       ids, idx = array_ops.unique(ids)
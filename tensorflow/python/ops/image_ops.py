@@ -30,6 +30,7 @@ to be stripped from the image and re-attached using slicing ops.
 
 @@decode_jpeg
 @@encode_jpeg
+@@decode_crop_and_resize_jpeg
 
 @@decode_png
 @@encode_png
@@ -908,6 +909,24 @@ def _ImageDecodeShape(op):
   return [tensor_shape.TensorShape([None, None, channels])]
 
 
+@ops.RegisterShape('DecodeCropAndResizeJpeg')
+def _DecodeCropAndResizeJpegShape(op):
+  """Shape function for the DecodeCropAndResizeJpeg op."""
+  unused_input_shape = op.inputs[0].get_shape().merge_with(
+      tensor_shape.scalar())
+  unused_crop_window_shape = op.inputs[1].get_shape().merge_with([4])
+  unused_size_shape = op.inputs[2].get_shape().merge_with([2])
+  size = tensor_util.constant_value(op.inputs[2])
+  if size is not None:
+    height = size[0]
+    width = size[1]
+  else:
+    height = None
+    width = None
+  channels = op.get_attr('channels') or None
+  return [tensor_shape.TensorShape([height, width, channels])]
+
+
 @ops.RegisterShape('EncodeJpeg')
 @ops.RegisterShape('EncodePng')
 def _ImageEncodeShape(op):
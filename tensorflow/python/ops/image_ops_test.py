@@ -1200,6 +1200,50 @@ class JpegTest(test_util.TensorFlowTestCase):
         self.assertEqual(image.get_shape().as_list(),
                          [None, None, channels or None])
 
+  def _decodeCropAndResize(self, path, crop_window, size):
+    with self.test_session() as sess:
+      jpeg = io_ops.read_file(path)
+      image = image_ops.decode_jpeg(jpeg)
+      crop = array_ops.slice(image, crop_window[:2] + [0],
+                             crop_window[2:] + [-1])
+      resized = image_ops.resize_bilinear(array_ops.expand_dims(crop, 0), size)
+      fused = image_ops.decode_crop_and_resize_jpeg(jpeg, crop_window, size)
+      self.assertEqual(fused.get_shape().as_list(), size + [None])
+      return sess.run([resized[0], fused])
+
+  def testDecodeCropAndResizeFullScale(self):
+    # Shrinking by less than 2 decodes at full scale, with the same result as
+    # the separate ops.
+    base = 'tensorflow/core/lib/jpeg/testdata'
+    for filename in 'jpeg_merge_test1.jpg', 'jpeg_merge_test1_cmyk.jpg':
+      resized, fused = self._decodeCropAndResize(
+          os.path.join(base, filename), [10, 20, 100, 80], [60, 50])
+      self.assertAllClose(resized, fused)
+
+  def testDecodeCropAndResizeScaled(self):
+    # A smooth ramp is close to the separate ops at any scale.
+    ramp = _SimpleColorRamp()
+    path = os.path.join(self.get_temp_dir(), 'ramp.jpg')
+    with self.test_session():
+      with open(path, 'wb') as f:
+        f.write(image_ops.encode_jpeg(constant_op.constant(ramp)).eval())
+    height, width = ramp.shape[:2]
+    for size in [height // 2, width // 2], [height // 8, width // 8]:
+      resized, fused = self._decodeCropAndResize(
+          path, [0, 0, height, width], size)
+      self.assertLess(self.averageError(resized, fused), 1.5)
+    resized, fused = self._decodeCropAndResize(path, [3, 5, 100, 150],
+                                               [20, 30])
+    self.assertLess(self.averageError(resized, fused), 1.5)
+
+  def testDecodeCropAndResizeInvalidWindow(self):
+    path = 'tensorflow/core/lib/jpeg/testdata/jpeg_merge_test1.jpg'
+    with self.test_session():
+      fused = image_ops.decode_crop_and_resize_jpeg(
+          io_ops.read_file(path), [200, 0, 100, 100], [10, 10])
+      with self.assertRaisesOpError('does not fit in the image'):
+        fused.eval()
+
 
 class PngTest(test_util.TensorFlowTestCase):
 
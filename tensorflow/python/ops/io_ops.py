@@ -48,6 +48,7 @@ formats into tensors.
 
 @@decode_csv
 @@decode_raw
+@@decode_column_block
 
 - - -
 
@@ -177,6 +178,85 @@ def _save(filename, tensor_names, tensors, tensor_slices=None, name="save"):
                                    tensors, name=name)
 
 
+def _save_async(filename, tensor_names, tensors, tensor_slices=None,
+                name="save_async"):
+  """Save a list of tensors to a file with given names, in the background.
+
+  Like `_save`, except that the op returns as soon as it has copied `tensors`,
+  and the copies are written by a background thread. Use `_wait_for_save` to
+  wait for the write to finish and to get its status.
+
+  Args:
+    filename: the file name of the sstable.
+    tensor_names: a list of strings.
+    tensors: the list of tensors to be saved.
+    tensor_slices: Optional list of strings to specify the shape and slices of
+      a larger virtual tensor that each tensor is a part of.  If not specified
+      each tensor is saved as a full slice.
+    name: string.  Optional name for the op.
+
+  Returns:
+    An Operation that starts saving the tensors.
+  """
+  if tensor_slices is None:
+    tensor_slices = [""] * len(tensors)
+  return gen_io_ops._save_slices_async(filename, tensor_names, tensor_slices,
+                                       tensors, name=name)
+
+
+def _wait_for_save(filename, name="wait_for_save"):
+  """Wait for the background saves to a file to finish.
+
+  Args:
+    filename: the file name passed to `_save_async`.
+    name: string.  Optional name for the op.
+
+  Returns:
+    An Operation that completes once the saves started so far have finished,
+    and fails if any of them failed.
+  """
+  return gen_io_ops._wait_for_save(filename, name=name)
+
+
+def _save_delta(filename, base, tensor_names, rows, tensors,
+                name="save_delta"):
+  """Save the changed rows of a list of tensors to a delta checkpoint.
+
+  Args:
+    filename: the file name of the sstable.
+    base: the file pattern of the checkpoint that the rows apply to.
+    tensor_names: a list of strings.
+    rows: a list of int64 vectors, the rows of each tensor to save, usually
+      obtained with `take_dirty_rows`. Commit them with `commit_dirty_rows`
+      once this operation succeeds.
+    tensors: the list of tensors whose rows to save.
+    name: string.  Optional name for the op.
+
+  Returns:
+    An Operation that saves the rows.
+  """
+  return gen_io_ops._save_delta(filename, base, tensor_names, rows, tensors,
+                                name=name)
+
+
+def _restore_delta(file_pattern, tensor_name, tensor_type,
+                   name="restore_delta"):
+  """Restore a tensor from a chain of delta checkpoints.
+
+  Args:
+    file_pattern: the file pattern of the newest checkpoint of the chain.
+    tensor_name: the name of the tensor to restore.
+    tensor_type: the type of the tensor to restore.
+    name: string.  Optional name for the op.
+
+  Returns:
+    A tensor of type "tensor_type".
+  """
+  base_type = dtypes.as_dtype(tensor_type).base_dtype
+  return gen_io_ops._restore_delta(file_pattern, tensor_name, base_type,
+                                   name=name)
+
+
 def _restore_slice(file_pattern, tensor_name, shape_and_slice, tensor_type,
                    name="restore_slice", preferred_shard=-1):
   """Restore a tensor slice from a set of files with a given pattern.
@@ -253,6 +333,39 @@ def _SaveSlicesShape(op):
   return []
 
 
+@ops.RegisterShape("SaveSlicesAsync")
+def _SaveSlicesAsyncShape(op):
+  """Shape function for SaveSlicesAsync op."""
+  return _SaveSlicesShape(op)
+
+
+@ops.RegisterShape("WaitForSave")
+def _WaitForSaveShape(op):
+  """Shape function for WaitForSave op."""
+  unused_filename = op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  return []
+
+
+@ops.RegisterShape("SaveDelta")
+def _SaveDeltaShape(op):
+  """Shape function for SaveDelta op."""
+  # Validate input shapes.
+  unused_filename = op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  unused_base = op.inputs[1].get_shape().merge_with(tensor_shape.scalar())
+  data_count = (len(op.inputs) - 3) // 2
+  unused_tensor_names_shape = op.inputs[2].get_shape().merge_with(
+      tensor_shape.vector(data_count))
+  for rows in op.inputs[3:3 + data_count]:
+    unused_rows_shape = rows.get_shape().merge_with(tensor_shape.vector(None))
+  return []
+
+
+@ops.RegisterShape("RestoreDelta")
+def _RestoreDeltaShape(op):
+  """Shape function for RestoreDelta op."""
+  return _RestoreShape(op)
+
+
 @ops.RegisterShape("ShardedFilename")
 def _ShardedFilenameShape(op):
   """Shape function for ShardedFilename op."""
@@ -25,6 +25,7 @@ from tensorflow.python.framework import ops
 from tensorflow.python.ops import array_ops
 from tensorflow.python.ops import constant_op
 from tensorflow.python.ops import gen_array_ops
+from tensorflow.python.ops import gen_math_ops
 from tensorflow.python.ops import math_ops
 
 
@@ -146,6 +147,17 @@ def _SparseSegmentSqrtNGrad(op, grad):
           None, None)
 
 
+@ops.RegisterGradient("EmbeddingLookupSparse")
+def _EmbeddingLookupSparseGrad(op, grad):
+  """Gradient for EmbeddingLookupSparse."""
+  params, ids, weights, segment_ids = op.inputs
+  params_grad, weights_grad = gen_math_ops._embedding_lookup_sparse_grad(
+      grad, params, ids, weights, segment_ids, op.outputs[0],
+      combiner=op.get_attr("combiner"))
+  return (ops.IndexedSlices(params_grad, ids, array_ops.shape(params)),
+          None, weights_grad, None)
+
+
 def _SegmentMinOrMaxGrad(op, grad):
   """Gradient for SegmentMin and SegmentMax. Both share the same code."""
   zeros = array_ops.zeros(array_ops.shape(op.inputs[0]),
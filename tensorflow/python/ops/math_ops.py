@@ -1496,6 +1496,28 @@ def _SparseSegmentReductionShape(op):
   return [tensor_shape.TensorShape([None]).concatenate(data_shape[1:])]
 
 
+@ops.RegisterShape("EmbeddingLookupSparse")
+def _EmbeddingLookupSparseShape(op):
+  """Shape function for EmbeddingLookupSparse."""
+  params_shape = op.inputs[0].get_shape().with_rank_at_least(1)
+  ids_shape = op.inputs[1].get_shape().with_rank(1)
+  unused_weights_shape = op.inputs[2].get_shape().with_rank(1)
+  segment_ids_shape = op.inputs[3].get_shape().with_rank(1)
+  ids_shape.assert_is_compatible_with(segment_ids_shape)
+  return [tensor_shape.TensorShape([None]).concatenate(params_shape[1:])]
+
+
+@ops.RegisterShape("EmbeddingLookupSparseGrad")
+def _EmbeddingLookupSparseGradShape(op):
+  """Shape function for EmbeddingLookupSparseGrad."""
+  params_shape = op.inputs[1].get_shape().with_rank_at_least(1)
+  ids_shape = op.inputs[2].get_shape().with_rank(1)
+  weights_shape = op.inputs[3].get_shape().with_rank(1)
+  segment_ids_shape = op.inputs[4].get_shape().with_rank(1)
+  ids_shape = ids_shape.merge_with(segment_ids_shape)
+  return [ids_shape.concatenate(params_shape[1:]), weights_shape]
+
+
 @ops.RegisterShape("SparseSegmentMeanGrad")
 @ops.RegisterShape("SparseSegmentSqrtNGrad")
 
@@ -926,6 +926,15 @@ def _DecodeRawShape(op):  # pylint: disable=invalid-name
   return [op.inputs[0].get_shape().concatenate([None])]
 
 
+@ops.RegisterShape("DecodeColumnBlock")
+def _DecodeColumnBlockShape(op):  # pylint: disable=invalid-name
+  """Shape function for the DecodeColumnBlock op."""
+  op.inputs[0].get_shape().merge_with(tensor_shape.scalar())
+  # NOTE: The number of rows is data-dependent.
+  return [tensor_shape.vector(None).concatenate(row_shape)
+          for row_shape in op.get_attr("row_shapes")]
+
+
 @ops.RegisterShape("DecodeCSV")
 def _DecodeCSVShape(op):  # pylint: disable=invalid-name
   """Shape function for the DecodeCSV op."""
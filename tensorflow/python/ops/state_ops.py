@@ -223,6 +223,16 @@ def _CountUpToShape(op):
   return [op.inputs[0].get_shape().merge_with(tensor_shape.scalar())]
 
 
+@ops.RegisterShape("TakeDirtyRows")
+def _TakeDirtyRowsShape(op):
+  """Shape function for the TakeDirtyRows op."""
+  unused_var_shape = op.inputs[0].get_shape().with_rank_at_least(1)
+  return [tensor_shape.vector(None)]
+
+
+ops.RegisterShape("CommitDirtyRows")(common_shapes.no_outputs)
+
+
 @ops.RegisterShape("ScatterAdd")
 @ops.RegisterShape("ScatterSub")
 @ops.RegisterShape("ScatterUpdate")
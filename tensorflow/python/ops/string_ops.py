@@ -19,6 +19,8 @@ String hashing ops take a string input tensor and map each element to an
 integer.
 
 @@string_to_hash_bucket
+@@string_to_hash_bucket_strong
+@@cross_to_hash_bucket
 
 ## Joining
 
@@ -47,9 +49,21 @@ from tensorflow.python.ops.gen_string_ops import *
 # pylint: enable=wildcard-import
 
 ops.NoGradient("StringToHashBucket")
+ops.NoGradient("StringToHashBucketStrong")
+ops.NoGradient("CrossToHashBucket")
 ops.NoGradient("ReduceJoin")
 
 ops.RegisterShape("StringToHashBucket")(common_shapes.unchanged_shape)
+ops.RegisterShape("StringToHashBucketStrong")(common_shapes.unchanged_shape)
+
+
+@ops.RegisterShape("CrossToHashBucket")
+def _CrossToHashBucketShape(op):
+  """Shape function for the CrossToHashBucket op."""
+  shape = tensor_shape.unknown_shape()
+  for x in op.inputs:
+    shape = shape.merge_with(x.get_shape())
+  return [shape]
 
 
 @ops.RegisterShape("ReduceJoin")